@@ -0,0 +1,389 @@
+/*
+状态机学习（编译期状态转移表）
+
+night8 的问题：
+FSM::initFSMTable() 每构造一个状态机就 new 13 个 FSMItem，析构时再 delete
+大量创建状态机时，堆分配 + 线性查表 成为主要开销
+
+night12 针对此状态机的修改：
+1. 状态转移表改成 constexpr 数组，由一个“定义类型”提供（类型即 DSL）
+2. 编译期检查：重复转移（同一现态+同一事件出现两次）、不可达现态 -> static_assert 直接报错
+3. 编译期生成 [状态][事件] -> 表项下标 的跳转表，handleEvent 只需一次查表，O(1)
+4. StaticFSM 对象只保存 现态/上一状态/进入时间，构造零堆分配
+*/
+#include <iostream>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+
+using namespace std;
+
+enum class State : uint8_t {
+    GETUP = 0,
+    GO_SCHOOL,
+    EAT,
+    DO_HOMEWORK,
+    GO_SLEEP,
+    TIMEOUT,
+    ERROR,
+
+    COUNT           // 状态个数，必须放最后
+};
+
+enum class Events : uint8_t {
+    EVENT1 = 0,
+    EVENT2,
+    EVENT3,
+    EVENT_TIMEOUT,
+
+    COUNT           // 事件个数，必须放最后
+};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+
+//状态转移项：现态 + 条件 -> 动作 + 次态
+struct Transition {
+    State curState;         // 现态
+    Events event;           // 条件
+    void(*action)();        // 动作
+    State nextState;        // 次态
+};
+
+// ---------- 编译期检查 ----------
+
+//同一个 (现态,事件) 只能出现一次，否则查表结果有歧义
+template <size_t N>
+constexpr bool hasDuplicate(const Transition (&t)[N]) {
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++)
+            if (t[i].curState == t[j].curState && t[i].event == t[j].event)
+                return true;
+    return false;
+}
+
+//从初始状态出发做一次遍历，求所有可达状态
+//errorState：非法事件时状态机会自动转入的状态，视为可达
+template <size_t N>
+constexpr array<bool, STATE_COUNT> reachableStates(const Transition (&t)[N], State init, State errorState) {
+    array<bool, STATE_COUNT> reach{};
+    reach[static_cast<size_t>(init)] = true;
+    reach[static_cast<size_t>(errorState)] = true;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < N; i++) {
+            if (reach[static_cast<size_t>(t[i].curState)] && !reach[static_cast<size_t>(t[i].nextState)]) {
+                reach[static_cast<size_t>(t[i].nextState)] = true;
+                changed = true;
+            }
+        }
+    }
+    return reach;
+}
+
+//每条转移的现态都必须可达，否则这条转移永远不会被执行
+template <size_t N>
+constexpr bool hasUnreachable(const Transition (&t)[N], State init, State errorState) {
+    auto reach = reachableStates(t, init, errorState);
+    for (size_t i = 0; i < N; i++)
+        if (!reach[static_cast<size_t>(t[i].curState)])
+            return true;
+    return false;
+}
+
+//生成跳转表：jump[state * EVENT_COUNT + event] = 表项下标，NO_TRANSITION 表示没有此转移
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+template <size_t N>
+constexpr array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    static_assert(N < NO_TRANSITION, "too many transitions for uint8_t jump table");
+    array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+const char* stateName(State s) {
+    switch (s) {
+    case State::GETUP:        return "GETUP";
+    case State::GO_SCHOOL:    return "GO_SCHOOL";
+    case State::EAT:          return "EAT";
+    case State::DO_HOMEWORK:  return "DO_HOMEWORK";
+    case State::GO_SLEEP:     return "GO_SLEEP";
+    case State::TIMEOUT:      return "TIMEOUT";
+    case State::ERROR:        return "ERROR";
+    default:                  return "UNKNOWN";
+    }
+}
+
+/*
+编译期状态机
+Def 需要提供：
+    static constexpr Transition table[]             状态转移表
+    static constexpr State initial                  初始状态
+    static constexpr State error                    非法事件转入的状态
+    static constexpr bool verbose                   是否打印状态切换
+    static void onError()                           非法事件动作
+    static std::chrono::milliseconds timeoutOf(State) 每个状态的超时
+*/
+template <typename Def>
+class StaticFSM {
+    static_assert(!hasDuplicate(Def::table), "FSM table has duplicate (state, event) transitions");
+    static_assert(!hasUnreachable(Def::table, Def::initial, Def::error), "FSM table has transitions from unreachable states");
+
+    static constexpr auto kJump = buildJumpTable(Def::table);
+
+public:
+    StaticFSM(State curState = Def::initial)
+        : _curState(curState),
+          _lastState(curState),
+          _enterTime(std::chrono::steady_clock::now()) {}
+
+    State state() const { return _curState; }
+    State lastState() const { return _lastState; }
+
+    void transferState(State nextState) {
+        _lastState = _curState;
+        _curState = nextState;
+        _enterTime = std::chrono::steady_clock::now();
+
+        if constexpr (Def::verbose)
+            cout << "[STATE] -> " << stateName(_curState) << endl;
+    }
+
+    //超时检测（主循环里周期调用）
+    void tick() {
+        auto to = Def::timeoutOf(_curState);
+        if (to.count() <= 0) return;
+
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - _enterTime);
+
+        if (elapsed > to) {
+            if constexpr (Def::verbose)
+                cout << "[TICK] " << stateName(_curState)
+                     << " elapsed=" << elapsed.count() << "ms"
+                     << " > timeout=" << to.count() << "ms" << endl;
+
+            handleEvent(Events::EVENT_TIMEOUT);
+        }
+    }
+
+    //一次查表得到表项，不再遍历整个转移表
+    void handleEvent(Events event) {
+        uint8_t i = kJump[static_cast<size_t>(_curState) * EVENT_COUNT + static_cast<size_t>(event)];
+        if (i != NO_TRANSITION) {
+            const Transition& t = Def::table[i];
+            if (t.action) t.action();
+            transferState(t.nextState);
+        } else {
+            if constexpr (Def::verbose)
+                cout << "[ERROR] no transition: state=" << stateName(_curState)
+                     << " event=" << static_cast<int>(event) << endl;
+
+            Def::onError();
+            transferState(Def::error);
+        }
+    }
+
+private:
+    State _curState;
+    State _lastState;
+    std::chrono::steady_clock::time_point _enterTime;
+};
+
+// ---------- 学生状态机定义（与 night8 相同的转移关系） ----------
+struct StudentActions {
+    static void getup()       { cout << "you should get up!!" << endl; }
+    static void go_school()   { cout << "you should go school!!" << endl; }
+    static void eat()         { cout << "you should eat!!" << endl; }
+    static void do_homework() { cout << "you should do homework!!" << endl; }
+    static void go_sleep()    { cout << "you should go sleep!!" << endl; }
+    static void on_timeout()  { cout << "[TIMEOUT] state timeout happened!" << endl; }
+    static void on_error()    { cout << "[ERROR] invalid event for current state!" << endl; }
+};
+
+struct StudentFSMDef {
+    using A = StudentActions;
+
+    static constexpr Transition table[] = {
+        // 正常流程
+        {State::GETUP,       Events::EVENT1, &A::getup,       State::GO_SCHOOL},
+        {State::GO_SCHOOL,   Events::EVENT2, &A::go_school,   State::EAT},
+        {State::EAT,         Events::EVENT3, &A::eat,         State::DO_HOMEWORK},
+        {State::DO_HOMEWORK, Events::EVENT1, &A::do_homework, State::GO_SLEEP},
+        {State::GO_SLEEP,    Events::EVENT2, &A::go_sleep,    State::GETUP},
+
+        // 任何正常态超时 -> TIMEOUT
+        {State::GETUP,       Events::EVENT_TIMEOUT, &A::on_timeout, State::TIMEOUT},
+        {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, &A::on_timeout, State::TIMEOUT},
+        {State::EAT,         Events::EVENT_TIMEOUT, &A::on_timeout, State::TIMEOUT},
+        {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, &A::on_timeout, State::TIMEOUT},
+        {State::GO_SLEEP,    Events::EVENT_TIMEOUT, &A::on_timeout, State::TIMEOUT},
+
+        // TIMEOUT 态的恢复策略
+        {State::TIMEOUT, Events::EVENT1, &A::getup,    State::GETUP},
+        {State::TIMEOUT, Events::EVENT3, &A::on_error, State::ERROR},
+
+        // ERROR 态恢复策略
+        {State::ERROR, Events::EVENT1, &A::getup, State::GETUP},
+
+        // 打开下面这一行会编译失败：(GETUP, EVENT1) 重复
+        // {State::GETUP, Events::EVENT1, &A::eat, State::EAT},
+    };
+
+    static constexpr State initial = State::GETUP;
+    static constexpr State error = State::ERROR;
+    static constexpr bool verbose = true;
+
+    static void onError() { A::on_error(); }
+
+    static std::chrono::milliseconds timeoutOf(State s) {
+        using namespace std::chrono;
+        switch (s) {
+        case State::GETUP:        return 1500ms;
+        case State::GO_SCHOOL:    return 1200ms;
+        case State::EAT:          return 1000ms;
+        case State::DO_HOMEWORK:  return 2000ms;
+        case State::GO_SLEEP:     return 1500ms;
+        default:                  return 0ms;
+        }
+    }
+};
+
+// ---------- 压测用：同一张转移关系，动作只计数不打印 ----------
+static uint64_t g_actionCount = 0;
+static void countAction() { g_actionCount++; }
+
+struct QuietFSMDef {
+    static constexpr Transition table[] = {
+        {State::GETUP,       Events::EVENT1, &countAction, State::GO_SCHOOL},
+        {State::GO_SCHOOL,   Events::EVENT2, &countAction, State::EAT},
+        {State::EAT,         Events::EVENT3, &countAction, State::DO_HOMEWORK},
+        {State::DO_HOMEWORK, Events::EVENT1, &countAction, State::GO_SLEEP},
+        {State::GO_SLEEP,    Events::EVENT2, &countAction, State::GETUP},
+        {State::GETUP,       Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::EAT,         Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::GO_SLEEP,    Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::TIMEOUT, Events::EVENT1, &countAction, State::GETUP},
+        {State::TIMEOUT, Events::EVENT3, &countAction, State::ERROR},
+        {State::ERROR,   Events::EVENT1, &countAction, State::GETUP},
+    };
+
+    static constexpr State initial = State::GETUP;
+    static constexpr State error = State::ERROR;
+    static constexpr bool verbose = false;
+
+    static void onError() { countAction(); }
+    static std::chrono::milliseconds timeoutOf(State) { return std::chrono::milliseconds(0); }
+};
+
+//night8 的构造方式：每个状态机 new 出整张表（只保留构造/析构相关部分用于对比）
+struct LegacyItem {
+    State _curState;
+    Events _event;
+    void(*_action)();
+    State _nextState;
+};
+
+class LegacyFSM {
+public:
+    LegacyFSM() : _curState(State::GETUP), _enterTime(std::chrono::steady_clock::now()), _lastState(State::GETUP) {
+        for (const auto& t : QuietFSMDef::table)
+            _fsmTable.push_back(new LegacyItem{t.curState, t.event, t.action, t.nextState});
+    }
+    ~LegacyFSM() {
+        for (auto p : _fsmTable) delete p;
+        _fsmTable.clear();
+    }
+
+    State _curState;
+
+private:
+    vector<LegacyItem*> _fsmTable;
+    std::chrono::steady_clock::time_point _enterTime;
+    State _lastState;
+};
+
+//测试事件变换：按照一定顺序循环变化
+void testEvent(Events& event) {
+    switch (event) {
+    case Events::EVENT1: event = Events::EVENT2; break;
+    case Events::EVENT2: event = Events::EVENT3; break;
+    case Events::EVENT3: event = Events::EVENT1; break;
+    default: break;
+    }
+}
+
+//构造压测：一次性创建 count 个状态机
+template <typename T>
+double benchConstruct(size_t count) {
+    auto start = std::chrono::steady_clock::now();
+    {
+        vector<T> fsms;
+        fsms.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            fsms.emplace_back();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main() {
+    // ---------- 1) 功能演示：与 night8 相同的流程 ----------
+    StaticFSM<StudentFSMDef> fsm;
+    auto event = Events::EVENT1;
+
+    int i = 0;
+    while (i < 12) {
+        if (i == 4 || i == 9) {
+            cout << "\n--- simulate blocking ... (sleep 1600ms) ---\n";
+            std::this_thread::sleep_for(std::chrono::milliseconds(1600));
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+
+        fsm.tick();
+
+        cout << "event " << static_cast<int>(event) << " is coming......" << endl;
+        fsm.handleEvent(event);
+        cout << "fsm current state is " << static_cast<int>(fsm.state()) << "\n" << endl;
+
+        testEvent(event);
+        i++;
+    }
+
+    // ---------- 2) 构造开销对比 ----------
+    constexpr size_t COUNT = 1000000;
+    double legacyMs = benchConstruct<LegacyFSM>(COUNT);
+    double staticMs = benchConstruct<StaticFSM<QuietFSMDef>>(COUNT);
+
+    cout << "construct " << COUNT << " machines:\n";
+    cout << "  legacy (new per item) : " << legacyMs << " ms, sizeof=" << sizeof(LegacyFSM)
+         << " + " << sizeof(LegacyItem) * size(QuietFSMDef::table) << " heap bytes\n";
+    cout << "  static (constexpr)    : " << staticMs << " ms, sizeof=" << sizeof(StaticFSM<QuietFSMDef>)
+         << " + 0 heap bytes\n";
+
+    // ---------- 3) 跳转表分派 ----------
+    StaticFSM<QuietFSMDef> quiet;
+    Events ev = Events::EVENT1;
+    constexpr uint64_t EVENTS = 10000000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t k = 0; k < EVENTS; k++) {
+        quiet.handleEvent(ev);
+        testEvent(ev);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / EVENTS;
+    cout << "dispatch: " << ns << " ns/event, actions=" << g_actionCount << "\n";
+
+    return 0;
+}
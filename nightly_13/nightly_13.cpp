@@ -0,0 +1,421 @@
+/*
+批量多实例状态机引擎（百万设备）
+
+问题：
+每个设备一个 FSM 对象，每个对象里有 vector<FSMItem*> + steady_clock 时间戳
+百万设备时：内存浪费（每台设备都有一整张表），对象分散在堆上，缓存不友好
+
+night13 的做法：
+1. 所有实例共用一张编译期转移表（沿用 night12 的 constexpr 表 + 跳转表）
+2. 实例数据按“结构数组”（SoA）存放：states[] / lastStates[] / enterTimes[]
+   enterTime 只存相对引擎起点的毫秒数（uint32_t），不存 time_point
+3. 事件按批次 (实例号, 事件) 投递，一个批次只读一次时钟
+4. 按实例号把批次分片到多个线程，每个线程只处理自己的实例，无锁且保持同一实例的事件顺序
+   工作线程在构造时启动、批次之间复用，每批只唤醒一次；小批次（< PARALLEL_MIN）直接在调用线程处理
+*/
+#include <iostream>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <cstdint>
+#include <random>
+
+using namespace std;
+
+enum class State : uint8_t {
+    GETUP = 0,
+    GO_SCHOOL,
+    EAT,
+    DO_HOMEWORK,
+    GO_SLEEP,
+    TIMEOUT,
+    ERROR,
+
+    COUNT
+};
+
+enum class Events : uint8_t {
+    EVENT1 = 0,
+    EVENT2,
+    EVENT3,
+    EVENT_TIMEOUT,
+
+    COUNT
+};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+
+struct Transition {
+    State curState;
+    Events event;
+    void(*action)();
+    State nextState;
+};
+
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+template <size_t N>
+constexpr bool hasDuplicate(const Transition (&t)[N]) {
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++)
+            if (t[i].curState == t[j].curState && t[i].event == t[j].event)
+                return true;
+    return false;
+}
+
+template <size_t N>
+constexpr array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+//动作只做计数：每个线程一份，避免多个线程抢同一个计数器
+thread_local uint64_t t_actionCount = 0;
+static void countAction() { t_actionCount++; }
+
+struct StudentFSMDef {
+    static constexpr Transition table[] = {
+        {State::GETUP,       Events::EVENT1, &countAction, State::GO_SCHOOL},
+        {State::GO_SCHOOL,   Events::EVENT2, &countAction, State::EAT},
+        {State::EAT,         Events::EVENT3, &countAction, State::DO_HOMEWORK},
+        {State::DO_HOMEWORK, Events::EVENT1, &countAction, State::GO_SLEEP},
+        {State::GO_SLEEP,    Events::EVENT2, &countAction, State::GETUP},
+        {State::GETUP,       Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::EAT,         Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::GO_SLEEP,    Events::EVENT_TIMEOUT, &countAction, State::TIMEOUT},
+        {State::TIMEOUT, Events::EVENT1, &countAction, State::GETUP},
+        {State::TIMEOUT, Events::EVENT3, &countAction, State::ERROR},
+        {State::ERROR,   Events::EVENT1, &countAction, State::GETUP},
+    };
+
+    static constexpr State initial = State::GETUP;
+    static constexpr State error = State::ERROR;
+
+    static void onError() { countAction(); }
+};
+
+//一条批量事件：发给哪个实例、什么事件
+struct InstanceEvent {
+    uint32_t instance;
+    Events event;
+};
+
+/*
+多实例状态机引擎
+每个实例只占 states[i] + lastStates[i] + enterTimes[i] = 6 字节
+handleBatch() 只能由一个线程调用；实例号越界的事件丢弃并计数（rejected()）
+*/
+template <typename Def>
+class FSMEngine {
+    static_assert(!hasDuplicate(Def::table), "FSM table has duplicate (state, event) transitions");
+    static constexpr auto kJump = buildJumpTable(Def::table);
+
+public:
+    //批次小于这个数就不分片：唤醒工作线程的开销比处理这些事件还大
+    static constexpr size_t PARALLEL_MIN = 4096;
+
+    FSMEngine(size_t instances, unsigned threads = std::thread::hardware_concurrency())
+        : _states(instances, static_cast<uint8_t>(Def::initial)),
+          _lastStates(instances, static_cast<uint8_t>(Def::initial)),
+          _enterTimes(instances, 0),
+          _epoch(std::chrono::steady_clock::now()),
+          _threads(threads == 0 ? 1 : threads),
+          _shards(_threads) {
+        if (instances == 0 || instances > UINT32_MAX)
+            throw std::invalid_argument("FSMEngine: instances must be in 1..UINT32_MAX");
+        _workers.reserve(_threads - 1);
+        for (unsigned t = 1; t < _threads; t++)
+            _workers.emplace_back([this, t] { workerLoop(t); });
+    }
+
+    ~FSMEngine() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto& w : _workers) w.join();
+    }
+
+    FSMEngine(const FSMEngine&) = delete;
+    FSMEngine& operator=(const FSMEngine&) = delete;
+
+    size_t size() const { return _states.size(); }
+    State state(uint32_t instance) const { return static_cast<State>(_states[instance]); }
+    uint32_t enterTimeMs(uint32_t instance) const { return _enterTimes[instance]; }
+    uint64_t rejected() const { return _rejected; }
+
+    //每个实例占用的字节数（不含批次缓冲）
+    static constexpr size_t bytesPerInstance() {
+        return sizeof(uint8_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    }
+
+    //处理一个批次
+    //先按实例号把事件分到各线程（保持原有顺序），再唤醒常驻工作线程并行处理自己的分片
+    void handleBatch(const vector<InstanceEvent>& batch) {
+        uint32_t now = nowMs();
+
+        if (_threads == 1 || batch.size() < PARALLEL_MIN) {
+            _rejected += runShard(batch.data(), batch.size(), now);
+            return;
+        }
+
+        //分片时就把越界的实例号挑出去，各分片里只剩合法事件
+        for (auto& s : _shards) s.clear();
+        for (const auto& e : batch) {
+            if (e.instance >= _states.size()) {
+                _rejected++;
+                continue;
+            }
+            _shards[shardOf(e.instance)].push_back(e);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _batchNow = now;
+            _pending = _threads - 1;
+            _generation++;
+        }
+        _wake.notify_all();
+        runShard(_shards[0].data(), _shards[0].size(), now);         // 当前线程也干活
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _pending == 0; });
+    }
+
+private:
+    //工作线程 t：每来一个新批次（_generation 变了）处理一次 _shards[t]
+    void workerLoop(unsigned t) {
+        uint64_t seen = 0;
+        for (;;) {
+            uint32_t now;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [&] { return _stop || _generation != seen; });
+                if (_stop) return;
+                seen = _generation;
+                now = _batchNow;
+            }
+            runShard(_shards[t].data(), _shards[t].size(), now);     // 分片里没有越界事件
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_pending == 0) _done.notify_one();
+        }
+    }
+
+    //连续实例号分到同一个线程，每个线程访问的 states[] 是一段连续内存
+    unsigned shardOf(uint32_t instance) const {
+        return static_cast<unsigned>(uint64_t(instance) * _threads / _states.size());
+    }
+
+    //返回丢弃的越界事件数
+    size_t runShard(const InstanceEvent* events, size_t n, uint32_t now) {
+        size_t bad = 0;
+        for (size_t k = 0; k < n; k++) {
+            uint32_t id = events[k].instance;
+            if (id >= _states.size()) {
+                bad++;
+                continue;
+            }
+            uint8_t cur = _states[id];
+            uint8_t i = kJump[cur * EVENT_COUNT + static_cast<size_t>(events[k].event)];
+            uint8_t next;
+            if (i != NO_TRANSITION) {
+                const Transition& t = Def::table[i];
+                if (t.action) t.action();
+                next = static_cast<uint8_t>(t.nextState);
+            } else {
+                Def::onError();
+                next = static_cast<uint8_t>(Def::error);
+            }
+            _lastStates[id] = cur;
+            _states[id] = next;
+            _enterTimes[id] = now;
+        }
+        return bad;
+    }
+
+    uint32_t nowMs() const {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - _epoch).count());
+    }
+
+    vector<uint8_t> _states;                // 现态
+    vector<uint8_t> _lastStates;            // 上一状态
+    vector<uint32_t> _enterTimes;           // 进入当前状态的时间（相对 _epoch 的毫秒）
+    std::chrono::steady_clock::time_point _epoch;
+    unsigned _threads;
+    vector<vector<InstanceEvent>> _shards;  // 分片缓冲，批次之间复用
+    uint64_t _rejected = 0;                 // 实例号越界被丢弃的事件数
+
+    vector<std::thread> _workers;           // 常驻工作线程 1.._threads-1，分片 0 由调用线程处理
+    std::mutex _mutex;                      // 保护下面几个字段
+    std::condition_variable _wake;          // 新批次 / 停止
+    std::condition_variable _done;          // 所有工作线程处理完
+    uint64_t _generation = 0;
+    uint32_t _batchNow = 0;
+    unsigned _pending = 0;
+    bool _stop = false;
+};
+
+//night8 的方式：每个设备一个对象，表在堆上，线性查表（去掉打印，只比较结构开销）
+struct LegacyItem {
+    State _curState;
+    Events _event;
+    void(*_action)();
+    State _nextState;
+};
+
+class LegacyFSM {
+public:
+    LegacyFSM() : _curState(State::GETUP), _enterTime(std::chrono::steady_clock::now()), _lastState(State::GETUP) {
+        for (const auto& t : StudentFSMDef::table)
+            _fsmTable.push_back(new LegacyItem{t.curState, t.event, t.action, t.nextState});
+    }
+    ~LegacyFSM() {
+        for (auto p : _fsmTable) delete p;
+        _fsmTable.clear();
+    }
+    LegacyFSM(const LegacyFSM&) = delete;
+    LegacyFSM& operator=(const LegacyFSM&) = delete;
+
+    void handleEvent(Events event) {
+        State nextState = StudentFSMDef::error;
+        void(*action)() = &countAction;
+        for (int i = 0; i < (int)_fsmTable.size(); i++) {
+            if (event == _fsmTable[i]->_event && _curState == _fsmTable[i]->_curState) {
+                action = _fsmTable[i]->_action;
+                nextState = _fsmTable[i]->_nextState;
+                break;
+            }
+        }
+        if (action) action();
+        _lastState = _curState;
+        _curState = nextState;
+        _enterTime = std::chrono::steady_clock::now();
+    }
+
+    //每个对象的总占用：对象本身 + vector 的指针数组 + 每个表项一次 new
+    size_t bytes() const {
+        return sizeof(*this) + _fsmTable.capacity() * sizeof(LegacyItem*) + _fsmTable.size() * sizeof(LegacyItem);
+    }
+
+    State _curState;
+
+private:
+    vector<LegacyItem*> _fsmTable;
+    std::chrono::steady_clock::time_point _enterTime;
+    State _lastState;
+};
+
+//随机生成一批事件
+vector<InstanceEvent> makeBatch(size_t n, uint32_t instances, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> pickInstance(0, instances - 1);
+    std::uniform_int_distribution<int> pickEvent(0, 2);
+    vector<InstanceEvent> batch(n);
+    for (auto& e : batch)
+        e = {pickInstance(rng), static_cast<Events>(pickEvent(rng))};
+    return batch;
+}
+
+int main() {
+    constexpr uint32_t INSTANCES = 1000000;
+    constexpr size_t BATCH = 1000000;
+    constexpr int ROUNDS = 10;
+
+    vector<vector<InstanceEvent>> batches;
+    for (int r = 0; r < ROUNDS; r++)
+        batches.push_back(makeBatch(BATCH, INSTANCES, r + 1));
+
+    // ---------- 1) 每个设备一个 FSM 对象 ----------
+    {
+        vector<LegacyFSM> fsms(INSTANCES);
+        t_actionCount = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& batch : batches)
+            for (const auto& e : batch)
+                fsms[e.instance].handleEvent(e.event);
+        auto end = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(end - start).count();
+
+        cout << "[legacy] instances=" << INSTANCES
+             << " bytes/instance=" << fsms[0].bytes()
+             << " events/s=" << uint64_t(BATCH * ROUNDS / sec)
+             << " actions=" << t_actionCount << "\n";
+    }
+
+    // ---------- 2) 批量引擎，线程数从 1 到 CPU 核数 ----------
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        FSMEngine<StudentFSMDef> engine(INSTANCES, threads);
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& batch : batches)
+            engine.handleBatch(batch);
+        auto end = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(end - start).count();
+
+        cout << "[engine] instances=" << INSTANCES
+             << " threads=" << threads
+             << " bytes/instance=" << engine.bytesPerInstance()
+             << " events/s=" << uint64_t(BATCH * ROUNDS / sec)
+             << " state[0]=" << static_cast<int>(engine.state(0)) << "\n";
+    }
+
+    // ---------- 3) 小批次：常驻工作线程每批只唤醒一次，结果必须和单线程一致 ----------
+    constexpr size_t SMALL_BATCH = 8192;
+    constexpr int SMALL_ROUNDS = 1000;
+    vector<vector<InstanceEvent>> small;
+    for (int r = 0; r < SMALL_ROUNDS; r++)
+        small.push_back(makeBatch(SMALL_BATCH, INSTANCES, 100 + r));
+
+    FSMEngine<StudentFSMDef> serial(INSTANCES, 1);
+    for (unsigned threads : {1u, std::max(2u, maxThreads)}) {
+        FSMEngine<StudentFSMDef> engine(INSTANCES, threads);
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& batch : small)
+            engine.handleBatch(batch);
+        auto end = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end - start).count() / SMALL_ROUNDS;
+        cout << "[engine] small batches of " << SMALL_BATCH << " threads=" << threads
+             << " us/batch=" << us << "\n";
+
+        if (threads == 1) {
+            for (const auto& batch : small)
+                serial.handleBatch(batch);
+            continue;
+        }
+        for (uint32_t i = 0; i < INSTANCES; i++) {
+            if (engine.state(i) != serial.state(i)) {
+                cerr << "error: sharded engine diverged from single-threaded at instance " << i << "\n";
+                return 1;
+            }
+        }
+        cout << "[engine] sharded states == single-threaded states\n";
+    }
+
+    // ---------- 4) 越界实例号：大小批次都丢弃并计数，不能写出界 ----------
+    for (size_t n : {size_t(16), FSMEngine<StudentFSMDef>::PARALLEL_MIN * 2}) {
+        FSMEngine<StudentFSMDef> engine(INSTANCES, std::max(2u, maxThreads));
+        vector<InstanceEvent> batch = makeBatch(n, INSTANCES, 7);
+        batch[0].instance = INSTANCES;
+        batch[n / 2].instance = UINT32_MAX;
+        engine.handleBatch(batch);
+        if (engine.rejected() != 2) {
+            cerr << "error: expected 2 rejected events in a batch of " << n << ", got " << engine.rejected() << "\n";
+            return 1;
+        }
+    }
+    cout << "[engine] out-of-range instance ids are rejected\n";
+
+    return 0;
+}
@@ -0,0 +1,390 @@
+/*
+分层时间轮（Hierarchical Timing Wheel）：状态超时管理
+
+night8 的问题：
+FSM::tick() 每次都读 steady_clock::now()，再用 timeoutOf(_curState) 判断一个状态机是否超时
+状态机一多，每个 tick 都要把所有状态机扫一遍，O(N)
+
+night14 的做法：
+1. 进入状态时按 timeoutOf(新状态) 在时间轮上挂一个定时器，离开状态时 O(1) 摘掉
+2. 时间轮 4 层，每层 256 个槽，1 tick = 1ms，可表示 2^32 ms 内的超时
+   第 0 层：[0,256) tick 内到期的定时器，按到期 tick 直接落槽
+   第 1~3 层：更远的定时器，第 0 层转完一圈时把上一层对应的槽“下放”（cascade）
+3. 每走一个 tick 只处理当前槽里的定时器，只有真正到期的状态机才会收到 EVENT_TIMEOUT
+4. 定时器节点不单独 new，按实例号放在数组里（next/prev/expire），百万定时器也不分配
+*/
+#include <iostream>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+enum class State : uint8_t {
+    GETUP = 0,
+    GO_SCHOOL,
+    EAT,
+    DO_HOMEWORK,
+    GO_SLEEP,
+    TIMEOUT,
+    ERROR,
+
+    COUNT
+};
+
+enum class Events : uint8_t {
+    EVENT1 = 0,
+    EVENT2,
+    EVENT3,
+    EVENT_TIMEOUT,
+
+    COUNT
+};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+
+/*
+分层时间轮
+定时器以 id（0..capacity-1）标识，每个 id 同一时刻最多挂一个定时器
+*/
+class TimingWheel {
+public:
+    static constexpr uint32_t NIL = 0xFFFFFFFF;
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t SLOT_MASK = SLOTS - 1;
+    static constexpr uint64_t MAX_DELAY = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+    explicit TimingWheel(size_t capacity)
+        : _next(capacity, NIL),
+          _prev(capacity, NIL),
+          _expire(capacity, 0),
+          _slotOf(capacity, NO_SLOT),
+          _current(0),
+          _armed(0) {
+        _heads.fill(NIL);
+    }
+
+    uint64_t now() const { return _current; }
+    size_t armed() const { return _armed; }
+    bool isArmed(uint32_t id) const { return _slotOf[id] != NO_SLOT; }
+    uint64_t expireOf(uint32_t id) const { return _expire[id]; }
+
+    //挂定时器：delay 个 tick 之后到期（delay=0 表示下一次 advance 就到期）
+    //已经挂着的会先摘掉
+    void schedule(uint32_t id, uint64_t delay) {
+        if (isArmed(id)) unlink(id);
+        if (delay > MAX_DELAY) delay = MAX_DELAY;
+        _expire[id] = _current + delay;
+        place(id);
+        _armed++;
+    }
+
+    //摘定时器，O(1)
+    void cancel(uint32_t id) {
+        if (!isArmed(id)) return;
+        unlink(id);
+        _armed--;
+    }
+
+    //走一个 tick：必要时先把上层槽下放，然后取出当前槽内全部到期定时器，逐个回调 onExpire(id)
+    //回调里可以安全地再 schedule/cancel 任意定时器
+    template <typename F>
+    size_t advance(F&& onExpire) {
+        uint64_t t = _current;
+        //第 0 层转完一圈：下放第 1 层对应槽；第 1 层也转完一圈时继续往上
+        for (int level = 1; level < LEVELS; level++) {
+            if (((t >> (SLOT_BITS * (level - 1))) & SLOT_MASK) != 0) break;
+            cascade(level, static_cast<uint32_t>((t >> (SLOT_BITS * level)) & SLOT_MASK));
+        }
+
+        _fired.clear();
+        uint32_t slot = static_cast<uint32_t>(t & SLOT_MASK);
+        uint32_t id = _heads[slot];
+        _heads[slot] = NIL;
+        while (id != NIL) {
+            uint32_t next = _next[id];
+            _slotOf[id] = NO_SLOT;
+            _fired.push_back(id);
+            id = next;
+        }
+        _armed -= _fired.size();
+        _current = t + 1;
+
+        for (uint32_t fired : _fired)
+            onExpire(fired);
+        return _fired.size();
+    }
+
+private:
+    static constexpr uint16_t NO_SLOT = 0xFFFF;
+
+    //按剩余 tick 数选层，按到期 tick 选槽
+    void place(uint32_t id) {
+        uint64_t expire = _expire[id];
+        uint64_t diff = expire - _current;
+        int level = 0;
+        while (level < LEVELS - 1 && diff >= (uint64_t(1) << (SLOT_BITS * (level + 1))))
+            level++;
+        uint32_t slot = static_cast<uint32_t>((expire >> (SLOT_BITS * level)) & SLOT_MASK);
+        uint16_t index = static_cast<uint16_t>(level * SLOTS + slot);
+
+        //头插
+        uint32_t head = _heads[index];
+        _next[id] = head;
+        _prev[id] = NIL;
+        if (head != NIL) _prev[head] = id;
+        _heads[index] = id;
+        _slotOf[id] = index;
+    }
+
+    void unlink(uint32_t id) {
+        uint32_t prev = _prev[id];
+        uint32_t next = _next[id];
+        if (prev != NIL) _next[prev] = next;
+        else _heads[_slotOf[id]] = next;
+        if (next != NIL) _prev[next] = prev;
+        _slotOf[id] = NO_SLOT;
+    }
+
+    //把某层某槽整条链表取下，按新的剩余时间重新落到下层
+    void cascade(int level, uint32_t slot) {
+        uint32_t index = level * SLOTS + slot;
+        uint32_t id = _heads[index];
+        _heads[index] = NIL;
+        while (id != NIL) {
+            uint32_t next = _next[id];
+            place(id);
+            id = next;
+        }
+    }
+
+    vector<uint32_t> _next;                 // 同槽链表后继
+    vector<uint32_t> _prev;                 // 同槽链表前驱，用于 O(1) 摘除
+    vector<uint64_t> _expire;               // 到期 tick
+    vector<uint16_t> _slotOf;               // 所在槽（level*256+slot），NO_SLOT 表示未挂
+    array<uint32_t, LEVELS * SLOTS> _heads; // 每个槽的链表头
+    uint64_t _current;                      // 下一个要处理的 tick
+    size_t _armed;                          // 当前挂着的定时器个数
+    vector<uint32_t> _fired;                // 本 tick 到期的定时器，复用避免分配
+};
+
+// ---------- 状态机（沿用 night12/13 的编译期表 + SoA 实例） ----------
+struct Transition {
+    State curState;
+    Events event;
+    State nextState;
+};
+
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+constexpr Transition kStudentTable[] = {
+    {State::GETUP,       Events::EVENT1, State::GO_SCHOOL},
+    {State::GO_SCHOOL,   Events::EVENT2, State::EAT},
+    {State::EAT,         Events::EVENT3, State::DO_HOMEWORK},
+    {State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP},
+    {State::GO_SLEEP,    Events::EVENT2, State::GETUP},
+    {State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::TIMEOUT, Events::EVENT1, State::GETUP},
+    {State::TIMEOUT, Events::EVENT3, State::ERROR},
+    {State::ERROR,   Events::EVENT1, State::GETUP},
+};
+
+template <size_t N>
+constexpr array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+constexpr auto kJump = buildJumpTable(kStudentTable);
+
+//每个状态允许停留的最大时间（ms，与 night8 相同），0 表示不超时
+constexpr uint32_t timeoutOf(State s) {
+    switch (s) {
+    case State::GETUP:        return 1500;
+    case State::GO_SCHOOL:    return 1200;
+    case State::EAT:          return 1000;
+    case State::DO_HOMEWORK:  return 2000;
+    case State::GO_SLEEP:     return 1500;
+    default:                  return 0;
+    }
+}
+
+/*
+状态机群：所有实例共享一张表，超时交给时间轮
+*/
+class FSMFleet {
+public:
+    explicit FSMFleet(size_t instances)
+        : _states(instances, static_cast<uint8_t>(State::GETUP)),
+          _wheel(instances),
+          _timeouts(0) {
+        for (uint32_t id = 0; id < instances; id++)
+            armTimeout(id);
+    }
+
+    State state(uint32_t id) const { return static_cast<State>(_states[id]); }
+    uint64_t timeouts() const { return _timeouts; }
+    size_t armed() const { return _wheel.armed(); }
+    uint64_t now() const { return _wheel.now(); }
+
+    void handleEvent(uint32_t id, Events event) {
+        uint8_t i = kJump[_states[id] * EVENT_COUNT + static_cast<size_t>(event)];
+        State next = (i != NO_TRANSITION) ? kStudentTable[i].nextState : State::ERROR;
+        transferState(id, next);
+    }
+
+    //1ms 调用一次：只有真正到期的实例会收到 EVENT_TIMEOUT
+    void tick() {
+        _wheel.advance([this](uint32_t id) {
+            _timeouts++;
+            handleEvent(id, Events::EVENT_TIMEOUT);
+        });
+    }
+
+private:
+    //离开旧状态：摘定时器；进入新状态：按新状态超时重新挂
+    void transferState(uint32_t id, State next) {
+        _states[id] = static_cast<uint8_t>(next);
+        _wheel.cancel(id);
+        armTimeout(id);
+    }
+
+    void armTimeout(uint32_t id) {
+        uint32_t to = timeoutOf(static_cast<State>(_states[id]));
+        if (to > 0) _wheel.schedule(id, to);
+    }
+
+    vector<uint8_t> _states;
+    TimingWheel _wheel;
+    uint64_t _timeouts;
+};
+
+//对照组：night8 的做法，每个 tick 把所有实例扫一遍
+class ScanFleet {
+public:
+    explicit ScanFleet(size_t instances)
+        : _states(instances, static_cast<uint8_t>(State::GETUP)),
+          _enterTimes(instances, 0),
+          _now(0),
+          _timeouts(0) {}
+
+    uint64_t timeouts() const { return _timeouts; }
+
+    void tick() {
+        for (uint32_t id = 0; id < _states.size(); id++) {
+            uint32_t to = timeoutOf(static_cast<State>(_states[id]));
+            if (to == 0) continue;
+            if (_now - _enterTimes[id] >= to) {
+                _timeouts++;
+                uint8_t i = kJump[_states[id] * EVENT_COUNT + static_cast<size_t>(Events::EVENT_TIMEOUT)];
+                _states[id] = static_cast<uint8_t>(i != NO_TRANSITION ? kStudentTable[i].nextState : State::ERROR);
+                _enterTimes[id] = _now;
+            }
+        }
+        _now++;
+    }
+
+private:
+    vector<uint8_t> _states;
+    vector<uint64_t> _enterTimes;
+    uint64_t _now;
+    uint64_t _timeouts;
+};
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    constexpr uint32_t TIMERS = 1000000;
+    std::mt19937 rng(2026);
+
+    // ---------- 1) 时间轮本身：100 万个随机超时 ----------
+    {
+        TimingWheel wheel(TIMERS);
+        std::uniform_int_distribution<uint32_t> pickDelay(1, 200000);   // 1ms ~ 200s，覆盖前 3 层
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t id = 0; id < TIMERS; id++)
+            wheel.schedule(id, pickDelay(rng));
+        double armMs = msSince(start);
+
+        //模拟状态切换：一半定时器取消后重挂
+        start = std::chrono::steady_clock::now();
+        for (uint32_t id = 0; id < TIMERS; id += 2) {
+            wheel.cancel(id);
+            wheel.schedule(id, pickDelay(rng));
+        }
+        double rearmMs = msSince(start);
+
+        uint64_t fired = 0, late = 0, ticks = 0;
+        start = std::chrono::steady_clock::now();
+        while (wheel.armed() > 0) {
+            uint64_t t = wheel.now();
+            fired += wheel.advance([&](uint32_t id) {
+                if (wheel.expireOf(id) != t) late++;    // 必须恰好在到期 tick 触发
+            });
+            ticks++;
+        }
+        double runMs = msSince(start);
+
+        cout << "[wheel] timers=" << TIMERS
+             << " schedule=" << armMs * 1e6 / TIMERS << " ns/op"
+             << " cancel+reschedule=" << rearmMs * 1e6 / (TIMERS / 2) << " ns/op\n";
+        cout << "[wheel] ticks=" << ticks << " fired=" << fired << " wrong_tick=" << late
+             << " total=" << runMs << " ms (" << runMs * 1e6 / ticks << " ns/tick)\n";
+    }
+
+    // ---------- 2) 状态机群：时间轮 vs 全量扫描 ----------
+    {
+        FSMFleet fleet(TIMERS);
+        //先打乱各实例的状态，让超时分散
+        std::uniform_int_distribution<uint32_t> pickInstance(0, TIMERS - 1);
+        std::uniform_int_distribution<int> pickEvent(0, 2);
+        for (int k = 0; k < 3000; k++) {
+            for (int j = 0; j < 1000; j++)
+                fleet.handleEvent(pickInstance(rng), static_cast<Events>(pickEvent(rng)));
+            fleet.tick();
+        }
+
+        constexpr int TICKS = 2000;
+        uint64_t before = fleet.timeouts();
+        auto start = std::chrono::steady_clock::now();
+        for (int k = 0; k < TICKS; k++)
+            fleet.tick();
+        double wheelMs = msSince(start);
+
+        cout << "[fleet/wheel] machines=" << TIMERS << " ticks=" << TICKS
+             << " timeouts=" << fleet.timeouts() - before
+             << " armed=" << fleet.armed()
+             << " " << wheelMs * 1e3 / TICKS << " us/tick\n";
+    }
+    {
+        ScanFleet fleet(TIMERS);
+        constexpr int TICKS = 2000;
+        auto start = std::chrono::steady_clock::now();
+        for (int k = 0; k < TICKS; k++)
+            fleet.tick();
+        double scanMs = msSince(start);
+
+        cout << "[fleet/scan]  machines=" << TIMERS << " ticks=" << TICKS
+             << " timeouts=" << fleet.timeouts()
+             << " " << scanMs * 1e3 / TICKS << " us/tick\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,350 @@
+/*
+Actor 模式：每个状态机一个无锁邮箱，由工作线程池处理
+
+night8 的问题：
+FSM::handleEvent 在调用者线程里同步执行
+两个线程同时给同一个状态机投递事件会产生数据竞争；动作慢的话会卡住调用者
+
+night15 的做法：
+1. 每个状态机（Actor）有一个有界无锁 MPSC 邮箱，任何线程都可以 post(event)，只做一次入队
+2. 邮箱从空变成非空时，把 Actor 放进线程池的就绪队列（scheduled 标志保证同一时刻只入队一次）
+3. 工作线程取出 Actor，一次最多处理 BATCH 个事件；处理完清 scheduled，
+   若邮箱里又有新事件则重新入队 —— 同一个 Actor 永远不会被两个线程同时执行
+4. 打印一下线程数从 1 到 CPU 核数时的吞吐
+*/
+#include <iostream>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <cstdint>
+
+using namespace std;
+
+enum class State : uint8_t {
+    GETUP = 0,
+    GO_SCHOOL,
+    EAT,
+    DO_HOMEWORK,
+    GO_SLEEP,
+    TIMEOUT,
+    ERROR,
+
+    COUNT
+};
+
+enum class Events : uint8_t {
+    EVENT1 = 0,
+    EVENT2,
+    EVENT3,
+    EVENT_TIMEOUT,
+
+    COUNT
+};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+
+struct Transition {
+    State curState;
+    Events event;
+    State nextState;
+};
+
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+constexpr Transition kStudentTable[] = {
+    {State::GETUP,       Events::EVENT1, State::GO_SCHOOL},
+    {State::GO_SCHOOL,   Events::EVENT2, State::EAT},
+    {State::EAT,         Events::EVENT3, State::DO_HOMEWORK},
+    {State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP},
+    {State::GO_SLEEP,    Events::EVENT2, State::GETUP},
+    {State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::TIMEOUT, Events::EVENT1, State::GETUP},
+    {State::TIMEOUT, Events::EVENT3, State::ERROR},
+    {State::ERROR,   Events::EVENT1, State::GETUP},
+};
+
+template <size_t N>
+constexpr array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+constexpr auto kJump = buildJumpTable(kStudentTable);
+
+/*
+有界无锁队列（Vyukov MPMC）
+每个格子带一个序号 seq：
+    seq == pos      空位，可写
+    seq == pos + 1  已写入，可读
+多个生产者用 CAS 抢 enqueuePos，多个消费者用 CAS 抢 dequeuePos
+邮箱只有一个消费者（当前持有 Actor 的工作线程），就绪队列有多个消费者，两处共用
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _mask(roundUp(capacity) - 1), _cells(new Cell[_mask + 1]) {
+        for (size_t i = 0; i <= _mask; i++)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        _enqueuePos.store(0, std::memory_order_relaxed);
+        _dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    bool push(const T& data) {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 满
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = data;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& data) {
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 空
+            } else {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        data = cell->data;
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        size_t pos = _dequeuePos.load(std::memory_order_acquire);
+        return _cells[pos & _mask].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t v = 2;
+        while (v < n) v <<= 1;
+        return v;
+    }
+
+    const size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    alignas(64) std::atomic<size_t> _enqueuePos;    // 生产者和消费者的位置分开放，避免伪共享
+    alignas(64) std::atomic<size_t> _dequeuePos;
+};
+
+class WorkerPool;
+
+/*
+Actor：状态机 + 邮箱
+状态机本身不加锁：scheduled 标志保证同一时刻只有一个工作线程在执行 drain()
+*/
+class FSMActor {
+public:
+    static constexpr size_t MAILBOX_SIZE = 256;
+    static constexpr size_t BATCH = 32;             // 每次被调度最多处理的事件数，防止一个 Actor 霸占线程
+
+    FSMActor() : _mailbox(MAILBOX_SIZE), _scheduled(false), _running(0),
+                 _curState(State::GETUP), _processed(0), _overlaps(0) {}
+
+    //任何线程都可以调用；邮箱满返回 false，由调用者决定重试还是丢弃
+    bool post(Events event, WorkerPool& pool);
+
+    //由工作线程调用：处理一批事件，邮箱里还有剩余就重新调度
+    void drain(WorkerPool& pool);
+
+    State state() const { return _curState; }
+    uint64_t processed() const { return _processed.load(std::memory_order_relaxed); }
+    uint64_t overlaps() const { return _overlaps; }
+
+private:
+    void handleEvent(Events event) {
+        uint8_t i = kJump[static_cast<size_t>(_curState) * EVENT_COUNT + static_cast<size_t>(event)];
+        _curState = (i != NO_TRANSITION) ? kStudentTable[i].nextState : State::ERROR;
+        _processed.store(_processed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    BoundedQueue<Events> _mailbox;
+    std::atomic<bool> _scheduled;       // 已在就绪队列中或正在被执行
+    std::atomic<int> _running;          // 仅用于验证：同时执行 drain 的线程数
+
+    //以下只由持有 Actor 的工作线程修改（_processed 允许其他线程读取统计）
+    State _curState;
+    std::atomic<uint64_t> _processed;
+    uint64_t _overlaps;
+};
+
+/*
+工作线程池：从就绪队列取 Actor 执行
+就绪队列容量 >= Actor 个数，每个 Actor 同一时刻最多在队列里出现一次，所以不会满
+*/
+class WorkerPool {
+public:
+    WorkerPool(size_t maxActors, unsigned threads) : _ready(maxActors), _stop(false) {
+        for (unsigned t = 0; t < threads; t++)
+            _workers.emplace_back(&WorkerPool::run, this);
+    }
+
+    ~WorkerPool() {
+        _stop.store(true, std::memory_order_release);
+        for (auto& w : _workers) w.join();
+    }
+
+    void schedule(FSMActor* actor) {
+        while (!_ready.push(actor))
+            std::this_thread::yield();
+    }
+
+private:
+    void run() {
+        FSMActor* actor;
+        int idle = 0;
+        while (true) {
+            if (_ready.pop(actor)) {
+                actor->drain(*this);
+                idle = 0;
+            } else if (_stop.load(std::memory_order_acquire)) {
+                break;
+            } else if (++idle < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    }
+
+    BoundedQueue<FSMActor*> _ready;
+    std::atomic<bool> _stop;
+    vector<std::thread> _workers;
+};
+
+bool FSMActor::post(Events event, WorkerPool& pool) {
+    if (!_mailbox.push(event)) return false;
+    //与 drain() 里的 fence 配对：要么这里看到 scheduled=false，要么 drain 看到新事件
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    //邮箱从“无人处理”变成“有事件”：由本次投递者负责调度
+    if (!_scheduled.exchange(true, std::memory_order_acq_rel))
+        pool.schedule(this);
+    return true;
+}
+
+void FSMActor::drain(WorkerPool& pool) {
+    if (_running.fetch_add(1, std::memory_order_acquire) != 0)
+        _overlaps++;
+
+    Events event;
+    size_t n = 0;
+    while (n < BATCH && _mailbox.pop(event)) {
+        handleEvent(event);
+        n++;
+    }
+
+    _running.fetch_sub(1, std::memory_order_release);
+    _scheduled.store(false, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    //清标志之后再看一眼：期间来的事件可能没人调度
+    if (!_mailbox.empty() && !_scheduled.exchange(true, std::memory_order_acq_rel))
+        pool.schedule(this);
+}
+
+//测试：producers 个线程向 actors 个状态机随机投递 eventsPerProducer 个事件
+void runBench(unsigned workers, unsigned producers, size_t actors, uint64_t eventsPerProducer) {
+    vector<FSMActor> fsms(actors);
+    uint64_t retries = 0;
+    double sec;
+    {
+        WorkerPool pool(actors, workers);
+        std::atomic<uint64_t> totalRetries{0};
+
+        auto start = std::chrono::steady_clock::now();
+        vector<std::thread> senders;
+        for (unsigned p = 0; p < producers; p++) {
+            senders.emplace_back([&, p] {
+                std::mt19937 rng(p + 1);
+                std::uniform_int_distribution<size_t> pickActor(0, actors - 1);
+                uint64_t localRetries = 0;
+                for (uint64_t k = 0; k < eventsPerProducer; k++) {
+                    FSMActor& a = fsms[pickActor(rng)];
+                    Events ev = static_cast<Events>(k % 3);
+                    while (!a.post(ev, pool)) {             // 邮箱满：让出 CPU 给工作线程
+                        localRetries++;
+                        std::this_thread::yield();
+                    }
+                }
+                totalRetries += localRetries;
+            });
+        }
+        for (auto& s : senders) s.join();
+
+        //等所有事件处理完
+        uint64_t expected = producers * eventsPerProducer;
+        while (true) {
+            uint64_t done = 0;
+            for (const auto& a : fsms) done += a.processed();
+            if (done >= expected) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        retries = totalRetries;
+    }
+
+    uint64_t processed = 0, overlaps = 0;
+    for (const auto& a : fsms) {
+        processed += a.processed();
+        overlaps += a.overlaps();
+    }
+    cout << "workers=" << workers << " producers=" << producers << " actors=" << actors
+         << " events=" << processed << " events/s=" << uint64_t(processed / sec)
+         << " mailbox_full_retries=" << retries
+         << " concurrent_drain=" << overlaps << "\n";
+}
+
+int main() {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    constexpr size_t ACTORS = 10000;
+    constexpr uint64_t EVENTS_PER_PRODUCER = 2000000;
+    unsigned producers = std::max(1u, cores / 2);
+
+    cout << "cores=" << cores << "\n";
+    for (unsigned workers = 1; workers <= cores; workers *= 2)
+        runBench(workers, producers, ACTORS, EVENTS_PER_PRODUCER);
+    if ((cores & (cores - 1)) != 0)
+        runBench(cores, producers, ACTORS, EVENTS_PER_PRODUCER);
+
+    return 0;
+}
@@ -0,0 +1,823 @@
+/*
+异步二进制日志：把 I/O 从状态机和解析器的热路径上拿走
+
+问题：
+FSM::transferState 每次状态切换都 cout << ... << endl，endl 每次都 flush
+FSM 的动作、tick()、StreamProcessor::processStream 打印帧也是同步格式化输出
+生产环境里这些 I/O 占了大部分延迟
+
+night16 的做法：
+1. 热路径 NLOG("fmt {}", a, b...) 只写一条紧凑的二进制记录：格式 id + 时间戳 + 参数原始值
+   写进本线程自己的 SPSC 环形缓冲（沿用 night9 的 head/tail 思路，按字节存变长记录）
+   不格式化、不加锁、不分配；缓冲满了直接丢弃并计数，绝不阻塞调用者
+2. 每个调用点的格式串在第一次执行时注册，得到一个 id（函数内 static）
+3. 后台线程轮询所有线程的环形缓冲，把记录原样写进二进制文件（顺带写入格式串定义）
+4. 离线解码：./nightly_16 decode <file> 把二进制文件还原成文本
+
+参数支持：整数/枚举/bool、浮点、字符串（const char* / char* / std::string，热路径拷贝内容）、
+定长字节串 LogBytes（热路径直接拷贝内容，用于打印帧数据）
+线程退出后它的环由后台线程写完剩余记录再释放；stop() 之后可以 start() 到新文件
+*/
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <sstream>
+#include <iterator>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+namespace nlog {
+
+//参数类型标签：写进文件，解码器据此还原
+enum ArgType : uint8_t {
+    ARG_I64 = 1,
+    ARG_U64,
+    ARG_F64,
+    ARG_STR,        // 热路径拷贝内容：u16 长度 + 数据，解码成文本
+    ARG_BYTES       // 热路径拷贝内容：u16 长度 + 数据，解码成字节
+};
+
+//定长字节串参数
+struct LogBytes {
+    const uint8_t* data;
+    uint16_t size;
+};
+
+constexpr int MAX_ARGS = 8;
+constexpr uint16_t MAX_BYTES = 1024;        // 字符串 / LogBytes 最多拷贝的字节数，超出部分截断
+constexpr uint16_t WRAP_MARK = 0xFFFF;      // 环形缓冲尾部放不下时的回绕标记
+constexpr uint32_t FILE_MAGIC = 0x474F4C4E; // "NLOG"
+constexpr uint32_t FILE_VERSION = 1;
+
+//文件里的块类型
+enum BlockType : uint8_t {
+    BLOCK_FORMAT = 1,       // 格式串定义
+    BLOCK_RECORD = 2        // 一条日志
+};
+
+//字符串参数：字面量也会推导成字符数组，和 char*、c_str() 一样分不清是不是常量，统一拷贝内容
+template <typename T>
+constexpr bool isText() {
+    using U = std::decay_t<T>;
+    return std::is_same_v<U, const char*> || std::is_same_v<U, char*> || std::is_same_v<U, string>;
+}
+
+template <typename T>
+constexpr ArgType argTag() {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, LogBytes>) return ARG_BYTES;
+    else if constexpr (isText<T>()) return ARG_STR;
+    else if constexpr (std::is_floating_point_v<U>) return ARG_F64;
+    else if constexpr (std::is_enum_v<U>) return ARG_I64;
+    else if constexpr (std::is_signed_v<U>) return ARG_I64;
+    else {
+        static_assert(std::is_integral_v<U>, "NLOG argument must be integer, enum, float, string or LogBytes");
+        return ARG_U64;
+    }
+}
+
+struct FormatDef {
+    string fmt;
+    uint8_t nargs;
+    uint8_t types[MAX_ARGS];
+};
+
+/*
+每线程一个 SPSC 字节环：生产者是业务线程，消费者是后台线程
+记录格式：u16 格式 id | u16 记录总长（8 对齐）| u32 保留 | u64 时间戳 | 参数...
+*/
+class ThreadRing {
+public:
+    static constexpr size_t SIZE = 1 << 20;     // 1MB，必须是 2 的幂
+
+    ThreadRing() : _buffer(new uint8_t[SIZE]), _head(0), _tail(0), _dropped(0), _retired(false) {}
+
+    //生产者：申请 n 字节连续空间，失败返回 nullptr
+    uint8_t* reserve(size_t n) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        size_t offset = head & (SIZE - 1);
+        size_t contiguous = SIZE - offset;
+
+        if (contiguous < n) {
+            //尾部放不下：写一个回绕标记，跳到开头
+            if (SIZE - (head - tail) < contiguous + n) return nullptr;
+            if (contiguous >= sizeof(uint16_t)) {
+                uint16_t mark = WRAP_MARK;
+                memcpy(_buffer.get() + offset, &mark, sizeof(mark));
+            }
+            _pendingSkip = contiguous;
+            return _buffer.get();
+        }
+        if (SIZE - (head - tail) < n) return nullptr;
+        _pendingSkip = 0;
+        return _buffer.get() + offset;
+    }
+
+    void commit(size_t n) {
+        _head.store(_head.load(std::memory_order_relaxed) + _pendingSkip + n, std::memory_order_release);
+    }
+
+    void drop() { _dropped.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    //生产者线程退出：之后不会再写，消费者排空后即可释放
+    void retire() { _retired.store(true, std::memory_order_release); }
+    bool retired() const { return _retired.load(std::memory_order_acquire); }
+
+    //消费者：取出一条记录（回绕标记自动跳过），没有则返回 nullptr
+    const uint8_t* peek(uint16_t& size) {
+        for (;;) {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            size_t head = _head.load(std::memory_order_acquire);
+            if (tail == head) return nullptr;
+
+            size_t offset = tail & (SIZE - 1);
+            size_t contiguous = SIZE - offset;
+            uint16_t id = WRAP_MARK;
+            if (contiguous >= sizeof(uint16_t))
+                memcpy(&id, _buffer.get() + offset, sizeof(id));
+            if (id == WRAP_MARK) {
+                _tail.store(tail + contiguous, std::memory_order_release);
+                continue;
+            }
+            memcpy(&size, _buffer.get() + offset + 2, sizeof(size));
+            return _buffer.get() + offset;
+        }
+    }
+
+    void release(uint16_t size) {
+        _tail.store(_tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+
+private:
+    std::unique_ptr<uint8_t[]> _buffer;
+    alignas(64) std::atomic<size_t> _head;      // 只生产者修改
+    size_t _pendingSkip = 0;                    // 只生产者使用
+    alignas(64) std::atomic<size_t> _tail;      // 只消费者修改
+    std::atomic<uint64_t> _dropped;
+    std::atomic<bool> _retired;
+};
+
+inline uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*
+全局日志器：格式表 + 线程环列表 + 后台线程
+*/
+class Logger {
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    //打开输出文件并启动后台线程
+    bool start(const string& path) {
+        if (_worker.joinable()) return false;
+        _file = fopen(path.c_str(), "wb");
+        if (!_file) return false;
+        setvbuf(_file, nullptr, _IOFBF, 1 << 16);
+        fwrite(&FILE_MAGIC, sizeof(FILE_MAGIC), 1, _file);
+        fwrite(&FILE_VERSION, sizeof(FILE_VERSION), 1, _file);
+
+        //新文件里还没有任何格式定义：已注册的格式串要重新写一遍
+        _formatsWritten = 0;
+        _known.clear();
+
+        calibrate();
+        _stop.store(false, std::memory_order_relaxed);
+        _worker = std::thread(&Logger::run, this);
+        return true;
+    }
+
+    //停止后台线程：先把所有环里剩下的记录写完
+    void stop() {
+        _stop.store(true, std::memory_order_release);
+        if (_worker.joinable()) _worker.join();
+        if (_file) {
+            fclose(_file);
+            _file = nullptr;
+        }
+    }
+
+    //注册格式串（冷路径，每个调用点只走一次）
+    template <typename... Args>
+    uint16_t registerFormat(std::atomic<uint16_t>& slot, const char* fmt) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many NLOG arguments");
+        std::lock_guard<std::mutex> lock(_mtx);
+        uint16_t id = slot.load(std::memory_order_relaxed);
+        if (id != 0) return id;
+
+        FormatDef def{fmt, static_cast<uint8_t>(sizeof...(Args)), {}};
+        uint8_t tags[] = {argTag<Args>()..., 0};
+        memcpy(def.types, tags, sizeof...(Args));
+        _formats.push_back(def);
+        id = static_cast<uint16_t>(_formats.size());        // id 从 1 开始，0 表示未注册
+        _formatCount.store(id, std::memory_order_release);
+        slot.store(id, std::memory_order_release);
+        return id;
+    }
+
+    ThreadRing& ring() {
+        thread_local RingOwner t_ring;
+        if (!t_ring.ring) {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _rings.push_back(std::make_unique<ThreadRing>());
+            t_ring.ring = _rings.back().get();
+        }
+        return *t_ring.ring;
+    }
+
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(_mtx);
+        uint64_t n = _retiredDropped;
+        for (auto& r : _rings) n += r->dropped();
+        return n;
+    }
+
+    size_t ringCount() {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _rings.size();
+    }
+
+    uint64_t written() const { return _written.load(std::memory_order_relaxed); }
+
+private:
+    //线程退出时析构：把本线程的环标记为退役，由后台线程回收
+    struct RingOwner {
+        ThreadRing* ring = nullptr;
+        ~RingOwner() {
+            if (ring) ring->retire();
+        }
+    };
+
+    Logger() : _file(nullptr), _stop(true), _formatCount(0), _written(0) {}
+    ~Logger() { stop(); }
+
+    //测一下时间戳计数器频率，后台线程落盘时换算成纳秒
+    void calibrate() {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = readTicks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto t1 = std::chrono::steady_clock::now();
+        uint64_t c1 = readTicks();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        _nsPerTick = (c1 > c0) ? ns / double(c1 - c0) : 1.0;
+        _tickBase = c0;
+    }
+
+    void run() {
+        vector<ThreadRing*> rings;
+        for (;;) {
+            bool stopping = _stop.load(std::memory_order_acquire);
+            {
+                std::lock_guard<std::mutex> lock(_mtx);
+                rings.clear();
+                for (auto& r : _rings) rings.push_back(r.get());
+            }
+            writeNewFormats();
+
+            size_t n = 0;
+            for (ThreadRing* r : rings) {
+                bool retired = r->retired();        // 先读标记再排空：标记之后生产者不会再写
+                n += drainRing(*r);
+                if (retired) reclaim(r);
+            }
+
+            if (n == 0) {
+                if (stopping) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        fflush(_file);
+    }
+
+    //把新注册的格式串写进文件（解码器需要它们）
+    void writeNewFormats() {
+        uint16_t count = _formatCount.load(std::memory_order_acquire);
+        while (_formatsWritten < count) {
+            {
+                std::lock_guard<std::mutex> lock(_mtx);
+                _known.push_back(_formats[_formatsWritten]);
+            }
+            const FormatDef& def = _known.back();
+            uint16_t id = static_cast<uint16_t>(_formatsWritten + 1);
+            uint16_t len = static_cast<uint16_t>(def.fmt.size());
+            fputc(BLOCK_FORMAT, _file);
+            fwrite(&id, sizeof(id), 1, _file);
+            fputc(def.nargs, _file);
+            fwrite(def.types, 1, def.nargs, _file);
+            fwrite(&len, sizeof(len), 1, _file);
+            fwrite(def.fmt.data(), 1, len, _file);
+            _formatsWritten++;
+        }
+    }
+
+    void reclaim(ThreadRing* r) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _retiredDropped += r->dropped();
+        _rings.erase(std::find_if(_rings.begin(), _rings.end(),
+                                  [r](const std::unique_ptr<ThreadRing>& p) { return p.get() == r; }));
+    }
+
+    size_t drainRing(ThreadRing& r) {
+        size_t n = 0;
+        uint16_t size;
+        while (const uint8_t* rec = r.peek(size)) {
+            writeRecord(rec);
+            r.release(size);
+            n++;
+        }
+        _written.fetch_add(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    //记录 -> 文件块：时间戳换算成纳秒，参数原样写出
+    void writeRecord(const uint8_t* rec) {
+        uint16_t id;
+        uint64_t ticks;
+        memcpy(&id, rec, sizeof(id));
+        memcpy(&ticks, rec + 8, sizeof(ticks));
+        uint64_t ns = static_cast<uint64_t>(double(ticks - _tickBase) * _nsPerTick);
+
+        //记录可能比本轮 writeNewFormats() 更晚注册，先补写格式定义
+        if (id > _known.size()) writeNewFormats();
+        const FormatDef& local = _known[id - 1];
+
+        fputc(BLOCK_RECORD, _file);
+        fwrite(&id, sizeof(id), 1, _file);
+        fwrite(&ns, sizeof(ns), 1, _file);
+
+        const uint8_t* p = rec + 16;
+        for (int i = 0; i < local.nargs; i++) {
+            if (local.types[i] == ARG_STR || local.types[i] == ARG_BYTES) {
+                uint16_t len;
+                memcpy(&len, p, sizeof(len));
+                fwrite(&len, sizeof(len), 1, _file);
+                fwrite(p + 2, 1, len, _file);
+                p += (2 + len + 7) & ~size_t(7);
+            } else {
+                fwrite(p, 8, 1, _file);
+                p += 8;
+            }
+        }
+    }
+
+    FILE* _file;
+    std::thread _worker;
+    std::atomic<bool> _stop;
+    std::mutex _mtx;
+    vector<FormatDef> _formats;
+    std::atomic<uint16_t> _formatCount;
+    uint16_t _formatsWritten = 0;
+    vector<FormatDef> _known;               // 已写入文件的格式串，只由后台线程访问
+    vector<std::unique_ptr<ThreadRing>> _rings;
+    uint64_t _retiredDropped = 0;           // 已回收的环丢弃过的记录数
+    std::atomic<uint64_t> _written;
+    double _nsPerTick = 1.0;
+    uint64_t _tickBase = 0;
+};
+
+// ---------- 热路径：计算记录长度，按类型把参数写进去 ----------
+inline uint16_t bytesLen(const LogBytes& b) { return b.size < MAX_BYTES ? b.size : MAX_BYTES; }
+inline size_t argSize(const LogBytes& b) { return (2 + bytesLen(b) + 7) & ~size_t(7); }
+
+//字符串按 LogBytes 的布局拷贝
+inline LogBytes textArg(const char* s) {
+    if (!s) s = "(null)";
+    return {reinterpret_cast<const uint8_t*>(s), static_cast<uint16_t>(strnlen(s, MAX_BYTES))};
+}
+inline LogBytes textArg(const string& s) {
+    return {reinterpret_cast<const uint8_t*>(s.data()), static_cast<uint16_t>(std::min<size_t>(s.size(), MAX_BYTES))};
+}
+
+template <typename T>
+inline size_t argSize(const T& v) {
+    if constexpr (isText<T>()) return argSize(textArg(v));
+    else return 8;
+}
+
+inline void putArg(uint8_t*& p, const LogBytes& b) {
+    uint16_t len = bytesLen(b);
+    memcpy(p, &len, sizeof(len));
+    memcpy(p + 2, b.data, len);
+    p += argSize(b);
+}
+
+template <typename T>
+inline void putArg(uint8_t*& p, const T& v) {
+    using U = std::decay_t<T>;
+    if constexpr (isText<T>()) {
+        putArg(p, textArg(v));
+        return;
+    } else if constexpr (std::is_floating_point_v<U>) {
+        double d = static_cast<double>(v);
+        memcpy(p, &d, sizeof(d));
+    } else if constexpr (std::is_enum_v<U>) {
+        int64_t i = static_cast<int64_t>(v);
+        memcpy(p, &i, sizeof(i));
+    } else if constexpr (std::is_signed_v<U>) {
+        int64_t i = static_cast<int64_t>(v);
+        memcpy(p, &i, sizeof(i));
+    } else {
+        uint64_t u = static_cast<uint64_t>(v);
+        memcpy(p, &u, sizeof(u));
+    }
+    p += 8;
+}
+
+template <typename... Args>
+inline void log(std::atomic<uint16_t>& slot, const char* fmt, const Args&... args) {
+    uint16_t id = slot.load(std::memory_order_acquire);
+    if (id == 0)
+        id = Logger::instance().registerFormat<Args...>(slot, fmt);
+
+    size_t size = 16 + (size_t(0) + ... + argSize(args));
+    ThreadRing& ring = Logger::instance().ring();
+    uint8_t* p = ring.reserve(size);
+    if (!p) {
+        ring.drop();
+        return;
+    }
+
+    uint16_t size16 = static_cast<uint16_t>(size);
+    uint64_t ticks = readTicks();
+    memcpy(p, &id, sizeof(id));
+    memcpy(p + 2, &size16, sizeof(size16));
+    memcpy(p + 8, &ticks, sizeof(ticks));
+    uint8_t* q = p + 16;
+    (putArg(q, args), ...);
+    (void)q;
+    ring.commit(size);
+}
+
+// ---------- 离线解码 ----------
+struct DecodedRecord {
+    uint64_t ns;
+    string text;
+};
+
+//把 "{}" 依次替换成参数
+static string render(const string& fmt, const vector<string>& args) {
+    string out;
+    size_t next = 0;
+    for (size_t i = 0; i < fmt.size(); i++) {
+        if (fmt[i] == '{' && i + 1 < fmt.size() && fmt[i + 1] == '}') {
+            out += next < args.size() ? args[next++] : "{?}";
+            i++;
+        } else {
+            out += fmt[i];
+        }
+    }
+    return out;
+}
+
+//读满 n 字节；文件被截断时返回 false
+static bool readExact(istream& in, void* p, size_t n) {
+    in.read(static_cast<char*>(p), static_cast<std::streamsize>(n));
+    return static_cast<size_t>(in.gcount()) == n;
+}
+
+static int corrupt(const string& what) {
+    cerr << "corrupt log: " << what << "\n";
+    return 1;
+}
+
+//文件内容不可信：长度、个数、id 都先检查再用，任何一次读不满都按损坏处理
+int decode(const string& path, ostream& out) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        cerr << "cannot open " << path << "\n";
+        return 1;
+    }
+    uint32_t magic = 0, version = 0;
+    if (!readExact(in, &magic, sizeof(magic)) || !readExact(in, &version, sizeof(version)) ||
+        magic != FILE_MAGIC || version != FILE_VERSION) {
+        cerr << "bad log file\n";
+        return 1;
+    }
+
+    vector<FormatDef> formats;
+    vector<DecodedRecord> records;
+    int type;
+    while ((type = in.get()) != EOF) {
+        uint16_t id = 0;
+        if (!readExact(in, &id, sizeof(id))) return corrupt("truncated block header");
+        if (type == BLOCK_FORMAT) {
+            FormatDef def{};
+            int nargs = in.get();
+            if (id == 0) return corrupt("format id 0");
+            if (nargs == EOF) return corrupt("truncated format block");
+            if (nargs > MAX_ARGS) return corrupt("format " + to_string(id) + " has " + to_string(nargs) + " arguments");
+            def.nargs = static_cast<uint8_t>(nargs);
+            if (!readExact(in, def.types, def.nargs)) return corrupt("truncated format block");
+            for (int i = 0; i < def.nargs; i++)
+                if (def.types[i] < ARG_I64 || def.types[i] > ARG_BYTES)
+                    return corrupt("format " + to_string(id) + " has argument type " + to_string(def.types[i]));
+            uint16_t len = 0;
+            if (!readExact(in, &len, sizeof(len))) return corrupt("truncated format block");
+            def.fmt.resize(len);
+            if (!readExact(in, &def.fmt[0], len)) return corrupt("truncated format string");
+            if (formats.size() < id) formats.resize(id);
+            formats[id - 1] = def;
+        } else if (type == BLOCK_RECORD) {
+            if (id == 0 || id > formats.size()) {
+                cerr << "unknown format id " << id << "\n";
+                return 1;
+            }
+            const FormatDef& def = formats[id - 1];
+            uint64_t ns = 0;
+            if (!readExact(in, &ns, sizeof(ns))) return corrupt("truncated record");
+
+            vector<string> args;
+            for (int i = 0; i < def.nargs; i++) {
+                if (def.types[i] == ARG_STR || def.types[i] == ARG_BYTES) {
+                    uint16_t len = 0;
+                    if (!readExact(in, &len, sizeof(len))) return corrupt("truncated record");
+                    string raw(len, '\0');
+                    if (!readExact(in, &raw[0], len)) return corrupt("truncated record");
+                    if (def.types[i] == ARG_STR) {
+                        args.push_back(raw);
+                    } else {
+                        string hex;
+                        char buf[4];
+                        for (size_t k = 0; k < raw.size(); k++) {
+                            snprintf(buf, sizeof(buf), k ? " %u" : "%u", unsigned(uint8_t(raw[k])));
+                            hex += buf;
+                        }
+                        args.push_back(hex);
+                    }
+                } else {
+                    uint64_t raw = 0;
+                    if (!readExact(in, &raw, sizeof(raw))) return corrupt("truncated record");
+                    if (def.types[i] == ARG_I64) {
+                        args.push_back(to_string(static_cast<int64_t>(raw)));
+                    } else if (def.types[i] == ARG_U64) {
+                        args.push_back(to_string(raw));
+                    } else {
+                        double d;
+                        memcpy(&d, &raw, sizeof(d));
+                        char buf[32];
+                        snprintf(buf, sizeof(buf), "%g", d);
+                        args.push_back(buf);
+                    }
+                }
+            }
+            records.push_back({ns, render(def.fmt, args)});
+        } else {
+            cerr << "corrupt block type " << type << "\n";
+            return 1;
+        }
+    }
+
+    //各线程的记录在文件里是按线程分段的，按时间戳合并成一条时间线
+    std::stable_sort(records.begin(), records.end(),
+                     [](const DecodedRecord& a, const DecodedRecord& b) { return a.ns < b.ns; });
+    for (const auto& r : records) {
+        char ts[32];
+        snprintf(ts, sizeof(ts), "[%10.3f ms] ", r.ns / 1e6);
+        out << ts << r.text << "\n";
+    }
+    return 0;
+}
+
+} // namespace nlog
+
+//每个调用点一个 static 的格式 id
+#define NLOG(fmt, ...)                                          \
+    do {                                                        \
+        static std::atomic<uint16_t> nlog_id_{0};               \
+        nlog::log(nlog_id_, fmt, ##__VA_ARGS__);                \
+    } while (0)
+
+// ---------- 使用示例：night8 状态机，打印全部改成 NLOG ----------
+class FSMItem {
+    friend class FSM;
+
+private:
+    static void getup()       { NLOG("you should get up!!"); }
+    static void go_school()   { NLOG("you should go school!!"); }
+    static void eat()         { NLOG("you should eat!!"); }
+    static void do_homework() { NLOG("you should do homework!!"); }
+    static void go_sleep()    { NLOG("you should go sleep!!"); }
+    static void on_timeout()  { NLOG("[TIMEOUT] state timeout happened!"); }
+    static void on_error()    { NLOG("[ERROR] invalid event for current state!"); }
+
+public:
+    enum class State { GETUP = 0, GO_SCHOOL, EAT, DO_HOMEWORK, GO_SLEEP, TIMEOUT, ERROR };
+    enum class Events { EVENT1 = 0, EVENT2, EVENT3, EVENT_TIMEOUT };
+
+    FSMItem(State curState, Events event, void(*action)(), State nextState)
+        : _curState(curState), _event(event), _action(action), _nextState(nextState) {}
+
+private:
+    State _curState;
+    Events _event;
+    void(*_action)();
+    State _nextState;
+};
+
+class FSM {
+private:
+    vector<FSMItem> _fsmTable;
+    FSMItem::State _lastState;
+
+    static const char* stateName(FSMItem::State s) {
+        switch (s) {
+        case FSMItem::State::GETUP:        return "GETUP";
+        case FSMItem::State::GO_SCHOOL:    return "GO_SCHOOL";
+        case FSMItem::State::EAT:          return "EAT";
+        case FSMItem::State::DO_HOMEWORK:  return "DO_HOMEWORK";
+        case FSMItem::State::GO_SLEEP:     return "GO_SLEEP";
+        case FSMItem::State::TIMEOUT:      return "TIMEOUT";
+        case FSMItem::State::ERROR:        return "ERROR";
+        default:                           return "UNKNOWN";
+        }
+    }
+
+    void initFSMTable() {
+        _fsmTable.emplace_back(FSMItem::State::GETUP,       FSMItem::Events::EVENT1, &FSMItem::getup,       FSMItem::State::GO_SCHOOL);
+        _fsmTable.emplace_back(FSMItem::State::GO_SCHOOL,   FSMItem::Events::EVENT2, &FSMItem::go_school,   FSMItem::State::EAT);
+        _fsmTable.emplace_back(FSMItem::State::EAT,         FSMItem::Events::EVENT3, &FSMItem::eat,         FSMItem::State::DO_HOMEWORK);
+        _fsmTable.emplace_back(FSMItem::State::DO_HOMEWORK, FSMItem::Events::EVENT1, &FSMItem::do_homework, FSMItem::State::GO_SLEEP);
+        _fsmTable.emplace_back(FSMItem::State::GO_SLEEP,    FSMItem::Events::EVENT2, &FSMItem::go_sleep,    FSMItem::State::GETUP);
+        _fsmTable.emplace_back(FSMItem::State::TIMEOUT,     FSMItem::Events::EVENT1, &FSMItem::getup,       FSMItem::State::GETUP);
+        _fsmTable.emplace_back(FSMItem::State::TIMEOUT,     FSMItem::Events::EVENT3, &FSMItem::on_error,    FSMItem::State::ERROR);
+        _fsmTable.emplace_back(FSMItem::State::ERROR,       FSMItem::Events::EVENT1, &FSMItem::getup,       FSMItem::State::GETUP);
+    }
+
+public:
+    FSMItem::State _curState;
+
+    FSM(FSMItem::State curState = FSMItem::State::GETUP) : _lastState(curState), _curState(curState) {
+        initFSMTable();
+    }
+
+    void transferState(FSMItem::State nextState) {
+        _lastState = _curState;
+        _curState = nextState;
+        NLOG("[STATE] {} -> {}", stateName(_lastState), stateName(_curState));
+    }
+
+    void handleEvent(FSMItem::Events event) {
+        for (const auto& item : _fsmTable) {
+            if (event == item._event && _curState == item._curState) {
+                if (item._action) item._action();
+                transferState(item._nextState);
+                return;
+            }
+        }
+        NLOG("[ERROR] no transition: state={} event={}", stateName(_curState), event);
+        FSMItem::on_error();
+        transferState(FSMItem::State::ERROR);
+    }
+};
+
+void testEvent(FSMItem::Events& event) {
+    switch (event) {
+    case FSMItem::Events::EVENT1: event = FSMItem::Events::EVENT2; break;
+    case FSMItem::Events::EVENT2: event = FSMItem::Events::EVENT3; break;
+    case FSMItem::Events::EVENT3: event = FSMItem::Events::EVENT1; break;
+    default: break;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && string(argv[1]) == "decode")
+        return nlog::decode(argv[2], cout);
+
+    const string path = argc >= 2 ? argv[1] : "nightly_16.nlog";
+    if (!nlog::Logger::instance().start(path)) {
+        cerr << "cannot open " << path << "\n";
+        return 1;
+    }
+
+    // ---------- 1) 状态机：所有打印都变成 NLOG ----------
+    FSM fsm;
+    auto event = FSMItem::Events::EVENT1;
+    for (int i = 0; i < 12; i++) {
+        fsm.handleEvent(event);
+        testEvent(event);
+    }
+
+    // ---------- 2) 帧打印：整帧数据作为一个 LogBytes 参数 ----------
+    const uint8_t payload[] = {0x01, 0x02, 0x03, 0x04, 0x05};
+    NLOG("frame received len={} data: {}", sizeof(payload), nlog::LogBytes{payload, sizeof(payload)});
+
+    // ---------- 3) 调用点开销：NLOG vs cout << endl ----------
+    //每轮写入量小于环容量，轮与轮之间给后台线程时间落盘，测的是不丢弃时的真实开销
+    constexpr int ROUNDS = 10;
+    constexpr int N = 20000;
+    double nlogTotal = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; i++)
+            NLOG("bench i={} state={} temp={}", i, "EAT", i * 0.5);
+        nlogTotal += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    double nlogNs = nlogTotal / (ROUNDS * N);
+
+    std::ofstream sink("/dev/null");
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+        sink << "bench i=" << i << " state=" << "EAT" << " temp=" << i * 0.5 << std::endl;
+    double coutNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+
+    //多线程同时打日志：每个线程用自己的环
+    vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < 1000; i++)
+                NLOG("worker {} seq {}", t, i);
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    //改写过的栈缓冲、临时 std::string：内容在调用点就已拷进记录
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "tmp-%d", 1);
+        NLOG("char buffer {} string {}", buf, string("temporary"));
+        snprintf(buf, sizeof(buf), "overwritten");
+    }
+
+    //退出的线程：环在后台线程写完后被回收，只剩主线程自己的
+    for (int i = 0; i < 100 && nlog::Logger::instance().ringCount() > 1; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    size_t ringsLeft = nlog::Logger::instance().ringCount();
+
+    nlog::Logger::instance().stop();
+
+    cout << "NLOG call site : " << nlogNs << " ns/call\n";
+    cout << "ostream + endl : " << coutNs << " ns/call\n";
+    cout << "records written=" << nlog::Logger::instance().written()
+         << " dropped=" << nlog::Logger::instance().dropped()
+         << " rings after worker exit=" << ringsLeft << "\n";
+
+    //解码前 20 行给人看
+    cout << "\n--- decoded (" << path << ") ---\n";
+    std::stringstream text;
+    if (nlog::decode(path, text) != 0) return 1;
+    string line;
+    for (int i = 0; i < 20 && std::getline(text, line); i++)
+        cout << line << "\n";
+
+    // ---------- 4) 损坏的文件：截断、参数个数超限，解码器必须报错而不是越界 ----------
+    string bytes;
+    {
+        std::ifstream f(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+    const string bad = path + ".corrupt";
+    auto decodeBad = [&](const char* what, const string& content) {
+        std::ofstream(bad, std::ios::binary) << content;
+        std::stringstream sink2;
+        cout << what << ": ";
+        cout.flush();
+        int rc = nlog::decode(bad, sink2);
+        cout << (rc != 0 ? "rejected" : "ACCEPTED") << "\n";
+        return rc != 0;
+    };
+    cout << "\n";
+    string badNargs = bytes;
+    badNargs[8 + 1 + 2] = char(200);                // 第一个格式块的 nargs
+    bool ok = decodeBad("truncated log", bytes.substr(0, bytes.size() - 3)) &&
+              decodeBad("nargs=200", badNargs);
+    std::remove(bad.c_str());
+
+    // ---------- 5) stop() 之后重新 start() 到新文件：格式定义要重新写进去 ----------
+    const string again = path + ".2";
+    if (!nlog::Logger::instance().start(again)) {
+        cerr << "cannot open " << again << "\n";
+        return 1;
+    }
+    fsm.handleEvent(FSMItem::Events::EVENT1);
+    nlog::Logger::instance().stop();
+    std::stringstream text2;
+    bool restarted = nlog::decode(again, text2) == 0 && text2.str().find("[STATE]") != string::npos;
+    cout << "restart into " << again << ": " << (restarted ? "decoded" : "FAILED") << "\n";
+    std::remove(again.c_str());
+    return ok && restarted && ringsLeft == 1 ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+/*
+状态机性能剖析：每个状态的停留时间 + 转移统计
+
+night8 记录了 _enterTime 和 _lastState，但只用来判断超时，看不到状态机的时间花在哪
+
+night17 针对此状态机的修改：内置 FSMProfiler
+1. 转移计数矩阵 transitions[现态][次态]
+2. 每个状态的停留时间直方图（按 2 的幂分桶，单位 us）
+3. 每个状态的超时次数 / 非法事件次数（除以离开该状态的次数就是超时率/错误率）
+4. 每个动作（状态转移表的每一项）累计耗时和调用次数
+5. 计数器都是 atomic，只有状态机线程写（relaxed load+store，不用加锁的 RMW），
+   其他线程随时 snapshot() 读取，不需要停下状态机
+6. 编译期开关：FSM_PROFILING=0 时 FSMProfiler 变成空类，所有剖析代码都不参与编译
+   g++ -DFSM_PROFILING=0 nightly_17.cpp
+*/
+#include <iostream>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+
+#ifndef FSM_PROFILING
+#define FSM_PROFILING 1
+#endif
+
+using namespace std;
+
+//状态项
+class FSMItem {
+    friend class FSM;
+
+private:
+    //动作：模拟一点耗时（忙等），不同动作耗时不同
+    static void spin(int us) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+        while (std::chrono::steady_clock::now() < end) {}
+    }
+    static void getup()       { spin(5); }
+    static void go_school()   { spin(20); }
+    static void eat()         { spin(10); }
+    static void do_homework() { spin(50); }
+    static void go_sleep()    { spin(5); }
+    static void on_timeout()  { spin(1); }
+    static void on_error()    { spin(1); }
+
+public:
+    enum class State {
+        GETUP = 0,
+        GO_SCHOOL,
+        EAT,
+        DO_HOMEWORK,
+        GO_SLEEP,
+        TIMEOUT,
+        ERROR
+    };
+
+    enum class Events {
+        EVENT1 = 0,
+        EVENT2,
+        EVENT3,
+        EVENT_TIMEOUT
+    };
+
+    FSMItem(State curState, Events event, void(*action)(), State nextState)
+        : _curState(curState), _event(event), _action(action), _nextState(nextState) {}
+
+private:
+    State _curState;      // 现态
+    Events _event;        // 条件
+    void(*_action)();     // 动作
+    State _nextState;     // 次态
+};
+
+constexpr int STATE_COUNT = 7;
+constexpr int MAX_ITEMS = 32;           // 转移表最多项数（动作耗时按表项统计）
+constexpr int DWELL_BUCKETS = 32;       // 停留时间桶：[0,1us) [1,2) [2,4) ... [2^30us, ∞)
+
+const char* stateName(FSMItem::State s) {
+    switch (s) {
+    case FSMItem::State::GETUP:        return "GETUP";
+    case FSMItem::State::GO_SCHOOL:    return "GO_SCHOOL";
+    case FSMItem::State::EAT:          return "EAT";
+    case FSMItem::State::DO_HOMEWORK:  return "DO_HOMEWORK";
+    case FSMItem::State::GO_SLEEP:     return "GO_SLEEP";
+    case FSMItem::State::TIMEOUT:      return "TIMEOUT";
+    case FSMItem::State::ERROR:        return "ERROR";
+    default:                           return "UNKNOWN";
+    }
+}
+
+//快照：普通数值，拿到以后随便算
+struct FSMProfileSnapshot {
+    uint64_t transitions[STATE_COUNT][STATE_COUNT] = {};
+    uint64_t dwell[STATE_COUNT][DWELL_BUCKETS] = {};
+    uint64_t dwellTotalUs[STATE_COUNT] = {};
+    uint64_t timeouts[STATE_COUNT] = {};
+    uint64_t errors[STATE_COUNT] = {};
+    uint64_t actionCalls[MAX_ITEMS] = {};
+    uint64_t actionNs[MAX_ITEMS] = {};
+
+    //离开某状态的总次数
+    uint64_t exits(int s) const {
+        uint64_t n = 0;
+        for (int t = 0; t < STATE_COUNT; t++) n += transitions[s][t];
+        return n;
+    }
+
+    //停留时间分位数（返回所在桶的上界，us）
+    uint64_t dwellPercentile(int s, double p) const {
+        uint64_t total = 0;
+        for (int b = 0; b < DWELL_BUCKETS; b++) total += dwell[s][b];
+        if (total == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(total * p);
+        uint64_t acc = 0;
+        for (int b = 0; b < DWELL_BUCKETS; b++) {
+            acc += dwell[s][b];
+            if (acc > target) return uint64_t(1) << b;
+        }
+        return uint64_t(1) << (DWELL_BUCKETS - 1);
+    }
+};
+
+#if FSM_PROFILING
+/*
+剖析数据
+单写者（状态机所在线程）：自增用 load + store(relaxed)，不需要 lock 前缀的原子加
+多读者：snapshot() 逐个 load(relaxed)，读到的是某一时刻附近的近似值，不会读到撕裂的数
+*/
+class FSMProfiler {
+public:
+    void onTransition(FSMItem::State from, FSMItem::State to, uint64_t dwellUs) {
+        int f = static_cast<int>(from);
+        bump(_transitions[f][static_cast<int>(to)]);
+        bump(_dwell[f][bucketOf(dwellUs)]);
+        add(_dwellTotalUs[f], dwellUs);
+    }
+    void onTimeout(FSMItem::State s) { bump(_timeouts[static_cast<int>(s)]); }
+    void onError(FSMItem::State s) { bump(_errors[static_cast<int>(s)]); }
+    void onAction(int item, uint64_t ns) {
+        bump(_actionCalls[item]);
+        add(_actionNs[item], ns);
+    }
+
+    FSMProfileSnapshot snapshot() const {
+        FSMProfileSnapshot s;
+        for (int i = 0; i < STATE_COUNT; i++) {
+            for (int j = 0; j < STATE_COUNT; j++) s.transitions[i][j] = _transitions[i][j].load(std::memory_order_relaxed);
+            for (int b = 0; b < DWELL_BUCKETS; b++) s.dwell[i][b] = _dwell[i][b].load(std::memory_order_relaxed);
+            s.dwellTotalUs[i] = _dwellTotalUs[i].load(std::memory_order_relaxed);
+            s.timeouts[i] = _timeouts[i].load(std::memory_order_relaxed);
+            s.errors[i] = _errors[i].load(std::memory_order_relaxed);
+        }
+        for (int k = 0; k < MAX_ITEMS; k++) {
+            s.actionCalls[k] = _actionCalls[k].load(std::memory_order_relaxed);
+            s.actionNs[k] = _actionNs[k].load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& c) { add(c, 1); }
+    static void add(std::atomic<uint64_t>& c, uint64_t v) {
+        c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+    static int bucketOf(uint64_t us) {
+        int b = 0;
+        while (us > 0 && b < DWELL_BUCKETS - 1) {
+            us >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    std::atomic<uint64_t> _transitions[STATE_COUNT][STATE_COUNT] = {};
+    std::atomic<uint64_t> _dwell[STATE_COUNT][DWELL_BUCKETS] = {};
+    std::atomic<uint64_t> _dwellTotalUs[STATE_COUNT] = {};
+    std::atomic<uint64_t> _timeouts[STATE_COUNT] = {};
+    std::atomic<uint64_t> _errors[STATE_COUNT] = {};
+    std::atomic<uint64_t> _actionCalls[MAX_ITEMS] = {};
+    std::atomic<uint64_t> _actionNs[MAX_ITEMS] = {};
+};
+#define FSM_PROF(stmt) do { stmt; } while (0)
+#else
+//关闭剖析：空类，snapshot 永远是全 0
+class FSMProfiler {
+public:
+    FSMProfileSnapshot snapshot() const { return {}; }
+};
+#define FSM_PROF(stmt) do {} while (0)
+#endif
+
+class FSM {
+private:
+    vector<FSMItem*> _fsmTable;
+
+    // 记录状态进入时间，用于超时判定和停留时间统计
+    std::chrono::steady_clock::time_point _enterTime;
+
+    FSMItem::State _lastState;
+
+    FSMProfiler _profiler;
+
+    // 每个状态允许停留的最大时间
+    static std::chrono::milliseconds timeoutOf(FSMItem::State s) {
+        using namespace std::chrono;
+        switch (s) {
+        case FSMItem::State::GETUP:        return 15ms;
+        case FSMItem::State::GO_SCHOOL:    return 12ms;
+        case FSMItem::State::EAT:          return 10ms;
+        case FSMItem::State::DO_HOMEWORK:  return 20ms;
+        case FSMItem::State::GO_SLEEP:     return 15ms;
+        case FSMItem::State::TIMEOUT:      return 0ms;
+        case FSMItem::State::ERROR:        return 0ms;
+        default:                           return 0ms;
+        }
+    }
+
+    void initFSMTable() {
+        // 正常流程
+        _fsmTable.push_back(new FSMItem(FSMItem::State::GETUP,       FSMItem::Events::EVENT1, &FSMItem::getup,       FSMItem::State::GO_SCHOOL));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::GO_SCHOOL,   FSMItem::Events::EVENT2, &FSMItem::go_school,   FSMItem::State::EAT));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::EAT,         FSMItem::Events::EVENT3, &FSMItem::eat,         FSMItem::State::DO_HOMEWORK));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::DO_HOMEWORK, FSMItem::Events::EVENT1, &FSMItem::do_homework, FSMItem::State::GO_SLEEP));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::GO_SLEEP,    FSMItem::Events::EVENT2, &FSMItem::go_sleep,    FSMItem::State::GETUP));
+
+        // 任何正常态超时 -> TIMEOUT
+        _fsmTable.push_back(new FSMItem(FSMItem::State::GETUP,       FSMItem::Events::EVENT_TIMEOUT, &FSMItem::on_timeout, FSMItem::State::TIMEOUT));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::GO_SCHOOL,   FSMItem::Events::EVENT_TIMEOUT, &FSMItem::on_timeout, FSMItem::State::TIMEOUT));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::EAT,         FSMItem::Events::EVENT_TIMEOUT, &FSMItem::on_timeout, FSMItem::State::TIMEOUT));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::DO_HOMEWORK, FSMItem::Events::EVENT_TIMEOUT, &FSMItem::on_timeout, FSMItem::State::TIMEOUT));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::GO_SLEEP,    FSMItem::Events::EVENT_TIMEOUT, &FSMItem::on_timeout, FSMItem::State::TIMEOUT));
+
+        // TIMEOUT 态的恢复策略
+        _fsmTable.push_back(new FSMItem(FSMItem::State::TIMEOUT, FSMItem::Events::EVENT1, &FSMItem::getup,     FSMItem::State::GETUP));
+        _fsmTable.push_back(new FSMItem(FSMItem::State::TIMEOUT, FSMItem::Events::EVENT3, &FSMItem::on_error,  FSMItem::State::ERROR));
+
+        // ERROR 态恢复策略
+        _fsmTable.push_back(new FSMItem(FSMItem::State::ERROR, FSMItem::Events::EVENT1, &FSMItem::getup, FSMItem::State::GETUP));
+    }
+
+public:
+    FSMItem::State _curState;
+
+public:
+    FSM(FSMItem::State curState = FSMItem::State::GETUP)
+        : _enterTime(std::chrono::steady_clock::now()),
+          _lastState(curState),
+          _curState(curState) {
+        initFSMTable();
+    }
+
+    //其他线程可以随时调用
+    FSMProfileSnapshot profile() const { return _profiler.snapshot(); }
+
+    //转移表第 i 项描述，用于打印动作耗时
+    size_t itemCount() const { return _fsmTable.size(); }
+    void describeItem(size_t i, FSMItem::State& from, FSMItem::Events& event, FSMItem::State& to) const {
+        from = _fsmTable[i]->_curState;
+        event = _fsmTable[i]->_event;
+        to = _fsmTable[i]->_nextState;
+    }
+
+    void transferState(FSMItem::State nextState) {
+        auto now = std::chrono::steady_clock::now();
+        FSM_PROF(_profiler.onTransition(_curState, nextState,
+            std::chrono::duration_cast<std::chrono::microseconds>(now - _enterTime).count()));
+
+        _lastState = _curState;
+        _curState = nextState;
+        _enterTime = now;
+    }
+
+    // 超时检测（主循环里周期调用）
+    void tick() {
+        auto to = timeoutOf(_curState);
+        if (to.count() <= 0) return;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - _enterTime > to) {
+            FSM_PROF(_profiler.onTimeout(_curState));
+            handleEvent(FSMItem::Events::EVENT_TIMEOUT);
+        }
+    }
+
+    void handleEvent(FSMItem::Events event) {
+        FSMItem::State curState = _curState;
+        void(*action)() = nullptr;
+        FSMItem::State nextState = curState;
+        int found = -1;
+
+        for (int i = 0; i < (int)_fsmTable.size(); i++) {
+            if (event == _fsmTable[i]->_event && curState == _fsmTable[i]->_curState) {
+                found = i;
+                action = _fsmTable[i]->_action;
+                nextState = _fsmTable[i]->_nextState;
+                break;
+            }
+        }
+
+        if (found >= 0) {
+            if (action) {
+#if FSM_PROFILING
+                auto start = std::chrono::steady_clock::now();
+                action();
+                _profiler.onAction(found, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+#else
+                action();
+#endif
+            }
+            transferState(nextState);
+        } else {
+            // 非法事件 -> ERROR
+            FSM_PROF(_profiler.onError(_curState));
+            FSMItem::on_error();
+            transferState(FSMItem::State::ERROR);
+        }
+    }
+
+    ~FSM() {
+        for (auto p : _fsmTable) delete p;
+        _fsmTable.clear();
+    }
+};
+
+void printProfile(const FSM& fsm, const FSMProfileSnapshot& s) {
+    cout << "transition matrix (row=from, col=to):\n            ";
+    for (int t = 0; t < STATE_COUNT; t++) printf("%12s", stateName(static_cast<FSMItem::State>(t)));
+    cout << "\n";
+    for (int f = 0; f < STATE_COUNT; f++) {
+        printf("%12s", stateName(static_cast<FSMItem::State>(f)));
+        for (int t = 0; t < STATE_COUNT; t++) printf("%12llu", (unsigned long long)s.transitions[f][t]);
+        cout << "\n";
+    }
+
+    cout << "\nper-state dwell / timeout / error:\n";
+    printf("%12s %8s %10s %10s %10s %9s %9s\n", "state", "exits", "avg(us)", "p50(us)", "p99(us)", "timeout%", "error%");
+    for (int st = 0; st < STATE_COUNT; st++) {
+        uint64_t exits = s.exits(st);
+        if (exits == 0) continue;
+        printf("%12s %8llu %10llu %10llu %10llu %8.2f%% %8.2f%%\n",
+               stateName(static_cast<FSMItem::State>(st)),
+               (unsigned long long)exits,
+               (unsigned long long)(s.dwellTotalUs[st] / exits),
+               (unsigned long long)s.dwellPercentile(st, 0.50),
+               (unsigned long long)s.dwellPercentile(st, 0.99),
+               100.0 * s.timeouts[st] / exits,
+               100.0 * s.errors[st] / exits);
+    }
+
+    cout << "\naction time per table item:\n";
+    for (size_t i = 0; i < fsm.itemCount(); i++) {
+        if (s.actionCalls[i] == 0) continue;
+        FSMItem::State from, to;
+        FSMItem::Events ev;
+        fsm.describeItem(i, from, ev, to);
+        printf("  %-12s --E%d--> %-12s calls=%-8llu avg=%.2f us\n",
+               stateName(from), static_cast<int>(ev), stateName(to),
+               (unsigned long long)s.actionCalls[i], s.actionNs[i] / 1000.0 / s.actionCalls[i]);
+    }
+}
+
+int main() {
+    FSM fsm;
+    std::atomic<bool> done{false};
+
+    //状态机线程：随机事件 + 随机停顿，偶尔停顿过长触发超时
+    std::thread worker([&] {
+        std::mt19937 rng(8);
+        std::uniform_int_distribution<int> pickEvent(0, 2);
+        std::uniform_int_distribution<int> pickPause(0, 99);
+        for (int i = 0; i < 2000; i++) {
+            int p = pickPause(rng);
+            std::this_thread::sleep_for(std::chrono::microseconds(p < 95 ? 200 + p * 20 : 25000));
+            fsm.tick();
+            fsm.handleEvent(static_cast<FSMItem::Events>(pickEvent(rng)));
+        }
+        done = true;
+    });
+
+    //观察线程：不停下状态机，周期性读取快照
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        FSMProfileSnapshot s = fsm.profile();
+        uint64_t total = 0;
+        for (int st = 0; st < STATE_COUNT; st++) total += s.exits(st);
+        cout << "[snapshot] transitions so far=" << total << "\n";
+    }
+    worker.join();
+
+    cout << "\n";
+#if FSM_PROFILING
+    printProfile(fsm, fsm.profile());
+#else
+    (void)printProfile;
+    cout << "profiling disabled (FSM_PROFILING=0), sizeof(FSMProfiler)=" << sizeof(FSMProfiler) << "\n";
+#endif
+    return 0;
+}
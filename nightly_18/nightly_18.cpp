@@ -0,0 +1,477 @@
+/*
+状态机群的快照/恢复：内存映射状态文件
+
+问题：
+服务重启后要把每台设备的状态机靠“重放事件”重新建出来，百万设备要好几分钟
+_enterTime 是 steady_clock 时间点，进程重启后就没意义了
+
+night18 的做法：
+1. 状态机群沿用 night13 的 SoA 布局：states[] / lastStates[] / deadlines[]
+   deadlines[] 存“超时截止时间，相对本进程 epoch 的毫秒数”，不再存进入时间
+2. 快照：把 states/lastStates 原样写出，deadline 换算成“剩余毫秒数”写出
+   文件 = 定长文件头（魔数/版本/实例数/转移表指纹/各数组偏移/校验和）+ 三个对齐的数组
+3. 恢复：mmap 整个文件，只校验文件头（可选再校验整体校验和），
+   然后把新进程的 epoch 设成“现在”，剩余毫秒数数组就直接是 deadlines[] —— 不逐个解析、不分配
+   MAP_PRIVATE 映射，之后状态机修改的是写时复制的私有页，不会改坏快照文件
+*/
+#include <iostream>
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+enum class State : uint8_t {
+    GETUP = 0,
+    GO_SCHOOL,
+    EAT,
+    DO_HOMEWORK,
+    GO_SLEEP,
+    TIMEOUT,
+    ERROR,
+
+    COUNT
+};
+
+enum class Events : uint8_t {
+    EVENT1 = 0,
+    EVENT2,
+    EVENT3,
+    EVENT_TIMEOUT,
+
+    COUNT
+};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+
+struct Transition {
+    State curState;
+    Events event;
+    State nextState;
+};
+
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+constexpr Transition kStudentTable[] = {
+    {State::GETUP,       Events::EVENT1, State::GO_SCHOOL},
+    {State::GO_SCHOOL,   Events::EVENT2, State::EAT},
+    {State::EAT,         Events::EVENT3, State::DO_HOMEWORK},
+    {State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP},
+    {State::GO_SLEEP,    Events::EVENT2, State::GETUP},
+    {State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::TIMEOUT, Events::EVENT1, State::GETUP},
+    {State::TIMEOUT, Events::EVENT3, State::ERROR},
+    {State::ERROR,   Events::EVENT1, State::GETUP},
+};
+
+template <size_t N>
+constexpr array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+constexpr auto kJump = buildJumpTable(kStudentTable);
+
+//FNV-1a：转移表指纹 + 快照数据校验和
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+constexpr uint64_t fnv1a(uint64_t h, uint8_t byte) {
+    return (h ^ byte) * FNV_PRIME;
+}
+
+uint64_t fnv1a(uint64_t h, const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        h = fnv1a(h, p[i]);
+    return h;
+}
+
+//转移表改了（状态编号含义变了）旧快照就不能用，指纹写进文件头
+template <size_t N>
+constexpr uint64_t tableFingerprint(const Transition (&t)[N]) {
+    uint64_t h = FNV_OFFSET;
+    h = fnv1a(h, static_cast<uint8_t>(STATE_COUNT));
+    h = fnv1a(h, static_cast<uint8_t>(EVENT_COUNT));
+    for (size_t i = 0; i < N; i++) {
+        h = fnv1a(h, static_cast<uint8_t>(t[i].curState));
+        h = fnv1a(h, static_cast<uint8_t>(t[i].event));
+        h = fnv1a(h, static_cast<uint8_t>(t[i].nextState));
+    }
+    return h;
+}
+
+constexpr uint64_t kTableFingerprint = tableFingerprint(kStudentTable);
+
+constexpr uint32_t timeoutOf(State s) {
+    switch (s) {
+    case State::GETUP:        return 1500;
+    case State::GO_SCHOOL:    return 1200;
+    case State::EAT:          return 1000;
+    case State::DO_HOMEWORK:  return 2000;
+    case State::GO_SLEEP:     return 1500;
+    default:                  return 0;
+    }
+}
+
+constexpr uint32_t NO_DEADLINE = 0xFFFFFFFF;
+
+/*
+快照文件头，定长 64 字节，后面紧跟三个数组（按 64 字节对齐）
+*/
+struct SnapshotHeader {
+    uint32_t magic;             // "FSMS"
+    uint32_t version;
+    uint64_t instances;
+    uint64_t tableFingerprint;
+    uint64_t statesOffset;
+    uint64_t lastStatesOffset;
+    uint64_t remainingOffset;   // u32 剩余毫秒，NO_DEADLINE 表示该状态不超时
+    uint64_t fileSize;
+    uint64_t checksum;          // 文件头之后全部数据的 FNV-1a
+};
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header must stay 64 bytes");
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x534D5346;   // "FSMS"
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+constexpr uint64_t alignUp(uint64_t v, uint64_t a) { return (v + a - 1) & ~(a - 1); }
+
+/*
+状态机群
+数据可以在自己的 vector 里，也可以直接指向 mmap 出来的快照（恢复时）
+*/
+class FSMFleet {
+public:
+    explicit FSMFleet(size_t instances)
+        : _count(instances),
+          _epoch(std::chrono::steady_clock::now()) {
+        _ownStates.assign(instances, static_cast<uint8_t>(State::GETUP));
+        _ownLastStates.assign(instances, static_cast<uint8_t>(State::GETUP));
+        _ownDeadlines.assign(instances, timeoutOf(State::GETUP));
+        _states = _ownStates.data();
+        _lastStates = _ownLastStates.data();
+        _deadlines = _ownDeadlines.data();
+    }
+
+    ~FSMFleet() {
+        if (_map) munmap(_map, _mapSize);
+    }
+
+    FSMFleet(const FSMFleet&) = delete;
+    FSMFleet& operator=(const FSMFleet&) = delete;
+
+    size_t size() const { return _count; }
+    State state(size_t i) const { return static_cast<State>(_states[i]); }
+    State lastState(size_t i) const { return static_cast<State>(_lastStates[i]); }
+
+    //相对 epoch 的当前毫秒数
+    uint32_t nowMs() const {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - _epoch).count());
+    }
+
+    //剩余时间（ms），NO_DEADLINE 表示不超时
+    uint32_t remainingMs(size_t i, uint32_t now) const {
+        uint32_t d = _deadlines[i];
+        if (d == NO_DEADLINE) return NO_DEADLINE;
+        return d > now ? d - now : 0;
+    }
+
+    void handleEvent(size_t i, Events event, uint32_t now) {
+        //恢复时不逐个校验，坏掉的状态字节在这里当成 ERROR，防止越界查表
+        uint8_t cur = _states[i] < STATE_COUNT ? _states[i] : static_cast<uint8_t>(State::ERROR);
+        uint8_t k = kJump[cur * EVENT_COUNT + static_cast<size_t>(event)];
+        State next = (k != NO_TRANSITION) ? kStudentTable[k].nextState : State::ERROR;
+        _lastStates[i] = cur;
+        _states[i] = static_cast<uint8_t>(next);
+        uint32_t to = timeoutOf(next);
+        _deadlines[i] = to ? now + to : NO_DEADLINE;
+    }
+
+    //超时检测：到期的实例投递 EVENT_TIMEOUT
+    void tick(size_t i, uint32_t now) {
+        if (_deadlines[i] != NO_DEADLINE && _deadlines[i] <= now)
+            handleEvent(i, Events::EVENT_TIMEOUT, now);
+    }
+
+    //写快照，成功返回 true
+    bool saveSnapshot(const string& path) const {
+        SnapshotHeader h{};
+        h.magic = SNAPSHOT_MAGIC;
+        h.version = SNAPSHOT_VERSION;
+        h.instances = _count;
+        h.tableFingerprint = kTableFingerprint;
+        h.statesOffset = alignUp(sizeof(SnapshotHeader), 64);
+        h.lastStatesOffset = alignUp(h.statesOffset + _count, 64);
+        h.remainingOffset = alignUp(h.lastStatesOffset + _count, 64);
+        h.fileSize = h.remainingOffset + _count * sizeof(uint32_t);
+
+        //先写临时文件再 rename，崩溃时不会留下半个快照
+        string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+
+        bool ok = true;
+        uint64_t sum = FNV_OFFSET;
+        ok = ok && writeAt(fd, h.statesOffset, _states, _count, sum);
+        ok = ok && writeAt(fd, h.lastStatesOffset, _lastStates, _count, sum);
+
+        //deadline -> 剩余毫秒，分块换算后写出
+        uint32_t now = nowMs();
+        vector<uint32_t> chunk(64 * 1024);
+        for (size_t base = 0; ok && base < _count; base += chunk.size()) {
+            size_t n = std::min(chunk.size(), _count - base);
+            for (size_t k = 0; k < n; k++)
+                chunk[k] = remainingMs(base + k, now);
+            ok = writeAt(fd, h.remainingOffset + base * sizeof(uint32_t),
+                         reinterpret_cast<const uint8_t*>(chunk.data()), n * sizeof(uint32_t), sum);
+        }
+
+        h.checksum = sum;
+        uint64_t dummy = 0;
+        ok = ok && writeAt(fd, 0, reinterpret_cast<const uint8_t*>(&h), sizeof(h), dummy);
+        ok = ok && ::ftruncate(fd, h.fileSize) == 0;
+        ok = ok && ::fsync(fd) == 0;
+        ::close(fd);
+        if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /*
+    从快照恢复：mmap + 校验文件头
+    verifyChecksum=true 时再把整个数据区算一遍校验和（O(N)，但仍然没有逐实例解析）
+    失败返回 nullptr，error 里是原因
+    */
+    static std::unique_ptr<FSMFleet> restore(const string& path, bool verifyChecksum, string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "open failed";
+            return nullptr;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader)) {
+            ::close(fd);
+            error = "file too small";
+            return nullptr;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);                // 映射建立后 fd 可以关掉
+        if (map == MAP_FAILED) {
+            error = "mmap failed";
+            return nullptr;
+        }
+
+        const SnapshotHeader* h = static_cast<const SnapshotHeader*>(map);
+        error.clear();
+        if (h->magic != SNAPSHOT_MAGIC) error = "bad magic";
+        else if (h->version != SNAPSHOT_VERSION) error = "unsupported version";
+        else if (h->tableFingerprint != kTableFingerprint) error = "transition table changed since snapshot";
+        else if (h->fileSize != size) error = "truncated file";
+        else if (!layoutFits(*h, size))
+            error = "bad layout";
+        else if (verifyChecksum) {
+            uint8_t* base = static_cast<uint8_t*>(map);
+            uint64_t sum = FNV_OFFSET;
+            sum = fnv1a(sum, base + h->statesOffset, h->instances);
+            sum = fnv1a(sum, base + h->lastStatesOffset, h->instances);
+            sum = fnv1a(sum, base + h->remainingOffset, h->instances * sizeof(uint32_t));
+            if (sum != h->checksum) error = "checksum mismatch";
+        }
+        if (!error.empty()) {
+            ::munmap(map, size);
+            return nullptr;
+        }
+
+        //新进程的 epoch 就是现在：剩余毫秒数 == 相对新 epoch 的截止时间
+        std::unique_ptr<FSMFleet> fleet(new FSMFleet());
+        uint8_t* base = static_cast<uint8_t*>(map);
+        fleet->_count = h->instances;
+        fleet->_epoch = std::chrono::steady_clock::now();
+        fleet->_states = base + h->statesOffset;
+        fleet->_lastStates = base + h->lastStatesOffset;
+        fleet->_deadlines = reinterpret_cast<uint32_t*>(base + h->remainingOffset);
+        fleet->_map = map;
+        fleet->_mapSize = size;
+        return fleet;
+    }
+
+private:
+    FSMFleet() : _count(0), _epoch(std::chrono::steady_clock::now()) {}
+
+    //三个数组依次排列且都在文件内
+    //文件头不可信：只用减法比较，偏移和实例数再大也不会加法回绕
+    static bool layoutFits(const SnapshotHeader& h, size_t size) {
+        if (h.statesOffset < sizeof(SnapshotHeader) || h.statesOffset > size)
+            return false;
+        if (h.lastStatesOffset < h.statesOffset || h.lastStatesOffset > size ||
+            h.instances > h.lastStatesOffset - h.statesOffset)
+            return false;
+        if (h.remainingOffset < h.lastStatesOffset || h.remainingOffset > size ||
+            h.instances > h.remainingOffset - h.lastStatesOffset)
+            return false;
+        return h.remainingOffset % alignof(uint32_t) == 0 &&
+               h.instances <= (size - h.remainingOffset) / sizeof(uint32_t);
+    }
+
+    static bool writeAt(int fd, uint64_t offset, const uint8_t* p, size_t n, uint64_t& sum) {
+        sum = fnv1a(sum, p, n);
+        while (n > 0) {
+            ssize_t w = ::pwrite(fd, p, n, static_cast<off_t>(offset));
+            if (w <= 0) return false;
+            p += w;
+            n -= static_cast<size_t>(w);
+            offset += static_cast<uint64_t>(w);
+        }
+        return true;
+    }
+
+    size_t _count;
+    std::chrono::steady_clock::time_point _epoch;
+
+    uint8_t* _states = nullptr;
+    uint8_t* _lastStates = nullptr;
+    uint32_t* _deadlines = nullptr;
+
+    vector<uint8_t> _ownStates;
+    vector<uint8_t> _ownLastStates;
+    vector<uint32_t> _ownDeadlines;
+
+    void* _map = nullptr;
+    size_t _mapSize = 0;
+};
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    const string path = argc >= 2 ? argv[1] : "nightly_18.snap";
+    constexpr size_t INSTANCES = 1000000;
+    constexpr int EVENTS_PER_INSTANCE = 10;
+
+    //事件日志：重放对照组用
+    vector<pair<uint32_t, Events>> journal;
+    journal.reserve(INSTANCES * EVENTS_PER_INSTANCE);
+    std::mt19937 rng(18);
+    std::uniform_int_distribution<uint32_t> pickInstance(0, INSTANCES - 1);
+    std::uniform_int_distribution<int> pickEvent(0, 2);
+    for (size_t k = 0; k < INSTANCES * EVENTS_PER_INSTANCE; k++)
+        journal.emplace_back(pickInstance(rng), static_cast<Events>(pickEvent(rng)));
+
+    // ---------- 1) 运行一段时间后写快照 ----------
+    FSMFleet fleet(INSTANCES);
+    uint32_t now = fleet.nowMs();
+    for (const auto& e : journal)
+        fleet.handleEvent(e.first, e.second, now);
+
+    auto start = std::chrono::steady_clock::now();
+    if (!fleet.saveSnapshot(path)) {
+        cerr << "snapshot failed\n";
+        return 1;
+    }
+    double saveMs = msSince(start);
+
+    // ---------- 2) 恢复：只校验文件头 / 加上整体校验和 ----------
+    string error;
+    start = std::chrono::steady_clock::now();
+    auto restored = FSMFleet::restore(path, false, error);
+    double restoreMs = msSince(start);
+    if (!restored) {
+        cerr << "restore failed: " << error << "\n";
+        return 1;
+    }
+
+    start = std::chrono::steady_clock::now();
+    auto verified = FSMFleet::restore(path, true, error);
+    double verifyMs = msSince(start);
+    if (!verified) {
+        cerr << "verified restore failed: " << error << "\n";
+        return 1;
+    }
+
+    // ---------- 3) 对照：重放事件日志重建 ----------
+    start = std::chrono::steady_clock::now();
+    FSMFleet replayed(INSTANCES);
+    uint32_t replayNow = replayed.nowMs();
+    for (const auto& e : journal)
+        replayed.handleEvent(e.first, e.second, replayNow);
+    double replayMs = msSince(start);
+
+    //恢复结果必须与原状态机群一致
+    size_t mismatches = 0;
+    uint32_t restoredNow = restored->nowMs();
+    uint32_t fleetNow = fleet.nowMs();
+    for (size_t i = 0; i < INSTANCES; i++) {
+        if (restored->state(i) != fleet.state(i) || restored->lastState(i) != fleet.lastState(i))
+            mismatches++;
+        //剩余时间：快照后又过去了一点时间，允许几毫秒误差
+        uint32_t a = restored->remainingMs(i, restoredNow), b = fleet.remainingMs(i, fleetNow);
+        if ((a == NO_DEADLINE) != (b == NO_DEADLINE) || (a != NO_DEADLINE && (a > b + 50 || b > a + 50)))
+            mismatches++;
+    }
+
+    //恢复出来的状态机可以直接继续跑（写时复制，不影响快照文件）
+    restored->handleEvent(0, Events::EVENT1, restoredNow);
+
+    cout << "instances=" << INSTANCES << " file=" << path << "\n";
+    cout << "snapshot save          : " << saveMs << " ms\n";
+    cout << "restore (header check) : " << restoreMs << " ms\n";
+    cout << "restore (+checksum)    : " << verifyMs << " ms\n";
+    cout << "rebuild by replay      : " << replayMs << " ms (" << journal.size() << " events)\n";
+    cout << "mismatches=" << mismatches << "\n";
+
+    //故意改坏一个字节，校验和应当能发现
+    {
+        int fd = ::open(path.c_str(), O_RDWR);
+        uint8_t b = 0;
+        off_t off = static_cast<off_t>(alignUp(sizeof(SnapshotHeader), 64) + 123);
+        if (fd >= 0 && ::pread(fd, &b, 1, off) == 1) {
+            b ^= 0x01;
+            if (::pwrite(fd, &b, 1, off) != 1) cerr << "corrupt write failed\n";
+        }
+        if (fd >= 0) ::close(fd);
+        auto bad = FSMFleet::restore(path, true, error);
+        cout << "corrupted snapshot -> " << (bad ? "accepted (BUG)" : error) << "\n";
+        if (bad) return 1;
+    }
+
+    //文件头里的实例数和偏移故意选成相加会回绕的值，不校验和也必须拒绝
+    {
+        int fd = ::open(path.c_str(), O_RDWR);
+        SnapshotHeader h{};
+        if (fd >= 0 && ::pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h)) {
+            h.instances = uint64_t(1) << 63;
+            h.lastStatesOffset = h.statesOffset + h.instances;     // lastStates + instances 回绕到 statesOffset
+            h.remainingOffset = h.statesOffset + 64;                // instances * 4 回绕成 0
+            if (::pwrite(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) cerr << "corrupt write failed\n";
+        }
+        if (fd >= 0) ::close(fd);
+        auto bad = FSMFleet::restore(path, false, error);
+        cout << "overflowing header -> " << (bad ? "accepted (BUG)" : error) << "\n";
+        if (bad) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,459 @@
+/*
+带上下文、可内联的状态机动作和守卫条件
+
+night8 的问题：
+FSMItem 的动作是 void(*)()：拿不到状态机本身，也拿不到事件携带的数据，真正的逻辑只能写到全局变量里
+每次转移还要经过一次编译器无法内联的间接调用，外加线性扫描整张表
+
+night19 的做法：
+1. 动作签名改成 void(Ctx&, const Payload&)，守卫签名 bool(const Ctx&, const Payload&)
+   同一个 (现态, 事件) 可以有多行，按顺序取第一条守卫通过的
+2. 编译期版本 TypedFSM：转移表是类型列表 Row<From, Event, To, Action, Guard>...
+   动作/守卫是模板非类型参数，编译器直接内联，分派展开成一串常量比较
+3. 运行期版本 RuntimeFSM：转移表运行时搭建，动作/守卫存进小缓冲委托 Delegate（可带捕获的 lambda，
+   不超过 32 字节就不分配堆）；所有转移放在一张连续的表里，按 [状态][事件] 偏移表 O(1) 定位
+4. 压测：night8 的函数指针 + 线性扫描 vs 运行期委托 vs 编译期内联
+   三种实现跑同一条事件流（按带守卫的状态机当前状态生成，大部分是合法转移；legacy 没有守卫，会多走出错分支）
+   每种实现测几遍取最快的一遍；runtime 和 template 的计数、终态不一致直接失败
+*/
+#include <iostream>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+enum class State : uint8_t {
+    GETUP = 0,
+    GO_SCHOOL,
+    EAT,
+    DO_HOMEWORK,
+    GO_SLEEP,
+    TIMEOUT,
+    ERROR,
+
+    COUNT
+};
+
+enum class Events : uint8_t {
+    EVENT1 = 0,
+    EVENT2,
+    EVENT3,
+    EVENT_TIMEOUT,
+
+    COUNT
+};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+
+// ---------- 状态机上下文和事件数据 ----------
+struct Student {
+    uint64_t mealsEaten = 0;
+    uint64_t homeworkDone = 0;
+    uint64_t errors = 0;
+    int64_t energy = 0;
+};
+
+struct Payload {
+    int32_t amount;         // 比如：吃了多少、写了几页作业
+};
+
+// ---------- 编译期版本 ----------
+
+/*
+一行转移
+Action/Guard 传函数（不是函数指针变量），省略时为 nullptr
+*/
+template <State From, Events Ev, State To, auto Action = nullptr, auto Guard = nullptr>
+struct Row {
+    template <typename Ctx, typename P>
+    static bool tryFire(State& cur, Events ev, Ctx& ctx, const P& p) {
+        if (cur != From || ev != Ev) return false;
+        if constexpr (!std::is_same_v<decltype(Guard), std::nullptr_t>) {
+            if (!Guard(ctx, p)) return false;
+        }
+        if constexpr (!std::is_same_v<decltype(Action), std::nullptr_t>) {
+            Action(ctx, p);
+        }
+        cur = To;
+        return true;
+    }
+};
+
+template <typename... Rows>
+struct TransitionTable {
+    //按行顺序尝试，第一条匹配（且守卫通过）的生效
+    template <typename Ctx, typename P>
+    static bool dispatch(State& cur, Events ev, Ctx& ctx, const P& p) {
+        return (Rows::tryFire(cur, ev, ctx, p) || ...);
+    }
+};
+
+template <typename Ctx, typename P, typename Table, auto OnError = nullptr>
+class TypedFSM {
+public:
+    explicit TypedFSM(Ctx& ctx, State init = State::GETUP) : _ctx(ctx), _curState(init) {}
+
+    State state() const { return _curState; }
+    Ctx& context() { return _ctx; }
+
+    void handleEvent(Events ev, const P& p) {
+        if (!Table::dispatch(_curState, ev, _ctx, p)) {
+            if constexpr (!std::is_same_v<decltype(OnError), std::nullptr_t>)
+                OnError(_ctx, p);
+            _curState = State::ERROR;
+        }
+    }
+
+private:
+    Ctx& _ctx;
+    State _curState;
+};
+
+// ---------- 运行期版本：小缓冲委托 ----------
+
+/*
+Delegate<R(A...)>：能装任意可调用对象（函数、lambda、带捕获的 lambda）
+对象不超过 Cap 字节时直接放在内部缓冲里，不分配堆；超过就编译报错
+*/
+template <typename Sig, size_t Cap = 32>
+class Delegate;
+
+template <typename R, typename... A, size_t Cap>
+class Delegate<R(A...), Cap> {
+public:
+    Delegate() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Delegate>>>
+    Delegate(F&& f) {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Cap, "callable too large for Delegate small buffer");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "callable over-aligned for Delegate");
+        static_assert(std::is_nothrow_copy_constructible_v<Fn>, "Delegate callable must be nothrow copyable");
+        new (_buf) Fn(std::forward<F>(f));
+        _invoke = [](const void* obj, A... args) -> R {
+            return (*static_cast<const Fn*>(obj))(std::forward<A>(args)...);
+        };
+        _ops = [](void* dst, const void* src) {
+            if (src) new (dst) Fn(*static_cast<const Fn*>(src));
+            else static_cast<Fn*>(dst)->~Fn();
+        };
+    }
+
+    Delegate(const Delegate& other) noexcept { copyFrom(other); }
+    Delegate& operator=(const Delegate& other) noexcept {
+        if (this != &other) {
+            reset();
+            copyFrom(other);
+        }
+        return *this;
+    }
+    ~Delegate() { reset(); }
+
+    explicit operator bool() const { return _invoke != nullptr; }
+
+    R operator()(A... args) const { return _invoke(_buf, std::forward<A>(args)...); }
+
+private:
+    void copyFrom(const Delegate& other) {
+        if (other._ops) other._ops(_buf, other._buf);
+        _invoke = other._invoke;
+        _ops = other._ops;
+    }
+
+    void reset() {
+        if (_ops) _ops(_buf, nullptr);
+        _invoke = nullptr;
+        _ops = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char _buf[Cap];
+    R (*_invoke)(const void*, A...) = nullptr;
+    void (*_ops)(void*, const void*) = nullptr;    // src 非空：拷贝构造到 dst；src 为空：析构 dst
+};
+
+template <typename Ctx, typename P>
+class RuntimeFSM {
+public:
+    using Action = Delegate<void(Ctx&, const P&)>;
+    using Guard = Delegate<bool(const Ctx&, const P&)>;
+
+    explicit RuntimeFSM(Ctx& ctx, State init = State::GETUP) : _ctx(ctx), _curState(init) {}
+
+    //同一个 (from, ev) 可以多次添加，按添加顺序检查守卫
+    //插到本格子的末尾，后面格子的偏移整体后移（只在搭表时发生）
+    void addTransition(State from, Events ev, State to, Action action = {}, Guard guard = {}) {
+        size_t slot = index(from, ev);
+        _entries.insert(_entries.begin() + _offsets[slot + 1], Entry{to, std::move(action), std::move(guard)});
+        for (size_t k = slot + 1; k < _offsets.size(); k++) _offsets[k]++;
+    }
+
+    void setOnError(Action onError) { _onError = std::move(onError); }
+
+    State state() const { return _curState; }
+
+    void handleEvent(Events ev, const P& p) {
+        size_t slot = index(_curState, ev);
+        const Entry* e = _entries.data() + _offsets[slot];
+        const Entry* end = _entries.data() + _offsets[slot + 1];
+        for (; e != end; ++e) {
+            if (e->guard && !e->guard(_ctx, p)) continue;
+            if (e->action) e->action(_ctx, p);
+            _curState = e->next;
+            return;
+        }
+        if (_onError) _onError(_ctx, p);
+        _curState = State::ERROR;
+    }
+
+private:
+    struct Entry {
+        State next;
+        Action action;
+        Guard guard;
+    };
+
+    static size_t index(State s, Events ev) {
+        return static_cast<size_t>(s) * EVENT_COUNT + static_cast<size_t>(ev);
+    }
+
+    Ctx& _ctx;
+    State _curState;
+    vector<Entry> _entries;                                     // 按格子排好的所有转移，一块连续内存
+    array<uint16_t, STATE_COUNT * EVENT_COUNT + 1> _offsets{};  // 格子 i 的转移是 [_offsets[i], _offsets[i+1])
+    Action _onError;
+};
+
+// ---------- 学生状态机的动作和守卫 ----------
+void getup(Student& s, const Payload&)         { s.energy += 10; }
+void goSchool(Student& s, const Payload& p)    { s.energy -= 2 + p.amount; }     // 路越远越累，到了可能还饿
+void eat(Student& s, const Payload& p)         { s.mealsEaten++; s.energy += p.amount; }
+void doHomework(Student& s, const Payload& p)  { s.homeworkDone += p.amount; s.energy -= p.amount; }
+void goSleep(Student& s, const Payload&)       { s.energy = 0; }
+void onError(Student& s, const Payload&)       { s.errors++; }
+
+//还饿（精力不足）就再吃一顿，不去写作业
+bool stillHungry(const Student& s, const Payload&) { return s.energy < 5; }
+
+using StudentTable = TransitionTable<
+    Row<State::GETUP,       Events::EVENT1, State::GO_SCHOOL,   getup>,
+    Row<State::GO_SCHOOL,   Events::EVENT2, State::EAT,         goSchool>,
+    Row<State::EAT,         Events::EVENT3, State::EAT,         eat,        stillHungry>,
+    Row<State::EAT,         Events::EVENT3, State::DO_HOMEWORK, eat>,
+    Row<State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP,    doHomework>,
+    Row<State::GO_SLEEP,    Events::EVENT2, State::GETUP,       goSleep>,
+    Row<State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT>,
+    Row<State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT>,
+    Row<State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT>,
+    Row<State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT>,
+    Row<State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT>,
+    Row<State::TIMEOUT,     Events::EVENT1, State::GETUP,       getup>,
+    Row<State::TIMEOUT,     Events::EVENT3, State::ERROR,       onError>,
+    Row<State::ERROR,       Events::EVENT1, State::GETUP,       getup>
+>;
+
+using StudentFSM = TypedFSM<Student, Payload, StudentTable, onError>;
+
+//运行期搭一张同样的表；eat 那一行用带捕获的 lambda 演示委托
+void buildRuntimeTable(RuntimeFSM<Student, Payload>& fsm, int32_t bonus) {
+    fsm.addTransition(State::GETUP,       Events::EVENT1, State::GO_SCHOOL,   getup);
+    fsm.addTransition(State::GO_SCHOOL,   Events::EVENT2, State::EAT,         goSchool);
+    fsm.addTransition(State::EAT,         Events::EVENT3, State::EAT,
+                      [bonus](Student& s, const Payload& p) { eat(s, Payload{p.amount + bonus}); },
+                      stillHungry);
+    fsm.addTransition(State::EAT,         Events::EVENT3, State::DO_HOMEWORK,
+                      [bonus](Student& s, const Payload& p) { eat(s, Payload{p.amount + bonus}); });
+    fsm.addTransition(State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP,    doHomework);
+    fsm.addTransition(State::GO_SLEEP,    Events::EVENT2, State::GETUP,       goSleep);
+    for (State s : {State::GETUP, State::GO_SCHOOL, State::EAT, State::DO_HOMEWORK, State::GO_SLEEP})
+        fsm.addTransition(s, Events::EVENT_TIMEOUT, State::TIMEOUT);
+    fsm.addTransition(State::TIMEOUT,     Events::EVENT1, State::GETUP,       getup);
+    fsm.addTransition(State::TIMEOUT,     Events::EVENT3, State::ERROR,       onError);
+    fsm.addTransition(State::ERROR,       Events::EVENT1, State::GETUP,       getup);
+    fsm.setOnError(onError);
+}
+
+// ---------- 对照组：night8 的函数指针 + 线性扫描，数据只能放全局 ----------
+static Student g_student;
+static Payload g_payload;
+
+class FSMItem {
+    friend class LegacyFSM;
+
+public:
+    FSMItem(State curState, Events event, void(*action)(), State nextState, bool(*guard)() = nullptr)
+        : _curState(curState), _event(event), _action(action), _nextState(nextState), _guard(guard) {}
+
+private:
+    State _curState;
+    Events _event;
+    void(*_action)();
+    State _nextState;
+    bool(*_guard)();        // 同样只能读全局数据；和另外两种实现走同一张表，才能跑同一条事件流
+};
+
+class LegacyFSM {
+public:
+    LegacyFSM() : _curState(State::GETUP) {
+        _fsmTable.push_back(new FSMItem(State::GETUP,       Events::EVENT1, [] { getup(g_student, g_payload); },      State::GO_SCHOOL));
+        _fsmTable.push_back(new FSMItem(State::GO_SCHOOL,   Events::EVENT2, [] { goSchool(g_student, g_payload); },   State::EAT));
+        _fsmTable.push_back(new FSMItem(State::EAT,         Events::EVENT3, [] { eat(g_student, g_payload); },        State::EAT,
+                                        [] { return stillHungry(g_student, g_payload); }));
+        _fsmTable.push_back(new FSMItem(State::EAT,         Events::EVENT3, [] { eat(g_student, g_payload); },        State::DO_HOMEWORK));
+        _fsmTable.push_back(new FSMItem(State::DO_HOMEWORK, Events::EVENT1, [] { doHomework(g_student, g_payload); }, State::GO_SLEEP));
+        _fsmTable.push_back(new FSMItem(State::GO_SLEEP,    Events::EVENT2, [] { goSleep(g_student, g_payload); },    State::GETUP));
+        for (State s : {State::GETUP, State::GO_SCHOOL, State::EAT, State::DO_HOMEWORK, State::GO_SLEEP})
+            _fsmTable.push_back(new FSMItem(s, Events::EVENT_TIMEOUT, nullptr, State::TIMEOUT));
+        _fsmTable.push_back(new FSMItem(State::TIMEOUT, Events::EVENT1, [] { getup(g_student, g_payload); },   State::GETUP));
+        _fsmTable.push_back(new FSMItem(State::TIMEOUT, Events::EVENT3, [] { onError(g_student, g_payload); }, State::ERROR));
+        _fsmTable.push_back(new FSMItem(State::ERROR,   Events::EVENT1, [] { getup(g_student, g_payload); },   State::GETUP));
+    }
+    ~LegacyFSM() {
+        for (auto p : _fsmTable) delete p;
+        _fsmTable.clear();
+    }
+
+    void handleEvent(Events event) {
+        for (int i = 0; i < (int)_fsmTable.size(); i++) {
+            if (event == _fsmTable[i]->_event && _curState == _fsmTable[i]->_curState) {
+                if (_fsmTable[i]->_guard && !_fsmTable[i]->_guard()) continue;
+                if (_fsmTable[i]->_action) _fsmTable[i]->_action();
+                _curState = _fsmTable[i]->_nextState;
+                return;
+            }
+        }
+        onError(g_student, g_payload);
+        _curState = State::ERROR;
+    }
+
+    State _curState;
+
+private:
+    vector<FSMItem*> _fsmTable;
+};
+
+/*
+事件序列：影子状态机跟着走，每一步按当前状态给出合法事件（EAT 里吃没吃饱由守卫决定，所以要真的跑一遍）
+step(ev, p) 把事件喂给影子状态机并返回新状态
+偶尔插入超时、超时后出错、非法事件，错误路径也覆盖到，但大部分事件都会触发动作和守卫
+*/
+template <typename Step>
+vector<pair<Events, Payload>> makeEvents(size_t n, Step&& step) {
+    vector<pair<Events, Payload>> events;
+    events.reserve(n);
+    State cur = State::GETUP;
+    uint32_t x = 19;
+    for (size_t i = 0; i < n; i++) {
+        x = x * 1103515245u + 12345u;
+        uint32_t r = x >> 16;
+        Payload p{static_cast<int32_t>((x >> 8) % 8)};
+        Events ev;
+        switch (cur) {
+            case State::GO_SCHOOL:
+            case State::GO_SLEEP:    ev = Events::EVENT2; break;
+            case State::EAT:         ev = Events::EVENT3; break;
+            case State::TIMEOUT:     ev = r % 8 == 0 ? Events::EVENT3 : Events::EVENT1; break;
+            default:                 ev = Events::EVENT1; break;     // GETUP / DO_HOMEWORK / ERROR
+        }
+        if (r % 97 == 0) ev = Events::EVENT_TIMEOUT;
+        else if (r % 499 == 0) ev = static_cast<Events>((static_cast<int>(ev) + 1) % 3);    // 非法事件
+        cur = step(ev, p);
+        events.push_back({ev, p});
+    }
+    return events;
+}
+
+template <typename F>
+double nsPerEvent(size_t n, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+}
+
+void printStudent(const char* name, const Student& s, State st, double ns) {
+    cout << name << ": " << ns << " ns/event"
+         << "  meals=" << s.mealsEaten << " homework=" << s.homeworkDone
+         << " errors=" << s.errors << " energy=" << s.energy
+         << " state=" << static_cast<int>(st) << "\n";
+}
+
+int main() {
+    constexpr size_t N = 20000000;
+    constexpr int REPEAT = 3;
+
+    //同一条事件流给三种实现：三种实现的表（含守卫）相同，按编译期状态机生成
+    Student shadowCtx;
+    StudentFSM shadow(shadowCtx);
+    auto events = makeEvents(N, [&](Events ev, const Payload& p) {
+        shadow.handleEvent(ev, p);
+        return shadow.state();
+    });
+
+    // ---------- 1) night8：函数指针 + 线性扫描 + 全局数据 ----------
+    State legacyState = State::GETUP;
+    double legacyNs = 1e9;
+    for (int r = 0; r < REPEAT; r++) {
+        g_student = Student{};
+        LegacyFSM fsm;
+        legacyNs = std::min(legacyNs, nsPerEvent(N, [&] {
+            for (const auto& e : events) {
+                g_payload = e.second;
+                fsm.handleEvent(e.first);
+            }
+        }));
+        legacyState = fsm._curState;
+    }
+    printStudent("legacy  (fn ptr scan)  ", g_student, legacyState, legacyNs);
+
+    // ---------- 2) 运行期表 + 小缓冲委托 ----------
+    Student runtimeCtx;
+    State runtimeState = State::GETUP;
+    double runtimeNs = 1e9;
+    for (int r = 0; r < REPEAT; r++) {
+        runtimeCtx = Student{};
+        RuntimeFSM<Student, Payload> fsm(runtimeCtx);
+        buildRuntimeTable(fsm, 0);
+        runtimeNs = std::min(runtimeNs, nsPerEvent(N, [&] {
+            for (const auto& e : events)
+                fsm.handleEvent(e.first, e.second);
+        }));
+        runtimeState = fsm.state();
+    }
+    printStudent("runtime (delegate)     ", runtimeCtx, runtimeState, runtimeNs);
+
+    // ---------- 3) 编译期表，动作内联 ----------
+    Student templateCtx;
+    State templateState = State::GETUP;
+    double templateNs = 1e9;
+    for (int r = 0; r < REPEAT; r++) {
+        templateCtx = Student{};
+        StudentFSM fsm(templateCtx);
+        templateNs = std::min(templateNs, nsPerEvent(N, [&] {
+            for (const auto& e : events)
+                fsm.handleEvent(e.first, e.second);
+        }));
+        templateState = fsm.state();
+    }
+    printStudent("template (inlined)     ", templateCtx, templateState, templateNs);
+
+    //三种实现是同一张带守卫的表，结果必须完全一致
+    auto same = [](const Student& a, State sa, const Student& b, State sb) {
+        return sa == sb && a.mealsEaten == b.mealsEaten && a.homeworkDone == b.homeworkDone &&
+               a.errors == b.errors && a.energy == b.energy;
+    };
+    if (!same(runtimeCtx, runtimeState, templateCtx, templateState) ||
+        !same(g_student, legacyState, templateCtx, templateState)) {
+        cerr << "error: legacy, runtime and template FSM disagree\n";
+        return 1;
+    }
+    cout << "legacy == runtime == template: ok\n";
+    if (runtimeNs > legacyNs)
+        cout << "note: runtime is " << runtimeNs / legacyNs << "x slower than legacy on this stream\n";
+    return 0;
+}
@@ -0,0 +1,444 @@
+/*
+串口 I/O 层：基于 AutoCloseFd 的非阻塞分散读
+
+问题：
+night7 的 AutoCloseFd 没写完：没有移动赋值、没有 get/release/reset，也没人用
+night11 的 UART 流水线根本没有真实设备输入，只是 main 里手动喂数组
+
+night20 的做法：
+1. 补全 AutoCloseFd（RAII 文件描述符）
+2. SerialPort：打开设备 + termios 配置（波特率、raw 模式、VMIN/VTIME）+ O_NONBLOCK
+3. ByteRing：2 的幂大小的字节环，可以拿到“空闲区”和“数据区”的两段 iovec
+4. SerialPort::readInto(ring) 用 readv 直接读进环的空闲区（绕回时两段一起读，一次系统调用）
+5. 解析器直接在环的数据区上逐字节解析，中间不再拷贝到 queue/临时数组
+6. 没有真实串口时用伪终端（pty）代替：主端写帧，从端当串口打开
+*/
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/uio.h>
+
+class AutoCloseFd{
+    public:
+        explicit AutoCloseFd(int fd = -1) : fd_(fd) {}
+        ~AutoCloseFd() {reset();}
+
+        AutoCloseFd(const AutoCloseFd&) = delete;
+        AutoCloseFd& operator = (const AutoCloseFd&) = delete;
+
+        AutoCloseFd(AutoCloseFd && other) noexcept : fd_(other.release()) {}
+        AutoCloseFd& operator = (AutoCloseFd && other) noexcept {
+            if(this != &other)
+                reset(other.release());
+            return *this;
+        }
+
+        int get() const {return fd_;}
+        bool valid() const {return fd_ >= 0;}
+        explicit operator bool() const {return valid();}
+
+        //交出所有权，不再负责关闭
+        int release() {
+            int fd = fd_;
+            fd_ = -1;
+            return fd;
+        }
+
+        //关闭当前 fd，接管新的 fd
+        void reset(int fd = -1) {
+            if(fd_ >= 0 && fd_ != fd)
+                ::close(fd_);           // close 被信号打断也不能重试（Linux 上 fd 已经释放）
+            fd_ = fd;
+        }
+
+    private:
+        int fd_;
+};
+
+/*
+字节环：容量必须是 2 的幂
+head/tail 单调递增，取模用 & mask
+writableSpans/readableSpans 返回最多两段连续区域（绕回时第二段从缓冲开头开始）
+读线程和解析在同一个线程里，不需要原子变量
+*/
+class ByteRing {
+public:
+    explicit ByteRing(size_t capacity) : _buffer(capacity), _mask(capacity - 1), _head(0), _tail(0) {
+        if(capacity == 0 || (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("ByteRing capacity must be a power of two");
+    }
+
+    size_t size() const {return _head - _tail;}
+    size_t freeSpace() const {return _buffer.size() - size();}
+
+    int writableSpans(iovec (&iov)[2]) {
+        return spans(_head, freeSpace(), iov);
+    }
+    void commitWrite(size_t n) {_head += n;}
+
+    int readableSpans(iovec (&iov)[2]) {
+        return spans(_tail, size(), iov);
+    }
+    void consume(size_t n) {_tail += n;}
+
+private:
+    int spans(size_t pos, size_t len, iovec (&iov)[2]) {
+        if(len == 0) return 0;
+        size_t offset = pos & _mask;
+        size_t first = std::min(len, _buffer.size() - offset);
+        iov[0].iov_base = _buffer.data() + offset;
+        iov[0].iov_len = first;
+        if(first == len) return 1;
+        iov[1].iov_base = _buffer.data();
+        iov[1].iov_len = len - first;
+        return 2;
+    }
+
+    std::vector<uint8_t> _buffer;
+    size_t _mask;
+    size_t _head;           // 写位置
+    size_t _tail;           // 读位置
+};
+
+/*
+串口
+open() 失败抛 std::system_error，readInto() 返回读到的字节数（0 表示暂时没数据）
+*/
+class SerialPort {
+public:
+    struct Config {
+        int baud = 115200;
+        uint8_t vmin = 0;       // 至少读到几个字节才返回（配合 poll 使用时设 0）
+        uint8_t vtime = 0;      // 单位 0.1s
+    };
+
+    static SerialPort open(const std::string& path, const Config& cfg) {
+        AutoCloseFd fd(::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC));
+        if(!fd)
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        configure(fd.get(), cfg);
+        return SerialPort(std::move(fd));
+    }
+
+    //接管一个已打开的 fd（例如管道、socket），只设置非阻塞，不做 termios 配置
+    static SerialPort adopt(AutoCloseFd fd) {
+        setNonBlocking(fd.get());
+        return SerialPort(std::move(fd));
+    }
+
+    int fd() const {return _fd.get();}
+    uint64_t readCalls() const {return _readCalls;}
+    bool eof() const {return _eof;}
+
+    //把数据直接读进环的空闲区，循环到 EAGAIN 或环满
+    size_t readInto(ByteRing& ring) {
+        size_t total = 0;
+        for(;;) {
+            iovec iov[2];
+            int n = ring.writableSpans(iov);
+            if(n == 0) break;                       // 环满，先让解析器消费
+
+            ssize_t r = ::readv(_fd.get(), iov, n);
+            _readCalls++;
+            if(r > 0) {
+                ring.commitWrite(static_cast<size_t>(r));
+                total += static_cast<size_t>(r);
+                continue;
+            }
+            if(r == 0) {
+                //tty 在 VMIN=0/VTIME=0 下没数据时 read 返回 0 而不是 EAGAIN，不能当成 EOF
+                if(!_isTty) _eof = true;
+                break;
+            }
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if(errno == EIO) {                      // pty 对端关闭
+                _eof = true;
+                break;
+            }
+            throw std::system_error(errno, std::generic_category(), "readv");
+        }
+        return total;
+    }
+
+    //等到可读或超时，返回是否可读
+    bool waitReadable(int timeoutMs) {
+        pollfd p{_fd.get(), POLLIN, 0};
+        int r = ::poll(&p, 1, timeoutMs);
+        if(r < 0 && errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "poll");
+        return r > 0 && (p.revents & (POLLIN | POLLHUP | POLLERR));
+    }
+
+private:
+    explicit SerialPort(AutoCloseFd fd) : _fd(std::move(fd)), _isTty(::isatty(_fd.get()) == 1) {}
+
+    static speed_t baudToSpeed(int baud) {
+        switch(baud) {
+            case 9600:    return B9600;
+            case 19200:   return B19200;
+            case 38400:   return B38400;
+            case 57600:   return B57600;
+            case 115200:  return B115200;
+            case 230400:  return B230400;
+#ifdef B460800
+            case 460800:  return B460800;
+#endif
+#ifdef B921600
+            case 921600:  return B921600;
+#endif
+            default:
+                throw std::invalid_argument("unsupported baud rate " + std::to_string(baud));
+        }
+    }
+
+    static void configure(int fd, const Config& cfg) {
+        termios tio;
+        if(::tcgetattr(fd, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcgetattr");
+
+        ::cfmakeraw(&tio);                          // 不做行缓冲、不回显、不转换换行
+        tio.c_cflag |= CLOCAL | CREAD;              // 忽略调制解调器控制线，允许接收
+        tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        tio.c_cflag = (tio.c_cflag & ~CSIZE) | CS8; // 8N1
+        tio.c_cc[VMIN] = cfg.vmin;
+        tio.c_cc[VTIME] = cfg.vtime;
+
+        speed_t speed = baudToSpeed(cfg.baud);
+        ::cfsetispeed(&tio, speed);
+        ::cfsetospeed(&tio, speed);
+
+        if(::tcsetattr(fd, TCSANOW, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcsetattr");
+        ::tcflush(fd, TCIFLUSH);
+    }
+
+    static void setNonBlocking(int fd) {
+        int flags = ::fcntl(fd, F_GETFL, 0);
+        if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+    }
+
+    AutoCloseFd _fd;
+    bool _isTty;                // tty 的对端关闭用 EIO 表示
+    uint64_t _readCalls = 0;
+    bool _eof = false;
+};
+
+//帧解析器（沿用 night10/11），增加按区间喂数据的接口
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//构造一帧：AA 55 len payload crc
+std::vector<uint8_t> makeFrame(const std::vector<uint8_t>& payload){
+    std::vector<uint8_t> f{0xAA, 0x55, static_cast<uint8_t>(payload.size())};
+    uint8_t crc = static_cast<uint8_t>(payload.size());
+    for(uint8_t b : payload){
+        f.push_back(b);
+        crc += b;
+    }
+    f.push_back(crc);
+    return f;
+}
+
+//打开一对伪终端：返回主端，从端路径写进 slavePath
+AutoCloseFd openPtyMaster(std::string& slavePath){
+    AutoCloseFd master(::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC));
+    if(!master)
+        throw std::system_error(errno, std::generic_category(), "posix_openpt");
+    if(::grantpt(master.get()) != 0 || ::unlockpt(master.get()) != 0)
+        throw std::system_error(errno, std::generic_category(), "grantpt/unlockpt");
+    char name[128];
+    if(::ptsname_r(master.get(), name, sizeof(name)) != 0)
+        throw std::system_error(errno, std::generic_category(), "ptsname_r");
+    slavePath = name;
+    return master;
+}
+
+int main(){
+    try{
+        // ---------- 1) AutoCloseFd 的移动语义 ----------
+        {
+            int fds[2];
+            if(::pipe(fds) != 0)
+                throw std::system_error(errno, std::generic_category(), "pipe");
+            AutoCloseFd a(fds[0]), b(fds[1]);
+            AutoCloseFd c = std::move(a);           // 移动构造：a 失效
+            AutoCloseFd d;
+            d = std::move(b);                       // 移动赋值：b 失效
+            std::cout << "AutoCloseFd: a=" << a.get() << " b=" << b.get()
+                      << " c=" << c.get() << " d=" << d.get() << "\n";
+            d.reset();                              // 提前关闭写端
+            std::cout << "after reset: d=" << d.get() << "\n";
+        }
+
+        // ---------- 2) 伪终端当串口：主端写，从端 readv 进环，直接解析 ----------
+        std::string slavePath;
+        AutoCloseFd master = openPtyMaster(slavePath);
+        SerialPort port = SerialPort::open(slavePath, SerialPort::Config{115200, 0, 0});
+        std::cout << "serial port " << slavePath << " fd=" << port.fd() << "\n";
+
+        constexpr int FRAMES = 20000;
+        std::thread writer([&]{
+            std::vector<uint8_t> stream;
+            for(int i = 0; i < FRAMES; i++){
+                std::vector<uint8_t> payload;
+                for(int k = 0; k < 1 + i % 32; k++)
+                    payload.push_back(static_cast<uint8_t>(i + k));
+                auto f = makeFrame(payload);
+                stream.insert(stream.end(), f.begin(), f.end());
+                if(i % 97 == 0) stream.push_back(0x13);     // 夹杂一点噪声
+            }
+            size_t off = 0;
+            while(off < stream.size()){
+                ssize_t w = ::write(master.get(), stream.data() + off, std::min<size_t>(4096, stream.size() - off));
+                if(w > 0) off += static_cast<size_t>(w);
+                else if(w < 0 && errno != EINTR && errno != EAGAIN) break;
+            }
+        });
+
+        ByteRing ring(1 << 16);
+        SimpleUartParser parser(1000);
+        int frames = 0;
+        uint64_t bytes = 0;
+        uint64_t payloadSum = 0;
+        auto start = std::chrono::steady_clock::now();
+        while(frames < FRAMES){
+            if(!port.waitReadable(1000)){
+                std::cout << "timeout waiting for data\n";
+                break;
+            }
+            bytes += port.readInto(ring);
+
+            iovec iov[2];
+            int n = ring.readableSpans(iov);
+            uint32_t now = now_ms();
+            size_t consumed = 0;
+            for(int k = 0; k < n; k++){
+                parser.feed(static_cast<const uint8_t*>(iov[k].iov_base), iov[k].iov_len, now,
+                    [&](const uint8_t* d, uint8_t len){
+                        frames++;
+                        for(int j = 0; j < len; j++) payloadSum += d[j];
+                    });
+                consumed += iov[k].iov_len;
+            }
+            ring.consume(consumed);
+            if(port.eof()) break;
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        writer.join();
+
+        std::cout << "frames=" << frames << "/" << FRAMES
+                  << " bytes=" << bytes
+                  << " readv_calls=" << port.readCalls()
+                  << " payload_sum=" << payloadSum
+                  << " throughput=" << bytes / sec / 1e6 << " MB/s\n";
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
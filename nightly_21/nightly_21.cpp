@@ -0,0 +1,847 @@
+/*
+多路串口 epoll 反应器：少量固定线程管理大量串口
+
+问题：
+night11 的 StreamProcessor 一路串口就要一个线程 + 一个 SimpleUartParser
+一台主机几十路串口就是几十个线程，大部分时间在睡觉，切换开销和栈内存都浪费
+night20 的 SerialPort 每路自己 poll，也是一路一个等待点
+
+night21 的做法：
+1. 每个分片（shard）一个线程 + 一个 epoll，线程绑到固定 CPU（pthread_setaffinity_np）
+2. 通道按编号轮流分配到分片，之后只由这个分片读写，解析器/环不需要加锁
+3. 每路通道有自己的 SerialPort + ByteRing + SimpleUartParser，解析状态互不干扰
+4. 边沿触发（EPOLLET）：一次唤醒把数据读到 EAGAIN 为止，环满就先解析再继续读
+5. 停止用 eventfd 唤醒 epoll_wait，线程里的异常在 stop() 里重新抛出
+6. main 用伪终端模拟 1~256 路串口，统计帧率和各分片线程的 CPU 时间
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+
+class AutoCloseFd{
+    public:
+        explicit AutoCloseFd(int fd = -1) : fd_(fd) {}
+        ~AutoCloseFd() {reset();}
+
+        AutoCloseFd(const AutoCloseFd&) = delete;
+        AutoCloseFd& operator = (const AutoCloseFd&) = delete;
+
+        AutoCloseFd(AutoCloseFd && other) noexcept : fd_(other.release()) {}
+        AutoCloseFd& operator = (AutoCloseFd && other) noexcept {
+            if(this != &other)
+                reset(other.release());
+            return *this;
+        }
+
+        int get() const {return fd_;}
+        bool valid() const {return fd_ >= 0;}
+        explicit operator bool() const {return valid();}
+
+        //交出所有权，不再负责关闭
+        int release() {
+            int fd = fd_;
+            fd_ = -1;
+            return fd;
+        }
+
+        //关闭当前 fd，接管新的 fd
+        void reset(int fd = -1) {
+            if(fd_ >= 0 && fd_ != fd)
+                ::close(fd_);           // close 被信号打断也不能重试（Linux 上 fd 已经释放）
+            fd_ = fd;
+        }
+
+    private:
+        int fd_;
+};
+
+/*
+字节环：容量必须是 2 的幂
+head/tail 单调递增，取模用 & mask
+writableSpans/readableSpans 返回最多两段连续区域（绕回时第二段从缓冲开头开始）
+读线程和解析在同一个线程里，不需要原子变量
+*/
+class ByteRing {
+public:
+    explicit ByteRing(size_t capacity) : _buffer(capacity), _mask(capacity - 1), _head(0), _tail(0) {
+        if(capacity == 0 || (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("ByteRing capacity must be a power of two");
+    }
+
+    size_t size() const {return _head - _tail;}
+    size_t freeSpace() const {return _buffer.size() - size();}
+
+    int writableSpans(iovec (&iov)[2]) {
+        return spans(_head, freeSpace(), iov);
+    }
+    void commitWrite(size_t n) {_head += n;}
+
+    int readableSpans(iovec (&iov)[2]) {
+        return spans(_tail, size(), iov);
+    }
+    void consume(size_t n) {_tail += n;}
+
+private:
+    int spans(size_t pos, size_t len, iovec (&iov)[2]) {
+        if(len == 0) return 0;
+        size_t offset = pos & _mask;
+        size_t first = std::min(len, _buffer.size() - offset);
+        iov[0].iov_base = _buffer.data() + offset;
+        iov[0].iov_len = first;
+        if(first == len) return 1;
+        iov[1].iov_base = _buffer.data();
+        iov[1].iov_len = len - first;
+        return 2;
+    }
+
+    std::vector<uint8_t> _buffer;
+    size_t _mask;
+    size_t _head;           // 写位置
+    size_t _tail;           // 读位置
+};
+
+/*
+串口
+open() 失败抛 std::system_error，readInto() 返回读到的字节数（0 表示暂时没数据）
+*/
+class SerialPort {
+public:
+    struct Config {
+        int baud = 115200;
+        uint8_t vmin = 0;       // 至少读到几个字节才返回（配合 poll 使用时设 0）
+        uint8_t vtime = 0;      // 单位 0.1s
+    };
+
+    static SerialPort open(const std::string& path, const Config& cfg) {
+        AutoCloseFd fd(::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC));
+        if(!fd)
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        configure(fd.get(), cfg);
+        return SerialPort(std::move(fd));
+    }
+
+    //接管一个已打开的 fd（例如管道、socket），只设置非阻塞，不做 termios 配置
+    static SerialPort adopt(AutoCloseFd fd) {
+        setNonBlocking(fd.get());
+        return SerialPort(std::move(fd));
+    }
+
+    int fd() const {return _fd.get();}
+    uint64_t readCalls() const {return _readCalls;}
+    bool eof() const {return _eof;}
+
+    //把数据直接读进环的空闲区，循环到 EAGAIN 或环满
+    size_t readInto(ByteRing& ring) {
+        size_t total = 0;
+        for(;;) {
+            iovec iov[2];
+            int n = ring.writableSpans(iov);
+            if(n == 0) break;                       // 环满，先让解析器消费
+
+            ssize_t r = ::readv(_fd.get(), iov, n);
+            _readCalls++;
+            if(r > 0) {
+                ring.commitWrite(static_cast<size_t>(r));
+                total += static_cast<size_t>(r);
+                continue;
+            }
+            if(r == 0) {
+                //tty 在 VMIN=0/VTIME=0 下没数据时 read 返回 0 而不是 EAGAIN，不能当成 EOF
+                if(!_isTty) _eof = true;
+                break;
+            }
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if(errno == EIO) {                      // pty 对端关闭
+                _eof = true;
+                break;
+            }
+            throw std::system_error(errno, std::generic_category(), "readv");
+        }
+        return total;
+    }
+
+    //等到可读或超时，返回是否可读
+    bool waitReadable(int timeoutMs) {
+        pollfd p{_fd.get(), POLLIN, 0};
+        int r = ::poll(&p, 1, timeoutMs);
+        if(r < 0 && errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "poll");
+        return r > 0 && (p.revents & (POLLIN | POLLHUP | POLLERR));
+    }
+
+private:
+    explicit SerialPort(AutoCloseFd fd) : _fd(std::move(fd)), _isTty(::isatty(_fd.get()) == 1) {}
+
+    static speed_t baudToSpeed(int baud) {
+        switch(baud) {
+            case 9600:    return B9600;
+            case 19200:   return B19200;
+            case 38400:   return B38400;
+            case 57600:   return B57600;
+            case 115200:  return B115200;
+            case 230400:  return B230400;
+#ifdef B460800
+            case 460800:  return B460800;
+#endif
+#ifdef B921600
+            case 921600:  return B921600;
+#endif
+            default:
+                throw std::invalid_argument("unsupported baud rate " + std::to_string(baud));
+        }
+    }
+
+    static void configure(int fd, const Config& cfg) {
+        termios tio;
+        if(::tcgetattr(fd, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcgetattr");
+
+        ::cfmakeraw(&tio);                          // 不做行缓冲、不回显、不转换换行
+        tio.c_cflag |= CLOCAL | CREAD;              // 忽略调制解调器控制线，允许接收
+        tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        tio.c_cflag = (tio.c_cflag & ~CSIZE) | CS8; // 8N1
+        tio.c_cc[VMIN] = cfg.vmin;
+        tio.c_cc[VTIME] = cfg.vtime;
+
+        speed_t speed = baudToSpeed(cfg.baud);
+        ::cfsetispeed(&tio, speed);
+        ::cfsetospeed(&tio, speed);
+
+        if(::tcsetattr(fd, TCSANOW, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcsetattr");
+        ::tcflush(fd, TCIFLUSH);
+    }
+
+    static void setNonBlocking(int fd) {
+        int flags = ::fcntl(fd, F_GETFL, 0);
+        if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+    }
+
+    AutoCloseFd _fd;
+    bool _isTty;                // tty 的对端关闭用 EIO 表示
+    uint64_t _readCalls = 0;
+    bool _eof = false;
+};
+
+//帧解析器（沿用 night20）
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//构造一帧：AA 55 len payload crc
+std::vector<uint8_t> makeFrame(const std::vector<uint8_t>& payload){
+    std::vector<uint8_t> f{0xAA, 0x55, static_cast<uint8_t>(payload.size())};
+    uint8_t crc = static_cast<uint8_t>(payload.size());
+    for(uint8_t b : payload){
+        f.push_back(b);
+        crc += b;
+    }
+    f.push_back(crc);
+    return f;
+}
+
+//打开一对伪终端：返回主端，从端路径写进 slavePath
+AutoCloseFd openPtyMaster(std::string& slavePath){
+    AutoCloseFd master(::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC));
+    if(!master)
+        throw std::system_error(errno, std::generic_category(), "posix_openpt");
+    if(::grantpt(master.get()) != 0 || ::unlockpt(master.get()) != 0)
+        throw std::system_error(errno, std::generic_category(), "grantpt/unlockpt");
+    char name[128];
+    if(::ptsname_r(master.get(), name, sizeof(name)) != 0)
+        throw std::system_error(errno, std::generic_category(), "ptsname_r");
+    slavePath = name;
+    return master;
+}
+
+static void setNonBlocking(int fd){
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+}
+
+//当前线程消耗的 CPU 时间
+static uint64_t threadCpuNs(){
+    timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+//单写者计数：只有所属线程写，其他线程只读，不需要 fetch_add 的总线锁
+static void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*
+一路通道：SerialPort + 接收环 + 解析器
+除了 frames/bytes 统计，其余成员只被所属分片线程访问
+*/
+struct Channel {
+    Channel(int id_, SerialPort port_) : id(id_), port(std::move(port_)) {}
+
+    int id;
+    SerialPort port;
+    ByteRing ring{1 << 14};
+    SimpleUartParser parser{1000};
+    bool closed = false;
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+/*
+反应器
+addChannel() 只能在 start() 之前调用；通道 id 按顺序编号，分到 id % shards 号分片
+FrameHandler 在分片线程里调用：同一通道的帧总是同一线程、按到达顺序回调
+*/
+class UartReactor {
+public:
+    using FrameHandler = std::function<void(int channel, const uint8_t* data, uint8_t len)>;
+
+    struct ShardStats {
+        int cpu;                // 绑定的 CPU，-1 表示没有绑定
+        size_t channels;
+        uint64_t wakeups;       // epoll_wait 返回次数
+        uint64_t events;        // 处理的就绪事件数
+        uint64_t cpuNs;         // 线程 CPU 时间（stop 之后才有）
+    };
+
+    explicit UartReactor(size_t shards, bool pinCpu = true) : _pinCpu(pinCpu) {
+        if(shards == 0)
+            throw std::invalid_argument("UartReactor needs at least one shard");
+        for(size_t i = 0; i < shards; i++){
+            auto s = std::make_unique<Shard>();
+            s->epfd.reset(::epoll_create1(EPOLL_CLOEXEC));
+            if(!s->epfd)
+                throw std::system_error(errno, std::generic_category(), "epoll_create1");
+            s->stopFd.reset(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+            if(!s->stopFd)
+                throw std::system_error(errno, std::generic_category(), "eventfd");
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.ptr = nullptr;                  // nullptr 表示停止信号
+            if(::epoll_ctl(s->epfd.get(), EPOLL_CTL_ADD, s->stopFd.get(), &ev) != 0)
+                throw std::system_error(errno, std::generic_category(), "epoll_ctl stopFd");
+            _shards.push_back(std::move(s));
+        }
+    }
+
+    ~UartReactor(){
+        try{ stop(); }
+        catch(...){}
+    }
+
+    UartReactor(const UartReactor&) = delete;
+    UartReactor& operator = (const UartReactor&) = delete;
+
+    int addChannel(SerialPort port){
+        if(_running)
+            throw std::logic_error("addChannel after start");
+        int id = static_cast<int>(_channels.size());
+        auto ch = std::make_unique<Channel>(id, std::move(port));
+        Shard& s = *_shards[id % _shards.size()];
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;              // 边沿触发，每次唤醒读到 EAGAIN
+        ev.data.ptr = ch.get();
+        if(::epoll_ctl(s.epfd.get(), EPOLL_CTL_ADD, ch->port.fd(), &ev) != 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl add channel");
+
+        s.channels.push_back(ch.get());
+        _channels.push_back(std::move(ch));
+        return id;
+    }
+
+    void start(FrameHandler onFrame = nullptr){
+        if(_running) return;
+        _onFrame = std::move(onFrame);
+        std::vector<int> cpus = allowedCpus();
+        _running = true;
+        for(size_t i = 0; i < _shards.size(); i++){
+            int cpu = (_pinCpu && !cpus.empty()) ? cpus[i % cpus.size()] : -1;
+            _shards[i]->thread = std::thread([this, i, cpu]{ run(*_shards[i], cpu); });
+        }
+    }
+
+    //可以重复调用；分片线程里的第一个异常在这里重新抛出
+    void stop(){
+        if(!_running) return;
+        for(auto& s : _shards){
+            uint64_t one = 1;
+            ssize_t w = ::write(s->stopFd.get(), &one, sizeof(one));
+            (void)w;
+        }
+        for(auto& s : _shards)
+            if(s->thread.joinable()) s->thread.join();
+        _running = false;
+        for(auto& s : _shards)
+            if(s->error) std::rethrow_exception(s->error);
+    }
+
+    size_t channelCount() const {return _channels.size();}
+    size_t shardCount() const {return _shards.size();}
+
+    uint64_t frames(int channel) const {
+        return _channels[channel]->frames.load(std::memory_order_relaxed);
+    }
+
+    uint64_t totalFrames() const {
+        uint64_t sum = 0;
+        for(auto& c : _channels) sum += c->frames.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    uint64_t totalBytes() const {
+        uint64_t sum = 0;
+        for(auto& c : _channels) sum += c->bytes.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    ShardStats shardStats(size_t i) const {
+        const Shard& s = *_shards[i];
+        return ShardStats{s.cpu.load(std::memory_order_relaxed), s.channels.size(),
+                          s.wakeups.load(std::memory_order_relaxed),
+                          s.events.load(std::memory_order_relaxed),
+                          s.cpuNs.load(std::memory_order_relaxed)};
+    }
+
+private:
+    struct Shard {
+        AutoCloseFd epfd;
+        AutoCloseFd stopFd;
+        std::vector<Channel*> channels;
+        std::thread thread;
+        std::atomic<int> cpu{-1};
+        std::atomic<uint64_t> wakeups{0};
+        std::atomic<uint64_t> events{0};
+        std::atomic<uint64_t> cpuNs{0};
+        std::exception_ptr error;
+    };
+
+    //进程允许运行的 CPU 列表（容器/taskset 限制后不一定从 0 开始）
+    static std::vector<int> allowedCpus(){
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(::sched_getaffinity(0, sizeof(set), &set) == 0){
+            for(int c = 0; c < CPU_SETSIZE; c++)
+                if(CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+    void run(Shard& s, int cpu){
+        if(cpu >= 0){
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if(::pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+                s.cpu.store(cpu, std::memory_order_relaxed);
+        }
+
+        try{
+            epoll_event evs[64];
+            bool stopping = false;
+            while(!stopping){
+                int n = ::epoll_wait(s.epfd.get(), evs, 64, -1);
+                if(n < 0){
+                    if(errno == EINTR) continue;
+                    throw std::system_error(errno, std::generic_category(), "epoll_wait");
+                }
+                bump(s.wakeups);
+                bump(s.events, static_cast<uint64_t>(n));
+                for(int i = 0; i < n; i++){
+                    if(evs[i].data.ptr == nullptr)
+                        stopping = true;
+                    else
+                        service(s, *static_cast<Channel*>(evs[i].data.ptr));
+                }
+            }
+        }
+        catch(...){
+            s.error = std::current_exception();
+        }
+        s.cpuNs.store(threadCpuNs(), std::memory_order_relaxed);
+    }
+
+    //边沿触发：必须读到 EAGAIN 才能返回，否则剩下的数据不会再通知
+    void service(Shard& s, Channel& c){
+        if(c.closed) return;
+        for(;;){
+            size_t got = c.port.readInto(c.ring);
+            bool full = c.ring.freeSpace() == 0;    // readInto 因环满停下，内核里可能还有数据
+            if(got > 0){
+                bump(c.bytes, got);
+                parse(c);
+            }
+            if(c.port.eof()){
+                ::epoll_ctl(s.epfd.get(), EPOLL_CTL_DEL, c.port.fd(), nullptr);
+                c.closed = true;
+                return;
+            }
+            if(!full) return;
+        }
+    }
+
+    void parse(Channel& c){
+        iovec iov[2];
+        int n = c.ring.readableSpans(iov);
+        uint32_t now = now_ms();
+        uint64_t frames = 0;
+        size_t consumed = 0;
+        for(int k = 0; k < n; k++){
+            c.parser.feed(static_cast<const uint8_t*>(iov[k].iov_base), iov[k].iov_len, now,
+                [&](const uint8_t* d, uint8_t len){
+                    frames++;
+                    if(_onFrame) _onFrame(c.id, d, len);
+                });
+            consumed += iov[k].iov_len;
+        }
+        c.ring.consume(consumed);
+        if(frames) bump(c.frames, frames);
+    }
+
+    bool _pinCpu;
+    bool _running = false;
+    FrameHandler _onFrame;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::vector<std::unique_ptr<Channel>> _channels;
+};
+
+//一路模拟串口：主端由写线程持有，从端交给反应器
+struct PtyChannel {
+    AutoCloseFd master;
+    SerialPort slave;
+};
+
+static PtyChannel openPtyChannel(){
+    std::string slavePath;
+    AutoCloseFd master = openPtyMaster(slavePath);
+    setNonBlocking(master.get());
+    SerialPort slave = SerialPort::open(slavePath, SerialPort::Config{115200, 0, 0});
+    return PtyChannel{std::move(master), std::move(slave)};
+}
+
+//256 路 pty 每路两个 fd，默认 1024 的软上限可能不够，抬到硬上限
+static void raiseFdLimit(){
+    rlimit rl;
+    if(::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max){
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static double processCpuSec(){
+    rusage ru;
+    ::getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+//测试流：长度 1~32 的帧，夹杂少量噪声
+static std::vector<uint8_t> makeStream(size_t frames){
+    std::vector<uint8_t> stream;
+    for(size_t i = 0; i < frames; i++){
+        std::vector<uint8_t> payload;
+        for(size_t k = 0; k < 1 + i % 32; k++)
+            payload.push_back(static_cast<uint8_t>(i + k));
+        auto f = makeFrame(payload);
+        stream.insert(stream.end(), f.begin(), f.end());
+        if(i % 97 == 0) stream.push_back(0x13);
+    }
+    return stream;
+}
+
+/*
+写线程：轮流往自己负责的每个主端写一块，全部 EAGAIN 时 poll 等可写
+*/
+static void writeAll(std::vector<int> fds, const std::vector<uint8_t>& stream){
+    std::vector<size_t> off(fds.size(), 0);
+    size_t remaining = fds.size();
+    std::vector<pollfd> waitSet;
+    while(remaining > 0){
+        bool progress = false;
+        for(size_t i = 0; i < fds.size(); i++){
+            if(off[i] >= stream.size()) continue;
+            ssize_t w = ::write(fds[i], stream.data() + off[i], std::min<size_t>(4096, stream.size() - off[i]));
+            if(w > 0){
+                off[i] += static_cast<size_t>(w);
+                progress = true;
+                if(off[i] >= stream.size()) remaining--;
+            }
+            else if(w < 0 && errno != EAGAIN && errno != EINTR){
+                off[i] = stream.size();                 // 这一路写不动了，放弃
+                remaining--;
+            }
+        }
+        if(!progress && remaining > 0){
+            waitSet.clear();
+            for(size_t i = 0; i < fds.size(); i++)
+                if(off[i] < stream.size()) waitSet.push_back(pollfd{fds[i], POLLOUT, 0});
+            ::poll(waitSet.data(), waitSet.size(), 10);
+        }
+    }
+}
+
+struct BenchResult {
+    size_t channels;
+    size_t shards;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t expected;
+    size_t incompleteChannels;
+    double sec;
+    double reactorCpuSec;
+    double processCpuSec;
+    uint64_t wakeups;
+    uint64_t events;
+};
+
+static BenchResult runBench(size_t channels, size_t shards, size_t totalFrames){
+    size_t perChannel = std::max<size_t>(totalFrames / channels, 256);
+    std::vector<uint8_t> stream = makeStream(perChannel);
+
+    UartReactor reactor(shards);
+    std::vector<AutoCloseFd> masters;
+    for(size_t i = 0; i < channels; i++){
+        PtyChannel p = openPtyChannel();
+        masters.push_back(std::move(p.master));
+        reactor.addChannel(std::move(p.slave));
+    }
+
+    uint64_t expected = static_cast<uint64_t>(perChannel) * channels;
+    reactor.start();
+
+    double cpu0 = processCpuSec();
+    auto start = std::chrono::steady_clock::now();
+
+    //写线程数和分片数一样，避免写端成为瓶颈
+    std::vector<std::thread> writers;
+    for(size_t w = 0; w < shards; w++){
+        std::vector<int> fds;
+        for(size_t i = w; i < channels; i += shards) fds.push_back(masters[i].get());
+        writers.emplace_back(writeAll, std::move(fds), std::cref(stream));
+    }
+
+    auto deadline = start + std::chrono::seconds(30);
+    while(reactor.totalFrames() < expected && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = processCpuSec() - cpu0;
+
+    for(auto& t : writers) t.join();
+    reactor.stop();
+
+    BenchResult r{channels, shards, reactor.totalFrames(), reactor.totalBytes(), expected, 0, sec, 0, cpu, 0, 0};
+    for(size_t i = 0; i < channels; i++)
+        if(reactor.frames(static_cast<int>(i)) != perChannel) r.incompleteChannels++;
+    for(size_t i = 0; i < shards; i++){
+        auto st = reactor.shardStats(i);
+        r.reactorCpuSec += st.cpuNs / 1e9;
+        r.wakeups += st.wakeups;
+        r.events += st.events;
+    }
+    return r;
+}
+
+int main(){
+    try{
+        raiseFdLimit();
+        size_t hw = std::max(1u, std::thread::hardware_concurrency());
+        size_t shards = std::min<size_t>(4, hw);
+
+        // ---------- 1) 每路独立的解析状态：4 路交错逐字节发送，帧不会串 ----------
+        {
+            constexpr int CH = 4;
+            UartReactor reactor(2);
+            std::vector<AutoCloseFd> masters;
+            for(int i = 0; i < CH; i++){
+                PtyChannel p = openPtyChannel();
+                masters.push_back(std::move(p.master));
+                reactor.addChannel(std::move(p.slave));
+            }
+            //每个通道只在所属分片线程里回调，按通道分开存不需要加锁
+            std::vector<std::vector<std::string>> got(CH);
+            reactor.start([&](int ch, const uint8_t* d, uint8_t len){
+                got[ch].emplace_back(reinterpret_cast<const char*>(d), len);
+            });
+
+            std::vector<std::vector<uint8_t>> frames;
+            for(int i = 0; i < CH; i++){
+                std::string text = "ch" + std::to_string(i) + "-hello";
+                frames.push_back(makeFrame(std::vector<uint8_t>(text.begin(), text.end())));
+            }
+            //第 k 个字节轮流发给每一路，每个字节之后停一下，让反应器看到半帧
+            for(size_t k = 0; k < frames[0].size(); k++){
+                for(int i = 0; i < CH; i++){
+                    ssize_t w = ::write(masters[i].get(), &frames[i][k], 1);
+                    (void)w;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            while(reactor.totalFrames() < CH && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            reactor.stop();
+
+            for(int i = 0; i < CH; i++){
+                std::cout << "channel " << i << ":";
+                for(auto& s : got[i]) std::cout << " \"" << s << "\"";
+                std::cout << "\n";
+            }
+            for(size_t i = 0; i < reactor.shardCount(); i++){
+                auto st = reactor.shardStats(i);
+                std::cout << "shard " << i << " cpu=" << st.cpu << " channels=" << st.channels
+                          << " wakeups=" << st.wakeups << "\n";
+            }
+        }
+
+        // ---------- 2) 1~256 路扩展测试 ----------
+        std::cout << "\nshards=" << shards << " (hardware threads " << hw << ")\n";
+        std::cout << std::left
+                  << std::setw(10) << "channels"
+                  << std::setw(12) << "frames"
+                  << std::setw(14) << "frames/s"
+                  << std::setw(10) << "MB/s"
+                  << std::setw(14) << "reactor cpu"
+                  << std::setw(14) << "ns cpu/frame"
+                  << std::setw(14) << "events/wake"
+                  << std::setw(10) << "process cpu"
+                  << "\n";
+        for(size_t channels : {1, 4, 16, 64, 256}){
+            BenchResult r = runBench(channels, shards, 1 << 18);
+            std::cout << std::left
+                      << std::setw(10) << r.channels
+                      << std::setw(12) << r.frames
+                      << std::setw(14) << static_cast<uint64_t>(r.frames / r.sec)
+                      << std::setw(10) << std::fixed << std::setprecision(1) << r.bytes / r.sec / 1e6
+                      << std::setw(14) << (std::to_string(static_cast<int>(r.reactorCpuSec / r.sec * 100)) + "%")
+                      << std::setw(14) << static_cast<uint64_t>(r.reactorCpuSec * 1e9 / std::max<uint64_t>(r.frames, 1))
+                      << std::setw(14) << std::setprecision(2) << (r.wakeups ? static_cast<double>(r.events) / r.wakeups : 0.0)
+                      << std::setw(10) << (std::to_string(static_cast<int>(r.processCpuSec / r.sec * 100)) + "%");
+            if(r.frames != r.expected || r.incompleteChannels)
+                std::cout << "  INCOMPLETE " << r.frames << "/" << r.expected
+                          << " (" << r.incompleteChannels << " channels short)";
+            std::cout << "\n";
+        }
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1024 @@
+/*
+io_uring 输入后端：多发读 + 内核选缓冲
+
+问题：
+night21 的 epoll 反应器每次就绪都要再调 read/readv，还要多读一次拿到 EAGAIN 才知道读干净了
+路数一多，epoll_wait + readv 的系统调用就成了大头
+
+night22 的做法：
+1. InputBackend 接口：addChannel / pollOnce / syscalls，解析器状态按通道放在基类里
+2. EpollBackend：night21 的单线程版本，readv 进环再解析
+3. UringBackend：直接用 io_uring_setup/io_uring_enter/io_uring_register 系统调用（不依赖 liburing）
+   - 注册一个 provided buffer ring（IORING_REGISTER_PBUF_RING），内核读数据时自己从环里挑缓冲
+   - 每路串口挂一个 READ_MULTISHOT 请求，有数据就产生一个 CQE，不用重复提交
+   - CQE 里带缓冲编号，直接在缓冲上解析，解析完把缓冲放回环（只写共享内存，不需要系统调用）
+   - 内核没有 READ_MULTISHOT 时退化成单发 READ + 缓冲选择，每次完成后重新提交
+4. makeInputBackend()：io_uring 建不起来（老内核、被 seccomp/sysctl 禁用）时退回 epoll
+5. main 比较两个后端的吞吐和每 MB 数据的系统调用次数
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+class AutoCloseFd{
+    public:
+        explicit AutoCloseFd(int fd = -1) : fd_(fd) {}
+        ~AutoCloseFd() {reset();}
+
+        AutoCloseFd(const AutoCloseFd&) = delete;
+        AutoCloseFd& operator = (const AutoCloseFd&) = delete;
+
+        AutoCloseFd(AutoCloseFd && other) noexcept : fd_(other.release()) {}
+        AutoCloseFd& operator = (AutoCloseFd && other) noexcept {
+            if(this != &other)
+                reset(other.release());
+            return *this;
+        }
+
+        int get() const {return fd_;}
+        bool valid() const {return fd_ >= 0;}
+        explicit operator bool() const {return valid();}
+
+        //交出所有权，不再负责关闭
+        int release() {
+            int fd = fd_;
+            fd_ = -1;
+            return fd;
+        }
+
+        //关闭当前 fd，接管新的 fd
+        void reset(int fd = -1) {
+            if(fd_ >= 0 && fd_ != fd)
+                ::close(fd_);           // close 被信号打断也不能重试（Linux 上 fd 已经释放）
+            fd_ = fd;
+        }
+
+    private:
+        int fd_;
+};
+
+/*
+字节环：容量必须是 2 的幂
+head/tail 单调递增，取模用 & mask
+writableSpans/readableSpans 返回最多两段连续区域（绕回时第二段从缓冲开头开始）
+读线程和解析在同一个线程里，不需要原子变量
+*/
+class ByteRing {
+public:
+    explicit ByteRing(size_t capacity) : _buffer(capacity), _mask(capacity - 1), _head(0), _tail(0) {
+        if(capacity == 0 || (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("ByteRing capacity must be a power of two");
+    }
+
+    size_t size() const {return _head - _tail;}
+    size_t freeSpace() const {return _buffer.size() - size();}
+
+    int writableSpans(iovec (&iov)[2]) {
+        return spans(_head, freeSpace(), iov);
+    }
+    void commitWrite(size_t n) {_head += n;}
+
+    int readableSpans(iovec (&iov)[2]) {
+        return spans(_tail, size(), iov);
+    }
+    void consume(size_t n) {_tail += n;}
+
+private:
+    int spans(size_t pos, size_t len, iovec (&iov)[2]) {
+        if(len == 0) return 0;
+        size_t offset = pos & _mask;
+        size_t first = std::min(len, _buffer.size() - offset);
+        iov[0].iov_base = _buffer.data() + offset;
+        iov[0].iov_len = first;
+        if(first == len) return 1;
+        iov[1].iov_base = _buffer.data();
+        iov[1].iov_len = len - first;
+        return 2;
+    }
+
+    std::vector<uint8_t> _buffer;
+    size_t _mask;
+    size_t _head;           // 写位置
+    size_t _tail;           // 读位置
+};
+
+/*
+串口
+open() 失败抛 std::system_error，readInto() 返回读到的字节数（0 表示暂时没数据）
+*/
+class SerialPort {
+public:
+    struct Config {
+        int baud = 115200;
+        uint8_t vmin = 0;       // 至少读到几个字节才返回（配合 poll 使用时设 0）
+        uint8_t vtime = 0;      // 单位 0.1s
+    };
+
+    static SerialPort open(const std::string& path, const Config& cfg) {
+        AutoCloseFd fd(::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC));
+        if(!fd)
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        configure(fd.get(), cfg);
+        return SerialPort(std::move(fd));
+    }
+
+    //接管一个已打开的 fd（例如管道、socket），只设置非阻塞，不做 termios 配置
+    static SerialPort adopt(AutoCloseFd fd) {
+        setNonBlocking(fd.get());
+        return SerialPort(std::move(fd));
+    }
+
+    int fd() const {return _fd.get();}
+    uint64_t readCalls() const {return _readCalls;}
+    bool eof() const {return _eof;}
+
+    //把数据直接读进环的空闲区，循环到 EAGAIN 或环满
+    size_t readInto(ByteRing& ring) {
+        size_t total = 0;
+        for(;;) {
+            iovec iov[2];
+            int n = ring.writableSpans(iov);
+            if(n == 0) break;                       // 环满，先让解析器消费
+
+            ssize_t r = ::readv(_fd.get(), iov, n);
+            _readCalls++;
+            if(r > 0) {
+                ring.commitWrite(static_cast<size_t>(r));
+                total += static_cast<size_t>(r);
+                continue;
+            }
+            if(r == 0) {
+                //tty 在 VMIN=0/VTIME=0 下没数据时 read 返回 0 而不是 EAGAIN，不能当成 EOF
+                if(!_isTty) _eof = true;
+                break;
+            }
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if(errno == EIO) {                      // pty 对端关闭
+                _eof = true;
+                break;
+            }
+            throw std::system_error(errno, std::generic_category(), "readv");
+        }
+        return total;
+    }
+
+    //等到可读或超时，返回是否可读
+    bool waitReadable(int timeoutMs) {
+        pollfd p{_fd.get(), POLLIN, 0};
+        int r = ::poll(&p, 1, timeoutMs);
+        if(r < 0 && errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "poll");
+        return r > 0 && (p.revents & (POLLIN | POLLHUP | POLLERR));
+    }
+
+private:
+    explicit SerialPort(AutoCloseFd fd) : _fd(std::move(fd)), _isTty(::isatty(_fd.get()) == 1) {}
+
+    static speed_t baudToSpeed(int baud) {
+        switch(baud) {
+            case 9600:    return B9600;
+            case 19200:   return B19200;
+            case 38400:   return B38400;
+            case 57600:   return B57600;
+            case 115200:  return B115200;
+            case 230400:  return B230400;
+#ifdef B460800
+            case 460800:  return B460800;
+#endif
+#ifdef B921600
+            case 921600:  return B921600;
+#endif
+            default:
+                throw std::invalid_argument("unsupported baud rate " + std::to_string(baud));
+        }
+    }
+
+    static void configure(int fd, const Config& cfg) {
+        termios tio;
+        if(::tcgetattr(fd, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcgetattr");
+
+        ::cfmakeraw(&tio);                          // 不做行缓冲、不回显、不转换换行
+        tio.c_cflag |= CLOCAL | CREAD;              // 忽略调制解调器控制线，允许接收
+        tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        tio.c_cflag = (tio.c_cflag & ~CSIZE) | CS8; // 8N1
+        tio.c_cc[VMIN] = cfg.vmin;
+        tio.c_cc[VTIME] = cfg.vtime;
+
+        speed_t speed = baudToSpeed(cfg.baud);
+        ::cfsetispeed(&tio, speed);
+        ::cfsetospeed(&tio, speed);
+
+        if(::tcsetattr(fd, TCSANOW, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcsetattr");
+        ::tcflush(fd, TCIFLUSH);
+    }
+
+    static void setNonBlocking(int fd) {
+        int flags = ::fcntl(fd, F_GETFL, 0);
+        if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+    }
+
+    AutoCloseFd _fd;
+    bool _isTty;                // tty 的对端关闭用 EIO 表示
+    uint64_t _readCalls = 0;
+    bool _eof = false;
+};
+
+//帧解析器（沿用 night20）
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//构造一帧：AA 55 len payload crc
+std::vector<uint8_t> makeFrame(const std::vector<uint8_t>& payload){
+    std::vector<uint8_t> f{0xAA, 0x55, static_cast<uint8_t>(payload.size())};
+    uint8_t crc = static_cast<uint8_t>(payload.size());
+    for(uint8_t b : payload){
+        f.push_back(b);
+        crc += b;
+    }
+    f.push_back(crc);
+    return f;
+}
+
+//打开一对伪终端：返回主端，从端路径写进 slavePath
+AutoCloseFd openPtyMaster(std::string& slavePath){
+    AutoCloseFd master(::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC));
+    if(!master)
+        throw std::system_error(errno, std::generic_category(), "posix_openpt");
+    if(::grantpt(master.get()) != 0 || ::unlockpt(master.get()) != 0)
+        throw std::system_error(errno, std::generic_category(), "grantpt/unlockpt");
+    char name[128];
+    if(::ptsname_r(master.get(), name, sizeof(name)) != 0)
+        throw std::system_error(errno, std::generic_category(), "ptsname_r");
+    slavePath = name;
+    return master;
+}
+
+static void setNonBlocking(int fd){
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+}
+
+
+/*
+输入后端接口
+单线程使用：pollOnce() 处理一轮 I/O（最多等 timeoutMs），解析出的帧同步回调 FrameHandler
+syscalls() 只统计后端自己发起的系统调用
+*/
+class InputBackend {
+public:
+    using FrameHandler = std::function<void(int channel, const uint8_t* data, uint8_t len)>;
+
+    virtual ~InputBackend() = default;
+    virtual const char* name() const = 0;
+    virtual int addChannel(SerialPort port) = 0;
+    virtual void pollOnce(int timeoutMs) = 0;
+    virtual uint64_t syscalls() const = 0;
+
+    void setFrameHandler(FrameHandler onFrame) {_onFrame = std::move(onFrame);}
+    size_t channelCount() const {return _parsers.size();}
+    uint64_t frames(int channel) const {return _frames[channel];}
+    uint64_t totalFrames() const {return _totalFrames;}
+    uint64_t totalBytes() const {return _totalBytes;}
+
+protected:
+    int newChannel(){
+        _parsers.emplace_back(1000);
+        _frames.push_back(0);
+        return static_cast<int>(_parsers.size() - 1);
+    }
+
+    //一段连续数据交给这一路的解析器
+    void deliver(int channel, const uint8_t* p, size_t n){
+        _totalBytes += n;
+        uint32_t now = now_ms();
+        _parsers[channel].feed(p, n, now, [&](const uint8_t* d, uint8_t len){
+            _frames[channel]++;
+            _totalFrames++;
+            if(_onFrame) _onFrame(channel, d, len);
+        });
+    }
+
+private:
+    FrameHandler _onFrame;
+    std::vector<SimpleUartParser> _parsers;
+    std::vector<uint64_t> _frames;
+    uint64_t _totalFrames = 0;
+    uint64_t _totalBytes = 0;
+};
+
+/*
+epoll 后端（night21 反应器的单线程版本）
+边沿触发：每次就绪 readv 到 EAGAIN 为止，所以每次唤醒至少有一次“空读”
+*/
+class EpollBackend : public InputBackend {
+public:
+    EpollBackend() : _epfd(::epoll_create1(EPOLL_CLOEXEC)) {
+        if(!_epfd)
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+    }
+
+    const char* name() const override {return "epoll";}
+
+    int addChannel(SerialPort port) override {
+        int id = newChannel();
+        _ports.push_back(Port{std::move(port), ByteRing(1 << 14), false});
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u32 = static_cast<uint32_t>(id);
+        _syscalls++;
+        if(::epoll_ctl(_epfd.get(), EPOLL_CTL_ADD, _ports.back().port.fd(), &ev) != 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl add channel");
+        return id;
+    }
+
+    void pollOnce(int timeoutMs) override {
+        epoll_event evs[64];
+        _syscalls++;
+        int n = ::epoll_wait(_epfd.get(), evs, 64, timeoutMs);
+        if(n < 0){
+            if(errno == EINTR) return;
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+        for(int i = 0; i < n; i++)
+            service(static_cast<int>(evs[i].data.u32));
+    }
+
+    uint64_t syscalls() const override {
+        uint64_t sum = _syscalls;
+        for(auto& p : _ports) sum += p.port.readCalls();
+        return sum;
+    }
+
+private:
+    struct Port {
+        SerialPort port;
+        ByteRing ring;
+        bool closed;
+    };
+
+    void service(int id){
+        Port& p = _ports[id];
+        if(p.closed) return;
+        for(;;){
+            size_t got = p.port.readInto(p.ring);
+            bool full = p.ring.freeSpace() == 0;
+            if(got > 0){
+                iovec iov[2];
+                int n = p.ring.readableSpans(iov);
+                size_t consumed = 0;
+                for(int k = 0; k < n; k++){
+                    deliver(id, static_cast<const uint8_t*>(iov[k].iov_base), iov[k].iov_len);
+                    consumed += iov[k].iov_len;
+                }
+                p.ring.consume(consumed);
+            }
+            if(p.port.eof()){
+                _syscalls++;
+                ::epoll_ctl(_epfd.get(), EPOLL_CTL_DEL, p.port.fd(), nullptr);
+                p.closed = true;
+                return;
+            }
+            if(!full) return;
+        }
+    }
+
+    AutoCloseFd _epfd;
+    std::vector<Port> _ports;
+    uint64_t _syscalls = 0;
+};
+
+/*
+io_uring 后端
+SQ/CQ 环和缓冲环都是和内核共享的内存：
+- 提交：填 SQE，release 写 SQ tail，io_uring_enter 通知内核
+- 完成：acquire 读 CQ tail，处理完 release 写 CQ head
+- 还缓冲：填 io_uring_buf，release 写缓冲环 tail
+共享内存的原子访问用 GCC 的 __atomic 内建函数（C++17 没有 atomic_ref）
+构造失败抛异常：system_error 表示系统调用失败，runtime_error 表示内核缺少需要的特性
+*/
+class UringBackend : public InputBackend {
+public:
+    static constexpr unsigned SQ_ENTRIES = 256;
+    static constexpr unsigned CQ_ENTRIES = 4096;
+    static constexpr unsigned BUF_COUNT = 512;      // 必须是 2 的幂
+    static constexpr unsigned BUF_SIZE = 4096;
+    static constexpr uint16_t BUF_GROUP = 0;
+    static constexpr uint8_t OP_READ_MULTISHOT = 49; // 6.7 内核加入，旧版 <linux/io_uring.h> 里还没有
+
+    explicit UringBackend(bool allowMultishot = true){
+        io_uring_params params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = CQ_ENTRIES;
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, SQ_ENTRIES, &params));
+        if(fd < 0)
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+        _ring.reset(fd);
+
+        if(!(params.features & IORING_FEAT_SINGLE_MMAP))
+            throw std::runtime_error("io_uring: IORING_FEAT_SINGLE_MMAP not supported");
+        if(!(params.features & IORING_FEAT_EXT_ARG))
+            throw std::runtime_error("io_uring: IORING_FEAT_EXT_ARG not supported");
+
+        mapRings(params);
+        probeOps(allowMultishot);
+        setupBufferRing();
+    }
+
+    ~UringBackend() override {
+        _ring.reset();                              // 先关 ring，内核不再访问下面的内存
+        if(_bufRing) ::munmap(_bufRing, _bufRingBytes);
+        if(_bufMem) ::munmap(_bufMem, static_cast<size_t>(BUF_COUNT) * BUF_SIZE);
+        if(_sqes) ::munmap(_sqes, _sqesBytes);
+        if(_ringMem) ::munmap(_ringMem, _ringBytes);
+    }
+
+    UringBackend(const UringBackend&) = delete;
+    UringBackend& operator = (const UringBackend&) = delete;
+
+    const char* name() const override {return _multishot ? "io_uring multishot" : "io_uring oneshot";}
+    bool multishot() const {return _multishot;}
+    uint64_t noBufferEvents() const {return _noBuffers;}
+
+    int addChannel(SerialPort port) override {
+        int id = newChannel();
+        _ports.push_back(Port{std::move(port), false});
+        arm(id);
+        return id;
+    }
+
+    void pollOnce(int timeoutMs) override {
+        rearmDeferred();
+        //CQ 里已经有完成事件就不等，只把新的提交带下去
+        bool haveCompletions = cqReady() > 0;
+        uint32_t toSubmit = sqPending();
+        if(!haveCompletions || toSubmit > 0)
+            enter(toSubmit, haveCompletions ? 0 : 1, timeoutMs);
+        reap();
+    }
+
+    uint64_t syscalls() const override {return _syscalls;}
+
+private:
+    struct Port {
+        SerialPort port;
+        bool closed;
+    };
+
+    template <typename T>
+    T* at(size_t offset) {return reinterpret_cast<T*>(static_cast<uint8_t*>(_ringMem) + offset);}
+
+    void mapRings(const io_uring_params& p){
+        size_t sqBytes = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        size_t cqBytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        _ringBytes = std::max(sqBytes, cqBytes);
+        _ringMem = ::mmap(nullptr, _ringBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          _ring.get(), IORING_OFF_SQ_RING);
+        if(_ringMem == MAP_FAILED){
+            _ringMem = nullptr;
+            throw std::system_error(errno, std::generic_category(), "mmap io_uring rings");
+        }
+        _sqesBytes = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, _sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            _ring.get(), IORING_OFF_SQES);
+        if(sqes == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap io_uring sqes");
+        _sqes = static_cast<io_uring_sqe*>(sqes);
+
+        _sqHead = at<uint32_t>(p.sq_off.head);
+        _sqTail = at<uint32_t>(p.sq_off.tail);
+        _sqMask = *at<uint32_t>(p.sq_off.ring_mask);
+        _sqEntries = *at<uint32_t>(p.sq_off.ring_entries);
+        _sqArray = at<uint32_t>(p.sq_off.array);
+        _cqHead = at<uint32_t>(p.cq_off.head);
+        _cqTail = at<uint32_t>(p.cq_off.tail);
+        _cqMask = *at<uint32_t>(p.cq_off.ring_mask);
+        _cqes = at<io_uring_cqe>(p.cq_off.cqes);
+        _sqLocalTail = *_sqTail;
+    }
+
+    void probeOps(bool allowMultishot){
+        constexpr unsigned OPS = 256;
+        std::vector<uint8_t> mem(sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(mem.data());
+        _syscalls++;
+        if(::syscall(__NR_io_uring_register, _ring.get(), IORING_REGISTER_PROBE, probe, OPS) < 0)
+            throw std::system_error(errno, std::generic_category(), "io_uring_register PROBE");
+
+        auto supported = [&](unsigned op){
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        if(!supported(IORING_OP_READ))
+            throw std::runtime_error("io_uring: IORING_OP_READ not supported");
+        _multishot = allowMultishot && supported(OP_READ_MULTISHOT);
+    }
+
+    //缓冲环：BUF_COUNT 个 io_uring_buf 描述符，指向一块 BUF_COUNT * BUF_SIZE 的缓冲区
+    void setupBufferRing(){
+        _bufRingBytes = BUF_COUNT * sizeof(io_uring_buf);
+        void* ring = ::mmap(nullptr, _bufRingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ring == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap buffer ring");
+        _bufRing = static_cast<io_uring_buf_ring*>(ring);
+
+        void* mem = ::mmap(nullptr, static_cast<size_t>(BUF_COUNT) * BUF_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(mem == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap buffers");
+        _bufMem = static_cast<uint8_t*>(mem);
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(_bufRing);
+        reg.ring_entries = BUF_COUNT;
+        reg.bgid = BUF_GROUP;
+        _syscalls++;
+        if(::syscall(__NR_io_uring_register, _ring.get(), IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+            throw std::system_error(errno, std::generic_category(), "io_uring_register PBUF_RING");
+
+        for(uint16_t bid = 0; bid < BUF_COUNT; bid++)
+            recycle(bid);
+        publishBuffers();
+    }
+
+    //把缓冲放回环（先攒着，publishBuffers 一次性对内核可见）
+    //注意不能用 _bufRing->bufs：头文件里的柔性数组宏在 C++ 下展开成一个 1 字节的空结构体，bufs 的偏移变成 8
+    //内核的布局是描述符数组从偏移 0 开始，tail 叠在 bufs[0].resv 上
+    void recycle(uint16_t bid){
+        io_uring_buf& b = reinterpret_cast<io_uring_buf*>(_bufRing)[_bufTail & (BUF_COUNT - 1)];
+        b.addr = reinterpret_cast<uint64_t>(_bufMem + static_cast<size_t>(bid) * BUF_SIZE);
+        b.len = BUF_SIZE;
+        b.bid = bid;
+        _bufTail++;
+    }
+
+    void publishBuffers(){
+        __atomic_store_n(&_bufRing->tail, _bufTail, __ATOMIC_RELEASE);
+    }
+
+    //SQ 满了先交给内核腾地方；内核也收不下（EBUSY/EAGAIN：CQ 积压或内存不足）就返回 nullptr
+    //不能在这里 reap：arm() 本身就会从 reap() -> complete() 里调用
+    io_uring_sqe* nextSqe(){
+        if(sqPending() >= _sqEntries){
+            enter(sqPending(), 0, 0);
+            if(sqPending() >= _sqEntries) return nullptr;
+        }
+        uint32_t idx = _sqLocalTail & _sqMask;
+        io_uring_sqe* sqe = &_sqes[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        _sqArray[idx] = idx;
+        return sqe;
+    }
+
+    void pushSqe(){
+        _sqLocalTail++;
+        __atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+    }
+
+    //给一路串口挂读请求：数据到了由内核从 BUF_GROUP 里挑一个缓冲
+    void arm(int id){
+        io_uring_sqe* sqe = nextSqe();
+        if(!sqe){
+            _deferred.push_back(id);                // 下一次 pollOnce 收完 CQ 再挂
+            return;
+        }
+        sqe->opcode = _multishot ? OP_READ_MULTISHOT : static_cast<uint8_t>(IORING_OP_READ);
+        sqe->fd = _ports[id].port.fd();
+        sqe->off = static_cast<uint64_t>(-1);       // 用文件当前位置（串口/管道不可 seek）
+        sqe->len = _multishot ? 0 : BUF_SIZE;       // 多发读的长度由缓冲大小决定
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUF_GROUP;
+        sqe->user_data = static_cast<uint64_t>(id);
+        pushSqe();
+    }
+
+    void rearmDeferred(){
+        if(_deferred.empty()) return;
+        std::vector<int> ids;
+        ids.swap(_deferred);
+        for(int id : ids)
+            if(!_ports[id].closed) arm(id);         // 还挂不上会再次进 _deferred
+    }
+
+    uint32_t sqPending() const {
+        return _sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    uint32_t cqReady() const {
+        return __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE) - *_cqHead;
+    }
+
+    void enter(uint32_t toSubmit, uint32_t minComplete, int timeoutMs){
+        unsigned flags = 0;
+        io_uring_getevents_arg arg{};
+        __kernel_timespec ts{};
+        if(minComplete > 0){
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        }
+        _syscalls++;
+        long r = flags ? ::syscall(__NR_io_uring_enter, _ring.get(), toSubmit, minComplete, flags, &arg, sizeof(arg))
+                       : ::syscall(__NR_io_uring_enter, _ring.get(), toSubmit, 0, 0, nullptr, 0);
+        if(r < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+    }
+
+    void reap(){
+        uint32_t head = *_cqHead;
+        uint32_t tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        bool recycled = false;
+        while(head != tail){
+            io_uring_cqe cqe = _cqes[head & _cqMask];
+            head++;
+            recycled |= complete(cqe);
+        }
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+        if(recycled) publishBuffers();
+    }
+
+    //处理一个完成事件，返回是否放回了缓冲
+    bool complete(const io_uring_cqe& cqe){
+        int id = static_cast<int>(cqe.user_data);
+        Port& p = _ports[id];
+        bool recycled = false;
+
+        if(cqe.flags & IORING_CQE_F_BUFFER){
+            uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            if(cqe.res > 0)
+                deliver(id, _bufMem + static_cast<size_t>(bid) * BUF_SIZE, static_cast<size_t>(cqe.res));
+            recycle(bid);                           // 解析完马上还回去
+            recycled = true;
+        }
+
+        if(cqe.res == 0 || cqe.res == -EIO)         // 对端关闭
+            p.closed = true;
+        else if(cqe.res == -ENOBUFS)                // 缓冲全在用，多发读被内核停掉，下面重新挂
+            _noBuffers++;
+        else if(cqe.res < 0 && cqe.res != -EAGAIN && cqe.res != -EINTR)
+            throw std::system_error(-cqe.res, std::generic_category(), "io_uring read");
+
+        //没有 F_MORE 表示这个请求已经结束（单发读每次都是，多发读出错时也是）
+        if(!(cqe.flags & IORING_CQE_F_MORE) && !p.closed)
+            arm(id);
+        return recycled;
+    }
+
+    AutoCloseFd _ring;
+    void* _ringMem = nullptr;
+    size_t _ringBytes = 0;
+    io_uring_sqe* _sqes = nullptr;
+    size_t _sqesBytes = 0;
+
+    uint32_t* _sqHead = nullptr;
+    uint32_t* _sqTail = nullptr;
+    uint32_t* _sqArray = nullptr;
+    uint32_t _sqMask = 0;
+    uint32_t _sqEntries = 0;
+    uint32_t _sqLocalTail = 0;
+    uint32_t* _cqHead = nullptr;
+    uint32_t* _cqTail = nullptr;
+    uint32_t _cqMask = 0;
+    io_uring_cqe* _cqes = nullptr;
+
+    io_uring_buf_ring* _bufRing = nullptr;
+    size_t _bufRingBytes = 0;
+    uint8_t* _bufMem = nullptr;
+    uint16_t _bufTail = 0;
+
+    bool _multishot = false;
+    uint64_t _syscalls = 0;
+    uint64_t _noBuffers = 0;
+    std::vector<Port> _ports;
+    std::vector<int> _deferred;                     // SQ 满时没挂上读请求的通道
+};
+
+enum class BackendKind {AUTO, EPOLL, URING, URING_ONESHOT};
+
+/*
+创建输入后端：AUTO 优先 io_uring，建不起来就退回 epoll，原因写进 fallbackReason
+*/
+std::unique_ptr<InputBackend> makeInputBackend(BackendKind kind, std::string* fallbackReason = nullptr){
+    if(kind == BackendKind::EPOLL)
+        return std::make_unique<EpollBackend>();
+    try{
+        return std::make_unique<UringBackend>(kind != BackendKind::URING_ONESHOT);
+    }
+    catch(const std::exception& e){
+        if(kind != BackendKind::AUTO) throw;
+        if(fallbackReason) *fallbackReason = e.what();
+        return std::make_unique<EpollBackend>();
+    }
+}
+//一路模拟串口：主端由写线程持有，从端交给输入后端
+struct PtyChannel {
+    AutoCloseFd master;
+    SerialPort slave;
+};
+
+static PtyChannel openPtyChannel(){
+    std::string slavePath;
+    AutoCloseFd master = openPtyMaster(slavePath);
+    setNonBlocking(master.get());
+    //VMIN=1：没数据时非阻塞 read 返回 EAGAIN 而不是 0
+    //io_uring 把读到 0 当成 EOF，会结束多发读，所以这里不能用 night20 的 VMIN=0
+    SerialPort slave = SerialPort::open(slavePath, SerialPort::Config{115200, 1, 0});
+    return PtyChannel{std::move(master), std::move(slave)};
+}
+
+//256 路 pty 每路两个 fd，默认 1024 的软上限可能不够，抬到硬上限
+static void raiseFdLimit(){
+    rlimit rl;
+    if(::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max){
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+//测试流：长度 1~32 的帧，夹杂少量噪声
+static std::vector<uint8_t> makeStream(size_t frames){
+    std::vector<uint8_t> stream;
+    for(size_t i = 0; i < frames; i++){
+        std::vector<uint8_t> payload;
+        for(size_t k = 0; k < 1 + i % 32; k++)
+            payload.push_back(static_cast<uint8_t>(i + k));
+        auto f = makeFrame(payload);
+        stream.insert(stream.end(), f.begin(), f.end());
+        if(i % 97 == 0) stream.push_back(0x13);
+    }
+    return stream;
+}
+
+/*
+写线程：轮流往自己负责的每个主端写一块，全部 EAGAIN 时 poll 等可写
+*/
+static void writeAll(std::vector<int> fds, const std::vector<uint8_t>& stream){
+    std::vector<size_t> off(fds.size(), 0);
+    size_t remaining = fds.size();
+    std::vector<pollfd> waitSet;
+    while(remaining > 0){
+        bool progress = false;
+        for(size_t i = 0; i < fds.size(); i++){
+            if(off[i] >= stream.size()) continue;
+            ssize_t w = ::write(fds[i], stream.data() + off[i], std::min<size_t>(4096, stream.size() - off[i]));
+            if(w > 0){
+                off[i] += static_cast<size_t>(w);
+                progress = true;
+                if(off[i] >= stream.size()) remaining--;
+            }
+            else if(w < 0 && errno != EAGAIN && errno != EINTR){
+                off[i] = stream.size();                 // 这一路写不动了，放弃
+                remaining--;
+            }
+        }
+        if(!progress && remaining > 0){
+            waitSet.clear();
+            for(size_t i = 0; i < fds.size(); i++)
+                if(off[i] < stream.size()) waitSet.push_back(pollfd{fds[i], POLLOUT, 0});
+            ::poll(waitSet.data(), waitSet.size(), 10);
+        }
+    }
+}
+
+
+struct BenchResult {
+    std::string backend;
+    uint64_t frames;
+    uint64_t expected;
+    uint64_t bytes;
+    uint64_t syscalls;
+    double sec;
+};
+
+static BenchResult runBench(BackendKind kind, size_t channels, size_t totalFrames){
+    size_t perChannel = std::max<size_t>(totalFrames / channels, 256);
+    std::vector<uint8_t> stream = makeStream(perChannel);
+
+    auto backend = makeInputBackend(kind);
+    std::vector<AutoCloseFd> masters;
+    for(size_t i = 0; i < channels; i++){
+        PtyChannel p = openPtyChannel();
+        masters.push_back(std::move(p.master));
+        backend->addChannel(std::move(p.slave));
+    }
+    uint64_t expected = static_cast<uint64_t>(perChannel) * channels;
+    uint64_t sys0 = backend->syscalls();        // 不算建立通道时的系统调用
+
+    //两个写线程：写端在别的线程，统计里只有读端的系统调用
+    constexpr size_t WRITERS = 2;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for(size_t w = 0; w < WRITERS; w++){
+        std::vector<int> fds;
+        for(size_t i = w; i < channels; i += WRITERS) fds.push_back(masters[i].get());
+        writers.emplace_back(writeAll, std::move(fds), std::cref(stream));
+    }
+
+    auto deadline = start + std::chrono::seconds(30);
+    while(backend->totalFrames() < expected && std::chrono::steady_clock::now() < deadline)
+        backend->pollOnce(100);
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for(auto& t : writers) t.join();
+
+    return BenchResult{backend->name(), backend->totalFrames(), expected,
+                       backend->totalBytes(), backend->syscalls() - sys0, sec};
+}
+
+int main(int argc, char* argv[]){
+    try{
+        raiseFdLimit();
+        BackendKind prefer = BackendKind::AUTO;
+        if(argc > 1 && std::string(argv[1]) == "epoll")
+            prefer = BackendKind::EPOLL;            // 手动模拟没有 io_uring 的内核
+
+        // ---------- 1) 自动选择后端，3 路交错发送 ----------
+        {
+            std::string why;
+            auto backend = makeInputBackend(prefer, &why);
+            std::cout << "backend: " << backend->name();
+            if(!why.empty()) std::cout << " (fallback: " << why << ")";
+            std::cout << "\n";
+
+            std::vector<AutoCloseFd> masters;
+            for(int i = 0; i < 3; i++){
+                PtyChannel p = openPtyChannel();
+                masters.push_back(std::move(p.master));
+                backend->addChannel(std::move(p.slave));
+            }
+            backend->setFrameHandler([](int ch, const uint8_t* d, uint8_t len){
+                std::cout << "  channel " << ch << ": \"" << std::string(reinterpret_cast<const char*>(d), len) << "\"\n";
+            });
+            for(int round = 0; round < 2; round++){
+                for(int i = 0; i < 3; i++){
+                    std::string text = "ch" + std::to_string(i) + " frame" + std::to_string(round);
+                    auto f = makeFrame(std::vector<uint8_t>(text.begin(), text.end()));
+                    ssize_t w = ::write(masters[i].get(), f.data(), f.size());
+                    (void)w;
+                }
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            while(backend->totalFrames() < 6 && std::chrono::steady_clock::now() < deadline)
+                backend->pollOnce(100);
+        }
+
+        // ---------- 2) 吞吐和每 MB 系统调用次数 ----------
+        std::vector<BackendKind> kinds{BackendKind::EPOLL};
+        if(prefer != BackendKind::EPOLL){
+            try{
+                UringBackend probe;
+                kinds.push_back(BackendKind::URING);
+                if(probe.multishot()) kinds.push_back(BackendKind::URING_ONESHOT);
+            }
+            catch(const std::exception& e){
+                std::cout << "io_uring unavailable: " << e.what() << "\n";
+            }
+        }
+
+        std::cout << "\n" << std::left
+                  << std::setw(10) << "channels"
+                  << std::setw(22) << "backend"
+                  << std::setw(10) << "MB/s"
+                  << std::setw(14) << "frames/s"
+                  << std::setw(12) << "syscalls"
+                  << std::setw(12) << "syscalls/MB"
+                  << "\n";
+        for(size_t channels : {1, 16, 256}){
+            for(BackendKind k : kinds){
+                BenchResult r = runBench(k, channels, 1 << 18);
+                double mb = r.bytes / 1e6;
+                std::cout << std::left
+                          << std::setw(10) << channels
+                          << std::setw(22) << r.backend
+                          << std::setw(10) << std::fixed << std::setprecision(1) << mb / r.sec
+                          << std::setw(14) << static_cast<uint64_t>(r.frames / r.sec)
+                          << std::setw(12) << r.syscalls
+                          << std::setw(12) << std::setprecision(0) << r.syscalls / mb;
+                if(r.frames != r.expected)
+                    std::cout << "  INCOMPLETE " << r.frames << "/" << r.expected;
+                std::cout << "\n";
+            }
+        }
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
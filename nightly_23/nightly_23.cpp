@@ -0,0 +1,967 @@
+/*
+端到端测试台：伪终端模拟串口 + 负载发生器
+
+问题：
+night10~22 的 main 都是把数组直接喂给解析器，或者一次性把整段数据写进 pty
+没法回答“一帧从设备发出到解析出来要多久”“加了噪声/抖动/突发之后丢多少”
+
+night23 的做法：
+1. PtyUart：一对伪终端当一路 UART，主端 = 设备侧，从端按 night20 的 SerialPort 打开 = 主机侧
+2. LoadProfile：帧率、负载长度、波特率占线、发送抖动、突发、噪声字节、损坏帧、分片写
+3. LoadGenerator：每路一个线程，按计划时间写帧；负载前 12 字节是 序号(u32) + 发送时刻(u64 ns)
+4. 接收走真实路径：fd → EpollBackend（readv 进环）→ SimpleUartParser → 回调里取时间算延迟
+5. E2EHarness 汇总：发出/收到/丢失/重复/乱序、被接受的损坏帧、延迟 p50/p99/p99.9/max
+6. 不需要任何外设，普通 Linux 就能跑；命令行 key=value 可以跑自定义场景
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+
+class AutoCloseFd{
+    public:
+        explicit AutoCloseFd(int fd = -1) : fd_(fd) {}
+        ~AutoCloseFd() {reset();}
+
+        AutoCloseFd(const AutoCloseFd&) = delete;
+        AutoCloseFd& operator = (const AutoCloseFd&) = delete;
+
+        AutoCloseFd(AutoCloseFd && other) noexcept : fd_(other.release()) {}
+        AutoCloseFd& operator = (AutoCloseFd && other) noexcept {
+            if(this != &other)
+                reset(other.release());
+            return *this;
+        }
+
+        int get() const {return fd_;}
+        bool valid() const {return fd_ >= 0;}
+        explicit operator bool() const {return valid();}
+
+        //交出所有权，不再负责关闭
+        int release() {
+            int fd = fd_;
+            fd_ = -1;
+            return fd;
+        }
+
+        //关闭当前 fd，接管新的 fd
+        void reset(int fd = -1) {
+            if(fd_ >= 0 && fd_ != fd)
+                ::close(fd_);           // close 被信号打断也不能重试（Linux 上 fd 已经释放）
+            fd_ = fd;
+        }
+
+    private:
+        int fd_;
+};
+
+/*
+字节环：容量必须是 2 的幂
+head/tail 单调递增，取模用 & mask
+writableSpans/readableSpans 返回最多两段连续区域（绕回时第二段从缓冲开头开始）
+读线程和解析在同一个线程里，不需要原子变量
+*/
+class ByteRing {
+public:
+    explicit ByteRing(size_t capacity) : _buffer(capacity), _mask(capacity - 1), _head(0), _tail(0) {
+        if(capacity == 0 || (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("ByteRing capacity must be a power of two");
+    }
+
+    size_t size() const {return _head - _tail;}
+    size_t freeSpace() const {return _buffer.size() - size();}
+
+    int writableSpans(iovec (&iov)[2]) {
+        return spans(_head, freeSpace(), iov);
+    }
+    void commitWrite(size_t n) {_head += n;}
+
+    int readableSpans(iovec (&iov)[2]) {
+        return spans(_tail, size(), iov);
+    }
+    void consume(size_t n) {_tail += n;}
+
+private:
+    int spans(size_t pos, size_t len, iovec (&iov)[2]) {
+        if(len == 0) return 0;
+        size_t offset = pos & _mask;
+        size_t first = std::min(len, _buffer.size() - offset);
+        iov[0].iov_base = _buffer.data() + offset;
+        iov[0].iov_len = first;
+        if(first == len) return 1;
+        iov[1].iov_base = _buffer.data();
+        iov[1].iov_len = len - first;
+        return 2;
+    }
+
+    std::vector<uint8_t> _buffer;
+    size_t _mask;
+    size_t _head;           // 写位置
+    size_t _tail;           // 读位置
+};
+
+/*
+串口
+open() 失败抛 std::system_error，readInto() 返回读到的字节数（0 表示暂时没数据）
+*/
+class SerialPort {
+public:
+    struct Config {
+        int baud = 115200;
+        uint8_t vmin = 0;       // 至少读到几个字节才返回（配合 poll 使用时设 0）
+        uint8_t vtime = 0;      // 单位 0.1s
+    };
+
+    static SerialPort open(const std::string& path, const Config& cfg) {
+        AutoCloseFd fd(::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC));
+        if(!fd)
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        configure(fd.get(), cfg);
+        return SerialPort(std::move(fd));
+    }
+
+    //接管一个已打开的 fd（例如管道、socket），只设置非阻塞，不做 termios 配置
+    static SerialPort adopt(AutoCloseFd fd) {
+        setNonBlocking(fd.get());
+        return SerialPort(std::move(fd));
+    }
+
+    int fd() const {return _fd.get();}
+    uint64_t readCalls() const {return _readCalls;}
+    bool eof() const {return _eof;}
+
+    //把数据直接读进环的空闲区，循环到 EAGAIN 或环满
+    size_t readInto(ByteRing& ring) {
+        size_t total = 0;
+        for(;;) {
+            iovec iov[2];
+            int n = ring.writableSpans(iov);
+            if(n == 0) break;                       // 环满，先让解析器消费
+
+            ssize_t r = ::readv(_fd.get(), iov, n);
+            _readCalls++;
+            if(r > 0) {
+                ring.commitWrite(static_cast<size_t>(r));
+                total += static_cast<size_t>(r);
+                continue;
+            }
+            if(r == 0) {
+                //tty 在 VMIN=0/VTIME=0 下没数据时 read 返回 0 而不是 EAGAIN，不能当成 EOF
+                if(!_isTty) _eof = true;
+                break;
+            }
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if(errno == EIO) {                      // pty 对端关闭
+                _eof = true;
+                break;
+            }
+            throw std::system_error(errno, std::generic_category(), "readv");
+        }
+        return total;
+    }
+
+    //等到可读或超时，返回是否可读
+    bool waitReadable(int timeoutMs) {
+        pollfd p{_fd.get(), POLLIN, 0};
+        int r = ::poll(&p, 1, timeoutMs);
+        if(r < 0 && errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "poll");
+        return r > 0 && (p.revents & (POLLIN | POLLHUP | POLLERR));
+    }
+
+private:
+    explicit SerialPort(AutoCloseFd fd) : _fd(std::move(fd)), _isTty(::isatty(_fd.get()) == 1) {}
+
+    static speed_t baudToSpeed(int baud) {
+        switch(baud) {
+            case 9600:    return B9600;
+            case 19200:   return B19200;
+            case 38400:   return B38400;
+            case 57600:   return B57600;
+            case 115200:  return B115200;
+            case 230400:  return B230400;
+#ifdef B460800
+            case 460800:  return B460800;
+#endif
+#ifdef B921600
+            case 921600:  return B921600;
+#endif
+            default:
+                throw std::invalid_argument("unsupported baud rate " + std::to_string(baud));
+        }
+    }
+
+    static void configure(int fd, const Config& cfg) {
+        termios tio;
+        if(::tcgetattr(fd, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcgetattr");
+
+        ::cfmakeraw(&tio);                          // 不做行缓冲、不回显、不转换换行
+        tio.c_cflag |= CLOCAL | CREAD;              // 忽略调制解调器控制线，允许接收
+        tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        tio.c_cflag = (tio.c_cflag & ~CSIZE) | CS8; // 8N1
+        tio.c_cc[VMIN] = cfg.vmin;
+        tio.c_cc[VTIME] = cfg.vtime;
+
+        speed_t speed = baudToSpeed(cfg.baud);
+        ::cfsetispeed(&tio, speed);
+        ::cfsetospeed(&tio, speed);
+
+        if(::tcsetattr(fd, TCSANOW, &tio) != 0)
+            throw std::system_error(errno, std::generic_category(), "tcsetattr");
+        ::tcflush(fd, TCIFLUSH);
+    }
+
+    static void setNonBlocking(int fd) {
+        int flags = ::fcntl(fd, F_GETFL, 0);
+        if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+            throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+    }
+
+    AutoCloseFd _fd;
+    bool _isTty;                // tty 的对端关闭用 EIO 表示
+    uint64_t _readCalls = 0;
+    bool _eof = false;
+};
+
+//帧解析器（沿用 night20）
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//构造一帧：AA 55 len payload crc
+std::vector<uint8_t> makeFrame(const std::vector<uint8_t>& payload){
+    std::vector<uint8_t> f{0xAA, 0x55, static_cast<uint8_t>(payload.size())};
+    uint8_t crc = static_cast<uint8_t>(payload.size());
+    for(uint8_t b : payload){
+        f.push_back(b);
+        crc += b;
+    }
+    f.push_back(crc);
+    return f;
+}
+
+//打开一对伪终端：返回主端，从端路径写进 slavePath
+AutoCloseFd openPtyMaster(std::string& slavePath){
+    AutoCloseFd master(::posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC));
+    if(!master)
+        throw std::system_error(errno, std::generic_category(), "posix_openpt");
+    if(::grantpt(master.get()) != 0 || ::unlockpt(master.get()) != 0)
+        throw std::system_error(errno, std::generic_category(), "grantpt/unlockpt");
+    char name[128];
+    if(::ptsname_r(master.get(), name, sizeof(name)) != 0)
+        throw std::system_error(errno, std::generic_category(), "ptsname_r");
+    slavePath = name;
+    return master;
+}
+
+static void setNonBlocking(int fd){
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+}
+
+
+/*
+输入后端接口
+单线程使用：pollOnce() 处理一轮 I/O（最多等 timeoutMs），解析出的帧同步回调 FrameHandler
+syscalls() 只统计后端自己发起的系统调用
+*/
+class InputBackend {
+public:
+    using FrameHandler = std::function<void(int channel, const uint8_t* data, uint8_t len)>;
+
+    virtual ~InputBackend() = default;
+    virtual const char* name() const = 0;
+    virtual int addChannel(SerialPort port) = 0;
+    virtual void pollOnce(int timeoutMs) = 0;
+    virtual uint64_t syscalls() const = 0;
+
+    void setFrameHandler(FrameHandler onFrame) {_onFrame = std::move(onFrame);}
+    size_t channelCount() const {return _parsers.size();}
+    uint64_t frames(int channel) const {return _frames[channel];}
+    uint64_t totalFrames() const {return _totalFrames;}
+    uint64_t totalBytes() const {return _totalBytes;}
+
+protected:
+    int newChannel(){
+        _parsers.emplace_back(1000);
+        _frames.push_back(0);
+        return static_cast<int>(_parsers.size() - 1);
+    }
+
+    //一段连续数据交给这一路的解析器
+    void deliver(int channel, const uint8_t* p, size_t n){
+        _totalBytes += n;
+        uint32_t now = now_ms();
+        _parsers[channel].feed(p, n, now, [&](const uint8_t* d, uint8_t len){
+            _frames[channel]++;
+            _totalFrames++;
+            if(_onFrame) _onFrame(channel, d, len);
+        });
+    }
+
+private:
+    FrameHandler _onFrame;
+    std::vector<SimpleUartParser> _parsers;
+    std::vector<uint64_t> _frames;
+    uint64_t _totalFrames = 0;
+    uint64_t _totalBytes = 0;
+};
+
+/*
+epoll 后端（night21 反应器的单线程版本）
+边沿触发：每次就绪 readv 到 EAGAIN 为止，所以每次唤醒至少有一次“空读”
+*/
+class EpollBackend : public InputBackend {
+public:
+    EpollBackend() : _epfd(::epoll_create1(EPOLL_CLOEXEC)) {
+        if(!_epfd)
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+    }
+
+    const char* name() const override {return "epoll";}
+
+    int addChannel(SerialPort port) override {
+        int id = newChannel();
+        _ports.push_back(Port{std::move(port), ByteRing(1 << 14), false});
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u32 = static_cast<uint32_t>(id);
+        _syscalls++;
+        if(::epoll_ctl(_epfd.get(), EPOLL_CTL_ADD, _ports.back().port.fd(), &ev) != 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl add channel");
+        return id;
+    }
+
+    void pollOnce(int timeoutMs) override {
+        epoll_event evs[64];
+        _syscalls++;
+        int n = ::epoll_wait(_epfd.get(), evs, 64, timeoutMs);
+        if(n < 0){
+            if(errno == EINTR) return;
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+        for(int i = 0; i < n; i++)
+            service(static_cast<int>(evs[i].data.u32));
+    }
+
+    uint64_t syscalls() const override {
+        uint64_t sum = _syscalls;
+        for(auto& p : _ports) sum += p.port.readCalls();
+        return sum;
+    }
+
+private:
+    struct Port {
+        SerialPort port;
+        ByteRing ring;
+        bool closed;
+    };
+
+    void service(int id){
+        Port& p = _ports[id];
+        if(p.closed) return;
+        for(;;){
+            size_t got = p.port.readInto(p.ring);
+            bool full = p.ring.freeSpace() == 0;
+            if(got > 0){
+                iovec iov[2];
+                int n = p.ring.readableSpans(iov);
+                size_t consumed = 0;
+                for(int k = 0; k < n; k++){
+                    deliver(id, static_cast<const uint8_t*>(iov[k].iov_base), iov[k].iov_len);
+                    consumed += iov[k].iov_len;
+                }
+                p.ring.consume(consumed);
+            }
+            if(p.port.eof()){
+                _syscalls++;
+                ::epoll_ctl(_epfd.get(), EPOLL_CTL_DEL, p.port.fd(), nullptr);
+                p.closed = true;
+                return;
+            }
+            if(!full) return;
+        }
+    }
+
+    AutoCloseFd _epfd;
+    std::vector<Port> _ports;
+    uint64_t _syscalls = 0;
+};
+
+//256 路 pty 每路两个 fd，默认 1024 的软上限可能不够，抬到硬上限
+static void raiseFdLimit(){
+    rlimit rl;
+    if(::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max){
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+
+//单调时钟，纳秒；发送端和接收端在同一台机器上，可以直接相减
+static uint64_t monoNs(){
+    using namespace std::chrono;
+    return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+/*
+一路模拟 UART
+device() 是设备侧（负载发生器写），host 侧用 takeHostPort() 交给输入后端
+*/
+class PtyUart {
+public:
+    explicit PtyUart(int baud = 115200){
+        std::string slavePath;
+        _device = openPtyMaster(slavePath);
+        setNonBlocking(_device.get());
+        //VMIN=1：没数据时返回 EAGAIN 而不是 0（night22）
+        _host = std::make_unique<SerialPort>(SerialPort::open(slavePath, SerialPort::Config{baud, 1, 0}));
+        _path = slavePath;
+    }
+
+    int device() const {return _device.get();}
+    const std::string& path() const {return _path;}
+
+    SerialPort takeHostPort(){
+        if(!_host) throw std::logic_error("host port already taken");
+        SerialPort p = std::move(*_host);
+        _host.reset();
+        return p;
+    }
+
+private:
+    AutoCloseFd _device;
+    std::unique_ptr<SerialPort> _host;
+    std::string _path;
+};
+
+/*
+负载配置
+framesPerSec 是平均帧率；burstFrames > 1 时每 burstFrames 帧连发一次，平均帧率不变
+baud > 0 时按 10 bit/字节 计算线路占用，帧率超过线路能力就被压到线路速度
+jitterUs：每帧发送时刻在计划时刻上加 [0, jitterUs] 的随机延后
+noiseProb：每帧之前插入 1~8 个随机噪声字节的概率（噪声里可能有 AA，会让解析器误锁帧头）
+corruptProb：把这一帧随机翻转 1 bit 的概率（应被校验丢掉）
+fragment：一帧拆成随机的几段分别 write，制造半帧
+*/
+struct LoadProfile {
+    double framesPerSec = 1000;
+    uint32_t durationMs = 1000;
+    uint8_t payloadMin = 12;
+    uint8_t payloadMax = 32;
+    int baud = 0;
+    uint32_t jitterUs = 0;
+    uint32_t burstFrames = 1;
+    double noiseProb = 0;
+    double corruptProb = 0;
+    bool fragment = false;
+    uint32_t seed = 1;
+};
+
+struct GeneratorStats {
+    uint32_t sent = 0;                  // 写出去的帧（含损坏帧）
+    uint64_t bytes = 0;
+    uint64_t noiseBytes = 0;
+    uint64_t lateNs = 0;                // 实际发送比计划晚的最大值（写阻塞、调度延迟）
+    std::vector<uint8_t> corrupted;     // 按序号标记哪些帧被故意损坏
+};
+
+//负载前 12 字节：序号 + 发送时刻，小端
+static constexpr uint8_t STAMP_BYTES = 12;
+
+class LoadGenerator {
+public:
+    LoadGenerator(int fd, const LoadProfile& profile) : _fd(fd), _profile(profile), _rng(profile.seed) {
+        if(_profile.payloadMin < STAMP_BYTES || _profile.payloadMax > SimpleUartParser::MAX_LENGTH
+           || _profile.payloadMin > _profile.payloadMax)
+            throw std::invalid_argument("LoadProfile payload range must be within [12, 32]");
+        if(_profile.framesPerSec <= 0 || _profile.burstFrames == 0)
+            throw std::invalid_argument("LoadProfile rate and burst must be positive");
+    }
+
+    ~LoadGenerator() {join();}
+
+    void start(){
+        _thread = std::thread([this]{ run(); });
+    }
+
+    void join(){
+        if(_thread.joinable()) _thread.join();
+    }
+
+    //join 之后读
+    const GeneratorStats& stats() const {return _stats;}
+
+private:
+    void run(){
+        const uint64_t periodNs = static_cast<uint64_t>(1e9 / _profile.framesPerSec);
+        const uint64_t byteNs = _profile.baud > 0 ? 10000000000ull / static_cast<uint64_t>(_profile.baud) : 0;
+        const uint64_t start = monoNs();
+        const uint64_t end = start + static_cast<uint64_t>(_profile.durationMs) * 1000000ull;
+        std::uniform_int_distribution<int> lenDist(_profile.payloadMin, _profile.payloadMax);
+        std::uniform_int_distribution<uint32_t> jitterDist(0, _profile.jitterUs);
+        std::uniform_real_distribution<double> prob(0.0, 1.0);
+        std::uniform_int_distribution<int> byteDist(0, 255);
+
+        uint64_t wireFree = start;              // 线路空闲的时刻
+        std::vector<uint8_t> out;
+        out.reserve(64);
+        for(uint32_t seq = 0; ; seq++){
+            //突发：同一组的帧共用组首的计划时刻
+            uint64_t group = seq / _profile.burstFrames;
+            uint64_t planned = start + group * _profile.burstFrames * periodNs;
+            if(_profile.jitterUs) planned += static_cast<uint64_t>(jitterDist(_rng)) * 1000;
+            planned = std::max(planned, wireFree);
+            if(planned >= end) break;
+            sleepUntil(planned);
+
+            out.clear();
+            if(_profile.noiseProb > 0 && prob(_rng) < _profile.noiseProb){
+                int n = 1 + byteDist(_rng) % 8;
+                for(int i = 0; i < n; i++) out.push_back(static_cast<uint8_t>(byteDist(_rng)));
+                _stats.noiseBytes += static_cast<uint64_t>(n);
+            }
+            size_t frameAt = out.size();
+            size_t len = static_cast<size_t>(lenDist(_rng));
+            uint64_t now = monoNs();
+            _stats.lateNs = std::max(_stats.lateNs, now - std::min(now, planned));
+
+            out.push_back(static_cast<uint8_t>(SimpleUartParser::HEAD1));
+            out.push_back(static_cast<uint8_t>(SimpleUartParser::HEAD2));
+            out.push_back(static_cast<uint8_t>(len));
+            for(int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(seq >> (8 * i)));
+            for(int i = 0; i < 8; i++) out.push_back(static_cast<uint8_t>(now >> (8 * i)));
+            for(size_t i = STAMP_BYTES; i < len; i++) out.push_back(static_cast<uint8_t>(seq + i));
+            uint8_t crc = static_cast<uint8_t>(len);
+            for(size_t i = frameAt + 3; i < out.size(); i++) crc += out[i];
+            out.push_back(crc);
+
+            bool corrupt = _profile.corruptProb > 0 && prob(_rng) < _profile.corruptProb;
+            if(corrupt){
+                //只翻负载或校验字节，不动帧头和长度
+                size_t pos = frameAt + 3 + static_cast<size_t>(byteDist(_rng)) % (len + 1);
+                out[pos] ^= static_cast<uint8_t>(1u << (byteDist(_rng) % 8));
+            }
+            _stats.corrupted.push_back(corrupt ? 1 : 0);
+
+            writeOut(out);
+            _stats.sent++;
+            _stats.bytes += out.size();
+            if(byteNs) wireFree = now + out.size() * byteNs;
+        }
+    }
+
+    //短等待用忙等，长等待先睡到差 100us 再忙等
+    static void sleepUntil(uint64_t t){
+        for(;;){
+            uint64_t now = monoNs();
+            if(now >= t) return;
+            uint64_t left = t - now;
+            if(left > 200000)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(left - 100000));
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void writeOut(const std::vector<uint8_t>& out){
+        size_t off = 0;
+        std::uniform_int_distribution<size_t> pieceDist(1, out.size());
+        while(off < out.size()){
+            size_t n = out.size() - off;
+            if(_profile.fragment) n = std::min(n, pieceDist(_rng));
+            ssize_t w = ::write(_fd, out.data() + off, n);
+            if(w > 0){
+                off += static_cast<size_t>(w);
+                continue;
+            }
+            if(w < 0 && errno == EINTR) continue;
+            if(w < 0 && errno == EAGAIN){
+                pollfd p{_fd, POLLOUT, 0};      // 接收端跟不上，pty 缓冲满
+                ::poll(&p, 1, 10);
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "LoadGenerator write");
+        }
+    }
+
+    int _fd;
+    LoadProfile _profile;
+    std::mt19937 _rng;
+    GeneratorStats _stats;
+    std::thread _thread;
+};
+
+struct E2EReport {
+    size_t channels = 0;
+    uint64_t sent = 0;
+    uint64_t corruptSent = 0;
+    uint64_t received = 0;
+    uint64_t lost = 0;                  // 完好发出却没收到
+    uint64_t corruptAccepted = 0;       // 损坏帧通过了校验
+    uint64_t duplicates = 0;
+    uint64_t reordered = 0;
+    uint64_t noiseBytes = 0;
+    uint64_t maxLateNs = 0;
+    double sec = 0;
+    uint64_t p50 = 0, p99 = 0, p999 = 0, maxNs = 0;
+};
+
+/*
+端到端测试台
+每路一个 PtyUart + LoadGenerator，接收端用一个 EpollBackend 读全部通道（调用线程里跑）
+*/
+class E2EHarness {
+public:
+    E2EHarness(size_t channels, const LoadProfile& profile) : _profile(profile) {
+        for(size_t i = 0; i < channels; i++){
+            _uarts.push_back(std::make_unique<PtyUart>(profile.baud > 0 ? profile.baud : 115200));
+            _backend.addChannel(_uarts.back()->takeHostPort());
+        }
+        _rx.resize(channels);
+    }
+
+    E2EReport run(){
+        _backend.setFrameHandler([this](int ch, const uint8_t* d, uint8_t len){ onFrame(ch, d, len); });
+
+        std::vector<std::unique_ptr<LoadGenerator>> gens;
+        for(size_t i = 0; i < _uarts.size(); i++){
+            LoadProfile p = _profile;
+            p.seed = _profile.seed + static_cast<uint32_t>(i) * 7919;
+            gens.push_back(std::make_unique<LoadGenerator>(_uarts[i]->device(), p));
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        for(auto& g : gens) g->start();
+
+        //发送期间一直读；之后再读到连续 50ms 没有新帧为止
+        auto sendEnd = t0 + std::chrono::milliseconds(_profile.durationMs);
+        uint64_t lastFrames = 0;
+        auto lastChange = std::chrono::steady_clock::now();
+        for(;;){
+            _backend.pollOnce(10);
+            auto now = std::chrono::steady_clock::now();
+            if(_backend.totalFrames() != lastFrames){
+                lastFrames = _backend.totalFrames();
+                lastChange = now;
+            }
+            if(now > sendEnd && now - lastChange > std::chrono::milliseconds(50)) break;
+        }
+        for(auto& g : gens) g->join();
+        double sec = std::chrono::duration<double>(lastChange - t0).count();
+
+        E2EReport r;
+        r.channels = _uarts.size();
+        r.sec = sec;
+        for(size_t i = 0; i < gens.size(); i++){
+            const GeneratorStats& gs = gens[i]->stats();
+            Rx& rx = _rx[i];
+            r.sent += gs.sent;
+            r.noiseBytes += gs.noiseBytes;
+            r.maxLateNs = std::max(r.maxLateNs, gs.lateNs);
+            r.duplicates += rx.duplicates;
+            r.reordered += rx.reordered;
+            for(uint32_t s = 0; s < gs.sent; s++){
+                bool seen = s < rx.seen.size() && rx.seen[s];
+                if(gs.corrupted[s]){
+                    r.corruptSent++;
+                    if(seen) r.corruptAccepted++;
+                }
+                else if(!seen){
+                    r.lost++;
+                }
+                if(seen) r.received++;
+            }
+        }
+
+        std::vector<uint64_t> all;
+        for(auto& rx : _rx) all.insert(all.end(), rx.latencies.begin(), rx.latencies.end());
+        std::sort(all.begin(), all.end());
+        if(!all.empty()){
+            auto pct = [&](double q){ return all[std::min(all.size() - 1, static_cast<size_t>(q * all.size()))]; };
+            r.p50 = pct(0.50);
+            r.p99 = pct(0.99);
+            r.p999 = pct(0.999);
+            r.maxNs = all.back();
+        }
+        return r;
+    }
+
+private:
+    struct Rx {
+        std::vector<uint8_t> seen;
+        std::vector<uint64_t> latencies;
+        int64_t lastSeq = -1;
+        uint64_t duplicates = 0;
+        uint64_t reordered = 0;
+    };
+
+    void onFrame(int ch, const uint8_t* d, uint8_t len){
+        uint64_t recv = monoNs();
+        if(len < STAMP_BYTES) return;           // 噪声里凑出来的短帧
+        uint32_t seq = 0;
+        uint64_t sentAt = 0;
+        for(int i = 0; i < 4; i++) seq |= static_cast<uint32_t>(d[i]) << (8 * i);
+        for(int i = 0; i < 8; i++) sentAt |= static_cast<uint64_t>(d[4 + i]) << (8 * i);
+
+        Rx& rx = _rx[ch];
+        if(seq > 10000000) return;              // 噪声凑出来的帧，序号不可信
+        if(seq >= rx.seen.size()) rx.seen.resize(seq + 1, 0);
+        if(rx.seen[seq]){
+            rx.duplicates++;
+            return;
+        }
+        rx.seen[seq] = 1;
+        if(static_cast<int64_t>(seq) < rx.lastSeq) rx.reordered++;
+        rx.lastSeq = std::max<int64_t>(rx.lastSeq, seq);
+        if(recv >= sentAt) rx.latencies.push_back(recv - sentAt);
+    }
+
+    LoadProfile _profile;
+    std::vector<std::unique_ptr<PtyUart>> _uarts;
+    EpollBackend _backend;
+    std::vector<Rx> _rx;
+};
+
+static void printHeader(){
+    std::cout << std::left
+              << std::setw(26) << "scenario"
+              << std::setw(5) << "ch"
+              << std::setw(9) << "sent"
+              << std::setw(9) << "recv"
+              << std::setw(7) << "lost"
+              << std::setw(9) << "corrupt"
+              << std::setw(7) << "dup"
+              << std::setw(10) << "p50 us"
+              << std::setw(10) << "p99 us"
+              << std::setw(10) << "p99.9 us"
+              << std::setw(10) << "max us"
+              << "\n";
+}
+
+static void printReport(const std::string& name, const E2EReport& r){
+    std::cout << std::left << std::fixed << std::setprecision(1)
+              << std::setw(26) << name
+              << std::setw(5) << r.channels
+              << std::setw(9) << r.sent
+              << std::setw(9) << r.received
+              << std::setw(7) << r.lost
+              << std::setw(9) << (std::to_string(r.corruptSent) + "/" + std::to_string(r.corruptAccepted))
+              << std::setw(7) << r.duplicates
+              << std::setw(10) << r.p50 / 1e3
+              << std::setw(10) << r.p99 / 1e3
+              << std::setw(10) << r.p999 / 1e3
+              << std::setw(10) << r.maxNs / 1e3
+              << "\n";
+}
+
+//命令行 key=value 覆盖默认配置，例如 rate=5000 channels=4 noise=0.01 burst=20
+static bool parseArgs(int argc, char* argv[], LoadProfile& p, size_t& channels){
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if(eq == std::string::npos) return false;
+        std::string key = arg.substr(0, eq);
+        double v = std::stod(arg.substr(eq + 1));
+        if(key == "rate") p.framesPerSec = v;
+        else if(key == "ms") p.durationMs = static_cast<uint32_t>(v);
+        else if(key == "channels") channels = static_cast<size_t>(v);
+        else if(key == "min") p.payloadMin = static_cast<uint8_t>(v);
+        else if(key == "max") p.payloadMax = static_cast<uint8_t>(v);
+        else if(key == "baud") p.baud = static_cast<int>(v);
+        else if(key == "jitter") p.jitterUs = static_cast<uint32_t>(v);
+        else if(key == "burst") p.burstFrames = static_cast<uint32_t>(v);
+        else if(key == "noise") p.noiseProb = v;
+        else if(key == "corrupt") p.corruptProb = v;
+        else if(key == "fragment") p.fragment = v != 0;
+        else if(key == "seed") p.seed = static_cast<uint32_t>(v);
+        else return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    try{
+        raiseFdLimit();
+
+        if(argc > 1){
+            LoadProfile p;
+            size_t channels = 1;
+            if(!parseArgs(argc, argv, p, channels)){
+                std::cerr << "usage: nightly_23 [rate=N] [ms=N] [channels=N] [min=N] [max=N] [baud=N]"
+                             " [jitter=us] [burst=N] [noise=p] [corrupt=p] [fragment=0|1] [seed=N]\n";
+                return 2;
+            }
+            printHeader();
+            E2EHarness h(channels, p);
+            printReport("custom", h.run());
+            return 0;
+        }
+
+        struct Scenario {
+            const char* name;
+            size_t channels;
+            LoadProfile profile;
+        };
+        std::vector<Scenario> scenarios;
+        {
+            LoadProfile p;
+            p.framesPerSec = 2000;
+            scenarios.push_back({"steady 2k fps", 1, p});
+        }
+        {
+            LoadProfile p;
+            p.framesPerSec = 1000;
+            p.baud = 115200;
+            p.jitterUs = 300;
+            scenarios.push_back({"115200 baud + jitter", 1, p});
+        }
+        {
+            LoadProfile p;
+            p.framesPerSec = 4000;
+            p.burstFrames = 100;
+            scenarios.push_back({"bursts of 100 @4k fps", 1, p});
+        }
+        {
+            LoadProfile p;
+            p.framesPerSec = 2000;
+            p.noiseProb = 0.05;
+            p.corruptProb = 0.02;
+            p.fragment = true;
+            scenarios.push_back({"noise+corrupt+fragment", 1, p});
+        }
+        {
+            LoadProfile p;
+            p.framesPerSec = 1000;
+            p.jitterUs = 100;
+            scenarios.push_back({"16 ch x 1k fps", 16, p});
+        }
+        {
+            LoadProfile p;
+            p.framesPerSec = 20000;
+            scenarios.push_back({"overload 20k fps", 1, p});
+        }
+
+        printHeader();
+        for(auto& s : scenarios){
+            E2EHarness h(s.channels, s.profile);
+            printReport(s.name, h.run());
+        }
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
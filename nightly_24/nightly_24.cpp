@@ -0,0 +1,932 @@
+/*
+定长缓冲池：给数据块和帧用的对齐缓冲 + 自动归还的句柄
+
+问题：
+night2 演示了裸 new/delete 的生命周期多容易出错（释放后还在用）
+night20~23 把输入切成块之后，每个块、每个解析出的帧都要一块堆内存，
+每帧一次 malloc/free，多线程下还要抢 malloc 的锁
+
+night24 的做法：
+1. BufferPool：构造时一次性申请 count 个 bufferSize 大小、按 alignment 对齐的缓冲，之后不再向堆要内存
+2. 句柄：
+   - Unique：独占，只能移动，析构时自动还给池
+   - Shared：引用计数（原子），最后一个副本析构时还给池；Unique 可以 share() 成 Shared
+3. 快路径是线程本地缓存：每线程一小摞空闲编号，取/还只碰本线程缓存的标志位（无竞争），不抢全局锁；空了/满了才批量和全局空闲栈交换
+   缓存上限按池大小算（capacity / EXPECTED_THREADS，最多 CACHE_MAX），小池不会被几个线程的缓存分光
+   全局栈空了就从别的线程缓存里拿回一半：A 线程取、B 线程还（读 → 解析 → 消费）时，B 缓存里的编号不会永远回不来
+4. 线程退出时缓存里的编号还回全局（池已销毁就跳过）
+5. 统计：高水位（离开全局空闲栈的缓冲数最大值）、耗尽次数、批量交换次数、从别的线程缓存拿回的次数
+6. main：小池跨线程取/还检查；读块 → 解析 → 消费 三线程流水线，稳定阶段统计 operator new 调用次数，和 std::vector 版本对比
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+//统计全局 operator new 的调用次数（std::vector/std::string/new 都走这里）
+static std::atomic<uint64_t> g_newCalls{0};
+
+void* operator new(size_t n){
+    g_newCalls.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete(void* p, size_t) noexcept {std::free(p);}
+
+/*
+有界无锁队列（Vyukov MPMC，沿用 night15）
+改成移动语义：句柄只能移动，入队失败时不动原对象
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _mask(roundUp(capacity) - 1), _cells(new Cell[_mask + 1]) {
+        for (size_t i = 0; i <= _mask; i++)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        _enqueuePos.store(0, std::memory_order_relaxed);
+        _dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    bool push(T&& data) {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 满
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(data);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& data) {
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 空
+            } else {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        data = std::move(cell->data);
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t v = 2;
+        while (v < n) v <<= 1;
+        return v;
+    }
+
+    const size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    alignas(64) std::atomic<size_t> _enqueuePos;    // 生产者和消费者的位置分开放，避免伪共享
+    alignas(64) std::atomic<size_t> _dequeuePos;
+};
+
+//单写者计数：只有所属线程写，其他线程只读（night21）
+static void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*
+定长缓冲池
+- 所有句柄必须在池析构之前释放
+- acquire() 池空时返回空句柄（operator bool 为 false），不抛异常也不阻塞，由调用方决定重试还是丢弃
+- 线程本地缓存按池的槽位号索引；最多同时有 MAX_POOLS 个池用缓存，超出的池每次都走全局栈
+*/
+class BufferPool {
+public:
+    static constexpr size_t MAX_POOLS = 32;
+    static constexpr uint32_t CACHE_MAX = 64;       // 每线程最多缓存的编号数（小池按 capacity / EXPECTED_THREADS 再缩小）
+    static constexpr size_t EXPECTED_THREADS = 4;   // 缓存上限按几个线程同时用池来分
+
+    struct Stats {
+        size_t capacity;
+        size_t bufferSize;
+        size_t globalFree;      // 全局空闲栈里的缓冲
+        size_t outstanding;     // 不在全局栈里的缓冲（在用 + 在线程缓存里）
+        size_t highWater;       // outstanding 的最大值
+        uint64_t acquires;
+        uint64_t exhausted;     // acquire 失败次数
+        uint64_t refills;       // 线程缓存从全局栈批量取
+        uint64_t flushes;       // 线程缓存向全局栈批量还
+        uint64_t steals;        // 全局栈空时从别的线程缓存拿回编号
+    };
+
+    class Shared;
+
+    //独占句柄
+    class Unique {
+    public:
+        Unique() = default;
+        ~Unique() {reset();}
+
+        Unique(const Unique&) = delete;
+        Unique& operator = (const Unique&) = delete;
+
+        Unique(Unique&& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            other._pool = nullptr;
+        }
+        Unique& operator = (Unique&& other) noexcept {
+            if(this != &other){
+                reset();
+                _pool = other._pool;
+                _index = other._index;
+                _size = other._size;
+                other._pool = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {return _pool != nullptr;}
+        uint8_t* data() const {return _pool->bufferAt(_index);}
+        size_t capacity() const {return _pool->bufferSize();}
+        size_t size() const {return _size;}
+        void setSize(size_t n) {_size = static_cast<uint32_t>(std::min(n, capacity()));}
+
+        void reset(){
+            if(_pool){
+                _pool->release(_index);
+                _pool = nullptr;
+            }
+        }
+
+        //转成共享句柄，本句柄失效
+        Shared share() &&;
+
+    private:
+        friend class BufferPool;
+        Unique(BufferPool* pool, uint32_t index) : _pool(pool), _index(index) {}
+
+        BufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+        uint32_t _size = 0;
+    };
+
+    //共享句柄：拷贝加引用，析构减引用，减到 0 还给池
+    class Shared {
+    public:
+        Shared() = default;
+        ~Shared() {reset();}
+
+        Shared(const Shared& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            if(_pool) _pool->_refs[_index].fetch_add(1, std::memory_order_relaxed);
+        }
+        Shared& operator = (const Shared& other) noexcept {
+            if(this != &other){
+                Shared tmp(other);
+                swap(tmp);
+            }
+            return *this;
+        }
+        Shared(Shared&& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            other._pool = nullptr;
+        }
+        Shared& operator = (Shared&& other) noexcept {
+            if(this != &other){
+                reset();
+                swap(other);
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {return _pool != nullptr;}
+        const uint8_t* data() const {return _pool->bufferAt(_index);}
+        size_t size() const {return _size;}
+        uint32_t useCount() const {return _pool ? _pool->_refs[_index].load(std::memory_order_relaxed) : 0;}
+
+        void reset(){
+            if(_pool){
+                //acq_rel：最后一个释放者要看到其他线程对缓冲的全部写入之后才能还回去
+                if(_pool->_refs[_index].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    _pool->release(_index);
+                _pool = nullptr;
+            }
+        }
+
+        void swap(Shared& other) noexcept {
+            std::swap(_pool, other._pool);
+            std::swap(_index, other._index);
+            std::swap(_size, other._size);
+        }
+
+    private:
+        friend class Unique;
+        Shared(BufferPool* pool, uint32_t index, uint32_t size) : _pool(pool), _index(index), _size(size) {}
+
+        BufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+        uint32_t _size = 0;
+    };
+
+    BufferPool(size_t bufferSize, size_t count, size_t alignment = 64)
+        : _bufferSize(bufferSize),
+          _stride(checkedStride(bufferSize, count, alignment)),
+          _count(count),
+          _cacheMax(static_cast<uint32_t>(std::clamp<size_t>(count / EXPECTED_THREADS, 1, CACHE_MAX))),
+          _batch(std::max<uint32_t>(_cacheMax / 2, 1)),
+          _memory(static_cast<uint8_t*>(std::aligned_alloc(alignment, _stride * count)), &std::free),
+          _refs(new std::atomic<uint32_t>[count]) {
+        if(!_memory)
+            throw std::bad_alloc();
+        _free.reserve(count);
+        for(size_t i = count; i > 0; i--)           // 倒序压栈，先发出低地址的缓冲
+            _free.push_back(static_cast<uint32_t>(i - 1));
+        for(size_t i = 0; i < count; i++)
+            _refs[i].store(0, std::memory_order_relaxed);
+        registerPool();
+    }
+
+    ~BufferPool(){
+        unregisterPool();
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator = (const BufferPool&) = delete;
+
+    size_t bufferSize() const {return _bufferSize;}
+    size_t capacity() const {return _count;}
+
+    Unique acquire(){
+        ThreadCache* c = localCache();
+        if(!c){
+            uint32_t index;
+            if(!popGlobal(index)) return Unique();
+            return Unique(this, index);
+        }
+        c->lock();
+        if(c->count == 0 && !refill(*c)){
+            c->unlock();
+            bump(c->exhausted);
+            return Unique();
+        }
+        uint32_t index = c->items[--c->count];
+        c->unlock();
+        bump(c->acquires);
+        return Unique(this, index);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Stats s{_count, _bufferSize, _free.size(), _count - _free.size(), _highWater,
+                _globalAcquires.load(std::memory_order_relaxed),
+                _globalExhausted.load(std::memory_order_relaxed), _refills, _flushes, _steals};
+        for(auto& c : _caches){
+            s.acquires += c->acquires.load(std::memory_order_relaxed);
+            s.exhausted += c->exhausted.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    /*
+    count/items 由 busy 保护：所属线程每次取/还都拿（同一条缓存行，没有竞争）
+    别的线程拿回编号时只 tryLock，拿不到就跳过，所以持有自己缓存再等 _mutex 不会死锁
+    */
+    struct ThreadCache {
+        std::atomic<bool> busy{false};
+        uint32_t count = 0;
+        uint32_t items[CACHE_MAX];
+        std::atomic<uint64_t> acquires{0};
+        std::atomic<uint64_t> exhausted{0};
+
+        void lock(){
+            while(busy.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+        }
+        bool tryLock(){
+            return !busy.load(std::memory_order_relaxed) && !busy.exchange(true, std::memory_order_acquire);
+        }
+        void unlock(){busy.store(false, std::memory_order_release);}
+    };
+
+    //每个线程一份：按池槽位号记录本线程的缓存，线程退出时把编号还回仍然存活的池
+    struct TlsCaches {
+        struct Slot {
+            uint64_t serial = 0;
+            ThreadCache* cache = nullptr;
+        };
+        Slot slots[MAX_POOLS];
+
+        ~TlsCaches(){
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            for(size_t i = 0; i < MAX_POOLS; i++){
+                if(slots[i].cache && registry().serials[i] == slots[i].serial)
+                    registry().pools[i]->retireCache(slots[i].cache);
+            }
+        }
+    };
+
+    //存活池的登记表：线程退出时靠它判断池还在不在
+    struct Registry {
+        std::mutex mutex;
+        BufferPool* pools[MAX_POOLS] = {};
+        uint64_t serials[MAX_POOLS] = {};
+        uint64_t nextSerial = 1;
+    };
+
+    static Registry& registry(){
+        static Registry r;
+        return r;
+    }
+
+    static TlsCaches& tlsCaches(){
+        thread_local TlsCaches t;
+        return t;
+    }
+
+    void registerPool(){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        _serial = r.nextSerial++;
+        for(size_t i = 0; i < MAX_POOLS; i++){
+            if(r.pools[i] == nullptr){
+                r.pools[i] = this;
+                r.serials[i] = _serial;
+                _slot = static_cast<int>(i);
+                return;
+            }
+        }
+        _slot = -1;                                 // 槽位用完，这个池不用线程缓存
+    }
+
+    void unregisterPool(){
+        if(_slot < 0) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.pools[_slot] = nullptr;
+        r.serials[_slot] = 0;
+    }
+
+    ThreadCache* localCache(){
+        if(_slot < 0) return nullptr;
+        TlsCaches::Slot& s = tlsCaches().slots[_slot];
+        if(s.serial == _serial) return s.cache;
+
+        //本线程第一次用这个池：优先复用已退出线程留下的缓存
+        std::lock_guard<std::mutex> lock(_mutex);
+        ThreadCache* c;
+        if(!_idleCaches.empty()){
+            c = _idleCaches.back();
+            _idleCaches.pop_back();
+        }
+        else{
+            _caches.push_back(std::make_unique<ThreadCache>());
+            c = _caches.back().get();
+        }
+        s.serial = _serial;
+        s.cache = c;
+        return c;
+    }
+
+    //线程退出：缓存里的编号还回全局栈，缓存对象留给下一个线程
+    void retireCache(ThreadCache* c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(uint32_t i = 0; i < c->count; i++)
+            _free.push_back(c->items[i]);
+        c->count = 0;
+        _idleCaches.push_back(c);
+    }
+
+    //调用方持有 c 的锁；慢路径，不内联进 acquire()
+    __attribute__((noinline)) bool refill(ThreadCache& c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()) stealLocked(c);
+        if(_free.empty()) return false;
+        uint32_t n = static_cast<uint32_t>(std::min<size_t>(_batch, _free.size()));
+        for(uint32_t i = 0; i < n; i++){
+            c.items[c.count++] = _free.back();
+            _free.pop_back();
+        }
+        _refills++;
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    //全局栈空了：把别的线程缓存里的编号拿回一半（至少一个）到全局栈，凑够一批就停
+    void stealLocked(ThreadCache& self){
+        for(auto& other : _caches){
+            if(_free.size() >= _batch) break;
+            ThreadCache* v = other.get();
+            if(v == &self || !v->tryLock()) continue;
+            uint32_t n = (v->count + 1) / 2;
+            for(uint32_t i = 0; i < n; i++)
+                _free.push_back(v->items[--v->count]);
+            v->unlock();
+            if(n) _steals++;
+        }
+    }
+
+    bool popGlobal(uint32_t& index){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()){
+            bump(_globalExhausted);
+            return false;
+        }
+        index = _free.back();
+        _free.pop_back();
+        bump(_globalAcquires);
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    void release(uint32_t index){
+        ThreadCache* c = localCache();
+        if(!c){
+            std::lock_guard<std::mutex> lock(_mutex);
+            _free.push_back(index);
+            return;
+        }
+        c->lock();
+        if(c->count == _cacheMax){
+            std::lock_guard<std::mutex> lock(_mutex);
+            for(uint32_t i = 0; i < _batch; i++)
+                _free.push_back(c->items[--c->count]);
+            _flushes++;
+        }
+        c->items[c->count++] = index;
+        c->unlock();
+    }
+
+    //初始化列表里第一个用到参数的地方：参数不对在申请内存之前就抛出，算步长和总大小都不会回绕
+    static size_t checkedStride(size_t bufferSize, size_t count, size_t alignment){
+        if(bufferSize == 0 || count == 0 || count > UINT32_MAX ||
+           alignment == 0 || (alignment & (alignment - 1)) != 0 || bufferSize > SIZE_MAX - (alignment - 1))
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        size_t stride = (bufferSize + alignment - 1) / alignment * alignment;
+        if(stride > SIZE_MAX / count)
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        return stride;
+    }
+
+    uint8_t* bufferAt(uint32_t index) const {return _memory.get() + static_cast<size_t>(index) * _stride;}
+
+    const size_t _bufferSize;
+    const size_t _stride;
+    const size_t _count;
+    const uint32_t _cacheMax;                       // 本池每线程缓存上限
+    const uint32_t _batch;                          // 和全局栈一次交换的数量
+    std::unique_ptr<uint8_t, decltype(&std::free)> _memory;
+    std::unique_ptr<std::atomic<uint32_t>[]> _refs;
+
+    int _slot = -1;
+    uint64_t _serial = 0;
+
+    mutable std::mutex _mutex;                      // 保护下面的全局状态
+    std::vector<uint32_t> _free;
+    std::vector<std::unique_ptr<ThreadCache>> _caches;
+    std::vector<ThreadCache*> _idleCaches;
+    size_t _highWater = 0;
+    uint64_t _refills = 0;
+    uint64_t _flushes = 0;
+    uint64_t _steals = 0;
+    std::atomic<uint64_t> _globalAcquires{0};
+    std::atomic<uint64_t> _globalExhausted{0};
+};
+
+inline BufferPool::Shared BufferPool::Unique::share() && {
+    if(!_pool) return Shared();
+    BufferPool* pool = _pool;
+    _pool = nullptr;
+    pool->_refs[_index].store(1, std::memory_order_relaxed);
+    return Shared(pool, _index, _size);
+}
+
+//帧解析器（沿用 night20）
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//构造一帧：AA 55 len payload crc
+std::vector<uint8_t> makeFrame(const std::vector<uint8_t>& payload){
+    std::vector<uint8_t> f{0xAA, 0x55, static_cast<uint8_t>(payload.size())};
+    uint8_t crc = static_cast<uint8_t>(payload.size());
+    for(uint8_t b : payload){
+        f.push_back(b);
+        crc += b;
+    }
+    f.push_back(crc);
+    return f;
+}
+
+//测试流：长度 1~32 的帧
+static std::vector<uint8_t> makeStream(size_t frames){
+    std::vector<uint8_t> stream;
+    for(size_t i = 0; i < frames; i++){
+        std::vector<uint8_t> payload;
+        for(size_t k = 0; k < 1 + i % 32; k++)
+            payload.push_back(static_cast<uint8_t>(i + k));
+        auto f = makeFrame(payload);
+        stream.insert(stream.end(), f.begin(), f.end());
+    }
+    return stream;
+}
+
+struct PipelineResult {
+    uint64_t frames = 0;
+    uint64_t payloadSum = 0;
+    double sec = 0;
+    uint64_t steadyNewCalls = 0;        // 预热之后整条流水线的 operator new 次数
+    uint64_t steadyFrames = 0;
+};
+
+static constexpr size_t CHUNK = 1024;
+static constexpr size_t WARMUP_CHUNKS = 256;
+
+//队列满/空时让出 CPU
+template <typename Q, typename T>
+static void pushWait(Q& q, T&& v){
+    while(!q.push(std::move(v))) std::this_thread::yield();
+}
+
+template <typename Q, typename T>
+static void popWait(Q& q, T& v){
+    while(!q.pop(v)) std::this_thread::yield();
+}
+
+/*
+池化流水线：读块线程 → 解析线程 → 消费线程
+块和帧都来自 BufferPool，空句柄当结束标记
+*/
+static PipelineResult runPooled(const std::vector<uint8_t>& stream, int rounds, BufferPool::Stats& chunkStats, BufferPool::Stats& frameStats){
+    BufferPool chunkPool(CHUNK, 256);
+    BufferPool framePool(SimpleUartParser::MAX_LENGTH, 1024);
+    BoundedQueue<BufferPool::Unique> chunkQ(64);
+    BoundedQueue<BufferPool::Unique> frameQ(512);
+    PipelineResult r;
+    std::atomic<uint64_t> steadyNew0{0};
+    std::atomic<uint64_t> steadyFrames0{0};
+    std::atomic<uint64_t> consumed{0};
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]{
+        size_t chunks = 0;
+        for(int round = 0; round < rounds; round++){
+            for(size_t off = 0; off < stream.size(); off += CHUNK){
+                if(++chunks == WARMUP_CHUNKS){
+                    steadyNew0 = g_newCalls.load(std::memory_order_relaxed);
+                    steadyFrames0 = consumed.load(std::memory_order_relaxed);
+                }
+                BufferPool::Unique c = chunkPool.acquire();
+                while(!c){                          // 池空：下游还没还回来，等一下
+                    std::this_thread::yield();
+                    c = chunkPool.acquire();
+                }
+                size_t n = std::min(CHUNK, stream.size() - off);
+                std::memcpy(c.data(), stream.data() + off, n);     // 模拟 read() 读进缓冲
+                c.setSize(n);
+                pushWait(chunkQ, c);
+            }
+        }
+        pushWait(chunkQ, BufferPool::Unique());
+    });
+
+    std::thread parser([&]{
+        SimpleUartParser p(1000);
+        BufferPool::Unique c;
+        for(;;){
+            popWait(chunkQ, c);
+            if(!c) break;
+            p.feed(c.data(), c.size(), now_ms(), [&](const uint8_t* d, uint8_t len){
+                BufferPool::Unique f = framePool.acquire();
+                while(!f){
+                    std::this_thread::yield();
+                    f = framePool.acquire();
+                }
+                std::memcpy(f.data(), d, len);
+                f.setSize(len);
+                pushWait(frameQ, f);
+            });
+            c.reset();                              // 块解析完马上还
+        }
+        pushWait(frameQ, BufferPool::Unique());
+    });
+
+    std::thread consumer([&]{
+        BufferPool::Unique f;
+        for(;;){
+            popWait(frameQ, f);
+            if(!f) break;
+            for(size_t i = 0; i < f.size(); i++) r.payloadSum += f.data()[i];
+            f.reset();
+            consumed.store(consumed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    });
+
+    producer.join();
+    parser.join();
+    consumer.join();
+    r.sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.frames = consumed.load();
+    r.steadyNewCalls = g_newCalls.load() - steadyNew0.load();
+    r.steadyFrames = r.frames - steadyFrames0.load();
+    chunkStats = chunkPool.stats();
+    frameStats = framePool.stats();
+    return r;
+}
+
+//对照组：每个块、每个帧一个 std::vector
+static PipelineResult runHeap(const std::vector<uint8_t>& stream, int rounds){
+    BoundedQueue<std::vector<uint8_t>> chunkQ(64);
+    BoundedQueue<std::vector<uint8_t>> frameQ(512);
+    PipelineResult r;
+    std::atomic<uint64_t> steadyNew0{0};
+    std::atomic<uint64_t> steadyFrames0{0};
+    std::atomic<uint64_t> consumed{0};
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]{
+        size_t chunks = 0;
+        for(int round = 0; round < rounds; round++){
+            for(size_t off = 0; off < stream.size(); off += CHUNK){
+                if(++chunks == WARMUP_CHUNKS){
+                    steadyNew0 = g_newCalls.load(std::memory_order_relaxed);
+                    steadyFrames0 = consumed.load(std::memory_order_relaxed);
+                }
+                size_t n = std::min(CHUNK, stream.size() - off);
+                std::vector<uint8_t> c(stream.begin() + off, stream.begin() + off + n);
+                pushWait(chunkQ, c);
+            }
+        }
+        pushWait(chunkQ, std::vector<uint8_t>());
+    });
+
+    std::thread parser([&]{
+        SimpleUartParser p(1000);
+        std::vector<uint8_t> c;
+        for(;;){
+            popWait(chunkQ, c);
+            if(c.empty()) break;
+            p.feed(c.data(), c.size(), now_ms(), [&](const uint8_t* d, uint8_t len){
+                std::vector<uint8_t> f(d, d + len);
+                pushWait(frameQ, f);
+            });
+        }
+        pushWait(frameQ, std::vector<uint8_t>());
+    });
+
+    std::thread consumer([&]{
+        std::vector<uint8_t> f;
+        for(;;){
+            popWait(frameQ, f);
+            if(f.empty()) break;
+            for(uint8_t b : f) r.payloadSum += b;
+            consumed.store(consumed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    });
+
+    producer.join();
+    parser.join();
+    consumer.join();
+    r.sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.frames = consumed.load();
+    r.steadyNewCalls = g_newCalls.load() - steadyNew0.load();
+    r.steadyFrames = r.frames - steadyFrames0.load();
+    return r;
+}
+
+/*
+小池跨线程：一个线程只取、另一个线程只还（读 → 解析 → 消费的形状）
+还回来的编号先进消费线程的缓存；池比线程缓存上限还小时，生产者只能靠从别的线程缓存拿回编号才能继续
+生产者 2 秒取不到缓冲就算卡死，返回 false
+*/
+static bool smallPoolCrossThread(size_t count, uint64_t frames, BufferPool::Stats& stats){
+    BufferPool pool(64, count);
+    BoundedQueue<BufferPool::Unique> q(count);
+    std::atomic<bool> stuck{false};
+    uint64_t received = 0;
+
+    std::thread consumer([&]{
+        BufferPool::Unique f;
+        for(;;){
+            popWait(q, f);
+            if(!f) break;
+            received++;
+            f.reset();
+        }
+    });
+
+    for(uint64_t i = 0; i < frames && !stuck; i++){
+        BufferPool::Unique f = pool.acquire();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while(!f){
+            if(std::chrono::steady_clock::now() > deadline){
+                stuck = true;
+                std::cout << "small pool stuck at frame " << i << "\n";
+                break;
+            }
+            std::this_thread::yield();
+            f = pool.acquire();
+        }
+        if(f) pushWait(q, f);
+    }
+    pushWait(q, BufferPool::Unique());
+    consumer.join();
+    stats = pool.stats();
+    return !stuck && received == frames;
+}
+
+static void printStats(const char* name, const BufferPool::Stats& s){
+    std::cout << name << ": capacity=" << s.capacity << " x " << s.bufferSize << "B"
+              << " outstanding=" << s.outstanding << " high_water=" << s.highWater
+              << " acquires=" << s.acquires << " exhausted=" << s.exhausted
+              << " refills=" << s.refills << " flushes=" << s.flushes << " steals=" << s.steals << "\n";
+}
+
+int main(){
+    // ---------- 1) 句柄语义 ----------
+    {
+        BufferPool pool(64, 4);
+        std::vector<BufferPool::Unique> held;
+        for(int i = 0; i < 5; i++){
+            BufferPool::Unique u = pool.acquire();
+            std::cout << "acquire " << i << ": " << (u ? "ok" : "exhausted") << "\n";
+            if(u) held.push_back(std::move(u));
+        }
+        printStats("after 5 acquires", pool.stats());
+        held.clear();                               // 析构自动归还
+
+        BufferPool::Unique u = pool.acquire();
+        std::strcpy(reinterpret_cast<char*>(u.data()), "shared frame");
+        u.setSize(12);
+        BufferPool::Shared a = std::move(u).share();
+        {
+            BufferPool::Shared b = a;               // 两个订阅者共用同一块缓冲
+            std::cout << "shared use_count=" << a.useCount() << " valid_unique=" << static_cast<bool>(u) << "\n";
+        }
+        std::cout << "after one subscriber released: use_count=" << a.useCount() << "\n";
+        a.reset();
+        std::cout << "aligned=" << (reinterpret_cast<uintptr_t>(pool.acquire().data()) % 64 == 0) << "\n";
+    }
+
+    // ---------- 2) 小池跨线程取/还 ----------
+    std::cout << "\n";
+    for(size_t count : {size_t(4), size_t(32), size_t(64), size_t(256)}){
+        BufferPool::Stats s;
+        bool ok = smallPoolCrossThread(count, 200000, s);
+        std::string label = "cross-thread pool of " + std::to_string(count) + (ok ? " ok" : " FAILED");
+        printStats(label.c_str(), s);
+        if(!ok) return 1;
+    }
+
+    // ---------- 3) 流水线：池化 vs 每帧 std::vector ----------
+    std::vector<uint8_t> stream = makeStream(1 << 16);
+    constexpr int ROUNDS = 10;
+
+    BufferPool::Stats chunkStats, frameStats;
+    PipelineResult pooled = runPooled(stream, ROUNDS, chunkStats, frameStats);
+    PipelineResult heap = runHeap(stream, ROUNDS);
+
+    std::cout << "\n";
+    printStats("chunk pool", chunkStats);
+    printStats("frame pool", frameStats);
+    std::cout << std::fixed << std::setprecision(3);
+    for(auto* p : {&pooled, &heap}){
+        std::cout << (p == &pooled ? "pooled    " : "std::vector")
+                  << " frames=" << p->frames
+                  << " sum=" << p->payloadSum
+                  << " frames/s=" << static_cast<uint64_t>(p->frames / p->sec)
+                  << " steady new calls=" << p->steadyNewCalls
+                  << " (" << static_cast<double>(p->steadyNewCalls) / std::max<uint64_t>(p->steadyFrames, 1) << " per frame)\n";
+    }
+
+    //参数不对：对齐为 0、步长乘数量回绕，构造时就抛出，不做除零、不申请一块算错大小的内存
+    for(auto args : {std::array<size_t, 3>{64, 4, 0}, std::array<size_t, 3>{SIZE_MAX / 2, 4, 64},
+                     std::array<size_t, 3>{SIZE_MAX - 8, 1, 64}}){
+        try{
+            BufferPool bad(args[0], args[1], args[2]);
+            std::cout << "BufferPool(" << args[0] << ", " << args[1] << ", " << args[2] << ") accepted\n";
+            return 1;
+        }
+        catch(const std::invalid_argument&){
+        }
+    }
+    std::cout << "bad size/count/alignment rejected\n";
+    return 0;
+}
@@ -0,0 +1,1177 @@
+/*
+调试模式的隔离分配器：释放后投毒 + 隔离队列 + 代数计数，发布版编译成纯快路径
+
+问题：
+night2 的释放后使用是靠肉眼看出来的：delete 之后那块内存马上被下一个 new 拿走，
+写坏的是别人的数据，程序照样“正常”输出
+night24 的 BufferPool 也一样：句柄析构后如果还留着 data() 拿到的裸指针，写进去没人知道
+
+night25 的做法：BasicBufferPool<Debug> / BasicArena<Debug>，POOL_DEBUG 选默认版本
+调试版（POOL_DEBUG=1，默认）：
+1. 代数（generation）：每块缓冲一个计数，每次释放 +1；句柄和 BufferRef 里带着拿到时的代数
+   - 释放一块不在用的缓冲 → DOUBLE_FREE
+   - 句柄代数和缓冲当前代数不一致 → STALE_HANDLE（缓冲已经被释放、可能已经给了别人）
+2. 投毒：释放时整块填 0xDD，分配时检查是否还是 0xDD（不是就说明释放后被写过 → WRITE_AFTER_FREE），再填 0xCD
+3. 隔离 FIFO：释放的缓冲先进隔离队列，排到队头才回空闲栈，拉长“释放 → 复用”的距离
+4. 调试版所有操作都走全局锁，不用线程缓存（正确性优先）
+5. Arena 每次 reset() 纪元 +1 并投毒，旧纪元的 ArenaRef 再取就报 ARENA_STALE
+发布版（-DPOOL_DEBUG=0）：
+   句柄里没有代数字段（空基类优化），if constexpr 把检查全部去掉，就是 night24 的快路径
+错误通过 poolErrorHandler() 报告，默认打印后 abort；测试里可以换成计数
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef POOL_DEBUG
+#define POOL_DEBUG 1
+#endif
+
+enum class PoolError : uint8_t {DOUBLE_FREE, STALE_HANDLE, WRITE_AFTER_FREE, ARENA_STALE};
+
+inline const char* toString(PoolError e){
+    switch(e){
+        case PoolError::DOUBLE_FREE:      return "DOUBLE_FREE";
+        case PoolError::STALE_HANDLE:     return "STALE_HANDLE";
+        case PoolError::WRITE_AFTER_FREE: return "WRITE_AFTER_FREE";
+        case PoolError::ARENA_STALE:      return "ARENA_STALE";
+    }
+    return "?";
+}
+
+using PoolErrorHandler = void(*)(PoolError error, const char* where, uint32_t index);
+
+inline void defaultPoolErrorHandler(PoolError error, const char* where, uint32_t index){
+    std::cerr << "pool error: " << toString(error) << " in " << where << " (buffer " << index << ")\n";
+    std::abort();
+}
+
+inline PoolErrorHandler& poolErrorHandler(){
+    static PoolErrorHandler h = &defaultPoolErrorHandler;
+    return h;
+}
+
+//单写者计数：只有所属线程写，其他线程只读（night21）
+static void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+//句柄里的代数字段：发布版是空类，靠空基类优化不占空间
+template <bool Debug>
+struct GenField {
+    uint32_t gen() const {return 0;}
+    void setGen(uint32_t) {}
+};
+
+template <>
+struct GenField<true> {
+    uint32_t gen() const {return _gen;}
+    void setGen(uint32_t g) {_gen = g;}
+    uint32_t _gen = 0;
+};
+
+//不拥有缓冲的裸引用：给只能传整数/指针的 C 接口用，detach() 得到，adopt()/free() 交回
+struct BufferRef {
+    uint32_t index;
+    uint32_t gen;           // 发布版恒为 0
+};
+
+/*
+定长缓冲池（night24），Debug 为 true 时带隔离和代数检查
+- 所有句柄必须在池析构之前释放
+- acquire() 池空时返回空句柄
+*/
+template <bool Debug>
+class BasicBufferPool {
+public:
+    static constexpr size_t MAX_POOLS = 32;
+    static constexpr uint32_t CACHE_MAX = 64;
+    static constexpr size_t EXPECTED_THREADS = 4;
+    static constexpr uint8_t POISON_FREE = 0xDD;    // 已释放
+    static constexpr uint8_t POISON_NEW = 0xCD;     // 刚分配、未初始化
+
+    struct Stats {
+        size_t capacity;
+        size_t globalFree;
+        size_t quarantined;
+        size_t highWater;
+        uint64_t exhausted;
+        uint64_t errors;        // 调试版检测到的错误数
+    };
+
+    class Unique : private GenField<Debug> {
+    public:
+        Unique() = default;
+        ~Unique() {reset();}
+
+        Unique(const Unique&) = delete;
+        Unique& operator = (const Unique&) = delete;
+
+        Unique(Unique&& other) noexcept : GenField<Debug>(other), _pool(other._pool), _index(other._index), _size(other._size) {
+            other._pool = nullptr;
+        }
+        Unique& operator = (Unique&& other) noexcept {
+            if(this != &other){
+                reset();
+                GenField<Debug>::operator = (other);
+                _pool = other._pool;
+                _index = other._index;
+                _size = other._size;
+                other._pool = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {return _pool != nullptr;}
+        uint8_t* data() const {return _pool->checkedData(_index, this->gen(), "Unique::data");}
+        size_t capacity() const {return _pool->bufferSize();}
+        size_t size() const {return _size;}
+        void setSize(size_t n) {_size = static_cast<uint32_t>(std::min(n, capacity()));}
+
+        void reset(){
+            if(_pool){
+                _pool->release(_index, this->gen(), "Unique::reset");
+                _pool = nullptr;
+            }
+        }
+
+        //交出所有权，只留下裸引用（缓冲仍然在用，必须之后 adopt() 或 free()）
+        BufferRef detach(){
+            BufferRef r{_index, this->gen()};
+            _pool = nullptr;
+            return r;
+        }
+
+    private:
+        friend class BasicBufferPool;
+        Unique(BasicBufferPool* pool, uint32_t index, uint32_t gen) : _pool(pool), _index(index) {
+            this->setGen(gen);
+        }
+
+        BasicBufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+        uint32_t _size = 0;
+    };
+
+    BasicBufferPool(size_t bufferSize, size_t count, size_t alignment = 64, size_t quarantine = 64)
+        : _bufferSize(bufferSize),
+          _stride(checkedStride(bufferSize, count, alignment)),
+          _count(count),
+          _cacheMax(static_cast<uint32_t>(std::clamp<size_t>(count / EXPECTED_THREADS, 1, CACHE_MAX))),
+          _batch(std::max<uint32_t>(_cacheMax / 2, 1)),
+          _memory(static_cast<uint8_t*>(std::aligned_alloc(alignment, _stride * count)), &std::free) {
+        if(!_memory)
+            throw std::bad_alloc();
+        _free.reserve(count);
+        for(size_t i = count; i > 0; i--)
+            _free.push_back(static_cast<uint32_t>(i - 1));
+
+        if constexpr (Debug){
+            _gen.assign(count, 0);
+            _live.assign(count, 0);
+            _quarantine.assign(std::min(quarantine, count / 2), 0);
+            std::memset(_memory.get(), POISON_FREE, _stride * count);
+        }
+        else{
+            (void)quarantine;
+            registerPool();
+        }
+    }
+
+    ~BasicBufferPool(){
+        if constexpr (!Debug) unregisterPool();
+    }
+
+    BasicBufferPool(const BasicBufferPool&) = delete;
+    BasicBufferPool& operator = (const BasicBufferPool&) = delete;
+
+    size_t bufferSize() const {return _bufferSize;}
+
+    Unique acquire(){
+        if constexpr (Debug){
+            return acquireDebug();
+        }
+        else{
+            ThreadCache* c = localCache();
+            if(!c){
+                uint32_t index;
+                if(!popGlobal(index)) return Unique();
+                return Unique(this, index, 0);
+            }
+            c->lock();
+            if(c->count == 0 && !refill(*c)){
+                c->unlock();
+                bump(c->exhausted);
+                return Unique();
+            }
+            uint32_t index = c->items[--c->count];
+            c->unlock();
+            return Unique(this, index, 0);
+        }
+    }
+
+    //裸引用重新变回句柄；调试版检查引用是否过期
+    Unique adopt(BufferRef ref){
+        if constexpr (Debug){
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(!validLocked(ref.index, ref.gen, "adopt")) return Unique();
+        }
+        return Unique(this, ref.index, ref.gen);
+    }
+
+    //通过裸引用释放
+    void free(BufferRef ref){
+        release(ref.index, ref.gen, "free(BufferRef)");
+    }
+
+    //通过裸引用取地址；调试版过期返回 nullptr
+    uint8_t* resolve(BufferRef ref){
+        return checkedData(ref.index, ref.gen, "resolve");
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Stats s{_count, _free.size(), _qSize, _highWater, _exhausted, _errors};
+        for(auto& c : _caches) s.exhausted += c->exhausted.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    //count/items 由 busy 保护（night24）：所属线程取/还时拿，别的线程拿回编号时只 tryLock
+    struct ThreadCache {
+        std::atomic<bool> busy{false};
+        uint32_t count = 0;
+        uint32_t items[CACHE_MAX];
+        std::atomic<uint64_t> exhausted{0};
+
+        void lock(){
+            while(busy.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+        }
+        bool tryLock(){
+            return !busy.load(std::memory_order_relaxed) && !busy.exchange(true, std::memory_order_acquire);
+        }
+        void unlock(){busy.store(false, std::memory_order_release);}
+    };
+
+    struct TlsCaches {
+        struct Slot {
+            uint64_t serial = 0;
+            ThreadCache* cache = nullptr;
+        };
+        Slot slots[MAX_POOLS];
+
+        ~TlsCaches(){
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            for(size_t i = 0; i < MAX_POOLS; i++){
+                if(slots[i].cache && registry().serials[i] == slots[i].serial)
+                    registry().pools[i]->retireCache(slots[i].cache);
+            }
+        }
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        BasicBufferPool* pools[MAX_POOLS] = {};
+        uint64_t serials[MAX_POOLS] = {};
+        uint64_t nextSerial = 1;
+    };
+
+    static Registry& registry(){
+        static Registry r;
+        return r;
+    }
+
+    static TlsCaches& tlsCaches(){
+        thread_local TlsCaches t;
+        return t;
+    }
+
+    void registerPool(){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        _serial = r.nextSerial++;
+        for(size_t i = 0; i < MAX_POOLS; i++){
+            if(r.pools[i] == nullptr){
+                r.pools[i] = this;
+                r.serials[i] = _serial;
+                _slot = static_cast<int>(i);
+                return;
+            }
+        }
+        _slot = -1;
+    }
+
+    void unregisterPool(){
+        if(_slot < 0) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.pools[_slot] = nullptr;
+        r.serials[_slot] = 0;
+    }
+
+    ThreadCache* localCache(){
+        if(_slot < 0) return nullptr;
+        typename TlsCaches::Slot& s = tlsCaches().slots[_slot];
+        if(s.serial == _serial) return s.cache;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        ThreadCache* c;
+        if(!_idleCaches.empty()){
+            c = _idleCaches.back();
+            _idleCaches.pop_back();
+        }
+        else{
+            _caches.push_back(std::make_unique<ThreadCache>());
+            c = _caches.back().get();
+        }
+        s.serial = _serial;
+        s.cache = c;
+        return c;
+    }
+
+    void retireCache(ThreadCache* c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(uint32_t i = 0; i < c->count; i++)
+            _free.push_back(c->items[i]);
+        c->count = 0;
+        _idleCaches.push_back(c);
+    }
+
+    //调用方持有 c 的锁
+    __attribute__((noinline)) bool refill(ThreadCache& c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()) stealLocked(c);
+        if(_free.empty()) return false;
+        uint32_t n = static_cast<uint32_t>(std::min<size_t>(_batch, _free.size()));
+        for(uint32_t i = 0; i < n; i++){
+            c.items[c.count++] = _free.back();
+            _free.pop_back();
+        }
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    //全局栈空了：把别的线程缓存里的编号拿回一半（至少一个），凑够一批就停
+    void stealLocked(ThreadCache& self){
+        for(auto& other : _caches){
+            if(_free.size() >= _batch) break;
+            ThreadCache* v = other.get();
+            if(v == &self || !v->tryLock()) continue;
+            uint32_t n = (v->count + 1) / 2;
+            for(uint32_t i = 0; i < n; i++)
+                _free.push_back(v->items[--v->count]);
+            v->unlock();
+        }
+    }
+
+    bool popGlobal(uint32_t& index){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()){
+            _exhausted++;
+            return false;
+        }
+        index = _free.back();
+        _free.pop_back();
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    void release(uint32_t index, uint32_t gen, const char* where){
+        if constexpr (Debug){
+            releaseDebug(index, gen, where);
+        }
+        else{
+            (void)gen;
+            (void)where;
+            ThreadCache* c = localCache();
+            if(!c){
+                std::lock_guard<std::mutex> lock(_mutex);
+                _free.push_back(index);
+                return;
+            }
+            c->lock();
+            if(c->count == _cacheMax){
+                std::lock_guard<std::mutex> lock(_mutex);
+                for(uint32_t i = 0; i < _batch; i++)
+                    _free.push_back(c->items[--c->count]);
+            }
+            c->items[c->count++] = index;
+            c->unlock();
+        }
+    }
+
+    //初始化列表里第一个用到参数的地方：参数不对在申请内存之前就抛出，算步长和总大小都不会回绕
+    static size_t checkedStride(size_t bufferSize, size_t count, size_t alignment){
+        if(bufferSize == 0 || count == 0 || count > UINT32_MAX ||
+           alignment == 0 || (alignment & (alignment - 1)) != 0 || bufferSize > SIZE_MAX - (alignment - 1))
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        size_t stride = (bufferSize + alignment - 1) / alignment * alignment;
+        if(stride > SIZE_MAX / count)
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        return stride;
+    }
+
+    uint8_t* bufferAt(uint32_t index) const {return _memory.get() + static_cast<size_t>(index) * _stride;}
+
+    uint8_t* checkedData(uint32_t index, uint32_t gen, const char* where){
+        if constexpr (Debug){
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(!validLocked(index, gen, where)) return nullptr;
+        }
+        else{
+            (void)gen;
+            (void)where;
+        }
+        return bufferAt(index);
+    }
+
+    // ---------- 以下只在调试版里用 ----------
+
+    void report(PoolError e, const char* where, uint32_t index){
+        _errors++;
+        poolErrorHandler()(e, where, index);
+    }
+
+    bool validLocked(uint32_t index, uint32_t gen, const char* where){
+        if(index >= _count || !_live[index] || _gen[index] != gen){
+            report(PoolError::STALE_HANDLE, where, index);
+            return false;
+        }
+        return true;
+    }
+
+    //检查一块空闲缓冲的毒值是否完整
+    void verifyPoison(uint32_t index){
+        const uint8_t* p = bufferAt(index);
+        for(size_t i = 0; i < _bufferSize; i++){
+            if(p[i] != POISON_FREE){
+                report(PoolError::WRITE_AFTER_FREE, "verifyPoison", index);
+                std::memset(bufferAt(index), POISON_FREE, _bufferSize);
+                return;
+            }
+        }
+    }
+
+    Unique acquireDebug(){
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint32_t index;
+        if(!_free.empty()){
+            index = _free.back();
+            _free.pop_back();
+        }
+        else if(_qSize > 0){
+            index = quarantinePop();                // 空闲栈空了，隔离队列不能让池提前耗尽
+        }
+        else{
+            _exhausted++;
+            return Unique();
+        }
+        verifyPoison(index);
+        _live[index] = 1;
+        std::memset(bufferAt(index), POISON_NEW, _bufferSize);
+        _highWater = std::max(_highWater, _count - _free.size() - _qSize);
+        return Unique(this, index, _gen[index]);
+    }
+
+    void releaseDebug(uint32_t index, uint32_t gen, const char* where){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(index >= _count || !_live[index]){
+            report(PoolError::DOUBLE_FREE, where, index);
+            return;
+        }
+        if(_gen[index] != gen){
+            report(PoolError::STALE_HANDLE, where, index);
+            return;
+        }
+        _live[index] = 0;
+        _gen[index]++;
+        std::memset(bufferAt(index), POISON_FREE, _bufferSize);
+        if(_quarantine.empty()){
+            _free.push_back(index);
+            return;
+        }
+        if(_qSize == _quarantine.size())
+            _free.push_back(quarantinePop());       // 队头出隔离，回空闲栈
+        _quarantine[(_qHead + _qSize) % _quarantine.size()] = index;
+        _qSize++;
+    }
+
+    uint32_t quarantinePop(){
+        uint32_t index = _quarantine[_qHead];
+        _qHead = (_qHead + 1) % _quarantine.size();
+        _qSize--;
+        verifyPoison(index);                        // 在隔离期间被写过就在这里发现
+        return index;
+    }
+
+    const size_t _bufferSize;
+    const size_t _stride;
+    const size_t _count;
+    const uint32_t _cacheMax;                       // 本池每线程缓存上限
+    const uint32_t _batch;                          // 和全局栈一次交换的数量
+    std::unique_ptr<uint8_t, decltype(&std::free)> _memory;
+
+    int _slot = -1;
+    uint64_t _serial = 0;
+
+    mutable std::mutex _mutex;
+    std::vector<uint32_t> _free;
+    std::vector<std::unique_ptr<ThreadCache>> _caches;
+    std::vector<ThreadCache*> _idleCaches;
+    size_t _highWater = 0;
+    uint64_t _exhausted = 0;
+
+    //调试版状态
+    std::vector<uint32_t> _gen;
+    std::vector<uint8_t> _live;
+    std::vector<uint32_t> _quarantine;          // 环形 FIFO
+    size_t _qHead = 0;
+    size_t _qSize = 0;
+    uint64_t _errors = 0;
+};
+
+/*
+单线程 Arena：顺序分配，reset() 一次性全部释放
+ArenaRef 记录偏移和分配时的纪元；调试版 reset() 时纪元 +1 并投毒，旧引用 get() 报 ARENA_STALE
+*/
+template <bool Debug>
+class BasicArena {
+public:
+    struct Ref {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t epoch;     // 发布版恒为 0
+    };
+
+    explicit BasicArena(size_t capacity) : _memory(new uint8_t[capacity]), _capacity(capacity) {
+        if constexpr (Debug) std::memset(_memory.get(), BasicBufferPool<true>::POISON_FREE, capacity);
+    }
+
+    //空间不够返回 size == 0 的 Ref
+    Ref alloc(size_t n, size_t align = 8){
+        size_t off = (_used + align - 1) & ~(align - 1);
+        if(off + n > _capacity) return Ref{0, 0, _epoch};
+        _used = off + n;
+        if constexpr (Debug) std::memset(_memory.get() + off, BasicBufferPool<true>::POISON_NEW, n);
+        return Ref{static_cast<uint32_t>(off), static_cast<uint32_t>(n), _epoch};
+    }
+
+    uint8_t* get(const Ref& r){
+        if constexpr (Debug){
+            if(r.epoch != _epoch){
+                poolErrorHandler()(PoolError::ARENA_STALE, "Arena::get", r.offset);
+                return nullptr;
+            }
+        }
+        return _memory.get() + r.offset;
+    }
+
+    void reset(){
+        if constexpr (Debug){
+            std::memset(_memory.get(), BasicBufferPool<true>::POISON_FREE, _used);
+            _epoch++;
+        }
+        _used = 0;
+    }
+
+    size_t used() const {return _used;}
+
+private:
+    std::unique_ptr<uint8_t[]> _memory;
+    size_t _capacity;
+    size_t _used = 0;
+    uint32_t _epoch = 0;
+};
+
+using BufferPool = BasicBufferPool<POOL_DEBUG != 0>;
+using Arena = BasicArena<POOL_DEBUG != 0>;
+
+//发布版句柄和 night24 一样大：指针 + 编号 + 长度
+static_assert(sizeof(BasicBufferPool<false>::Unique) == sizeof(void*) + 2 * sizeof(uint32_t),
+              "release handle must not carry debug fields");
+static_assert(sizeof(BasicBufferPool<true>::Unique) > sizeof(BasicBufferPool<false>::Unique),
+              "debug handle carries a generation");
+
+/*
+对照组：night24 的 BufferPool 原样拷贝（不含任何调试钩子）
+和发布版 BasicBufferPool<false> 跑同一个基准，证明调试能力在发布版里是零开销
+*/
+namespace night24 {
+/*
+定长缓冲池
+- 所有句柄必须在池析构之前释放
+- acquire() 池空时返回空句柄（operator bool 为 false），不抛异常也不阻塞，由调用方决定重试还是丢弃
+- 线程本地缓存按池的槽位号索引；最多同时有 MAX_POOLS 个池用缓存，超出的池每次都走全局栈
+*/
+class BufferPool {
+public:
+    static constexpr size_t MAX_POOLS = 32;
+    static constexpr uint32_t CACHE_MAX = 64;       // 每线程最多缓存的编号数（小池按 capacity / EXPECTED_THREADS 再缩小）
+    static constexpr size_t EXPECTED_THREADS = 4;   // 缓存上限按几个线程同时用池来分
+
+    struct Stats {
+        size_t capacity;
+        size_t bufferSize;
+        size_t globalFree;      // 全局空闲栈里的缓冲
+        size_t outstanding;     // 不在全局栈里的缓冲（在用 + 在线程缓存里）
+        size_t highWater;       // outstanding 的最大值
+        uint64_t acquires;
+        uint64_t exhausted;     // acquire 失败次数
+        uint64_t refills;       // 线程缓存从全局栈批量取
+        uint64_t flushes;       // 线程缓存向全局栈批量还
+        uint64_t steals;        // 全局栈空时从别的线程缓存拿回编号
+    };
+
+    class Shared;
+
+    //独占句柄
+    class Unique {
+    public:
+        Unique() = default;
+        ~Unique() {reset();}
+
+        Unique(const Unique&) = delete;
+        Unique& operator = (const Unique&) = delete;
+
+        Unique(Unique&& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            other._pool = nullptr;
+        }
+        Unique& operator = (Unique&& other) noexcept {
+            if(this != &other){
+                reset();
+                _pool = other._pool;
+                _index = other._index;
+                _size = other._size;
+                other._pool = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {return _pool != nullptr;}
+        uint8_t* data() const {return _pool->bufferAt(_index);}
+        size_t capacity() const {return _pool->bufferSize();}
+        size_t size() const {return _size;}
+        void setSize(size_t n) {_size = static_cast<uint32_t>(std::min(n, capacity()));}
+
+        void reset(){
+            if(_pool){
+                _pool->release(_index);
+                _pool = nullptr;
+            }
+        }
+
+        //转成共享句柄，本句柄失效
+        Shared share() &&;
+
+    private:
+        friend class BufferPool;
+        Unique(BufferPool* pool, uint32_t index) : _pool(pool), _index(index) {}
+
+        BufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+        uint32_t _size = 0;
+    };
+
+    //共享句柄：拷贝加引用，析构减引用，减到 0 还给池
+    class Shared {
+    public:
+        Shared() = default;
+        ~Shared() {reset();}
+
+        Shared(const Shared& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            if(_pool) _pool->_refs[_index].fetch_add(1, std::memory_order_relaxed);
+        }
+        Shared& operator = (const Shared& other) noexcept {
+            if(this != &other){
+                Shared tmp(other);
+                swap(tmp);
+            }
+            return *this;
+        }
+        Shared(Shared&& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            other._pool = nullptr;
+        }
+        Shared& operator = (Shared&& other) noexcept {
+            if(this != &other){
+                reset();
+                swap(other);
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {return _pool != nullptr;}
+        const uint8_t* data() const {return _pool->bufferAt(_index);}
+        size_t size() const {return _size;}
+        uint32_t useCount() const {return _pool ? _pool->_refs[_index].load(std::memory_order_relaxed) : 0;}
+
+        void reset(){
+            if(_pool){
+                //acq_rel：最后一个释放者要看到其他线程对缓冲的全部写入之后才能还回去
+                if(_pool->_refs[_index].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    _pool->release(_index);
+                _pool = nullptr;
+            }
+        }
+
+        void swap(Shared& other) noexcept {
+            std::swap(_pool, other._pool);
+            std::swap(_index, other._index);
+            std::swap(_size, other._size);
+        }
+
+    private:
+        friend class Unique;
+        Shared(BufferPool* pool, uint32_t index, uint32_t size) : _pool(pool), _index(index), _size(size) {}
+
+        BufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+        uint32_t _size = 0;
+    };
+
+    BufferPool(size_t bufferSize, size_t count, size_t alignment = 64)
+        : _bufferSize(bufferSize),
+          _stride(checkedStride(bufferSize, count, alignment)),
+          _count(count),
+          _cacheMax(static_cast<uint32_t>(std::clamp<size_t>(count / EXPECTED_THREADS, 1, CACHE_MAX))),
+          _batch(std::max<uint32_t>(_cacheMax / 2, 1)),
+          _memory(static_cast<uint8_t*>(std::aligned_alloc(alignment, _stride * count)), &std::free),
+          _refs(new std::atomic<uint32_t>[count]) {
+        if(!_memory)
+            throw std::bad_alloc();
+        _free.reserve(count);
+        for(size_t i = count; i > 0; i--)           // 倒序压栈，先发出低地址的缓冲
+            _free.push_back(static_cast<uint32_t>(i - 1));
+        for(size_t i = 0; i < count; i++)
+            _refs[i].store(0, std::memory_order_relaxed);
+        registerPool();
+    }
+
+    ~BufferPool(){
+        unregisterPool();
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator = (const BufferPool&) = delete;
+
+    size_t bufferSize() const {return _bufferSize;}
+    size_t capacity() const {return _count;}
+
+    Unique acquire(){
+        ThreadCache* c = localCache();
+        if(!c){
+            uint32_t index;
+            if(!popGlobal(index)) return Unique();
+            return Unique(this, index);
+        }
+        c->lock();
+        if(c->count == 0 && !refill(*c)){
+            c->unlock();
+            bump(c->exhausted);
+            return Unique();
+        }
+        uint32_t index = c->items[--c->count];
+        c->unlock();
+        bump(c->acquires);
+        return Unique(this, index);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Stats s{_count, _bufferSize, _free.size(), _count - _free.size(), _highWater,
+                _globalAcquires.load(std::memory_order_relaxed),
+                _globalExhausted.load(std::memory_order_relaxed), _refills, _flushes, _steals};
+        for(auto& c : _caches){
+            s.acquires += c->acquires.load(std::memory_order_relaxed);
+            s.exhausted += c->exhausted.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    /*
+    count/items 由 busy 保护：所属线程每次取/还都拿（同一条缓存行，没有竞争）
+    别的线程拿回编号时只 tryLock，拿不到就跳过，所以持有自己缓存再等 _mutex 不会死锁
+    */
+    struct ThreadCache {
+        std::atomic<bool> busy{false};
+        uint32_t count = 0;
+        uint32_t items[CACHE_MAX];
+        std::atomic<uint64_t> acquires{0};
+        std::atomic<uint64_t> exhausted{0};
+
+        void lock(){
+            while(busy.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+        }
+        bool tryLock(){
+            return !busy.load(std::memory_order_relaxed) && !busy.exchange(true, std::memory_order_acquire);
+        }
+        void unlock(){busy.store(false, std::memory_order_release);}
+    };
+
+    //每个线程一份：按池槽位号记录本线程的缓存，线程退出时把编号还回仍然存活的池
+    struct TlsCaches {
+        struct Slot {
+            uint64_t serial = 0;
+            ThreadCache* cache = nullptr;
+        };
+        Slot slots[MAX_POOLS];
+
+        ~TlsCaches(){
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            for(size_t i = 0; i < MAX_POOLS; i++){
+                if(slots[i].cache && registry().serials[i] == slots[i].serial)
+                    registry().pools[i]->retireCache(slots[i].cache);
+            }
+        }
+    };
+
+    //存活池的登记表：线程退出时靠它判断池还在不在
+    struct Registry {
+        std::mutex mutex;
+        BufferPool* pools[MAX_POOLS] = {};
+        uint64_t serials[MAX_POOLS] = {};
+        uint64_t nextSerial = 1;
+    };
+
+    static Registry& registry(){
+        static Registry r;
+        return r;
+    }
+
+    static TlsCaches& tlsCaches(){
+        thread_local TlsCaches t;
+        return t;
+    }
+
+    void registerPool(){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        _serial = r.nextSerial++;
+        for(size_t i = 0; i < MAX_POOLS; i++){
+            if(r.pools[i] == nullptr){
+                r.pools[i] = this;
+                r.serials[i] = _serial;
+                _slot = static_cast<int>(i);
+                return;
+            }
+        }
+        _slot = -1;                                 // 槽位用完，这个池不用线程缓存
+    }
+
+    void unregisterPool(){
+        if(_slot < 0) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.pools[_slot] = nullptr;
+        r.serials[_slot] = 0;
+    }
+
+    ThreadCache* localCache(){
+        if(_slot < 0) return nullptr;
+        TlsCaches::Slot& s = tlsCaches().slots[_slot];
+        if(s.serial == _serial) return s.cache;
+
+        //本线程第一次用这个池：优先复用已退出线程留下的缓存
+        std::lock_guard<std::mutex> lock(_mutex);
+        ThreadCache* c;
+        if(!_idleCaches.empty()){
+            c = _idleCaches.back();
+            _idleCaches.pop_back();
+        }
+        else{
+            _caches.push_back(std::make_unique<ThreadCache>());
+            c = _caches.back().get();
+        }
+        s.serial = _serial;
+        s.cache = c;
+        return c;
+    }
+
+    //线程退出：缓存里的编号还回全局栈，缓存对象留给下一个线程
+    void retireCache(ThreadCache* c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(uint32_t i = 0; i < c->count; i++)
+            _free.push_back(c->items[i]);
+        c->count = 0;
+        _idleCaches.push_back(c);
+    }
+
+    //调用方持有 c 的锁；慢路径，不内联进 acquire()
+    __attribute__((noinline)) bool refill(ThreadCache& c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()) stealLocked(c);
+        if(_free.empty()) return false;
+        uint32_t n = static_cast<uint32_t>(std::min<size_t>(_batch, _free.size()));
+        for(uint32_t i = 0; i < n; i++){
+            c.items[c.count++] = _free.back();
+            _free.pop_back();
+        }
+        _refills++;
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    //全局栈空了：把别的线程缓存里的编号拿回一半（至少一个）到全局栈，凑够一批就停
+    void stealLocked(ThreadCache& self){
+        for(auto& other : _caches){
+            if(_free.size() >= _batch) break;
+            ThreadCache* v = other.get();
+            if(v == &self || !v->tryLock()) continue;
+            uint32_t n = (v->count + 1) / 2;
+            for(uint32_t i = 0; i < n; i++)
+                _free.push_back(v->items[--v->count]);
+            v->unlock();
+            if(n) _steals++;
+        }
+    }
+
+    bool popGlobal(uint32_t& index){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()){
+            bump(_globalExhausted);
+            return false;
+        }
+        index = _free.back();
+        _free.pop_back();
+        bump(_globalAcquires);
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    void release(uint32_t index){
+        ThreadCache* c = localCache();
+        if(!c){
+            std::lock_guard<std::mutex> lock(_mutex);
+            _free.push_back(index);
+            return;
+        }
+        c->lock();
+        if(c->count == _cacheMax){
+            std::lock_guard<std::mutex> lock(_mutex);
+            for(uint32_t i = 0; i < _batch; i++)
+                _free.push_back(c->items[--c->count]);
+            _flushes++;
+        }
+        c->items[c->count++] = index;
+        c->unlock();
+    }
+
+    //初始化列表里第一个用到参数的地方：参数不对在申请内存之前就抛出，算步长和总大小都不会回绕
+    static size_t checkedStride(size_t bufferSize, size_t count, size_t alignment){
+        if(bufferSize == 0 || count == 0 || count > UINT32_MAX ||
+           alignment == 0 || (alignment & (alignment - 1)) != 0 || bufferSize > SIZE_MAX - (alignment - 1))
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        size_t stride = (bufferSize + alignment - 1) / alignment * alignment;
+        if(stride > SIZE_MAX / count)
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        return stride;
+    }
+
+    uint8_t* bufferAt(uint32_t index) const {return _memory.get() + static_cast<size_t>(index) * _stride;}
+
+    const size_t _bufferSize;
+    const size_t _stride;
+    const size_t _count;
+    const uint32_t _cacheMax;                       // 本池每线程缓存上限
+    const uint32_t _batch;                          // 和全局栈一次交换的数量
+    std::unique_ptr<uint8_t, decltype(&std::free)> _memory;
+    std::unique_ptr<std::atomic<uint32_t>[]> _refs;
+
+    int _slot = -1;
+    uint64_t _serial = 0;
+
+    mutable std::mutex _mutex;                      // 保护下面的全局状态
+    std::vector<uint32_t> _free;
+    std::vector<std::unique_ptr<ThreadCache>> _caches;
+    std::vector<ThreadCache*> _idleCaches;
+    size_t _highWater = 0;
+    uint64_t _refills = 0;
+    uint64_t _flushes = 0;
+    uint64_t _steals = 0;
+    std::atomic<uint64_t> _globalAcquires{0};
+    std::atomic<uint64_t> _globalExhausted{0};
+};
+
+inline BufferPool::Shared BufferPool::Unique::share() && {
+    if(!_pool) return Shared();
+    BufferPool* pool = _pool;
+    _pool = nullptr;
+    pool->_refs[_index].store(1, std::memory_order_relaxed);
+    return Shared(pool, _index, _size);
+}
+}
+
+//基准：每轮取 K 块、各写一个字节、再全部释放（模拟一批帧的生命周期）
+constexpr size_t BENCH_BATCH = 16;
+
+template <typename Pool>
+static double benchPool(Pool& pool, size_t rounds, uint64_t& sink){
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < rounds; r++){
+        typename Pool::Unique held[BENCH_BATCH];
+        for(size_t i = 0; i < BENCH_BATCH; i++){
+            held[i] = pool.acquire();
+            held[i].data()[0] = static_cast<uint8_t>(r + i);
+        }
+        for(size_t i = 0; i < BENCH_BATCH; i++){
+            sink += held[i].data()[0];
+            held[i].reset();
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    return ns / (rounds * BENCH_BATCH);
+}
+
+/*
+小池跨线程（night24）：一个线程只取、另一个线程只还，每帧交给对方前后都过一把锁
+生产者 2 秒取不到缓冲就算卡死
+*/
+template <typename Pool>
+static bool crossThreadOk(Pool& pool, uint64_t frames){
+    std::mutex m;
+    std::vector<typename Pool::Unique> handoff;
+    std::atomic<bool> done{false};
+    uint64_t received = 0;
+
+    std::thread consumer([&]{
+        for(;;){
+            typename Pool::Unique f;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if(!handoff.empty()){
+                    f = std::move(handoff.back());
+                    handoff.pop_back();
+                }
+            }
+            if(f){
+                received++;
+                continue;                           // f 在这里析构，由消费线程还给池
+            }
+            if(done.load(std::memory_order_acquire)){
+                std::lock_guard<std::mutex> lock(m);
+                if(handoff.empty()) break;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    bool stuck = false;
+    for(uint64_t i = 0; i < frames && !stuck; i++){
+        typename Pool::Unique f = pool.acquire();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while(!f && !stuck){
+            stuck = std::chrono::steady_clock::now() > deadline;
+            std::this_thread::yield();
+            f = pool.acquire();
+        }
+        std::lock_guard<std::mutex> lock(m);
+        if(f) handoff.push_back(std::move(f));
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    return !stuck && received == frames;
+}
+
+//演示时不 abort，只记下来
+static int g_reported = 0;
+static void countingHandler(PoolError e, const char* where, uint32_t index){
+    g_reported++;
+    std::cout << "  detected " << toString(e) << " in " << where << " (buffer " << index << ")\n";
+}
+
+int main(){
+    std::cout << "POOL_DEBUG=" << POOL_DEBUG
+              << " sizeof(Unique)=" << sizeof(BufferPool::Unique) << "\n";
+
+    // ---------- 1) 调试版能抓到的错误（发布版里这些都是未定义行为，不演示） ----------
+    if(POOL_DEBUG){
+        poolErrorHandler() = &countingHandler;
+        BasicBufferPool<true> pool(64, 16, 64, 4);
+
+        std::cout << "double free:\n";
+        {
+            BufferRef ref = pool.acquire().detach();
+            pool.free(ref);
+            pool.free(ref);                         // 第二次
+        }
+
+        std::cout << "stale handle (buffer reused after quarantine):\n";
+        {
+            BufferRef old = pool.acquire().detach();
+            pool.free(old);
+            std::vector<BasicBufferPool<true>::Unique> churn;
+            for(int i = 0; i < 16; i++) churn.push_back(pool.acquire());   // 把整个池拿空，old 的编号一定被复用
+            uint8_t* p = pool.resolve(old);
+            std::cout << "  resolve(old) = " << static_cast<void*>(p) << "\n";
+        }
+
+        std::cout << "write after free (night2 style):\n";
+        {
+            BasicBufferPool<true>::Unique u = pool.acquire();
+            uint8_t* raw = u.data();                // 留了一个裸指针
+            u.reset();
+            raw[3] = 42;                            // 释放后写：写进了隔离区里的毒值
+            for(int i = 0; i < 8; i++) pool.acquire();   // 隔离队列轮转，出队时检查毒值
+        }
+
+        std::cout << "arena stale ref:\n";
+        {
+            BasicArena<true> arena(1024);
+            auto r = arena.alloc(16);
+            arena.reset();
+            uint8_t* p = arena.get(r);
+            std::cout << "  arena.get(old) = " << static_cast<void*>(p) << "\n";
+        }
+
+        auto s = pool.stats();
+        std::cout << "errors detected=" << g_reported << " (pool counted " << s.errors << ")\n";
+        poolErrorHandler() = &defaultPoolErrorHandler;
+    }
+    else{
+        std::cout << "release build: debug checks compiled out\n";
+    }
+
+    // ---------- 2) 开销：night24 快路径 vs 发布版 vs 调试版 ----------
+    constexpr size_t ROUNDS = 2000000;
+    uint64_t sink = 0;
+    night24::BufferPool fast(256, 1024);
+    BasicBufferPool<false> rel(256, 1024);
+    BasicBufferPool<true> dbg(256, 1024);
+
+    //预热，让线程缓存就位
+    benchPool(fast, 1000, sink);
+    benchPool(rel, 1000, sink);
+
+    double best[3] = {1e9, 1e9, 1e9};
+    for(int rep = 0; rep < 5; rep++){
+        best[0] = std::min(best[0], benchPool(fast, ROUNDS, sink));
+        best[1] = std::min(best[1], benchPool(rel, ROUNDS, sink));
+    }
+    best[2] = benchPool(dbg, ROUNDS / 20, sink);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "\nacquire+release, best of 5 (ns/op):\n"
+              << "  night24 BufferPool     " << best[0] << "\n"
+              << "  BufferPool<release>    " << best[1] << "  (" << std::showpos << (best[1] / best[0] - 1) * 100 << std::noshowpos << "%)\n"
+              << "  BufferPool<debug>      " << best[2] << "  (poison 256B x2 + lock + quarantine)\n"
+              << "sink=" << sink << "\n";
+
+    // ---------- 3) 小池跨线程取/还 ----------
+    {
+        BasicBufferPool<false> small(64, 32);
+        bool ok = crossThreadOk(small, 200000);
+        std::cout << "\ncross-thread release pool of 32: " << (ok ? "ok" : "FAILED") << "\n";
+        if(!ok) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,768 @@
+/*
+共享内存指标：每线程缓存行对齐的计数器 + 外部进程随时读取
+
+问题：
+night11 的 StreamProcessor / SimpleUartParser 运行时什么都看不到：
+收了多少字节、多少帧、多少校验失败、多少次超时复位、队列积压多深、状态机走了多少次错误转移
+night16 的日志能事后分析，但不适合“现在是什么情况”的监控
+
+night26 的做法（namespace nmetrics）：
+1. Registry 把一个 POSIX 共享内存段（shm_open + mmap）当指标仓库：
+   段头 | 指标描述表（名字、说明、类型）| 全局槽（gauge）| 每线程一行计数槽
+2. 计数器按线程分行：每个线程第一次用时领一行，行按 64 字节对齐，线程之间没有伪共享
+   热路径 Counter::inc() = 读 thread_local 行指针 + 本线程行里的一次 relaxed fetch_add（缓存行只在本核心，不会争用）
+   线程退出时把行还回去，下一个线程接着用（计数器只加不减，接着加总和不变）
+3. Gauge（队列深度这类“当前值”）放在全局槽里，relaxed store
+4. 描述表写完再 release 发布 metricCount，读者 acquire 读到多少就只看多少，不需要停进程
+5. Reader：另一个进程 shm_open 只读映射，把各线程行求和，输出 Prometheus 文本格式
+   nightly_26 read <segment>   就是这样一个外部读取工具
+6. 给 SimpleUartParser / StreamProcessor / 学生状态机挂上指标，main 运行时拉起子进程读取
+*/
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <array>
+#include <string>
+#include <queue>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace nmetrics {
+
+constexpr char MAGIC[4] = {'N', 'M', 'E', 'T'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t CACHE_LINE = 64;
+constexpr size_t NAME_LEN = 64;
+constexpr size_t HELP_LEN = 128;
+
+enum class MetricType : uint8_t {COUNTER = 1, GAUGE = 2};
+
+//段头：读者只认 magic/version 和偏移，布局变了就改 VERSION
+struct alignas(CACHE_LINE) SegmentHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t maxMetrics;
+    uint32_t maxThreads;
+    uint32_t rowStride;                     // 每线程一行的字节数（64 的倍数）
+    uint32_t descOffset;
+    uint32_t globalOffset;
+    uint32_t rowsOffset;
+    uint64_t totalSize;
+    int64_t pid;
+    std::atomic<uint32_t> metricCount;      // release 发布
+    std::atomic<uint32_t> rowsUsed;         // 领过的行数（读者只需要扫这么多行）
+};
+
+struct MetricDesc {
+    char name[NAME_LEN];
+    char help[HELP_LEN];
+    MetricType type;
+    uint8_t pad[7];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "counters in shared memory must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "header fields in shared memory must be lock-free");
+
+//计算各区域偏移，写者和读者共用
+struct Layout {
+    uint32_t descOffset, globalOffset, rowsOffset, rowStride;
+    uint64_t totalSize;
+
+    Layout(uint32_t maxMetrics, uint32_t maxThreads){
+        auto align = [](uint64_t v){ return (v + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE; };
+        descOffset = static_cast<uint32_t>(align(sizeof(SegmentHeader)));
+        globalOffset = static_cast<uint32_t>(align(descOffset + uint64_t(maxMetrics) * sizeof(MetricDesc)));
+        rowStride = static_cast<uint32_t>(align(uint64_t(maxMetrics) * sizeof(uint64_t)));
+        rowsOffset = static_cast<uint32_t>(align(globalOffset + uint64_t(maxMetrics) * sizeof(uint64_t)));
+        totalSize = rowsOffset + uint64_t(rowStride) * maxThreads;
+    }
+};
+
+struct Sample {
+    std::string name;
+    std::string help;
+    MetricType type;
+    int64_t value;
+};
+
+//把采样写成 Prometheus 文本格式
+inline void writePrometheus(std::ostream& os, const std::vector<Sample>& samples){
+    for(auto& s : samples){
+        os << "# HELP " << s.name << " " << s.help << "\n";
+        os << "# TYPE " << s.name << " " << (s.type == MetricType::COUNTER ? "counter" : "gauge") << "\n";
+        os << s.name << " " << s.value << "\n";
+    }
+}
+
+//按布局从一段映射里读出所有指标（写者自己和外部读者共用）
+inline std::vector<Sample> collect(const uint8_t* base){
+    auto* h = reinterpret_cast<const SegmentHeader*>(base);
+    uint32_t n = h->metricCount.load(std::memory_order_acquire);
+    uint32_t rows = std::min(h->rowsUsed.load(std::memory_order_acquire), h->maxThreads);
+    auto* desc = reinterpret_cast<const MetricDesc*>(base + h->descOffset);
+    auto* global = reinterpret_cast<const std::atomic<int64_t>*>(base + h->globalOffset);
+
+    std::vector<Sample> out;
+    out.reserve(n);
+    for(uint32_t i = 0; i < n; i++){
+        Sample s{std::string(desc[i].name, strnlen(desc[i].name, NAME_LEN)),
+                 std::string(desc[i].help, strnlen(desc[i].help, HELP_LEN)), desc[i].type, 0};
+        if(s.type == MetricType::GAUGE){
+            s.value = global[i].load(std::memory_order_relaxed);
+        }
+        else{
+            uint64_t sum = 0;
+            for(uint32_t r = 0; r < rows; r++){
+                auto* row = reinterpret_cast<const std::atomic<uint64_t>*>(base + h->rowsOffset + uint64_t(r) * h->rowStride);
+                sum += row[i].load(std::memory_order_relaxed);
+            }
+            s.value = static_cast<int64_t>(sum);
+        }
+        out.push_back(std::move(s));
+    }
+    return out;
+}
+
+class Registry;
+
+//本线程的计数行；不带析构的裸指针，访问时没有初始化检查
+inline thread_local std::atomic<uint64_t>* t_row = nullptr;
+
+//计数器句柄：只存编号，可以随便拷贝
+class Counter {
+public:
+    Counter() = default;
+    inline void inc(uint64_t n = 1) const;
+    uint32_t id() const {return _id;}
+
+private:
+    friend class Registry;
+    explicit Counter(uint32_t id) : _id(id) {}
+    uint32_t _id = 0;
+};
+
+class Gauge {
+public:
+    Gauge() = default;
+    inline void set(int64_t v) const;
+    inline void add(int64_t d) const;
+
+private:
+    friend class Registry;
+    explicit Gauge(std::atomic<int64_t>* slot) : _slot(slot) {}
+    std::atomic<int64_t>* _slot = nullptr;
+};
+
+/*
+进程内唯一的指标仓库（和 night16 的 Logger 一样用单例）
+- open() 之前注册指标、inc() 都会抛异常；每个进程只 open() 一次
+- close() 只删除段的名字（外部工具不再能打开），映射保留到进程退出，
+  这样还没停下来的线程继续 inc() 也不会写到已经解除映射的内存
+*/
+class Registry {
+public:
+    static Registry& instance(){
+        static Registry r;
+        return r;
+    }
+
+    //创建共享内存段；name 形如 "/nightly26_metrics"
+    void open(const std::string& name, uint32_t maxMetrics = 128, uint32_t maxThreads = 64){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_base) throw std::logic_error("metrics registry can only be opened once");
+        Layout l(maxMetrics, maxThreads);
+
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if(fd < 0)
+            throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        if(::ftruncate(fd, static_cast<off_t>(l.totalSize)) != 0){
+            int e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), "ftruncate " + name);
+        }
+        void* p = ::mmap(nullptr, l.totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);                                // 映射建立后 fd 就不需要了
+        if(p == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap " + name);
+
+        //ftruncate 出来的页全是 0，atomic 的初值正好是 0
+        _base = static_cast<uint8_t*>(p);
+        _size = l.totalSize;
+        _name = name;
+        _header = reinterpret_cast<SegmentHeader*>(_base);
+        _header->version = VERSION;
+        _header->maxMetrics = maxMetrics;
+        _header->maxThreads = maxThreads;
+        _header->rowStride = l.rowStride;
+        _header->descOffset = l.descOffset;
+        _header->globalOffset = l.globalOffset;
+        _header->rowsOffset = l.rowsOffset;
+        _header->totalSize = l.totalSize;
+        _header->pid = ::getpid();
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(_header->magic, MAGIC, sizeof(MAGIC));     // 最后写 magic，读者看到 magic 就说明段头完整
+    }
+
+    //删除段的名字
+    void close(){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_base || _unlinked) return;
+        ::shm_unlink(_name.c_str());
+        _unlinked = true;
+    }
+
+    Counter counter(const std::string& name, const std::string& help){
+        return Counter(registerMetric(name, help, MetricType::COUNTER));
+    }
+
+    Gauge gauge(const std::string& name, const std::string& help){
+        uint32_t id = registerMetric(name, help, MetricType::GAUGE);
+        return Gauge(reinterpret_cast<std::atomic<int64_t>*>(_base + _header->globalOffset) + id);
+    }
+
+    std::vector<Sample> snapshot() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_base) return {};
+        return collect(_base);
+    }
+
+    void dumpPrometheus(std::ostream& os) const {writePrometheus(os, snapshot());}
+
+    const std::string& name() const {return _name;}
+
+    //线程第一次 inc() 时领一行（慢路径）
+    std::atomic<uint64_t>* attachThread(){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_base) throw std::logic_error("metrics registry not open");
+        uint32_t index;
+        if(!_freeRows.empty()){
+            index = _freeRows.back();
+            _freeRows.pop_back();
+        }
+        else{
+            uint32_t used = _header->rowsUsed.load(std::memory_order_relaxed);
+            //行用完以后多出来的线程共用最后一行（fetch_add 本来就允许多写者，只是会争用）
+            index = std::min(used, _header->maxThreads - 1);
+            if(used < _header->maxThreads)
+                _header->rowsUsed.store(used + 1, std::memory_order_release);
+        }
+        t_row = reinterpret_cast<std::atomic<uint64_t>*>(_base + _header->rowsOffset + uint64_t(index) * _header->rowStride);
+        rowGuard().index = index;                   // 第一次访问时登记析构，线程退出时还行
+        return t_row;
+    }
+
+private:
+    //线程退出：行号还回去，计数值留在行里
+    struct RowGuard {
+        uint32_t index = UINT32_MAX;
+        ~RowGuard(){
+            if(index != UINT32_MAX) Registry::instance().releaseRow(index);
+            t_row = nullptr;
+        }
+    };
+
+    Registry() = default;
+
+    static RowGuard& rowGuard(){
+        thread_local RowGuard g;
+        return g;
+    }
+
+    uint32_t registerMetric(const std::string& name, const std::string& help, MetricType type){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_base) throw std::logic_error("metrics registry not open");
+        if(name.empty() || name.size() >= NAME_LEN)
+            throw std::invalid_argument("bad metric name: " + name);
+
+        auto* desc = reinterpret_cast<MetricDesc*>(_base + _header->descOffset);
+        uint32_t n = _header->metricCount.load(std::memory_order_relaxed);
+        for(uint32_t i = 0; i < n; i++){
+            if(name == desc[i].name){               // 同名重复注册返回同一个编号
+                if(desc[i].type != type)
+                    throw std::invalid_argument("metric " + name + " registered with another type");
+                return i;
+            }
+        }
+        if(n >= _header->maxMetrics)
+            throw std::length_error("metrics registry full");
+
+        std::strncpy(desc[n].name, name.c_str(), NAME_LEN - 1);
+        std::strncpy(desc[n].help, help.c_str(), HELP_LEN - 1);
+        desc[n].type = type;
+        _header->metricCount.store(n + 1, std::memory_order_release);
+        return n;
+    }
+
+    void releaseRow(uint32_t index){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_base && index < _header->maxThreads - 1)   // 共用的最后一行不回收
+            _freeRows.push_back(index);
+    }
+
+    mutable std::mutex _mutex;
+    uint8_t* _base = nullptr;
+    size_t _size = 0;
+    SegmentHeader* _header = nullptr;
+    std::string _name;
+    std::vector<uint32_t> _freeRows;
+    bool _unlinked = false;
+};
+
+inline void Counter::inc(uint64_t n) const {
+    std::atomic<uint64_t>* row = t_row;
+    if(__builtin_expect(row == nullptr, 0))
+        row = Registry::instance().attachThread();
+    row[_id].fetch_add(n, std::memory_order_relaxed);
+}
+
+inline void Gauge::set(int64_t v) const {
+    _slot->store(v, std::memory_order_relaxed);
+}
+
+inline void Gauge::add(int64_t d) const {
+    _slot->fetch_add(d, std::memory_order_relaxed);
+}
+
+/*
+外部读者：只读映射别的进程的指标段
+*/
+class Reader {
+public:
+    explicit Reader(const std::string& name){
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0)
+            throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        struct stat st;
+        if(::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentHeader)){
+            ::close(fd);
+            throw std::runtime_error("metrics segment " + name + " too small");
+        }
+        _size = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap " + name);
+        _base = static_cast<const uint8_t*>(p);
+
+        auto* h = reinterpret_cast<const SegmentHeader*>(_base);
+        if(std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION || h->totalSize != _size){
+            ::munmap(const_cast<uint8_t*>(_base), _size);
+            throw std::runtime_error("metrics segment " + name + " has wrong magic/version/size");
+        }
+    }
+
+    ~Reader(){
+        ::munmap(const_cast<uint8_t*>(_base), _size);
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator = (const Reader&) = delete;
+
+    int64_t pid() const {return reinterpret_cast<const SegmentHeader*>(_base)->pid;}
+    std::vector<Sample> snapshot() const {return collect(_base);}
+
+private:
+    const uint8_t* _base = nullptr;
+    size_t _size = 0;
+};
+
+}   // namespace nmetrics
+
+// ---------------- 挂上指标的流水线 ----------------
+
+struct ParserMetrics {
+    nmetrics::Counter bytesIn;
+    nmetrics::Counter framesOk;
+    nmetrics::Counter checksumFail;
+    nmetrics::Counter lengthError;
+    nmetrics::Counter timeoutReset;
+
+    static ParserMetrics& get(){
+        static ParserMetrics m{
+            nmetrics::Registry::instance().counter("uart_bytes_in_total", "Bytes fed into SimpleUartParser"),
+            nmetrics::Registry::instance().counter("uart_frames_ok_total", "Frames with a valid checksum"),
+            nmetrics::Registry::instance().counter("uart_checksum_fail_total", "Frames dropped on checksum mismatch"),
+            nmetrics::Registry::instance().counter("uart_length_error_total", "Length byte above MAX_LENGTH"),
+            nmetrics::Registry::instance().counter("uart_timeout_reset_total", "Parser resets caused by inter-byte timeout"),
+        };
+        return m;
+    }
+};
+
+//帧解析器（沿用 night20），每个出错分支计数
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us), metrics(ParserMetrics::get()){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            if(state != 0) metrics.timeoutReset.inc();
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    metrics.lengthError.inc();
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    metrics.framesOk.inc();
+                    return true;
+                }
+                else{
+                    metrics.checksumFail.inc();
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，字节数只计一次
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        metrics.bytesIn.inc(n);
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+    ParserMetrics& metrics;
+};
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// ---------------- 学生状态机（night18 的转移表），统计转移和错误转移 ----------------
+
+enum class State : uint8_t {GETUP = 0, GO_SCHOOL, EAT, DO_HOMEWORK, GO_SLEEP, TIMEOUT, ERROR, COUNT};
+enum class Events : uint8_t {EVENT1 = 0, EVENT2, EVENT3, EVENT_TIMEOUT, COUNT};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+struct Transition {
+    State curState;
+    Events event;
+    State nextState;
+};
+
+constexpr Transition kStudentTable[] = {
+    {State::GETUP,       Events::EVENT1, State::GO_SCHOOL},
+    {State::GO_SCHOOL,   Events::EVENT2, State::EAT},
+    {State::EAT,         Events::EVENT3, State::DO_HOMEWORK},
+    {State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP},
+    {State::GO_SLEEP,    Events::EVENT2, State::GETUP},
+    {State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::TIMEOUT, Events::EVENT1, State::GETUP},
+    {State::TIMEOUT, Events::EVENT3, State::ERROR},
+    {State::ERROR,   Events::EVENT1, State::GETUP},
+};
+
+template <size_t N>
+constexpr std::array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    std::array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+constexpr auto kJump = buildJumpTable(kStudentTable);
+
+class StudentFSM {
+public:
+    StudentFSM()
+        : _transitions(nmetrics::Registry::instance().counter("fsm_transitions_total", "FSM transitions taken")),
+          _errors(nmetrics::Registry::instance().counter("fsm_error_transitions_total", "Events with no transition (FSM forced to ERROR)")),
+          _state(nmetrics::Registry::instance().gauge("fsm_state", "Current FSM state number")) {}
+
+    void handleEvent(Events e){
+        uint8_t i = kJump[static_cast<size_t>(_cur) * EVENT_COUNT + static_cast<size_t>(e)];
+        if(i == NO_TRANSITION){
+            _errors.inc();
+            _cur = State::ERROR;
+        }
+        else{
+            _transitions.inc();
+            _cur = kStudentTable[i].nextState;
+        }
+        _state.set(static_cast<int64_t>(_cur));
+    }
+
+private:
+    nmetrics::Counter _transitions;
+    nmetrics::Counter _errors;
+    nmetrics::Gauge _state;
+    State _cur = State::GETUP;
+};
+
+/*
+StreamProcessor（night11），改成按块入队，队列深度用 gauge 暴露
+*/
+class StreamProcessor{
+public:
+    StreamProcessor(SimpleUartParser& parser, StudentFSM& fsm)
+        : uartParser(parser), fsm(fsm),
+          queueDepth(nmetrics::Registry::instance().gauge("stream_queue_depth", "Bytes waiting in StreamProcessor queue")),
+          bytesQueued(nmetrics::Registry::instance().counter("stream_bytes_queued_total", "Bytes pushed into StreamProcessor")),
+          stop(false) {}
+
+    void start(){
+        processingThread = std::thread(&StreamProcessor::processStream,this);
+    }
+
+    void stopProcessing(){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        if(processingThread.joinable()){
+            processingThread.join();
+        }
+    }
+
+    void pushData(const uint8_t* p, size_t n){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for(size_t i = 0; i < n; i++) dataQueue.push(p[i]);
+            queueDepth.set(static_cast<int64_t>(dataQueue.size()));
+        }
+        bytesQueued.inc(n);
+        cv.notify_one();
+    }
+
+private:
+    void processStream(){
+        uint8_t chunk[256];
+        for(;;){
+            size_t n = 0;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock,[this] {return !dataQueue.empty() || stop;});
+                if(stop && dataQueue.empty()) break;
+                while(n < sizeof(chunk) && !dataQueue.empty()){
+                    chunk[n++] = dataQueue.front();
+                    dataQueue.pop();
+                }
+                queueDepth.set(static_cast<int64_t>(dataQueue.size()));
+            }
+            uartParser.feed(chunk, n, now_ms(), [&](const uint8_t* d, uint8_t){
+                fsm.handleEvent(static_cast<Events>(d[0] % EVENT_COUNT));
+            });
+        }
+    }
+
+    SimpleUartParser& uartParser;
+    StudentFSM& fsm;
+    nmetrics::Gauge queueDepth;
+    nmetrics::Counter bytesQueued;
+    std::queue<uint8_t> dataQueue;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread processingThread;
+    bool stop;
+};
+
+//构造一帧：AA 55 len payload crc
+std::vector<uint8_t> makeFrame(const std::vector<uint8_t>& payload){
+    std::vector<uint8_t> f{0xAA, 0x55, static_cast<uint8_t>(payload.size())};
+    uint8_t crc = static_cast<uint8_t>(payload.size());
+    for(uint8_t b : payload){
+        f.push_back(b);
+        crc += b;
+    }
+    f.push_back(crc);
+    return f;
+}
+
+//外部读取工具：nightly_26 read <segment> [次数] [间隔ms]
+static int readMain(const std::string& name, int times, int intervalMs){
+    nmetrics::Reader reader(name);
+    for(int i = 0; i < times; i++){
+        std::cout << "# --- snapshot " << i << " of pid " << reader.pid() << " ---\n";
+        nmetrics::writePrometheus(std::cout, reader.snapshot());
+        std::cout.flush();
+        if(i + 1 < times) std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+    return 0;
+}
+
+//热路径开销：每线程行 vs 所有线程共用一个原子变量
+static void benchIncrement(){
+    constexpr uint64_t N = 20000000;
+    nmetrics::Counter c = nmetrics::Registry::instance().counter("bench_increments_total", "Benchmark increments");
+    alignas(64) static std::atomic<uint64_t> shared{0};
+    unsigned threads = std::max(2u, std::min(4u, std::thread::hardware_concurrency()));
+
+    auto run = [&](auto&& body){
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> ts;
+        for(unsigned t = 0; t < threads; t++)
+            ts.emplace_back([&]{ for(uint64_t i = 0; i < N; i++) body(); });
+        for(auto& t : ts) t.join();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (N * threads);
+    };
+    double perThread = run([&]{ c.inc(); });
+    double contended = run([&]{ shared.fetch_add(1, std::memory_order_relaxed); });
+
+    uint64_t total = 0;
+    for(auto& s : nmetrics::Registry::instance().snapshot())
+        if(s.name == "bench_increments_total") total = static_cast<uint64_t>(s.value);
+    std::cout << std::fixed << std::setprecision(2)
+              << threads << " threads (" << std::thread::hardware_concurrency() << " cpus) x " << N << " increments: per-thread rows " << perThread
+              << " ns/inc (sum=" << total << "), one shared atomic " << contended << " ns/inc\n";
+}
+
+int main(int argc, char* argv[]){
+    try{
+        if(argc >= 3 && std::string(argv[1]) == "read")
+            return readMain(argv[2], argc > 3 ? std::atoi(argv[3]) : 1, argc > 4 ? std::atoi(argv[4]) : 200);
+
+        std::string segment = "/nightly26_metrics_" + std::to_string(::getpid());
+        nmetrics::Registry::instance().open(segment);
+        std::cout << "metrics segment /dev/shm" << segment << "\n";
+
+        SimpleUartParser parser(1000);
+        StudentFSM fsm;
+        StreamProcessor processor(parser, fsm);
+        processor.start();
+
+        //两个生产者：正常帧 + 噪声 + 坏校验 + 超长长度字节
+        std::atomic<bool> running{true};
+        std::vector<std::thread> producers;
+        for(int t = 0; t < 2; t++){
+            producers.emplace_back([&, t]{
+                std::mt19937 rng(static_cast<uint32_t>(t + 1));
+                std::vector<uint8_t> buf;
+                while(running.load(std::memory_order_relaxed)){
+                    buf.clear();
+                    for(int k = 0; k < 64; k++){
+                        std::vector<uint8_t> payload(1 + rng() % 16);
+                        for(auto& b : payload) b = static_cast<uint8_t>(rng());
+                        auto f = makeFrame(payload);
+                        uint32_t r = rng() % 100;
+                        if(r < 3) f.back() ^= 0x01;                 // 坏校验
+                        else if(r < 5) f[2] = 0xF0;                 // 超长长度
+                        buf.insert(buf.end(), f.begin(), f.end());
+                        if(r >= 95) buf.push_back(static_cast<uint8_t>(rng()));   // 噪声
+                    }
+                    processor.pushData(buf.data(), buf.size());
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            });
+        }
+
+        //运行中拉起一个外部进程读取（不暂停本进程）
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        std::string self = "/proc/self/exe";
+        char* args[] = {argv[0], const_cast<char*>("read"), const_cast<char*>(segment.c_str()),
+                        const_cast<char*>("2"), const_cast<char*>("300"), nullptr};
+        pid_t child;
+        std::cout.flush();
+        int rc = ::posix_spawn(&child, self.c_str(), nullptr, nullptr, args, environ);
+        if(rc != 0)
+            throw std::system_error(rc, std::generic_category(), "posix_spawn reader");
+        int status = 0;
+        ::waitpid(child, &status, 0);
+
+        running = false;
+        for(auto& t : producers) t.join();
+        processor.stopProcessing();
+
+        std::cout << "\n# --- final in-process dump ---\n";
+        nmetrics::Registry::instance().dumpPrometheus(std::cout);
+
+        std::cout << "\n";
+        benchIncrement();
+        nmetrics::Registry::instance().close();
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
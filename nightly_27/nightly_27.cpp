@@ -0,0 +1,841 @@
+/*
+分级流水线：读块 → 解析 → 解码 → 状态机，级间有界队列 + 反压
+
+问题：
+环形缓冲（night9）、流式解析（night10/11）、二进制帧解码（night6）、状态机（night5/8）一直是分开的演示
+night24/26 的流水线是写死的三个线程，想把两级合到一个线程里、或者拆开，都得改代码
+而且下游慢了以后上游怎么办也没有定义：night11 的 std::queue 会一直长下去
+
+night27 的做法：
+1. 每一级是一个 Stage<In, Out>，只管处理一个输入、往 _next 里 emit 输出；_next 是一个 Sink<Out>
+   - 融合：_next 直接指向下一级，emit 就是一次函数调用，同一个线程跑完
+   - 拆开：_next 指向 QueueLink<Out>，里面是有界队列（night15/24 的 Vyukov 队列）+ 一个工作线程，工作线程把数据交给下一级
+2. 级到线程的映射用一个字符串配置："RPDF" 全融合、"R|P|D|F" 每级一个线程、"R|PDF" 只把读拆出去……
+   '|' 的位置就是放队列的位置
+3. 反压：队列满了 QueueLink::push 就等（空转 → yield → sleep），上游线程停住，它自己的输入队列跟着满，
+   一直传到读线程，读线程不再读（真串口时数据留在内核缓冲里），内存始终有上界
+4. 结束：读完以后 finish() 顺着链往下传；QueueLink 收到 finish 先把队列排空再往下传，保证不丢尾巴
+5. 统计：每级 in/out/dropped（吞吐 = in / 墙钟时间）；每个队列的平均/最大占用、满了等待的次数和时间
+   哪个队列的生产者总在等，瓶颈就在它的下游
+6. main：同一份抓包数据分别用几种映射跑，先核对结果和全融合完全一致，再比较吞吐；最后用一个慢状态机演示反压
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <exception>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// ---------------- 有界队列（night24，移动语义版） ----------------
+
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _mask(roundUp(capacity) - 1), _cells(new Cell[_mask + 1]) {
+        for (size_t i = 0; i <= _mask; i++)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        _enqueuePos.store(0, std::memory_order_relaxed);
+        _dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    bool push(T&& data) {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 满（data 没有被移走）
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(data);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& data) {
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 空
+            } else {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        data = std::move(cell->data);
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const {return _mask + 1;}
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t v = 2;
+        while (v < n) v <<= 1;
+        return v;
+    }
+
+    const size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    alignas(64) std::atomic<size_t> _enqueuePos;    // 生产者和消费者的位置分开放，避免伪共享
+    alignas(64) std::atomic<size_t> _dequeuePos;
+};
+
+//单写者计数：只有所属线程写，其他线程只读（night21）
+static void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static uint64_t nowNs(){
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//等待策略：先空转，再让出 CPU，最后睡眠（单核机器上空转没有意义，很快就退到 yield）
+struct Backoff {
+    uint32_t n = 0;
+    void wait(){
+        if(n < 32){
+            n++;
+        }
+        else if(n < 32 + 256){
+            n++;
+            std::this_thread::yield();
+        }
+        else{
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+};
+
+// ---------------- 流水线框架 ----------------
+
+//下一级的入口：融合时是下一级本身，拆开时是 QueueLink
+template <typename T>
+class Sink {
+public:
+    virtual ~Sink() = default;
+    virtual void push(T&& v) = 0;
+    virtual void finish() = 0;                      // 上游不会再有数据了
+};
+
+struct StageStats {
+    const char* name = "";
+    std::atomic<uint64_t> in{0};
+    std::atomic<uint64_t> out{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+template <typename In, typename Out>
+class Stage : public Sink<In> {
+public:
+    explicit Stage(const char* name){_stats.name = name;}
+
+    void connect(Sink<Out>* next){_next = next;}
+    void finish() override {_next->finish();}
+    const StageStats& stats() const {return _stats;}
+
+protected:
+    void emit(Out&& v){
+        bump(_stats.out);
+        _next->push(std::move(v));
+    }
+
+    StageStats _stats;
+    Sink<Out>* _next = nullptr;
+};
+
+//出错时通知所有线程停下，第一个异常留给 run() 重新抛出
+class PipelineControl {
+public:
+    bool aborted() const {return _aborted.load(std::memory_order_relaxed);}
+
+    void fail(std::exception_ptr e){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_error) _error = e;
+        _aborted.store(true, std::memory_order_relaxed);
+    }
+
+    void rethrow(){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_error) std::rethrow_exception(_error);
+    }
+
+private:
+    std::atomic<bool> _aborted{false};
+    std::mutex _mutex;
+    std::exception_ptr _error;
+};
+
+struct LinkStats {
+    const char* name = "";
+    size_t capacity = 0;
+    std::atomic<uint64_t> pushed{0};                // 生产者写
+    std::atomic<uint64_t> popped{0};                // 消费者写
+    std::atomic<uint64_t> occupancySum{0};          // 每次 push 时的占用累加，算平均
+    std::atomic<uint64_t> occupancyMax{0};
+    std::atomic<uint64_t> fullStalls{0};            // push 时队列满的次数（反压）
+    std::atomic<uint64_t> stallNs{0};               // 生产者被反压卡住的总时间
+    std::atomic<uint64_t> emptyWaits{0};            // 消费者等数据的次数
+};
+
+/*
+级间队列：生产者线程调 push，自带的工作线程 pop 出来交给下一级
+*/
+template <typename T>
+class QueueLink : public Sink<T> {
+public:
+    QueueLink(const char* name, size_t capacity, Sink<T>* down, PipelineControl& ctl)
+        : _queue(capacity), _down(down), _ctl(ctl) {
+        _stats.name = name;
+        _stats.capacity = _queue.capacity();
+    }
+
+    ~QueueLink(){
+        if(_worker.joinable()) _worker.join();
+    }
+
+    QueueLink(const QueueLink&) = delete;
+    QueueLink& operator = (const QueueLink&) = delete;
+
+    void start(){
+        _worker = std::thread(&QueueLink::run, this);
+    }
+
+    void join(){
+        if(_worker.joinable()) _worker.join();
+    }
+
+    void push(T&& v) override {
+        uint64_t pushed = _stats.pushed.load(std::memory_order_relaxed);
+        uint64_t occ = pushed - _stats.popped.load(std::memory_order_relaxed);
+        bump(_stats.occupancySum, occ);
+        if(occ > _stats.occupancyMax.load(std::memory_order_relaxed))
+            _stats.occupancyMax.store(occ, std::memory_order_relaxed);
+
+        if(!_queue.push(std::move(v))){
+            //满了：等下游腾地方，这就是反压
+            uint64_t t0 = nowNs();
+            Backoff backoff;
+            while(!_queue.push(std::move(v))){
+                if(_ctl.aborted()) return;
+                backoff.wait();
+            }
+            bump(_stats.fullStalls);
+            bump(_stats.stallNs, nowNs() - t0);
+        }
+        _stats.pushed.store(pushed + 1, std::memory_order_relaxed);
+    }
+
+    void finish() override {
+        _closed.store(true, std::memory_order_release);
+    }
+
+    const LinkStats& stats() const {return _stats;}
+
+private:
+    void run(){
+        try{
+            T v;
+            Backoff backoff;
+            while(!_ctl.aborted()){
+                if(_queue.pop(v)){
+                    bump(_stats.popped);
+                    _down->push(std::move(v));
+                    backoff = Backoff{};
+                    continue;
+                }
+                //先看关闭标志再 pop 一次：finish 之前 push 的数据一定能取到
+                if(_closed.load(std::memory_order_acquire)){
+                    if(_queue.pop(v)){
+                        bump(_stats.popped);
+                        _down->push(std::move(v));
+                        continue;
+                    }
+                    _down->finish();
+                    return;
+                }
+                bump(_stats.emptyWaits);
+                backoff.wait();
+            }
+        }
+        catch(...){
+            _ctl.fail(std::current_exception());
+        }
+    }
+
+    BoundedQueue<T> _queue;
+    Sink<T>* _down;
+    PipelineControl& _ctl;
+    std::atomic<bool> _closed{false};
+    LinkStats _stats;
+    std::thread _worker;
+};
+
+// ---------------- 各级的数据和处理 ----------------
+
+constexpr size_t CHUNK_MAX = 256;
+
+//读线程一次 read 到的数据块
+struct Chunk {
+    uint32_t t = 0;                                 // 读到的时间（ms），解析器超时用
+    uint16_t len = 0;
+    uint8_t data[CHUNK_MAX];
+};
+
+//解析出的一帧（AA 55 len payload crc 里的 payload）
+struct RawFrame {
+    uint8_t len = 0;
+    uint8_t data[32];
+};
+
+//解码后的传感器帧（night6 的 22 字节格式）
+struct Sample {
+    uint8_t type = 0;
+    uint16_t len = 0;
+    uint32_t seq = 0;
+    uint32_t pressure = 0;
+    int16_t temp_x100 = 0;
+    uint16_t voltage = 0;
+    int32_t yaw_x10 = 0;
+};
+
+//帧解析器（沿用 night20）
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+class ParserStage : public Stage<Chunk, RawFrame> {
+public:
+    explicit ParserStage(uint32_t timeoutMs) : Stage("parser"), _parser(timeoutMs) {}
+
+    void push(Chunk&& c) override {
+        bump(_stats.in);
+        _parser.feed(c.data, c.len, c.t, [this](const uint8_t* p, uint8_t n){
+            RawFrame f;
+            f.len = n;
+            std::memcpy(f.data, p, n);
+            emit(std::move(f));
+        });
+    }
+
+private:
+    SimpleUartParser _parser;
+};
+
+//le:小端序  be：大端序（night6）
+static uint16_t le16(const uint8_t* p){
+    return uint16_t(p[0]) | (uint16_t(p[1]) << 8);
+}
+
+static uint32_t le32(const uint8_t* p){
+    return uint32_t(p[0]) |
+    (uint32_t(p[1]) << 8) |
+    (uint32_t(p[2]) << 16) |
+    (uint32_t(p[3]) << 24);
+}
+
+static uint16_t be16(const uint8_t* p){
+    return uint16_t(p[0] << 8) | (uint16_t(p[1]));
+}
+
+static uint32_t be32(const uint8_t* p){
+    return (uint32_t(p[0]) << 24) |
+    (uint32_t(p[1]) << 16) |
+    (uint32_t(p[2]) << 8) |
+    (uint32_t(p[3]));
+}
+
+constexpr size_t SENSOR_FRAME_LEN = 22;
+
+//按 night6 的偏移解码；magic/tail/长度不对的帧丢掉
+class DecoderStage : public Stage<RawFrame, Sample> {
+public:
+    DecoderStage() : Stage("decoder") {}
+
+    void push(RawFrame&& f) override {
+        bump(_stats.in);
+        const uint8_t* p = f.data;
+        if(f.len != SENSOR_FRAME_LEN || p[0] != 0xAA || p[1] != 0x55 || p[21] != 0x0D){
+            bump(_stats.dropped);
+            return;
+        }
+        Sample s;
+        s.type = p[2];
+        s.len = le16(&p[3]);
+        s.seq = le32(&p[5]);
+        s.pressure = be32(&p[9]);
+        s.temp_x100 = static_cast<int16_t>(be16(&p[13]));
+        s.voltage = le16(&p[15]);
+        s.yaw_x10 = static_cast<int32_t>(be32(&p[17]));
+        emit(std::move(s));
+    }
+};
+
+// ---------------- 学生状态机（night18 的转移表） ----------------
+
+enum class State : uint8_t {GETUP = 0, GO_SCHOOL, EAT, DO_HOMEWORK, GO_SLEEP, TIMEOUT, ERROR, COUNT};
+enum class Events : uint8_t {EVENT1 = 0, EVENT2, EVENT3, EVENT_TIMEOUT, COUNT};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+struct Transition {
+    State curState;
+    Events event;
+    State nextState;
+};
+
+constexpr Transition kStudentTable[] = {
+    {State::GETUP,       Events::EVENT1, State::GO_SCHOOL},
+    {State::GO_SCHOOL,   Events::EVENT2, State::EAT},
+    {State::EAT,         Events::EVENT3, State::DO_HOMEWORK},
+    {State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP},
+    {State::GO_SLEEP,    Events::EVENT2, State::GETUP},
+    {State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::TIMEOUT, Events::EVENT1, State::GETUP},
+    {State::TIMEOUT, Events::EVENT3, State::ERROR},
+    {State::ERROR,   Events::EVENT1, State::GETUP},
+};
+
+template <size_t N>
+constexpr std::array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    std::array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+constexpr auto kJump = buildJumpTable(kStudentTable);
+
+//状态机的运行结果，用来核对不同映射的输出完全一致
+struct FsmResult {
+    uint64_t events = 0;
+    uint64_t transitions = 0;
+    uint64_t errors = 0;
+    uint64_t seqHash = 0;                           // 按到达顺序滚动的哈希，顺序错了也对不上
+    State finalState = State::GETUP;
+
+    bool operator == (const FsmResult& o) const {
+        return events == o.events && transitions == o.transitions && errors == o.errors &&
+               seqHash == o.seqHash && finalState == o.finalState;
+    }
+};
+
+//最后一级：type 低两位当事件喂状态机；workNs 模拟一个慢的下游
+class FsmStage : public Sink<Sample> {
+public:
+    explicit FsmStage(uint32_t workNs) : _workNs(workNs) {_stats.name = "fsm";}
+
+    void push(Sample&& s) override {
+        bump(_stats.in);
+        Events e = static_cast<Events>(s.type & 0x03);
+        uint8_t i = kJump[static_cast<size_t>(_cur) * EVENT_COUNT + static_cast<size_t>(e)];
+        if(i == NO_TRANSITION){
+            _result.errors++;
+            _cur = State::ERROR;
+        }
+        else{
+            _result.transitions++;
+            _cur = kStudentTable[i].nextState;
+        }
+        _result.events++;
+        _result.seqHash = _result.seqHash * 1000003 + s.seq;
+        if(_workNs){
+            uint64_t until = nowNs() + _workNs;
+            while(nowNs() < until) {}
+        }
+    }
+
+    void finish() override {
+        _result.finalState = _cur;
+    }
+
+    const StageStats& stats() const {return _stats;}
+    const FsmResult& result() const {return _result;}
+
+private:
+    uint32_t _workNs;
+    StageStats _stats;
+    State _cur = State::GETUP;
+    FsmResult _result;
+};
+
+// ---------------- 流水线：按配置把各级接起来 ----------------
+
+struct PipelineConfig {
+    std::string layout = "RPDF";                    // R=读 P=解析 D=解码 F=状态机，'|' 处放队列
+    size_t queueCapacity = 1024;
+    size_t chunkSize = 128;
+    uint32_t parserTimeoutMs = 50;
+    uint32_t fsmWorkNs = 0;
+};
+
+struct PipelineReport {
+    std::string layout;
+    unsigned threads = 0;
+    double seconds = 0;
+    uint64_t bytes = 0;
+    std::vector<std::array<uint64_t, 3>> stages;    // in/out/dropped
+    std::vector<const char*> stageNames;
+    struct Link {
+        const char* name;
+        size_t capacity;
+        uint64_t pushed, occMax, fullStalls, stallNs, emptyWaits;
+        double occAvg;
+    };
+    std::vector<Link> links;
+    FsmResult result;
+};
+
+class Pipeline {
+public:
+    explicit Pipeline(const PipelineConfig& cfg)
+        : _cfg(cfg), _parser(cfg.parserTimeoutMs), _fsm(cfg.fsmWorkNs) {
+        if(cfg.chunkSize == 0 || cfg.chunkSize > CHUNK_MAX)
+            throw std::invalid_argument("chunkSize must be 1.." + std::to_string(CHUNK_MAX));
+        _cuts = parseLayout(cfg.layout);
+
+        //从后往前接：先有下游，才能把上游的 _next 指过去
+        Sink<Sample>* toFsm = &_fsm;
+        if(_cuts[2]){
+            _decodeToFsm.reset(new QueueLink<Sample>("decoder->fsm", cfg.queueCapacity, &_fsm, _ctl));
+            toFsm = _decodeToFsm.get();
+        }
+        _decoder.connect(toFsm);
+
+        Sink<RawFrame>* toDecoder = &_decoder;
+        if(_cuts[1]){
+            _parseToDecode.reset(new QueueLink<RawFrame>("parser->decoder", cfg.queueCapacity, &_decoder, _ctl));
+            toDecoder = _parseToDecode.get();
+        }
+        _parser.connect(toDecoder);
+
+        _head = &_parser;
+        if(_cuts[0]){
+            _readToParse.reset(new QueueLink<Chunk>("reader->parser", cfg.queueCapacity, &_parser, _ctl));
+            _head = _readToParse.get();
+        }
+    }
+
+    //读线程就是调用 run() 的线程；capture 模拟一路串口的输入
+    PipelineReport run(const std::vector<uint8_t>& capture){
+        if(_ran) throw std::logic_error("pipeline can only run once");
+        _ran = true;
+
+        StageStats reader;
+        reader.name = "reader";
+
+        if(_readToParse) _readToParse->start();
+        if(_parseToDecode) _parseToDecode->start();
+        if(_decodeToFsm) _decodeToFsm->start();
+
+        uint64_t t0 = nowNs();
+        try{
+            for(size_t off = 0; off < capture.size() && !_ctl.aborted(); off += _cfg.chunkSize){
+                Chunk c;
+                c.len = static_cast<uint16_t>(std::min(_cfg.chunkSize, capture.size() - off));
+                std::memcpy(c.data, capture.data() + off, c.len);
+                c.t = now_ms();
+                bump(reader.in, c.len);
+                bump(reader.out);
+                _head->push(std::move(c));
+            }
+            _head->finish();
+        }
+        catch(...){
+            _ctl.fail(std::current_exception());
+        }
+        if(_readToParse) _readToParse->join();
+        if(_parseToDecode) _parseToDecode->join();
+        if(_decodeToFsm) _decodeToFsm->join();
+        uint64_t t1 = nowNs();
+        _ctl.rethrow();
+
+        PipelineReport r;
+        r.layout = _cfg.layout;
+        r.threads = 1 + unsigned(_cuts[0]) + unsigned(_cuts[1]) + unsigned(_cuts[2]);
+        r.seconds = (t1 - t0) / 1e9;
+        r.bytes = capture.size();
+        for(const StageStats* s : {static_cast<const StageStats*>(&reader), &_parser.stats(), &_decoder.stats(), &_fsm.stats()}){
+            r.stageNames.push_back(s->name);
+            r.stages.push_back({s->in.load(), s->out.load(), s->dropped.load()});
+        }
+        auto addLink = [&](const LinkStats& s){
+            uint64_t pushed = s.pushed.load();
+            r.links.push_back({s.name, s.capacity, pushed, s.occupancyMax.load(), s.fullStalls.load(),
+                               s.stallNs.load(), s.emptyWaits.load(),
+                               pushed ? double(s.occupancySum.load()) / pushed : 0.0});
+        };
+        if(_readToParse) addLink(_readToParse->stats());
+        if(_parseToDecode) addLink(_parseToDecode->stats());
+        if(_decodeToFsm) addLink(_decodeToFsm->stats());
+        r.result = _fsm.result();
+        return r;
+    }
+
+private:
+    //"R|PD|F" → {true, false, true}：第 i 个元素表示第 i 级和第 i+1 级之间放不放队列
+    static std::array<bool, 3> parseLayout(const std::string& layout){
+        static const char kStages[] = "RPDF";
+        std::array<bool, 3> cuts{};
+        size_t stage = 0;
+        bool pendingCut = false;
+        for(char ch : layout){
+            if(ch == '|'){
+                if(stage == 0 || pendingCut)
+                    throw std::invalid_argument("bad pipeline layout: " + layout);
+                pendingCut = true;
+                continue;
+            }
+            if(stage >= 4 || ch != kStages[stage])
+                throw std::invalid_argument("bad pipeline layout (expected stages R,P,D,F in order): " + layout);
+            if(stage > 0) cuts[stage - 1] = pendingCut;
+            pendingCut = false;
+            stage++;
+        }
+        if(stage != 4 || pendingCut)
+            throw std::invalid_argument("bad pipeline layout (expected stages R,P,D,F in order): " + layout);
+        return cuts;
+    }
+
+    PipelineConfig _cfg;
+    std::array<bool, 3> _cuts{};
+    PipelineControl _ctl;
+    ParserStage _parser;
+    DecoderStage _decoder;
+    FsmStage _fsm;
+    std::unique_ptr<QueueLink<Chunk>> _readToParse;
+    std::unique_ptr<QueueLink<RawFrame>> _parseToDecode;
+    std::unique_ptr<QueueLink<Sample>> _decodeToFsm;
+    Sink<Chunk>* _head = nullptr;
+    bool _ran = false;
+};
+
+// ---------------- 测试数据和输出 ----------------
+
+//生成一段抓包：AA 55 len [night6 传感器帧] crc，夹杂少量噪声和校验错
+std::vector<uint8_t> makeCapture(size_t bytes, uint32_t seed){
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> out;
+    out.reserve(bytes + 64);
+    uint32_t seq = 0;
+    while(out.size() < bytes){
+        if(rng() % 100 == 0){                       // 1%：一小段噪声
+            size_t n = 1 + rng() % 8;
+            for(size_t i = 0; i < n; i++) out.push_back(static_cast<uint8_t>(rng()));
+        }
+        uint8_t p[SENSOR_FRAME_LEN] = {
+            0xAA, 0x55, static_cast<uint8_t>(0x10 | (rng() & 0x03)), 0x07, 0x00,
+            uint8_t(seq), uint8_t(seq >> 8), uint8_t(seq >> 16), uint8_t(seq >> 24),
+            0x00, 0x01, 0x8B, 0xCD, 0x09, 0xE6, 0x82, 0x2D, 0xFF, 0xFF, 0xFF, 0x85, 0x0D};
+        seq++;
+        out.push_back(0xAA);
+        out.push_back(0x55);
+        out.push_back(static_cast<uint8_t>(SENSOR_FRAME_LEN));
+        uint8_t crc = static_cast<uint8_t>(SENSOR_FRAME_LEN);
+        for(uint8_t b : p){
+            out.push_back(b);
+            crc += b;
+        }
+        if(rng() % 100 == 0) crc ^= 0x5A;           // 1%：校验错
+        out.push_back(crc);
+    }
+    return out;
+}
+
+void printReport(const PipelineReport& r, bool detail){
+    std::cout << std::fixed << std::setprecision(1)
+              << std::left << std::setw(10) << r.layout << std::right
+              << " threads=" << r.threads
+              << "  " << std::setw(7) << r.bytes / r.seconds / 1e6 << " MB/s"
+              << "  " << std::setw(6) << r.result.events / r.seconds / 1e6 << " M events/s"
+              << "  time=" << std::setprecision(3) << r.seconds * 1e3 << " ms\n";
+    if(!detail) return;
+    for(size_t i = 0; i < r.stages.size(); i++){
+        std::cout << "    stage " << std::left << std::setw(16) << r.stageNames[i] << std::right
+                  << " in=" << std::setw(9) << r.stages[i][0]
+                  << " out=" << std::setw(9) << r.stages[i][1]
+                  << " dropped=" << std::setw(6) << r.stages[i][2]
+                  << std::setprecision(2) << "  " << r.stages[i][0] / r.seconds / 1e6 << " M in/s\n";
+    }
+    for(auto& l : r.links){
+        std::cout << "    queue " << std::left << std::setw(16) << l.name << std::right
+                  << " cap=" << l.capacity
+                  << std::setprecision(1) << " occ avg=" << l.occAvg << " max=" << l.occMax
+                  << "  full stalls=" << l.fullStalls
+                  << " (" << std::setprecision(2) << l.stallNs / 1e6 << " ms)"
+                  << "  consumer empty waits=" << l.emptyWaits << "\n";
+    }
+}
+
+int main(int argc, char** argv){
+    try{
+        //可以从命令行试别的映射：nightly_27 "RP|DF" ...
+        std::vector<std::string> layouts = {"RPDF", "R|PDF", "RP|DF", "RPD|F", "R|P|D|F"};
+        if(argc > 1) layouts.assign(argv + 1, argv + argc);
+
+        std::vector<uint8_t> capture = makeCapture(32u << 20, 2027);
+        std::cout << "capture " << capture.size() / 1024 << " KB, "
+                  << std::thread::hardware_concurrency() << " cpus\n";
+
+        //全融合作为基准：其他映射的结果必须和它一模一样
+        PipelineConfig base;
+        base.layout = "RPDF";
+        FsmResult expect = Pipeline(base).run(capture).result;
+        std::cout << "reference: events=" << expect.events << " transitions=" << expect.transitions
+                  << " errors=" << expect.errors << " final state=" << int(expect.finalState) << "\n\n";
+
+        std::cout << "--- fused vs threaded (queue capacity " << base.queueCapacity
+                  << ", chunk " << base.chunkSize << " B) ---\n";
+        for(auto& layout : layouts){
+            PipelineConfig cfg = base;
+            cfg.layout = layout;
+            PipelineReport r = Pipeline(cfg).run(capture);
+            printReport(r, true);
+            if(!(r.result == expect)){
+                std::cout << "    MISMATCH against fused reference\n";
+                return 1;
+            }
+        }
+
+        //慢下游：状态机每个事件 2us，小队列；看反压一路传回读线程
+        std::cout << "\n--- backpressure: slow FSM (2 us/event), queue capacity 64 ---\n";
+        std::vector<uint8_t> small(capture.begin(), capture.begin() + (1u << 20));
+        PipelineConfig slow;
+        slow.layout = "R|P|D|F";
+        slow.queueCapacity = 64;
+        slow.fsmWorkNs = 2000;
+        printReport(Pipeline(slow).run(small), true);
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
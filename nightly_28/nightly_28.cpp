@@ -0,0 +1,509 @@
+/*
+大抓包的并行解析：投机切块 + 合并修正，输出和串行逐字节解析完全一致
+
+问题：
+离线分析几个 GB 的串口抓包时，SimpleUartParser 只能一个字节一个字节地在一个核上扫
+直接把文件切成几块各扫各的不行：块边界可能在帧中间，块开头的解析器状态是不知道的
+
+night28 的做法：
+1. 把输入切成 N 块，每个线程一块，从“空闲状态”（state 0，等 0xAA 0x55）开始投机解析，
+   记下每帧的结束位置和内容，以及块末尾解析器的完整状态（解析器本身可以直接拷贝）
+2. 合并：按顺序把前一块末尾的真实状态带进下一块
+   - 带进来的是空闲状态：投机结果就是真实结果，直接用
+   - 否则（边界切在帧中间，或者前一块末尾刚看到 AA）：从块开头用真实状态和投机状态并排重扫，
+     真实解析器完成的帧收下（跨边界的帧就是这么补回来的），
+     直到两者在同一个位置都回到空闲状态——之后两者的行为完全相同，
+     投机结果里这个位置之前结束的帧（可能是误同步出来的假帧）丢掉，之后的原样保留
+   一帧最多 36 字节，真实解析器很快就会回到空闲，所以重扫通常只有几十个字节
+3. 块末尾真实状态：收敛了就是投机解析的末尾状态，没收敛（块太小）就是重扫出来的状态
+4. 离线解析不用超时（时间戳固定为 0），和串行基准的配置一样
+5. main：生成（或 mmap 一个文件）抓包，串行解析作为基准，1/2/4/8 线程并行解析逐帧比对，再比吞吐
+   nightly_28 [MB]          生成 MB 大小的抓包（默认 64）
+   nightly_28 file <path>   解析一个抓包文件
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//帧解析器（沿用 night20），加一个 idle() 给合并时判断是否收敛
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //空闲：在等帧头，之前的字节对以后的解析没有任何影响
+    bool idle() const {return state == 0;}
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+/*
+解析出的一帧：end 是校验字节在整个输入里的偏移
+帧在输入里是连续的，载荷就是 [end - len, end)，所以只记位置不拷内容（几个 GB 的抓包也只多一份索引）
+*/
+struct ParsedFrame {
+    uint64_t end;
+    uint8_t len;
+
+    const uint8_t* payload(const uint8_t* capture) const {return capture + end - len;}
+
+    bool operator == (const ParsedFrame& o) const {
+        return end == o.end && len == o.len;
+    }
+};
+
+/*
+帧索引数组：resize 时默认初始化（ParsedFrame 是平凡类型，就是不初始化）而不是清零
+并行汇总时输出先 resize 到总帧数再由各线程填自己那段：值初始化会在调用线程上把几十 MB 串行清零一遍，
+页也全由调用线程第一次碰到；默认初始化之后清零没了，缺页分摊到各个拷贝线程上
+*/
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {using other = DefaultInitAllocator<U>;};
+
+    DefaultInitAllocator() = default;
+    template <typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value){::new (static_cast<void*>(p)) U;}
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args){::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);}
+};
+
+using FrameList = std::vector<ParsedFrame, DefaultInitAllocator<ParsedFrame>>;
+
+static ParsedFrame makeParsed(uint64_t end, SimpleUartParser& p){
+    return ParsedFrame{end, p.size()};
+}
+
+constexpr uint32_t OFFLINE_TIMEOUT = 1000;      // 时间戳固定为 0，超时永远不会触发
+
+//串行基准：逐字节扫完整个输入
+FrameList parseSerial(const uint8_t* p, size_t n){
+    FrameList out;
+    out.reserve(n / 16);
+    SimpleUartParser parser(OFFLINE_TIMEOUT);
+    for(size_t i = 0; i < n; i++){
+        if(parser.feed(p[i], 0))
+            out.push_back(makeParsed(i, parser));
+    }
+    return out;
+}
+
+struct ParallelStats {
+    size_t chunks = 0;
+    size_t fixedChunks = 0;         // 开头状态不是空闲、需要重扫的块
+    uint64_t rescannedBytes = 0;    // 合并时重扫的字节数
+    uint64_t boundaryFrames = 0;    // 跨块边界、靠合并补回来的帧
+    uint64_t falseFrames = 0;       // 投机解析出来但被丢掉的帧
+    double parseMs = 0;
+    double mergeMs = 0;
+    double gatherMs = 0;
+};
+
+/*
+并行解析
+threads 个块各自投机解析，再按顺序合并；结果和 parseSerial 完全一致
+*/
+class ParallelParser {
+public:
+    explicit ParallelParser(unsigned threads) : _threads(threads ? threads : 1) {}
+
+    FrameList parse(const uint8_t* p, size_t n, ParallelStats* stats = nullptr){
+        using clock = std::chrono::steady_clock;
+        ParallelStats st;
+
+        //块太小时合并的重扫比例变大，块数按最小块大小限制
+        size_t chunks = std::max<size_t>(1, std::min<size_t>(_threads, n / MIN_CHUNK));
+        std::vector<Chunk> parts(chunks);
+        for(size_t k = 0; k < chunks; k++){
+            parts[k].begin = n * k / chunks;
+            parts[k].end = n * (k + 1) / chunks;
+        }
+        st.chunks = chunks;
+
+        auto t0 = clock::now();
+        forEachChunk(chunks, [&](size_t k){ speculate(p, parts[k]); });
+        auto t1 = clock::now();
+
+        //合并：顺序传递真实状态，修正每块开头；顺便算出每块结果在输出里的位置
+        SimpleUartParser carried = parts[0].endState;
+        size_t total = parts[0].frames.size();
+        for(size_t k = 1; k < chunks; k++){
+            reconcile(p, parts[k], carried, st);
+            carried = parts[k].endState;
+            parts[k].outOffset = total;
+            total += parts[k].fixed.size() + (parts[k].frames.size() - parts[k].keepFrom);
+        }
+        auto t2 = clock::now();
+
+        //只有一块时直接交出去；否则各线程把自己那块拷到输出的对应位置（resize 不清零，见 FrameList）
+        FrameList out;
+        if(chunks == 1){
+            out = std::move(parts[0].frames);
+        }
+        else{
+            out.resize(total);
+            forEachChunk(chunks, [&](size_t k){
+                Chunk& c = parts[k];
+                auto it = std::copy(c.fixed.begin(), c.fixed.end(), out.begin() + c.outOffset);
+                std::copy(c.frames.begin() + c.keepFrom, c.frames.end(), it);
+                FrameList().swap(c.frames);  // 边拷边释放，峰值内存少一份
+            });
+        }
+        auto t3 = clock::now();
+
+        st.parseMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        st.mergeMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        st.gatherMs = std::chrono::duration<double, std::milli>(t3 - t2).count();
+        if(stats) *stats = st;
+        return out;
+    }
+
+private:
+    static constexpr size_t MIN_CHUNK = 4096;
+
+    struct Chunk {
+        size_t begin = 0, end = 0;
+        FrameList frames;            // 投机解析的结果
+        SimpleUartParser endState{OFFLINE_TIMEOUT}; // 块末尾的解析器状态（合并后是真实状态）
+        FrameList fixed;             // 合并时真实解析器在收敛之前完成的帧
+        size_t keepFrom = 0;                        // frames 里从这个下标开始是真实的
+        size_t outOffset = 0;                       // 本块第一帧在输出里的下标
+    };
+
+    //第 0 块在调用线程上跑，其余每块一个线程；第一个异常重新抛出
+    template <typename F>
+    static void forEachChunk(size_t chunks, F&& fn){
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(chunks);
+        for(size_t k = 1; k < chunks; k++){
+            workers.emplace_back([&, k]{
+                try{
+                    fn(k);
+                }
+                catch(...){
+                    errors[k] = std::current_exception();
+                }
+            });
+        }
+        try{
+            fn(0);
+        }
+        catch(...){
+            errors[0] = std::current_exception();
+        }
+        for(auto& w : workers) w.join();
+        for(auto& e : errors)
+            if(e) std::rethrow_exception(e);
+    }
+
+    //从空闲状态开始扫一块
+    static void speculate(const uint8_t* p, Chunk& c){
+        c.frames.reserve((c.end - c.begin) / 16);
+        SimpleUartParser parser(OFFLINE_TIMEOUT);
+        for(size_t i = c.begin; i < c.end; i++){
+            if(parser.feed(p[i], 0))
+                c.frames.push_back(makeParsed(i, parser));
+        }
+        c.endState = parser;
+    }
+
+    //用真实的开头状态修正一块的投机结果
+    static void reconcile(const uint8_t* p, Chunk& c, const SimpleUartParser& carried, ParallelStats& st){
+        if(carried.idle()) return;                  // 开头就是空闲：投机结果就是真实结果
+
+        st.fixedChunks++;
+        SimpleUartParser real = carried;
+        SimpleUartParser spec(OFFLINE_TIMEOUT);     // 重放投机解析，找两者第一次同时空闲的位置
+        size_t i = c.begin;
+        bool converged = false;
+        while(i < c.end){
+            bool gotReal = real.feed(p[i], 0);
+            spec.feed(p[i], 0);
+            if(gotReal){
+                c.fixed.push_back(makeParsed(i, real));
+                if(i - c.begin < real.size() + 3u) st.boundaryFrames++;     // 帧头在上一块里
+            }
+            i++;
+            if(real.idle() && spec.idle()){
+                converged = true;
+                break;
+            }
+        }
+        st.rescannedBytes += i - c.begin;
+
+        if(converged){
+            //收敛点之前结束的投机帧作废，之后的和真实解析完全一样
+            auto it = std::lower_bound(c.frames.begin(), c.frames.end(), uint64_t(i),
+                                       [](const ParsedFrame& f, uint64_t pos){ return f.end < pos; });
+            c.keepFrom = static_cast<size_t>(it - c.frames.begin());
+        }
+        else{
+            c.keepFrom = c.frames.size();           // 整块都没收敛：投机结果全部作废
+            c.endState = real;
+        }
+        st.falseFrames += c.keepFrom;
+    }
+
+    unsigned _threads;
+};
+
+// ---------------- 输入 ----------------
+
+//只读映射一个文件（离线抓包往往比内存还大，不整读进来）
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path){
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        struct stat st;
+        if(::fstat(fd, &st) != 0){
+            int e = errno;
+            ::close(fd);
+            throw std::system_error(e, std::generic_category(), "fstat " + path);
+        }
+        _size = static_cast<size_t>(st.st_size);
+        if(_size > 0){
+            void* m = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(m == MAP_FAILED){
+                int e = errno;
+                ::close(fd);
+                throw std::system_error(e, std::generic_category(), "mmap " + path);
+            }
+            _data = static_cast<const uint8_t*>(m);
+            ::madvise(m, _size, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile(){
+        if(_data) ::munmap(const_cast<uint8_t*>(_data), _size);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    const uint8_t* data() const {return _data;}
+    size_t size() const {return _size;}
+
+private:
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+};
+
+//生成抓包：随机长度的帧，夹杂噪声、校验错、超长长度字节，部分载荷里故意放 AA 55 制造误同步
+std::vector<uint8_t> makeCapture(size_t bytes, uint32_t seed){
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> out;
+    out.reserve(bytes + 64);
+    while(out.size() < bytes){
+        uint32_t r = rng() % 100;
+        if(r == 0){                                 // 噪声
+            size_t n = 1 + rng() % 16;
+            for(size_t i = 0; i < n; i++) out.push_back(static_cast<uint8_t>(rng()));
+        }
+        else if(r == 1){                            // 长度超限
+            out.push_back(0xAA);
+            out.push_back(0x55);
+            out.push_back(static_cast<uint8_t>(SimpleUartParser::MAX_LENGTH + 1 + rng() % 100));
+        }
+
+        uint8_t len = static_cast<uint8_t>(1 + rng() % SimpleUartParser::MAX_LENGTH);
+        uint8_t payload[SimpleUartParser::MAX_LENGTH];
+        for(uint8_t i = 0; i < len; i++) payload[i] = static_cast<uint8_t>(rng());
+        if(len >= 4 && rng() % 20 == 0){            // 5%：载荷里藏一个帧头
+            size_t at = rng() % (len - 3);
+            payload[at] = 0xAA;
+            payload[at + 1] = 0x55;
+            payload[at + 2] = static_cast<uint8_t>(rng() % 40);
+        }
+
+        out.push_back(0xAA);
+        out.push_back(0x55);
+        out.push_back(len);
+        uint8_t crc = len;
+        for(uint8_t i = 0; i < len; i++){
+            out.push_back(payload[i]);
+            crc += payload[i];
+        }
+        if(rng() % 100 == 0) crc ^= 0x01;           // 1%：校验错
+        out.push_back(crc);
+    }
+    return out;
+}
+
+int main(int argc, char** argv){
+    try{
+        std::vector<uint8_t> generated;
+        std::unique_ptr<MappedFile> file;
+        const uint8_t* data;
+        size_t size;
+        if(argc > 2 && std::string(argv[1]) == "file"){
+            file.reset(new MappedFile(argv[2]));
+            data = file->data();
+            size = file->size();
+            std::cout << "capture " << argv[2] << ": " << size << " bytes\n";
+        }
+        else{
+            size_t mb = argc > 1 ? std::stoul(argv[1]) : 64;
+            generated = makeCapture(mb << 20, 28);
+            data = generated.data();
+            size = generated.size();
+            std::cout << "generated capture: " << size << " bytes\n";
+        }
+        std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+
+        using clock = std::chrono::steady_clock;
+        auto t0 = clock::now();
+        FrameList serial = parseSerial(data, size);
+        double serialMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        std::cout << std::fixed << std::setprecision(1)
+                  << "serial      : " << serial.size() << " frames, " << serialMs << " ms, "
+                  << size / serialMs / 1e3 << " MB/s\n";
+
+        //索引直接指回输入：用输入里的载荷重算校验，确认每帧都对得上
+        size_t badIndex = 0;
+        for(auto& f : serial){
+            const uint8_t* pl = f.payload(data);
+            uint8_t crc = f.len;
+            for(uint8_t i = 0; i < f.len; i++) crc += pl[i];
+            if(crc != data[f.end] || pl[-1] != f.len) badIndex++;
+        }
+        if(badIndex){
+            std::cout << "frame index does not point at the payload for " << badIndex << " frames\n";
+            return 1;
+        }
+
+        std::vector<unsigned> threadCounts = {1, 2, 4, 8};
+        unsigned hw = std::thread::hardware_concurrency();
+        if(hw > 8) threadCounts.push_back(hw);
+        for(unsigned t : threadCounts){
+            ParallelStats st;
+            auto t1 = clock::now();
+            FrameList par = ParallelParser(t).parse(data, size, &st);
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - t1).count();
+
+            bool same = par.size() == serial.size() && std::equal(par.begin(), par.end(), serial.begin());
+            std::cout << "parallel x" << std::left << std::setw(2) << t << std::right << ": "
+                      << par.size() << " frames, " << std::setprecision(1) << ms << " ms ("
+                      << "parse " << st.parseMs << " + merge " << st.mergeMs << " + gather " << st.gatherMs << "), "
+                      << size / ms / 1e3 << " MB/s, speedup " << std::setprecision(2) << serialMs / ms
+                      << "  | chunks fixed " << st.fixedChunks << "/" << st.chunks
+                      << ", rescanned " << st.rescannedBytes << " B"
+                      << ", boundary frames " << st.boundaryFrames
+                      << ", false frames dropped " << st.falseFrames
+                      << (same ? "  [matches serial]" : "  [MISMATCH]") << "\n";
+            if(!same) return 1;
+        }
+
+        //小块压力测试：块很多、很小，收敛点经常落在块外，结果也必须一致
+        std::vector<uint8_t> small(data, data + std::min<size_t>(size, 1u << 20));
+        FrameList smallSerial = parseSerial(small.data(), small.size());
+        ParallelStats st;
+        FrameList smallPar = ParallelParser(256).parse(small.data(), small.size(), &st);
+        bool same = smallPar.size() == smallSerial.size() &&
+                    std::equal(smallPar.begin(), smallPar.end(), smallSerial.begin());
+        std::cout << "stress 256 chunks of 1 MB: fixed " << st.fixedChunks << "/" << st.chunks
+                  << ", boundary frames " << st.boundaryFrames << ", false frames dropped " << st.falseFrames
+                  << (same ? "  [matches serial]" : "  [MISMATCH]") << "\n";
+        if(!same) return 1;
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
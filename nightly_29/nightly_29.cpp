@@ -0,0 +1,967 @@
+/*
+协程版通道处理：几千路低速遥测链路跑在少数几个线程上（C++20）
+
+问题：
+night11 的 StreamProcessor 每路一个线程，线程阻塞在条件变量（或 read）上等数据
+几千路低速链路就是几千个线程：每个线程一块栈（默认 8 MB 虚拟地址、至少几页常驻）、
+每来一帧就是一次内核线程切换
+night21/22 的反应器解决了线程数，但处理逻辑被拆成回调，解析 → 解码 → 状态机的流程不再是一段顺序代码
+
+night29 的做法：
+1. 每路的处理写成一个协程 channelHandler：for 循环里 co_await sched.read(...)，拿到数据就解析、解码、喂状态机，
+   读起来和阻塞版一模一样
+2. Scheduler：一个线程一个 epoll（边沿触发）+ 就绪队列
+   - read 的等待体先直接 read 一次，有数据就不挂起；EAGAIN 才把自己挂到这个 fd 上
+   - epoll 报可读时由调度器替它 read，读到了才把协程放进就绪队列
+   - 连续不挂起的次数有上限（BUDGET），用完强制让出，一路数据源源不断也饿不死别的通道
+3. CoroRuntime：几个 Scheduler 分片，每个一个线程（和 night21 的分片一样，通道 id % 分片数）
+4. 协程帧不走通用堆：promise_type 重载 operator new/delete，从 FramePool 拿
+   FramePool 按 64 字节分档，每档一条空闲链表，底下是 mmap 出来的 1 MB 块
+5. main 对比每路一个线程：
+   - 每通道内存：协程是池里一个帧的大小（池的 slab 在几轮测试间复用，常驻内存增量看不出来）
+                 线程是起完 N 个线程后常驻内存的增量 / N（栈用到的页 + TLS，不算内核的 task 结构）
+   - 切换代价：两个协程互相 yield  vs  两个线程用条件变量来回交接
+   - 实际流量：N 路各收若干帧，每帧墙钟时间、CPU 时间、上下文切换次数
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <pthread.h>
+
+//单写者计数：只有所属线程写，其他线程只读（night21）
+static void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// ---------------- 协程帧池 ----------------
+
+/*
+协程帧的分配器
+- 大小按 GRANULE 向上取整分档，每档一条空闲链表；释放的帧挂回链表，下次同样大小的协程直接复用
+- 链表空了从当前 slab 切一块，slab 用完再 mmap 一个（不经过 malloc）
+- 帧的创建/销毁只发生在通道开始/结束时，一把锁就够
+*/
+class FramePool {
+public:
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t MAX_FRAME = 4096;       // 更大的帧说明协程里放了大数组，应该挪到协程外面
+    static constexpr size_t SLAB_BYTES = 1 << 20;
+
+    static FramePool& instance(){
+        static FramePool pool;
+        return pool;
+    }
+
+    void* allocate(size_t n){
+        if(n > MAX_FRAME) throw std::bad_alloc();
+        size_t cls = (n + GRANULE - 1) / GRANULE;
+        size_t bytes = cls * GRANULE;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _live++;
+        _allocs++;
+        _lastRequest = n;
+        if(FreeNode* f = _free[cls]){
+            _free[cls] = f->next;
+            return f;
+        }
+        if(_cur + bytes > _end){
+            void* p = ::mmap(nullptr, SLAB_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(p == MAP_FAILED){
+                _live--;
+                throw std::bad_alloc();
+            }
+            _slabs.push_back(p);
+            _cur = static_cast<uint8_t*>(p);
+            _end = _cur + SLAB_BYTES;
+        }
+        void* p = _cur;
+        _cur += bytes;
+        return p;
+    }
+
+    void deallocate(void* p, size_t n){
+        size_t cls = (n + GRANULE - 1) / GRANULE;
+        std::lock_guard<std::mutex> lock(_mutex);
+        FreeNode* f = static_cast<FreeNode*>(p);
+        f->next = _free[cls];
+        _free[cls] = f;
+        _live--;
+    }
+
+    size_t live() const {std::lock_guard<std::mutex> lock(_mutex); return _live;}
+    size_t allocs() const {std::lock_guard<std::mutex> lock(_mutex); return _allocs;}
+    size_t lastRequest() const {std::lock_guard<std::mutex> lock(_mutex); return _lastRequest;}
+    size_t slabBytes() const {std::lock_guard<std::mutex> lock(_mutex); return _slabs.size() * SLAB_BYTES;}
+
+private:
+    struct FreeNode {FreeNode* next;};
+
+    FramePool() = default;
+    ~FramePool(){
+        for(void* s : _slabs) ::munmap(s, SLAB_BYTES);
+    }
+
+    mutable std::mutex _mutex;
+    std::array<FreeNode*, MAX_FRAME / GRANULE + 1> _free{};
+    std::vector<void*> _slabs;
+    uint8_t* _cur = nullptr;
+    uint8_t* _end = nullptr;
+    size_t _live = 0;
+    size_t _allocs = 0;
+    size_t _lastRequest = 0;
+};
+
+// ---------------- 协程类型和调度器 ----------------
+
+class Scheduler;
+
+/*
+通道协程的返回类型
+- 创建后先挂起（initial_suspend），由 Scheduler::spawn 放进就绪队列
+- 跑完自动销毁帧（final_suspend 不挂起），promise 析构时从调度器的存活链表里摘掉
+*/
+struct ChannelTask {
+    struct promise_type {
+        Scheduler* sched = nullptr;
+        promise_type* prev = nullptr;               // 调度器的存活链表（侵入式，不额外分配）
+        promise_type* next = nullptr;
+
+        ChannelTask get_return_object(){
+            return ChannelTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept {return {};}
+        std::suspend_never final_suspend() noexcept {return {};}
+        void return_void(){}
+        inline void unhandled_exception();
+        inline ~promise_type();
+
+        static void* operator new(size_t n){return FramePool::instance().allocate(n);}
+        static void operator delete(void* p, size_t n) noexcept {FramePool::instance().deallocate(p, n);}
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+//一个被 epoll 监视的 fd；协程挂起等它时 waiter 指向等待体
+struct ReadAwaiter;
+struct Watch {
+    int fd = -1;
+    ReadAwaiter* waiter = nullptr;
+};
+
+struct SchedulerStats {
+    std::atomic<uint64_t> resumes{0};
+    std::atomic<uint64_t> epollWaits{0};
+    std::atomic<uint64_t> inlineReads{0};           // await 时直接读到数据，没有挂起
+    std::atomic<uint64_t> parkedReads{0};           // EAGAIN 挂起，等 epoll 叫醒
+    std::atomic<uint64_t> budgetYields{0};          // 连续不挂起太多次被强制让出
+};
+
+struct ReadAwaiter {
+    Scheduler& sched;
+    Watch& watch;
+    void* buf;
+    size_t len;
+    ssize_t result = 0;
+    std::coroutine_handle<> handle;
+
+    bool await_ready() const noexcept {return false;}
+    inline bool await_suspend(std::coroutine_handle<> h);
+    ssize_t await_resume() const noexcept {return result;}    // 字节数；0 = 对端关闭；<0 = -errno
+};
+
+struct YieldAwaiter {
+    Scheduler& sched;
+    bool await_ready() const noexcept {return false;}
+    inline void await_suspend(std::coroutine_handle<> h);
+    void await_resume() const noexcept {}
+};
+
+/*
+单线程调度器：一个 epoll + 一个就绪队列
+spawn/watch 只能在 run() 之前（或者在本线程的协程里）调用；stop() 可以从任何线程调用
+*/
+class Scheduler {
+public:
+    static constexpr uint32_t BUDGET = 16;
+
+    Scheduler(){
+        _epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        if(_epfd < 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        _stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(_stopFd < 0){
+            int e = errno;
+            ::close(_epfd);
+            throw std::system_error(e, std::generic_category(), "eventfd");
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;                      // nullptr 表示停止信号
+        ::epoll_ctl(_epfd, EPOLL_CTL_ADD, _stopFd, &ev);
+    }
+
+    //还没跑完的协程直接销毁（帧还给池）
+    ~Scheduler(){
+        while(_liveHead){
+            auto h = std::coroutine_handle<ChannelTask::promise_type>::from_promise(*_liveHead);
+            h.destroy();                            // promise 析构会把自己摘掉
+        }
+        ::close(_stopFd);
+        ::close(_epfd);
+    }
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator = (const Scheduler&) = delete;
+
+    void spawn(ChannelTask task){
+        auto& p = task.handle.promise();
+        p.sched = this;
+        p.next = _liveHead;
+        if(_liveHead) _liveHead->prev = &p;
+        _liveHead = &p;
+        _live++;
+        _ready.push_back(task.handle);
+    }
+
+    //fd 必须是非阻塞的；边沿触发，注册一次就够
+    void watch(Watch& w){
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = &w;
+        if(::epoll_ctl(_epfd, EPOLL_CTL_ADD, w.fd, &ev) != 0)
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl ADD");
+    }
+
+    ReadAwaiter read(Watch& w, void* buf, size_t len){return ReadAwaiter{*this, w, buf, len, 0, {}};}
+    YieldAwaiter yield(){return YieldAwaiter{*this};}
+
+    //跑到所有协程结束或者 stop()；协程里的异常在这里重新抛出
+    void run(){
+        epoll_event events[256];
+        std::vector<std::coroutine_handle<>> running;
+        while(_live > 0 && !_stopping){
+            running.swap(_ready);                   // 本轮跑的时候新就绪的放到下一轮
+            for(auto h : running){
+                _budget = BUDGET;
+                bump(_stats.resumes);
+                h.resume();
+            }
+            running.clear();
+            if(_error) break;
+            if(_live == 0) break;
+
+            int n = ::epoll_wait(_epfd, events, 256, _ready.empty() ? -1 : 0);
+            bump(_stats.epollWaits);
+            if(n < 0){
+                if(errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "epoll_wait");
+            }
+            for(int i = 0; i < n; i++){
+                if(events[i].data.ptr == nullptr){
+                    _stopping = true;
+                    continue;
+                }
+                Watch& w = *static_cast<Watch*>(events[i].data.ptr);
+                if(ReadAwaiter* a = w.waiter){
+                    ssize_t r = readOnce(w.fd, a->buf, a->len);
+                    if(r == -EAGAIN) continue;      // 假唤醒，接着等
+                    a->result = r;
+                    w.waiter = nullptr;
+                    _ready.push_back(a->handle);
+                }
+            }
+        }
+        if(_error) std::rethrow_exception(_error);
+    }
+
+    void stop(){
+        uint64_t one = 1;
+        ssize_t r = ::write(_stopFd, &one, sizeof(one));
+        (void)r;
+    }
+
+    size_t live() const {return _live;}
+    const SchedulerStats& stats() const {return _stats;}
+
+private:
+    friend struct ChannelTask::promise_type;
+    friend struct ReadAwaiter;
+    friend struct YieldAwaiter;
+
+    static ssize_t readOnce(int fd, void* buf, size_t len){
+        for(;;){
+            ssize_t r = ::read(fd, buf, len);
+            if(r >= 0) return r;
+            if(errno != EINTR) return -errno;
+        }
+    }
+
+    void unlink(ChannelTask::promise_type& p){
+        if(p.prev) p.prev->next = p.next;
+        else _liveHead = p.next;
+        if(p.next) p.next->prev = p.prev;
+        _live--;
+    }
+
+    int _epfd = -1;
+    int _stopFd = -1;
+    std::vector<std::coroutine_handle<>> _ready;
+    ChannelTask::promise_type* _liveHead = nullptr;
+    size_t _live = 0;
+    uint32_t _budget = BUDGET;
+    bool _stopping = false;
+    std::exception_ptr _error;
+    SchedulerStats _stats;
+};
+
+inline void ChannelTask::promise_type::unhandled_exception(){
+    if(sched && !sched->_error) sched->_error = std::current_exception();
+}
+
+inline ChannelTask::promise_type::~promise_type(){
+    if(sched) sched->unlink(*this);
+}
+
+inline bool ReadAwaiter::await_suspend(std::coroutine_handle<> h){
+    handle = h;
+    ssize_t r = Scheduler::readOnce(watch.fd, buf, len);
+    if(r != -EAGAIN){
+        result = r;
+        bump(sched._stats.inlineReads);
+        if(--sched._budget > 0) return false;       // 不挂起，协程接着跑
+        bump(sched._stats.budgetYields);
+        sched._ready.push_back(h);                  // 结果已经拿到，排到队尾让别人先跑
+        return true;
+    }
+    bump(sched._stats.parkedReads);
+    watch.waiter = this;
+    return true;
+}
+
+inline void YieldAwaiter::await_suspend(std::coroutine_handle<> h){
+    sched._ready.push_back(h);
+}
+
+/*
+几个调度器分片，每个一个线程
+*/
+class CoroRuntime {
+public:
+    explicit CoroRuntime(size_t shards){
+        for(size_t i = 0; i < shards; i++)
+            _shards.emplace_back(new Scheduler());
+        _errors.resize(shards);
+    }
+
+    ~CoroRuntime(){
+        for(auto& s : _shards) s->stop();
+        for(auto& t : _threads)
+            if(t.joinable()) t.join();
+    }
+
+    size_t shards() const {return _shards.size();}
+    Scheduler& shard(size_t i){return *_shards[i % _shards.size()];}
+
+    void start(){
+        for(size_t i = 0; i < _shards.size(); i++){
+            _threads.emplace_back([this, i]{
+                try{
+                    _shards[i]->run();
+                }
+                catch(...){
+                    _errors[i] = std::current_exception();
+                }
+            });
+        }
+    }
+
+    //等所有协程跑完（通道都关了）
+    void join(){
+        for(auto& t : _threads)
+            if(t.joinable()) t.join();
+        for(auto& e : _errors)
+            if(e) std::rethrow_exception(e);
+    }
+
+private:
+    std::vector<std::unique_ptr<Scheduler>> _shards;
+    std::vector<std::thread> _threads;
+    std::vector<std::exception_ptr> _errors;
+};
+
+// ---------------- 解析 / 解码 / 状态机（night20 / night6 / night18） ----------------
+
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+constexpr size_t SENSOR_FRAME_LEN = 22;
+
+//night6 的传感器帧只取状态机需要的字段
+struct Sample {
+    uint8_t type = 0;
+    uint32_t seq = 0;
+};
+
+static bool decodeSample(const uint8_t* p, uint8_t len, Sample& s){
+    if(len != SENSOR_FRAME_LEN || p[0] != 0xAA || p[1] != 0x55 || p[21] != 0x0D)
+        return false;
+    s.type = p[2];
+    s.seq = uint32_t(p[5]) | (uint32_t(p[6]) << 8) | (uint32_t(p[7]) << 16) | (uint32_t(p[8]) << 24);
+    return true;
+}
+
+enum class State : uint8_t {GETUP = 0, GO_SCHOOL, EAT, DO_HOMEWORK, GO_SLEEP, TIMEOUT, ERROR, COUNT};
+enum class Events : uint8_t {EVENT1 = 0, EVENT2, EVENT3, EVENT_TIMEOUT, COUNT};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+struct Transition {
+    State curState;
+    Events event;
+    State nextState;
+};
+
+constexpr Transition kStudentTable[] = {
+    {State::GETUP,       Events::EVENT1, State::GO_SCHOOL},
+    {State::GO_SCHOOL,   Events::EVENT2, State::EAT},
+    {State::EAT,         Events::EVENT3, State::DO_HOMEWORK},
+    {State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP},
+    {State::GO_SLEEP,    Events::EVENT2, State::GETUP},
+    {State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::TIMEOUT, Events::EVENT1, State::GETUP},
+    {State::TIMEOUT, Events::EVENT3, State::ERROR},
+    {State::ERROR,   Events::EVENT1, State::GETUP},
+};
+
+template <size_t N>
+constexpr std::array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    std::array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+constexpr auto kJump = buildJumpTable(kStudentTable);
+
+class StudentFSM {
+public:
+    void handleEvent(Events e){
+        uint8_t i = kJump[static_cast<size_t>(_cur) * EVENT_COUNT + static_cast<size_t>(e)];
+        _cur = (i == NO_TRANSITION) ? State::ERROR : kStudentTable[i].nextState;
+    }
+
+    State state() const {return _cur;}
+
+private:
+    State _cur = State::GETUP;
+};
+
+// ---------------- 一路通道和两种处理方式 ----------------
+
+struct Channel {
+    Watch watch;                                    // 读端（协程版要求非阻塞）
+    int writeFd = -1;
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint8_t> finalState{0};
+    std::atomic<int> error{0};
+};
+
+//协程版：和阻塞读的写法一样是一段顺序代码
+ChannelTask channelHandler(Scheduler& sched, Channel& ch){
+    SimpleUartParser parser(50);
+    StudentFSM fsm;
+    uint8_t buf[128];
+    for(;;){
+        ssize_t n = co_await sched.read(ch.watch, buf, sizeof(buf));
+        if(n <= 0){                                 // 0：写端关了；<0：出错
+            if(n < 0) ch.error.store(static_cast<int>(-n), std::memory_order_relaxed);
+            break;
+        }
+        bump(ch.bytes, static_cast<uint64_t>(n));
+        parser.feed(buf, static_cast<size_t>(n), now_ms(), [&](const uint8_t* p, uint8_t len){
+            Sample s;
+            if(!decodeSample(p, len, s)){
+                bump(ch.dropped);
+                return;
+            }
+            fsm.handleEvent(static_cast<Events>(s.type & 0x03));
+            bump(ch.frames);
+        });
+    }
+    ch.finalState.store(static_cast<uint8_t>(fsm.state()), std::memory_order_relaxed);
+}
+
+//每路一个线程的版本（night11 的模型）：线程阻塞在 read 上，内核叫醒它
+void threadHandler(Channel& ch, std::atomic<size_t>& started){
+    SimpleUartParser parser(50);
+    StudentFSM fsm;
+    uint8_t buf[128];
+    started.fetch_add(1, std::memory_order_relaxed);
+    for(;;){
+        ssize_t n = ::read(ch.watch.fd, buf, sizeof(buf));
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0){
+            if(n < 0) ch.error.store(errno, std::memory_order_relaxed);
+            break;
+        }
+        bump(ch.bytes, static_cast<uint64_t>(n));
+        parser.feed(buf, static_cast<size_t>(n), now_ms(), [&](const uint8_t* p, uint8_t len){
+            Sample s;
+            if(!decodeSample(p, len, s)){
+                bump(ch.dropped);
+                return;
+            }
+            fsm.handleEvent(static_cast<Events>(s.type & 0x03));
+            bump(ch.frames);
+        });
+    }
+    ch.finalState.store(static_cast<uint8_t>(fsm.state()), std::memory_order_relaxed);
+}
+
+// ---------------- 测量工具 ----------------
+
+static void raiseFdLimit(){
+    rlimit rl;
+    if(::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max){
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static size_t fdLimit(){
+    rlimit rl;
+    if(::getrlimit(RLIMIT_NOFILE, &rl) != 0) return 1024;
+    return static_cast<size_t>(rl.rlim_cur);
+}
+
+//常驻内存（字节）
+static size_t rssBytes(){
+    std::ifstream f("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    f >> pages >> resident;
+    return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+struct Usage {
+    double cpuSec;
+    long switches;                                  // 自愿 + 非自愿上下文切换（整个进程）
+};
+
+static Usage processUsage(){
+    rusage ru;
+    ::getrusage(RUSAGE_SELF, &ru);
+    return {ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6,
+            ru.ru_nvcsw + ru.ru_nivcsw};
+}
+
+static size_t defaultStackSize(){
+    pthread_attr_t attr;
+    size_t sz = 0;
+    if(::pthread_attr_init(&attr) == 0){
+        ::pthread_attr_getstacksize(&attr, &sz);
+        ::pthread_attr_destroy(&attr);
+    }
+    return sz;
+}
+
+//一帧：AA 55 22 [night6 传感器帧] crc
+static std::vector<uint8_t> makeFrame(uint8_t type, uint32_t seq){
+    uint8_t p[SENSOR_FRAME_LEN] = {
+        0xAA, 0x55, type, 0x07, 0x00,
+        uint8_t(seq), uint8_t(seq >> 8), uint8_t(seq >> 16), uint8_t(seq >> 24),
+        0x00, 0x01, 0x8B, 0xCD, 0x09, 0xE6, 0x82, 0x2D, 0xFF, 0xFF, 0xFF, 0x85, 0x0D};
+    std::vector<uint8_t> f{0xAA, 0x55, static_cast<uint8_t>(SENSOR_FRAME_LEN)};
+    uint8_t crc = static_cast<uint8_t>(SENSOR_FRAME_LEN);
+    for(uint8_t b : p){
+        f.push_back(b);
+        crc += b;
+    }
+    f.push_back(crc);
+    return f;
+}
+
+//N 路管道：读端给处理方，写端给发送线程（管道代替串口，几千个 pty 会碰到系统上限）
+static std::vector<std::unique_ptr<Channel>> openChannels(size_t n, bool nonBlockingRead){
+    std::vector<std::unique_ptr<Channel>> chans;
+    chans.reserve(n);
+    for(size_t i = 0; i < n; i++){
+        int fds[2];
+        if(::pipe2(fds, O_CLOEXEC) != 0)
+            throw std::system_error(errno, std::generic_category(), "pipe2");
+        if(nonBlockingRead)
+            ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        std::unique_ptr<Channel> c(new Channel());
+        c->watch.fd = fds[0];
+        c->writeFd = fds[1];
+        chans.push_back(std::move(c));
+    }
+    return chans;
+}
+
+static void closeWriters(std::vector<std::unique_ptr<Channel>>& chans){
+    for(auto& c : chans){
+        if(c->writeFd >= 0) ::close(c->writeFd);
+        c->writeFd = -1;
+    }
+}
+
+static void closeReaders(std::vector<std::unique_ptr<Channel>>& chans){
+    for(auto& c : chans){
+        if(c->watch.fd >= 0) ::close(c->watch.fd);
+        c->watch.fd = -1;
+    }
+}
+
+struct TrafficResult {
+    size_t channels = 0;
+    size_t threads = 0;
+    size_t memPerChannel = 0;
+    uint64_t frames = 0;
+    double wallUsPerFrame = 0;
+    double cpuUsPerFrame = 0;
+    double switchesPerFrame = 0;
+    bool ok = false;
+};
+
+//发送线程：一轮给每路写一帧，写 rounds 轮；然后等处理方全部收完
+static void sendTraffic(std::vector<std::unique_ptr<Channel>>& chans, size_t rounds,
+                        const std::vector<std::vector<uint8_t>>& frames, TrafficResult& r){
+    uint64_t expect = uint64_t(chans.size()) * rounds;
+    Usage u0 = processUsage();
+    auto t0 = std::chrono::steady_clock::now();
+    size_t k = 0;
+    for(size_t round = 0; round < rounds; round++){
+        for(auto& c : chans){
+            const auto& f = frames[k++ % frames.size()];
+            if(::write(c->writeFd, f.data(), f.size()) != static_cast<ssize_t>(f.size()))
+                throw std::system_error(errno, std::generic_category(), "write");
+        }
+    }
+    for(;;){
+        uint64_t got = 0;
+        for(auto& c : chans) got += c->frames.load(std::memory_order_relaxed);
+        if(got >= expect) break;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    Usage u1 = processUsage();
+
+    r.frames = expect;
+    r.wallUsPerFrame = std::chrono::duration<double, std::micro>(t1 - t0).count() / expect;
+    r.cpuUsPerFrame = (u1.cpuSec - u0.cpuSec) * 1e6 / expect;
+    r.switchesPerFrame = double(u1.switches - u0.switches) / expect;
+}
+
+static bool checkChannels(const std::vector<std::unique_ptr<Channel>>& chans, size_t rounds){
+    for(auto& c : chans){
+        if(c->frames.load() != rounds || c->dropped.load() != 0 || c->error.load() != 0)
+            return false;
+    }
+    return true;
+}
+
+TrafficResult runCoroutines(size_t n, size_t rounds, size_t shards, const std::vector<std::vector<uint8_t>>& frames){
+    TrafficResult r;
+    r.channels = n;
+    r.threads = shards;
+    auto chans = openChannels(n, true);
+    {
+        CoroRuntime rt(shards);
+        for(size_t i = 0; i < n; i++){
+            Scheduler& s = rt.shard(i);
+            s.watch(chans[i]->watch);
+            s.spawn(channelHandler(s, *chans[i]));
+        }
+        rt.start();
+        //等每个协程都跑到第一次挂起
+        for(;;){
+            uint64_t parked = 0;
+            for(size_t i = 0; i < shards; i++) parked += rt.shard(i).stats().parkedReads.load();
+            if(parked >= n) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        size_t frame = FramePool::instance().lastRequest();
+        r.memPerChannel = (frame + FramePool::GRANULE - 1) / FramePool::GRANULE * FramePool::GRANULE;
+
+        sendTraffic(chans, rounds, frames, r);
+        closeWriters(chans);
+        rt.join();
+    }
+    r.ok = checkChannels(chans, rounds);
+    closeReaders(chans);
+    return r;
+}
+
+TrafficResult runThreads(size_t n, size_t rounds, const std::vector<std::vector<uint8_t>>& frames){
+    TrafficResult r;
+    r.channels = n;
+    r.threads = n;
+    auto chans = openChannels(n, false);
+    std::atomic<size_t> started{0};
+    std::vector<std::thread> threads;
+    threads.reserve(n);
+    size_t rss0 = rssBytes();
+    try{
+        for(size_t i = 0; i < n; i++)
+            threads.emplace_back(threadHandler, std::ref(*chans[i]), std::ref(started));
+        while(started.load() < n)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));     // 都阻塞进 read
+        size_t rss1 = rssBytes();
+        r.memPerChannel = (rss1 - std::min(rss1, rss0)) / n;
+
+        sendTraffic(chans, rounds, frames, r);
+    }
+    catch(...){
+        closeWriters(chans);
+        for(auto& t : threads) t.join();
+        closeReaders(chans);
+        throw;
+    }
+    closeWriters(chans);
+    for(auto& t : threads) t.join();
+    r.ok = checkChannels(chans, rounds);
+    closeReaders(chans);
+    return r;
+}
+
+// ---------------- 切换代价 ----------------
+
+ChannelTask yielder(Scheduler& s, uint64_t n){
+    for(uint64_t i = 0; i < n; i++)
+        co_await s.yield();
+}
+
+//两个协程轮流 yield：每次是一次挂起 + 一次恢复
+double coroutineSwitchNs(uint64_t n){
+    Scheduler s;
+    s.spawn(yielder(s, n));
+    s.spawn(yielder(s, n));
+    auto t0 = std::chrono::steady_clock::now();
+    s.run();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / (2 * n);
+}
+
+//两个线程用条件变量交接（StreamProcessor 的唤醒方式）：每次交接是一次线程切换
+double threadSwitchNs(uint64_t n){
+    std::mutex m;
+    std::condition_variable cv;
+    uint64_t turn = 0;                              // 偶数归 A，奇数归 B
+    auto player = [&](uint64_t parity){
+        std::unique_lock<std::mutex> lock(m);
+        for(uint64_t i = 0; i < n; i++){
+            cv.wait(lock, [&]{ return turn % 2 == parity; });
+            turn++;
+            cv.notify_one();
+        }
+    };
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread a(player, 0), b(player, 1);
+    a.join();
+    b.join();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / (2 * n);
+}
+
+void printTraffic(const char* name, const TrafficResult& r){
+    std::cout << std::fixed << std::setprecision(2)
+              << std::left << std::setw(11) << name << std::right
+              << " channels=" << std::setw(5) << r.channels
+              << " threads=" << std::setw(5) << r.threads
+              << "  mem/channel=" << std::setw(6) << r.memPerChannel << " B"
+              << "  frames=" << r.frames
+              << "  wall " << r.wallUsPerFrame << " us/frame"
+              << "  cpu " << r.cpuUsPerFrame << " us/frame"
+              << "  ctx switches " << r.switchesPerFrame << "/frame"
+              << (r.ok ? "" : "  [WRONG COUNTS]") << "\n";
+}
+
+int main(){
+    try{
+        raiseFdLimit();
+        size_t hw = std::max(1u, std::thread::hardware_concurrency());
+        size_t shards = std::min<size_t>(4, hw);
+
+        // ---------- 1) 每通道内存 ----------
+        {
+            Channel ch;
+            int fds[2];
+            if(::pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0)
+                throw std::system_error(errno, std::generic_category(), "pipe2");
+            ch.watch.fd = fds[0];
+            ch.writeFd = fds[1];
+            {
+                Scheduler s;
+                s.watch(ch.watch);
+                s.spawn(channelHandler(s, ch));
+            }                                       // 没跑完的协程随调度器销毁，帧还给池
+            ::close(fds[0]);
+            ::close(fds[1]);
+            std::cout << "coroutine frame: " << FramePool::instance().lastRequest() << " B requested, "
+                      << ((FramePool::instance().lastRequest() + FramePool::GRANULE - 1) / FramePool::GRANULE) * FramePool::GRANULE
+                      << " B from pool (live after destroy: " << FramePool::instance().live() << ")\n";
+            std::cout << "thread stack   : " << defaultStackSize() / 1024 << " KB reserved per thread\n";
+            std::cout << "cpus: " << hw << ", coroutine shards: " << shards << "\n\n";
+        }
+
+        // ---------- 2) 切换代价 ----------
+        std::cout << std::fixed << std::setprecision(1)
+                  << "switch cost: coroutine yield " << coroutineSwitchNs(2000000) << " ns"
+                  << ", thread condition-variable handoff " << threadSwitchNs(200000) << " ns\n\n";
+
+        // ---------- 3) 实际流量：每路若干帧 ----------
+        std::vector<std::vector<uint8_t>> frames;
+        std::mt19937 rng(29);
+        for(uint32_t i = 0; i < 64; i++)
+            frames.push_back(makeFrame(static_cast<uint8_t>(0x10 | (rng() & 0x03)), i));
+
+        size_t maxChannels = (fdLimit() - 64) / 2;
+        for(size_t n : {size_t(100), size_t(1000), size_t(4000), size_t(8000)}){
+            if(n > maxChannels){
+                std::cout << n << " channels: skipped (fd limit " << fdLimit() << ")\n";
+                continue;
+            }
+            size_t rounds = std::max<size_t>(4, 200000 / n);
+            printTraffic("coroutines", runCoroutines(n, rounds, shards, frames));
+            if(n <= 4000)
+                printTraffic("threads", runThreads(n, rounds, frames));
+            else
+                std::cout << "threads     channels=" << n << ": skipped (too many OS threads for this demo)\n";
+        }
+        std::cout << "\nframe pool: " << FramePool::instance().allocs() << " frames allocated, "
+                  << FramePool::instance().slabBytes() / 1024 << " KB of slabs, "
+                  << FramePool::instance().live() << " live\n";
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,658 @@
+/*
+StreamProcessor 有界队列 + 过载策略
+
+问题：
+night11 的 StreamProcessor::dataQueue 是不限长的 std::queue<uint8_t>
+解析跟不上（设备突发、下游处理慢）的时候队列一直长，直到进程被 OOM 杀掉
+
+night30 的做法：
+1. dataQueue 换成构造时一次分配好的字节环（容量是 2 的幂），之后内存不再增长
+2. 队列满了怎么办由 OverloadPolicy 决定：
+   - BLOCK：生产者等消费者腾出空间（数据不丢，反压给数据源）
+   - DROP_NEWEST：这次 push 的数据放不下就整段丢掉，队列里已有的保留
+   - DROP_OLDEST：丢掉队列里最老的字节给新数据腾地方（要的是“最新状态”时用）
+   - DROP_UNTIL_HEADER：放不下以后一直丢，直到新数据里出现 AA 55 帧头并且队列空出 1/4，
+     从帧头开始恢复接收，残帧不会进队列
+3. 丢数据的地方记一个“断点”（流里的绝对位置），消费者读到断点先 reset 解析器，
+   不会把断点两边的字节拼成一帧（否则只靠 1 字节校验，有 1/256 的概率收下假帧）
+4. OverloadStats：过载次数、丢弃字节、阻塞次数和时间、队列高水位、断点复位次数
+5. main：
+   - 持续过载（生产者全速，消费者每帧 2us）：各策略常驻内存不涨，对比 night11 的无界队列
+   - 正常速率：延迟 p50/p99 和无界队列一样
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <string>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+//帧解析器（沿用 night20），reset() 改成公开：丢过数据以后由 StreamProcessor 让它重新同步
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+private:
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static uint64_t nowNs(){
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+enum class OverloadPolicy {BLOCK, DROP_NEWEST, DROP_OLDEST, DROP_UNTIL_HEADER};
+
+const char* policyName(OverloadPolicy p){
+    switch(p){
+        case OverloadPolicy::BLOCK:             return "block";
+        case OverloadPolicy::DROP_NEWEST:       return "drop-newest";
+        case OverloadPolicy::DROP_OLDEST:       return "drop-oldest";
+        case OverloadPolicy::DROP_UNTIL_HEADER: return "drop-until-header";
+    }
+    return "?";
+}
+
+struct OverloadStats {
+    uint64_t pushedBytes = 0;
+    uint64_t droppedBytes = 0;
+    uint64_t overloadEvents = 0;    // push 时放不下的次数
+    uint64_t blockedPushes = 0;     // BLOCK：等过空间的 push 次数
+    uint64_t blockedNs = 0;
+    uint64_t gapResets = 0;         // 消费者在断点处 reset 解析器的次数
+    size_t highWater = 0;           // 队列里最多同时有多少字节
+};
+
+/*
+后台解析任务（night11），队列有上限
+pushData() 模拟数据到来（中断 / DMA 回调），processStream() 线程取数据喂解析器
+*/
+class StreamProcessor{
+public:
+    using FrameHandler = std::function<void(const uint8_t*, uint8_t)>;
+
+    //capacity 必须是 2 的幂；onFrame 在解析线程里调用
+    StreamProcessor(SimpleUartParser& parser, size_t capacity, OverloadPolicy policy, FrameHandler onFrame)
+        : uartParser(parser), onFrame(std::move(onFrame)), policy(policy),
+          ring(capacity), mask(capacity - 1), stop(false) {
+        if(capacity < 64 || (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("StreamProcessor capacity must be a power of two >= 64");
+    }
+
+    ~StreamProcessor(){
+        stopProcessing();
+    }
+
+    void start(){
+        processingThread = std::thread(&StreamProcessor::processStream,this);
+    }
+
+    //队列里剩下的数据处理完再停；被 BLOCK 卡住的生产者放弃剩余数据返回
+    void stopProcessing(){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        notFull.notify_all();
+        if(processingThread.joinable()){
+            processingThread.join();
+        }
+    }
+
+    void pushData(const uint8_t* p, size_t n){
+        std::unique_lock<std::mutex> lock(mtx);
+        stats.pushedBytes += n;
+        switch(policy){
+            case OverloadPolicy::BLOCK:             pushBlocking(lock, p, n); break;
+            case OverloadPolicy::DROP_NEWEST:       pushDropNewest(p, n); break;
+            case OverloadPolicy::DROP_OLDEST:       pushDropOldest(p, n); break;
+            case OverloadPolicy::DROP_UNTIL_HEADER: pushDropUntilHeader(p, n); break;
+        }
+        stats.highWater = std::max(stats.highWater, size());
+        lock.unlock();
+        cv.notify_one();
+    }
+
+    OverloadStats overloadStats() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return stats;
+    }
+
+    size_t capacity() const {return ring.size();}
+
+private:
+    size_t size() const {return static_cast<size_t>(head - tail);}
+    size_t freeSpace() const {return ring.size() - size();}
+
+    void write(const uint8_t* p, size_t n){
+        size_t off = static_cast<size_t>(head) & mask;
+        size_t first = std::min(n, ring.size() - off);
+        std::memcpy(ring.data() + off, p, first);
+        std::memcpy(ring.data(), p + first, n - first);
+        head += n;
+    }
+
+    //在流的 pos 处记一个断点（按位置递增排列）；记满了就合并到最后一个，最多少 reset 一次
+    void markGap(uint64_t pos){
+        if(gapCount > 0){
+            uint64_t& last = gaps[(gapHead + gapCount - 1) % gaps.size()];
+            if(last == pos) return;
+            if(gapCount == gaps.size()){
+                last = pos;
+                return;
+            }
+        }
+        gaps[(gapHead + gapCount) % gaps.size()] = pos;
+        gapCount++;
+    }
+
+    void pushBlocking(std::unique_lock<std::mutex>& lock, const uint8_t* p, size_t n){
+        uint64_t t0 = 0;
+        while(n > 0){
+            size_t room = freeSpace();
+            if(room == 0){
+                if(t0 == 0){
+                    t0 = nowNs();
+                    stats.overloadEvents++;
+                    stats.blockedPushes++;
+                }
+                cv.notify_one();                    // 先让消费者把已经放进去的取走
+                notFull.wait(lock, [this]{ return freeSpace() > 0 || stop; });
+                if(stop){
+                    stats.droppedBytes += n;
+                    break;
+                }
+                continue;
+            }
+            size_t k = std::min(n, room);
+            write(p, k);
+            p += k;
+            n -= k;
+        }
+        if(t0) stats.blockedNs += nowNs() - t0;
+    }
+
+    //整段放不下就整段丢：队列里已有的数据是完整的，断点在当前队尾
+    void pushDropNewest(const uint8_t* p, size_t n){
+        if(n > freeSpace()){
+            stats.overloadEvents++;
+            stats.droppedBytes += n;
+            markGap(head);
+            return;
+        }
+        write(p, n);
+    }
+
+    /*
+    丢掉最老的字节，在新的队头记断点（它比队列里剩下的断点都早，插在 FIFO 前面）
+    断点 FIFO 满了就接着丢到最老的那个断点为止：新断点和它合成一个，较新的断点都保留，不会漏 reset
+    */
+    void pushDropOldest(const uint8_t* p, size_t n){
+        if(n > ring.size()){                        // 一次来的比整个队列还多：只留最后 capacity 个字节
+            stats.droppedBytes += n - ring.size();
+            p += n - ring.size();
+            n = ring.size();
+        }
+        if(n > freeSpace()){
+            size_t k = n - freeSpace();
+            stats.overloadEvents++;
+            stats.droppedBytes += k;
+            tail += k;
+            while(gapCount > 0 && gaps[gapHead] <= tail){
+                gapHead = (gapHead + 1) % gaps.size();
+                gapCount--;
+            }
+            if(gapCount == gaps.size()){
+                stats.droppedBytes += gaps[gapHead] - tail;
+                tail = gaps[gapHead];               // 队头已经就是断点，不用再插
+            }
+            else{
+                gapHead = (gapHead + gaps.size() - 1) % gaps.size();
+                gaps[gapHead] = tail;
+                gapCount++;
+            }
+        }
+        write(p, n);
+    }
+
+    //过载后丢到下一个 AA 55 帧头为止，并且等队列空出 1/4 才恢复（不然马上又满）
+    void pushDropUntilHeader(const uint8_t* p, size_t n){
+        size_t i = 0;
+        while(i < n){
+            if(skipping){
+                for(; i < n; i++){
+                    if(skipPrev == SimpleUartParser::HEAD1 && p[i] == SimpleUartParser::HEAD2 &&
+                       freeSpace() >= ring.size() / 4){
+                        markGap(head);
+                        uint8_t h1 = SimpleUartParser::HEAD1;   // 帧头第一个字节在上一轮被丢了，补回来
+                        write(&h1, 1);
+                        stats.droppedBytes--;
+                        skipping = false;
+                        break;
+                    }
+                    skipPrev = p[i];
+                    stats.droppedBytes++;
+                }
+                continue;
+            }
+            size_t k = std::min(n - i, freeSpace());
+            write(p + i, k);
+            i += k;
+            if(i < n){
+                stats.overloadEvents++;
+                skipping = true;
+                skipPrev = 0;
+            }
+        }
+    }
+
+    void processStream(){
+        uint8_t chunk[256];
+        for(;;){
+            size_t n = 0;
+            bool resync = false;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock,[this] {return head != tail || stop;});
+                if(stop && head == tail) break;
+
+                //到了断点：先 reset，这一块也不跨过下一个断点
+                if(gapCount > 0 && gaps[gapHead] == tail){
+                    resync = true;
+                    stats.gapResets++;
+                    gapHead = (gapHead + 1) % gaps.size();
+                    gapCount--;
+                }
+                uint64_t limit = head;
+                if(gapCount > 0) limit = std::min(limit, gaps[gapHead]);
+                n = static_cast<size_t>(std::min<uint64_t>(sizeof(chunk), limit - tail));
+                size_t off = static_cast<size_t>(tail) & mask;
+                size_t first = std::min(n, ring.size() - off);
+                std::memcpy(chunk, ring.data() + off, first);
+                std::memcpy(chunk + first, ring.data(), n - first);
+                tail += n;
+            }
+            if(policy == OverloadPolicy::BLOCK) notFull.notify_one();
+
+            if(resync) uartParser.reset();
+            uartParser.feed(chunk, n, now_ms(), onFrame);
+        }
+    }
+
+    SimpleUartParser& uartParser;
+    FrameHandler onFrame;
+    const OverloadPolicy policy;
+    std::vector<uint8_t> ring;                      // 构造时分配，之后大小不变
+    const size_t mask;
+    uint64_t head = 0;                              // 写位置（流里的绝对位置）
+    uint64_t tail = 0;                              // 读位置
+    std::array<uint64_t, 32> gaps{};                // 断点 FIFO
+    size_t gapHead = 0;
+    size_t gapCount = 0;
+    bool skipping = false;                          // DROP_UNTIL_HEADER：正在丢，等帧头
+    uint8_t skipPrev = 0;
+    OverloadStats stats;
+    mutable std::mutex mtx;
+    std::condition_variable cv;                     // 有数据了 / 要停了
+    std::condition_variable notFull;                // BLOCK：有空间了
+    std::thread processingThread;
+    bool stop;
+};
+
+/*
+对照组：night11/26 的无界队列版本
+*/
+class UnboundedStreamProcessor{
+public:
+    using FrameHandler = std::function<void(const uint8_t*, uint8_t)>;
+
+    UnboundedStreamProcessor(SimpleUartParser& parser, FrameHandler onFrame)
+        : uartParser(parser), onFrame(std::move(onFrame)), stop(false) {}
+
+    ~UnboundedStreamProcessor(){
+        stopProcessing();
+    }
+
+    void start(){
+        processingThread = std::thread(&UnboundedStreamProcessor::processStream,this);
+    }
+
+    void stopProcessing(){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        if(processingThread.joinable()){
+            processingThread.join();
+        }
+    }
+
+    void pushData(const uint8_t* p, size_t n){
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for(size_t i = 0; i < n; i++) dataQueue.push(p[i]);
+        }
+        cv.notify_one();
+    }
+
+private:
+    void processStream(){
+        uint8_t chunk[256];
+        for(;;){
+            size_t n = 0;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock,[this] {return !dataQueue.empty() || stop;});
+                if(stop && dataQueue.empty()) break;
+                while(n < sizeof(chunk) && !dataQueue.empty()){
+                    chunk[n++] = dataQueue.front();
+                    dataQueue.pop();
+                }
+            }
+            uartParser.feed(chunk, n, now_ms(), onFrame);
+        }
+    }
+
+    SimpleUartParser& uartParser;
+    FrameHandler onFrame;
+    std::queue<uint8_t> dataQueue;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread processingThread;
+    bool stop;
+};
+
+// ---------------- 测试 ----------------
+
+//载荷：seq(4, LE) + 发送时间 ns(8, LE) + 8 字节由 seq 推出来的填充，收到后能校验内容是不是真的
+constexpr uint8_t PAYLOAD_LEN = 20;
+
+static void makeFrame(uint32_t seq, uint64_t sendNs, uint8_t (&out)[PAYLOAD_LEN + 4]){
+    uint8_t* p = out + 3;
+    for(int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(seq >> (8 * i));
+    for(int i = 0; i < 8; i++) p[4 + i] = static_cast<uint8_t>(sendNs >> (8 * i));
+    for(int i = 0; i < 8; i++) p[12 + i] = static_cast<uint8_t>(seq * 31 + i);
+    out[0] = 0xAA;
+    out[1] = 0x55;
+    out[2] = PAYLOAD_LEN;
+    uint8_t crc = PAYLOAD_LEN;
+    for(int i = 0; i < PAYLOAD_LEN; i++) crc += p[i];
+    out[3 + PAYLOAD_LEN] = crc;
+}
+
+struct Receiver {
+    uint64_t frames = 0;
+    uint64_t bad = 0;                               // 校验过了但内容不对（断点两边拼出来的假帧）
+    uint32_t workNs = 0;                            // 模拟慢的下游
+    std::vector<uint32_t> latencyUs;
+
+    void onFrame(const uint8_t* d, uint8_t len){
+        if(len != PAYLOAD_LEN){
+            bad++;
+            return;
+        }
+        uint32_t seq = 0;
+        uint64_t sendNs = 0;
+        for(int i = 0; i < 4; i++) seq |= uint32_t(d[i]) << (8 * i);
+        for(int i = 0; i < 8; i++) sendNs |= uint64_t(d[4 + i]) << (8 * i);
+        for(int i = 0; i < 8; i++){
+            if(d[12 + i] != static_cast<uint8_t>(seq * 31 + i)){
+                bad++;
+                return;
+            }
+        }
+        frames++;
+        uint64_t now = nowNs();
+        if(latencyUs.size() < latencyUs.capacity())
+            latencyUs.push_back(static_cast<uint32_t>((now - sendNs) / 1000));
+        if(workNs){
+            uint64_t until = now + workNs;
+            while(nowNs() < until) {}
+        }
+    }
+};
+
+static size_t rssBytes(){
+    std::ifstream f("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    f >> pages >> resident;
+    return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, double q){
+    if(v.empty()) return 0;
+    size_t k = static_cast<size_t>(q * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+//持续过载：生产者全速推 durationMs，每次推 4 帧
+template <typename Processor>
+static void overload(Processor& proc, uint32_t durationMs, uint64_t& sentFrames, size_t& peakRss){
+    uint8_t frames[4][PAYLOAD_LEN + 4];
+    uint8_t buf[sizeof(frames)];
+    uint32_t seq = 0;
+    uint64_t end = nowNs() + uint64_t(durationMs) * 1000000;
+    size_t rss0 = rssBytes();
+    peakRss = 0;
+    uint64_t lastSample = 0;
+    while(nowNs() < end){
+        for(int i = 0; i < 4; i++){
+            makeFrame(seq++, nowNs(), frames[i]);
+            std::memcpy(buf + i * sizeof(frames[i]), frames[i], sizeof(frames[i]));
+        }
+        proc.pushData(buf, sizeof(buf));
+        if(seq - lastSample >= 4096){
+            lastSample = seq;
+            size_t r = rssBytes();
+            peakRss = std::max(peakRss, r > rss0 ? r - rss0 : 0);
+        }
+    }
+    sentFrames = seq;
+}
+
+//正常速率：每 200us 一帧，看延迟
+template <typename Processor>
+static void normalRate(Processor& proc, uint32_t frames){
+    uint8_t f[PAYLOAD_LEN + 4];
+    for(uint32_t seq = 0; seq < frames; seq++){
+        makeFrame(seq, nowNs(), f);
+        proc.pushData(f, sizeof(f));
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+static void printOverload(const std::string& name, uint64_t sent, const Receiver& r, size_t peakRss,
+                          const OverloadStats* st){
+    std::cout << std::left << std::setw(20) << name << std::right
+              << " sent=" << std::setw(8) << sent
+              << " parsed=" << std::setw(7) << r.frames
+              << " bad=" << r.bad
+              << "  rss growth=" << std::setw(7) << std::fixed << std::setprecision(1) << peakRss / 1048576.0 << " MB";
+    if(st){
+        std::cout << "  high water=" << st->highWater
+                  << " overloads=" << st->overloadEvents
+                  << " dropped=" << st->droppedBytes << " B"
+                  << " blocked=" << st->blockedPushes << " (" << std::setprecision(0) << st->blockedNs / 1e6 << " ms)"
+                  << " gap resets=" << st->gapResets;
+    }
+    std::cout << "\n";
+}
+
+int main(){
+    try{
+        constexpr size_t CAPACITY = 64 * 1024;
+        constexpr uint32_t OVERLOAD_MS = 500;
+        const OverloadPolicy policies[] = {OverloadPolicy::BLOCK, OverloadPolicy::DROP_NEWEST,
+                                           OverloadPolicy::DROP_OLDEST, OverloadPolicy::DROP_UNTIL_HEADER};
+
+        // ---------- 1) 持续过载：消费者每帧 2us，生产者全速 ----------
+        std::cout << "--- sustained overload for " << OVERLOAD_MS << " ms, queue cap "
+                  << CAPACITY / 1024 << " KB, consumer 2 us/frame ---\n";
+        for(OverloadPolicy pol : policies){
+            SimpleUartParser parser(50);
+            Receiver rx;
+            rx.workNs = 2000;
+            StreamProcessor proc(parser, CAPACITY, pol, [&](const uint8_t* d, uint8_t len){ rx.onFrame(d, len); });
+            proc.start();
+            uint64_t sent = 0;
+            size_t peak = 0;
+            overload(proc, OVERLOAD_MS, sent, peak);
+            proc.stopProcessing();
+            OverloadStats st = proc.overloadStats();
+            printOverload(policyName(pol), sent, rx, peak, &st);
+        }
+        {
+            SimpleUartParser parser(50);
+            Receiver rx;
+            rx.workNs = 2000;
+            UnboundedStreamProcessor proc(parser, [&](const uint8_t* d, uint8_t len){ rx.onFrame(d, len); });
+            proc.start();
+            uint64_t sent = 0;
+            size_t peak = 0;
+            overload(proc, OVERLOAD_MS, sent, peak);
+            printOverload("unbounded (night11)", sent, rx, peak, nullptr);
+            std::cout << "  (unbounded queue still has to drain its backlog before it can stop)\n";
+            proc.stopProcessing();
+        }
+
+        // ---------- 2) 正常速率的延迟 ----------
+        constexpr uint32_t NORMAL_FRAMES = 5000;
+        std::cout << "\n--- normal rate: " << NORMAL_FRAMES << " frames, one every 200 us ---\n";
+        auto report = [](const std::string& name, const Receiver& rx){
+            std::cout << std::left << std::setw(20) << name << std::right
+                      << " parsed=" << rx.frames << " bad=" << rx.bad
+                      << "  latency p50=" << percentile(rx.latencyUs, 0.50) << " us"
+                      << " p99=" << percentile(rx.latencyUs, 0.99) << " us"
+                      << " max=" << percentile(rx.latencyUs, 1.0) << " us\n";
+        };
+        {
+            SimpleUartParser parser(50);
+            Receiver rx;
+            rx.latencyUs.reserve(NORMAL_FRAMES);
+            UnboundedStreamProcessor proc(parser, [&](const uint8_t* d, uint8_t len){ rx.onFrame(d, len); });
+            proc.start();
+            normalRate(proc, NORMAL_FRAMES);
+            proc.stopProcessing();
+            report("unbounded (night11)", rx);
+        }
+        for(OverloadPolicy pol : policies){
+            SimpleUartParser parser(50);
+            Receiver rx;
+            rx.latencyUs.reserve(NORMAL_FRAMES);
+            StreamProcessor proc(parser, CAPACITY, pol, [&](const uint8_t* d, uint8_t len){ rx.onFrame(d, len); });
+            proc.start();
+            normalRate(proc, NORMAL_FRAMES);
+            proc.stopProcessing();
+            report(policyName(pol), rx);
+            OverloadStats st = proc.overloadStats();
+            if(st.overloadEvents != 0 || st.droppedBytes != 0)
+                std::cout << "  unexpected overload at normal rate\n";
+        }
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,767 @@
+/*
+按协议特征模板化的帧解析器 + 运行时注册表
+
+问题：
+现场有好几类设备，帧格式只差在：帧头字节、长度字段宽度和字节序、校验方式、最大载荷
+SimpleUartParser 把 HEAD1/HEAD2、1 字节长度、累加和、MAX_LENGTH = 32 都写死了
+每来一类设备就复制一份改常量；改成运行时配置的话，每个字节都要判断“几字节长度”“哪种校验”
+
+night31 的做法：
+1. 协议特征（traits）：一个只有编译期常量的 struct
+   HEADER[]、LENGTH_BYTES（1/2）、LENGTH_ENDIAN、MAX_PAYLOAD、Checksum（校验策略类型）、NAME
+2. 校验策略：Sum8 / Xor8 / Crc16Modbus / Crc16CcittFalse，统一成 init / update / store 三个静态函数
+   CRC 表在编译期生成；校验范围统一是“长度字段 + 载荷”（和 SimpleUartParser 一样）
+3. ProtocolParser<Traits>：和 SimpleUartParser 同一个状态机（帧头 → 长度 → 载荷 → 校验），
+   所有分支条件都是编译期常量（if constexpr），每种协议实例化出来的都是一份专用代码，没有运行时配置判断
+   顺便修了 SimpleUartParser 的一个老问题：长度为 0 时会多吃一个字节当载荷
+4. FrameParser：运行时接口，虚函数按“块”调用（不是按字节），块内循环是内联的专用代码
+5. ProtocolRegistry：协议名 → 工厂；每个通道按配置的协议名 create() 一个解析器（和 night16 的 Logger 一样用单例）
+6. main：
+   - 四个通道四种协议，各自按注册表挑解析器，收到的帧逐个核对
+   - Night 协议的模板实例和 SimpleUartParser、运行时配置版逐帧一致
+   - 吞吐：模板实例 vs 运行时配置版 vs 原版
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <map>
+#include <string>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// ---------------- 校验策略 ----------------
+
+//累加和（SimpleUartParser 用的就是这个）
+struct Sum8 {
+    using State = uint8_t;
+    static constexpr size_t BYTES = 1;
+    static constexpr const char* NAME = "sum8";
+    static constexpr State init(){return 0;}
+    static State update(State s, uint8_t b){return static_cast<uint8_t>(s + b);}
+    static void store(State s, uint8_t* out){out[0] = s;}
+};
+
+struct Xor8 {
+    using State = uint8_t;
+    static constexpr size_t BYTES = 1;
+    static constexpr const char* NAME = "xor8";
+    static constexpr State init(){return 0;}
+    static State update(State s, uint8_t b){return static_cast<uint8_t>(s ^ b);}
+    static void store(State s, uint8_t* out){out[0] = s;}
+};
+
+//反射多项式 0xA001 的 CRC16 查表（Modbus）
+constexpr std::array<uint16_t, 256> makeCrc16ReflectedTable(uint16_t poly){
+    std::array<uint16_t, 256> t{};
+    for(uint32_t i = 0; i < 256; i++){
+        uint16_t c = static_cast<uint16_t>(i);
+        for(int k = 0; k < 8; k++)
+            c = (c & 1) ? static_cast<uint16_t>((c >> 1) ^ poly) : static_cast<uint16_t>(c >> 1);
+        t[i] = c;
+    }
+    return t;
+}
+
+//不反射多项式 0x1021 的 CRC16 查表（CCITT-FALSE）
+constexpr std::array<uint16_t, 256> makeCrc16Table(uint16_t poly){
+    std::array<uint16_t, 256> t{};
+    for(uint32_t i = 0; i < 256; i++){
+        uint16_t c = static_cast<uint16_t>(i << 8);
+        for(int k = 0; k < 8; k++)
+            c = (c & 0x8000) ? static_cast<uint16_t>((c << 1) ^ poly) : static_cast<uint16_t>(c << 1);
+        t[i] = c;
+    }
+    return t;
+}
+
+//Modbus：初值 0xFFFF，线上小端
+struct Crc16Modbus {
+    using State = uint16_t;
+    static constexpr size_t BYTES = 2;
+    static constexpr const char* NAME = "crc16-modbus";
+    static constexpr std::array<uint16_t, 256> TABLE = makeCrc16ReflectedTable(0xA001);
+    static constexpr State init(){return 0xFFFF;}
+    static State update(State s, uint8_t b){return static_cast<uint16_t>((s >> 8) ^ TABLE[(s ^ b) & 0xFF]);}
+    static void store(State s, uint8_t* out){
+        out[0] = static_cast<uint8_t>(s);
+        out[1] = static_cast<uint8_t>(s >> 8);
+    }
+};
+
+//CCITT-FALSE：初值 0xFFFF，线上大端
+struct Crc16CcittFalse {
+    using State = uint16_t;
+    static constexpr size_t BYTES = 2;
+    static constexpr const char* NAME = "crc16-ccitt";
+    static constexpr std::array<uint16_t, 256> TABLE = makeCrc16Table(0x1021);
+    static constexpr State init(){return 0xFFFF;}
+    static State update(State s, uint8_t b){return static_cast<uint16_t>((s << 8) ^ TABLE[((s >> 8) ^ b) & 0xFF]);}
+    static void store(State s, uint8_t* out){
+        out[0] = static_cast<uint8_t>(s >> 8);
+        out[1] = static_cast<uint8_t>(s);
+    }
+};
+
+// ---------------- 协议特征 ----------------
+
+enum class Endian : uint8_t {LITTLE, BIG};
+
+//night10 以来的帧：AA 55 len payload sum8
+struct NightProtocol {
+    static constexpr const char* NAME = "night";
+    static constexpr uint8_t HEADER[] = {0xAA, 0x55};
+    static constexpr size_t LENGTH_BYTES = 1;
+    static constexpr Endian LENGTH_ENDIAN = Endian::LITTLE;
+    static constexpr size_t MAX_PAYLOAD = 32;
+    using Checksum = Sum8;
+};
+
+//传感器总线：7E lenLE16 payload crc16-modbus
+struct SensorBusProtocol {
+    static constexpr const char* NAME = "sensorbus";
+    static constexpr uint8_t HEADER[] = {0x7E};
+    static constexpr size_t LENGTH_BYTES = 2;
+    static constexpr Endian LENGTH_ENDIAN = Endian::LITTLE;
+    static constexpr size_t MAX_PAYLOAD = 256;
+    using Checksum = Crc16Modbus;
+};
+
+//遥测：EB 90 5A lenBE16 payload crc16-ccitt
+struct TelemetryProtocol {
+    static constexpr const char* NAME = "telemetry";
+    static constexpr uint8_t HEADER[] = {0xEB, 0x90, 0x5A};
+    static constexpr size_t LENGTH_BYTES = 2;
+    static constexpr Endian LENGTH_ENDIAN = Endian::BIG;
+    static constexpr size_t MAX_PAYLOAD = 1024;
+    using Checksum = Crc16CcittFalse;
+};
+
+//老设备：02 len payload xor8
+struct LegacyProtocol {
+    static constexpr const char* NAME = "legacy";
+    static constexpr uint8_t HEADER[] = {0x02};
+    static constexpr size_t LENGTH_BYTES = 1;
+    static constexpr Endian LENGTH_ENDIAN = Endian::LITTLE;
+    static constexpr size_t MAX_PAYLOAD = 64;
+    using Checksum = Xor8;
+};
+
+// ---------------- 模板解析器 ----------------
+
+/*
+帧头 → 长度 → 载荷 → 校验，和 SimpleUartParser 一样逐字节喂
+帧头对不上就回到等第一个字节（和 night10 一样，不回看）
+*/
+template <typename Traits>
+class ProtocolParser {
+public:
+    using Checksum = typename Traits::Checksum;
+    static constexpr size_t HEADER_LEN = sizeof(Traits::HEADER);
+    static constexpr size_t LENGTH_BYTES = Traits::LENGTH_BYTES;
+    static constexpr size_t MAX_PAYLOAD = Traits::MAX_PAYLOAD;
+    using Length = std::conditional_t<LENGTH_BYTES == 1, uint8_t, uint16_t>;
+
+    static_assert(HEADER_LEN >= 1 && HEADER_LEN <= 8, "header must be 1..8 bytes");
+    static_assert(LENGTH_BYTES == 1 || LENGTH_BYTES == 2, "length field must be 1 or 2 bytes");
+    static_assert(MAX_PAYLOAD >= 1 && MAX_PAYLOAD < (size_t(1) << (8 * LENGTH_BYTES)), "MAX_PAYLOAD must fit the length field");
+
+    explicit ProtocolParser(uint32_t timeoutMs) : timeout(timeoutMs) {
+        reset();
+    }
+
+    bool feed(uint8_t byte, uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case HEADER:
+                if(byte == Traits::HEADER[index]){
+                    if(++index == HEADER_LEN){
+                        state = LENGTH;
+                        index = 0;
+                        length = 0;
+                        checksum = Checksum::init();
+                    }
+                }
+                else{
+                    index = 0;
+                }
+                break;
+            case LENGTH:
+                checksum = Checksum::update(checksum, byte);
+                if constexpr (LENGTH_BYTES == 1)
+                    length = byte;
+                else if constexpr (Traits::LENGTH_ENDIAN == Endian::LITTLE)
+                    length = static_cast<Length>(length | (Length(byte) << (8 * index)));
+                else
+                    length = static_cast<Length>((length << 8) | byte);
+                if(++index == LENGTH_BYTES){
+                    if(length > MAX_PAYLOAD){
+                        reset();
+                    }
+                    else{
+                        index = 0;
+                        state = length ? PAYLOAD : TRAILER;
+                    }
+                }
+                break;
+            case PAYLOAD:
+                buffer[index++] = byte;
+                checksum = Checksum::update(checksum, byte);
+                if(index == length){
+                    index = 0;
+                    state = TRAILER;
+                }
+                break;
+            case TRAILER:
+                trailer[index++] = byte;
+                if(index == Checksum::BYTES){
+                    uint8_t expect[Checksum::BYTES];
+                    Checksum::store(checksum, expect);
+                    if(std::memcmp(expect, trailer, Checksum::BYTES) == 0){
+                        state = HEADER;
+                        index = 0;
+                        return true;
+                    }
+                    reset();
+                }
+                break;
+        }
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    const uint8_t* data() const {return buffer;}
+    size_t size() const {return length;}
+
+    void reset(){
+        state = HEADER;
+        index = 0;
+        length = 0;
+    }
+
+    //按同一个协议组一帧（测试和发送端用）
+    static std::vector<uint8_t> encode(const uint8_t* payload, size_t n){
+        if(n > MAX_PAYLOAD) throw std::length_error(std::string(Traits::NAME) + ": payload too long");
+        std::vector<uint8_t> f(Traits::HEADER, Traits::HEADER + HEADER_LEN);
+        uint8_t len[LENGTH_BYTES];
+        if constexpr (LENGTH_BYTES == 1){
+            len[0] = static_cast<uint8_t>(n);
+        }
+        else if constexpr (Traits::LENGTH_ENDIAN == Endian::LITTLE){
+            len[0] = static_cast<uint8_t>(n);
+            len[1] = static_cast<uint8_t>(n >> 8);
+        }
+        else{
+            len[0] = static_cast<uint8_t>(n >> 8);
+            len[1] = static_cast<uint8_t>(n);
+        }
+        auto crc = Checksum::init();
+        for(uint8_t b : len){
+            f.push_back(b);
+            crc = Checksum::update(crc, b);
+        }
+        for(size_t i = 0; i < n; i++){
+            f.push_back(payload[i]);
+            crc = Checksum::update(crc, payload[i]);
+        }
+        uint8_t t[Checksum::BYTES];
+        Checksum::store(crc, t);
+        f.insert(f.end(), t, t + Checksum::BYTES);
+        return f;
+    }
+
+private:
+    enum : uint8_t {HEADER, LENGTH, PAYLOAD, TRAILER};
+
+    uint8_t state;
+    Length index;                                   // 帧头/长度/校验里是第几个字节；载荷里是下标
+    Length length;
+    typename Checksum::State checksum{};
+    uint8_t trailer[Checksum::BYTES];
+    uint8_t buffer[MAX_PAYLOAD];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+// ---------------- 运行时接口和注册表 ----------------
+
+/*
+运行时看到的解析器：每块调用一次虚函数，块内是模板实例的内联循环
+帧回调用函数指针 + 上下文（虚函数不能是模板，也不想每帧构造 std::function）
+*/
+class FrameParser {
+public:
+    struct Sink {
+        void (*fn)(void* ctx, const uint8_t* p, size_t n);
+        void* ctx;
+    };
+
+    virtual ~FrameParser() = default;
+    virtual const char* protocol() const = 0;
+    virtual size_t maxPayload() const = 0;
+    virtual void feed(const uint8_t* p, size_t n, uint32_t now_ms, Sink sink) = 0;
+    virtual void reset() = 0;
+};
+
+template <typename F>
+FrameParser::Sink makeSink(F& f){
+    return FrameParser::Sink{[](void* ctx, const uint8_t* p, size_t n){ (*static_cast<F*>(ctx))(p, n); }, &f};
+}
+
+template <typename Traits>
+class ParserFor : public FrameParser {
+public:
+    explicit ParserFor(uint32_t timeoutMs) : _parser(timeoutMs) {}
+
+    const char* protocol() const override {return Traits::NAME;}
+    size_t maxPayload() const override {return Traits::MAX_PAYLOAD;}
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, Sink sink) override {
+        _parser.feed(p, n, now_ms, [&](const uint8_t* d, size_t len){ sink.fn(sink.ctx, d, len); });
+    }
+    void reset() override {_parser.reset();}
+
+private:
+    ProtocolParser<Traits> _parser;
+};
+
+/*
+协议名 → 工厂
+通道配置里写协议名，create() 给出对应的模板实例；不认识的名字抛 std::invalid_argument
+*/
+class ProtocolRegistry {
+public:
+    using Factory = std::unique_ptr<FrameParser> (*)(uint32_t timeoutMs);
+
+    static ProtocolRegistry& instance(){
+        static ProtocolRegistry registry;
+        return registry;
+    }
+
+    template <typename Traits>
+    void add(){
+        _factories[Traits::NAME] = [](uint32_t timeoutMs){
+            return std::unique_ptr<FrameParser>(new ParserFor<Traits>(timeoutMs));
+        };
+    }
+
+    std::unique_ptr<FrameParser> create(const std::string& name, uint32_t timeoutMs) const {
+        auto it = _factories.find(name);
+        if(it == _factories.end()){
+            std::string known;
+            for(auto& f : _factories) known += (known.empty() ? "" : ", ") + f.first;
+            throw std::invalid_argument("unknown protocol '" + name + "' (known: " + known + ")");
+        }
+        return it->second(timeoutMs);
+    }
+
+    std::vector<std::string> names() const {
+        std::vector<std::string> out;
+        for(auto& f : _factories) out.push_back(f.first);
+        return out;
+    }
+
+private:
+    ProtocolRegistry() = default;
+    std::map<std::string, Factory> _factories;
+};
+
+void registerBuiltinProtocols(){
+    ProtocolRegistry& r = ProtocolRegistry::instance();
+    r.add<NightProtocol>();
+    r.add<SensorBusProtocol>();
+    r.add<TelemetryProtocol>();
+    r.add<LegacyProtocol>();
+}
+
+// ---------------- 对照组 ----------------
+
+//原版（night20）
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+//运行时配置版：同一个状态机，协议参数放在成员里，每个字节都要判断
+enum class ChecksumKind : uint8_t {SUM8, XOR8, CRC16_MODBUS, CRC16_CCITT};
+
+struct RuntimeProtocol {
+    std::vector<uint8_t> header;
+    size_t lengthBytes;
+    Endian lengthEndian;
+    size_t maxPayload;
+    ChecksumKind checksum;
+};
+
+class RuntimeParser {
+public:
+    RuntimeParser(const RuntimeProtocol& proto, uint32_t timeoutMs)
+        : _proto(proto), _buffer(proto.maxPayload), _timeout(timeoutMs) {
+        reset();
+    }
+
+    bool feed(uint8_t byte, uint32_t now_ms){
+        if(now_ms - _lastTime > _timeout) reset();
+        _lastTime = now_ms;
+
+        switch(_state){
+            case 0:
+                if(byte == _proto.header[_index]){
+                    if(++_index == _proto.header.size()){
+                        _state = 1;
+                        _index = 0;
+                        _length = 0;
+                        _crc = initCrc();
+                    }
+                }
+                else{
+                    _index = 0;
+                }
+                break;
+            case 1:
+                _crc = updateCrc(_crc, byte);
+                if(_proto.lengthBytes == 1) _length = byte;
+                else if(_proto.lengthEndian == Endian::LITTLE) _length |= size_t(byte) << (8 * _index);
+                else _length = (_length << 8) | byte;
+                if(++_index == _proto.lengthBytes){
+                    if(_length > _proto.maxPayload){
+                        reset();
+                    }
+                    else{
+                        _index = 0;
+                        _state = _length ? 2 : 3;
+                    }
+                }
+                break;
+            case 2:
+                _buffer[_index++] = byte;
+                _crc = updateCrc(_crc, byte);
+                if(_index == _length){
+                    _index = 0;
+                    _state = 3;
+                }
+                break;
+            case 3: {
+                size_t bytes = (_proto.checksum == ChecksumKind::SUM8 || _proto.checksum == ChecksumKind::XOR8) ? 1 : 2;
+                _trailer[_index++] = byte;
+                if(_index == bytes){
+                    uint8_t expect[2];
+                    storeCrc(_crc, expect);
+                    if(std::memcmp(expect, _trailer, bytes) == 0){
+                        _state = 0;
+                        _index = 0;
+                        return true;
+                    }
+                    reset();
+                }
+                break;
+            }
+        }
+        return false;
+    }
+
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(_buffer.data(), _length);
+        }
+    }
+
+private:
+    void reset(){
+        _state = 0;
+        _index = 0;
+        _length = 0;
+    }
+
+    uint16_t initCrc() const {
+        switch(_proto.checksum){
+            case ChecksumKind::SUM8:         return Sum8::init();
+            case ChecksumKind::XOR8:         return Xor8::init();
+            case ChecksumKind::CRC16_MODBUS: return Crc16Modbus::init();
+            case ChecksumKind::CRC16_CCITT:  return Crc16CcittFalse::init();
+        }
+        return 0;
+    }
+
+    uint16_t updateCrc(uint16_t s, uint8_t b) const {
+        switch(_proto.checksum){
+            case ChecksumKind::SUM8:         return Sum8::update(static_cast<uint8_t>(s), b);
+            case ChecksumKind::XOR8:         return Xor8::update(static_cast<uint8_t>(s), b);
+            case ChecksumKind::CRC16_MODBUS: return Crc16Modbus::update(s, b);
+            case ChecksumKind::CRC16_CCITT:  return Crc16CcittFalse::update(s, b);
+        }
+        return 0;
+    }
+
+    void storeCrc(uint16_t s, uint8_t* out) const {
+        switch(_proto.checksum){
+            case ChecksumKind::SUM8:         Sum8::store(static_cast<uint8_t>(s), out); break;
+            case ChecksumKind::XOR8:         Xor8::store(static_cast<uint8_t>(s), out); break;
+            case ChecksumKind::CRC16_MODBUS: Crc16Modbus::store(s, out); break;
+            case ChecksumKind::CRC16_CCITT:  Crc16CcittFalse::store(s, out); break;
+        }
+    }
+
+    RuntimeProtocol _proto;
+    std::vector<uint8_t> _buffer;
+    uint8_t _trailer[2];
+    uint8_t _state = 0;
+    size_t _index = 0;
+    size_t _length = 0;
+    uint16_t _crc = 0;
+    uint32_t _timeout;
+    uint32_t _lastTime = 0;
+};
+
+// ---------------- 测试数据 ----------------
+
+struct Capture {
+    std::vector<uint8_t> bytes;
+    std::vector<std::vector<uint8_t>> expected;     // 应该收到的载荷（校验被改坏的帧不算）
+};
+
+//按协议生成一路数据：随机长度载荷，夹杂不含帧头首字节的噪声，1% 校验错
+template <typename Traits>
+Capture makeCapture(size_t frames, size_t maxLen, uint32_t seed){
+    using Parser = ProtocolParser<Traits>;
+    std::mt19937 rng(seed);
+    Capture c;
+    maxLen = std::min(maxLen, Traits::MAX_PAYLOAD);
+    for(size_t i = 0; i < frames; i++){
+        if(rng() % 50 == 0){
+            size_t n = 1 + rng() % 8;
+            for(size_t k = 0; k < n; k++){
+                uint8_t b = static_cast<uint8_t>(rng());
+                if(b == Traits::HEADER[0]) b ^= 0x01;
+                c.bytes.push_back(b);
+            }
+        }
+        std::vector<uint8_t> payload(1 + rng() % maxLen);
+        for(auto& b : payload) b = static_cast<uint8_t>(rng());
+        std::vector<uint8_t> f = Parser::encode(payload.data(), payload.size());
+        if(rng() % 100 == 0) f.back() ^= 0x01;
+        else c.expected.push_back(payload);
+        c.bytes.insert(c.bytes.end(), f.begin(), f.end());
+    }
+    return c;
+}
+
+template <typename F>
+double mbPerSec(const std::vector<uint8_t>& bytes, int reps, F&& run){
+    auto t0 = std::chrono::steady_clock::now();
+    for(int r = 0; r < reps; r++) run();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return bytes.size() * double(reps) / s / 1e6;
+}
+
+int main(){
+    try{
+        registerBuiltinProtocols();
+
+        // ---------- 1) 每个通道按配置的协议名挑解析器 ----------
+        struct ChannelConfig {
+            std::string name;
+            std::string protocol;
+            Capture capture;
+        };
+        std::vector<ChannelConfig> channels;
+        channels.push_back({"uart0", "night", makeCapture<NightProtocol>(20000, 32, 1)});
+        channels.push_back({"uart1", "sensorbus", makeCapture<SensorBusProtocol>(20000, 200, 2)});
+        channels.push_back({"uart2", "telemetry", makeCapture<TelemetryProtocol>(5000, 1024, 3)});
+        channels.push_back({"uart3", "legacy", makeCapture<LegacyProtocol>(20000, 64, 4)});
+
+        std::cout << "registered protocols:";
+        for(auto& n : ProtocolRegistry::instance().names()) std::cout << " " << n;
+        std::cout << "\n";
+
+        for(auto& ch : channels){
+            std::unique_ptr<FrameParser> parser = ProtocolRegistry::instance().create(ch.protocol, 50);
+            size_t got = 0, mismatched = 0;
+            auto onFrame = [&](const uint8_t* d, size_t n){
+                const auto& e = ch.capture.expected;
+                if(got >= e.size() || e[got].size() != n || std::memcmp(e[got].data(), d, n) != 0)
+                    mismatched++;
+                got++;
+            };
+            //按 64 字节一块喂，帧会跨块
+            const auto& bytes = ch.capture.bytes;
+            for(size_t off = 0; off < bytes.size(); off += 64)
+                parser->feed(bytes.data() + off, std::min<size_t>(64, bytes.size() - off), now_ms(), makeSink(onFrame));
+            std::cout << ch.name << " (" << std::left << std::setw(9) << parser->protocol() << std::right
+                      << ", max payload " << std::setw(4) << parser->maxPayload() << "): "
+                      << got << "/" << ch.capture.expected.size() << " frames"
+                      << (got == ch.capture.expected.size() && mismatched == 0 ? "  [ok]" : "  [MISMATCH]") << "\n";
+        }
+        try{
+            ProtocolRegistry::instance().create("canbus", 50);
+        }
+        catch(const std::invalid_argument& e){
+            std::cout << "create(\"canbus\"): " << e.what() << "\n";
+        }
+
+        // ---------- 2) Night 协议：模板实例、原版、运行时配置版逐帧一致 ----------
+        Capture night = makeCapture<NightProtocol>(400000, 32, 5);
+        RuntimeProtocol nightRt{{0xAA, 0x55}, 1, Endian::LITTLE, 32, ChecksumKind::SUM8};
+        std::vector<std::vector<uint8_t>> a, b, c;
+        {
+            ProtocolParser<NightProtocol> p(50);
+            p.feed(night.bytes.data(), night.bytes.size(), 0, [&](const uint8_t* d, size_t n){ a.emplace_back(d, d + n); });
+        }
+        {
+            SimpleUartParser p(50);
+            p.feed(night.bytes.data(), night.bytes.size(), 0, [&](const uint8_t* d, uint8_t n){ b.emplace_back(d, d + n); });
+        }
+        {
+            RuntimeParser p(nightRt, 50);
+            p.feed(night.bytes.data(), night.bytes.size(), 0, [&](const uint8_t* d, size_t n){ c.emplace_back(d, d + n); });
+        }
+        std::cout << "\nnight protocol, " << night.bytes.size() / 1024 << " KB: template " << a.size()
+                  << ", SimpleUartParser " << b.size() << ", runtime-configured " << c.size() << " frames"
+                  << (a == b && a == c && a == night.expected ? "  [identical]" : "  [DIFFERENT]") << "\n";
+
+        // ---------- 3) 吞吐 ----------
+        volatile size_t sink = 0;
+        const int REPS = 10;
+        std::cout << std::fixed << std::setprecision(0) << "\nthroughput (MB/s):\n";
+        std::cout << "  night     SimpleUartParser        " << mbPerSec(night.bytes, REPS, [&]{
+            SimpleUartParser p(50);
+            p.feed(night.bytes.data(), night.bytes.size(), 0, [&](const uint8_t*, uint8_t n){ sink = sink + n; });
+        }) << "\n";
+        std::cout << "  night     ProtocolParser<Night>   " << mbPerSec(night.bytes, REPS, [&]{
+            ProtocolParser<NightProtocol> p(50);
+            p.feed(night.bytes.data(), night.bytes.size(), 0, [&](const uint8_t*, size_t n){ sink = sink + n; });
+        }) << "\n";
+        std::cout << "  night     RuntimeParser           " << mbPerSec(night.bytes, REPS, [&]{
+            RuntimeParser p(nightRt, 50);
+            p.feed(night.bytes.data(), night.bytes.size(), 0, [&](const uint8_t*, size_t n){ sink = sink + n; });
+        }) << "\n";
+        std::cout << "  night     registry (256 B chunks) " << mbPerSec(night.bytes, REPS, [&]{
+            auto p = ProtocolRegistry::instance().create("night", 50);
+            auto f = [&](const uint8_t*, size_t n){ sink = sink + n; };
+            for(size_t off = 0; off < night.bytes.size(); off += 256)
+                p->feed(night.bytes.data() + off, std::min<size_t>(256, night.bytes.size() - off), 0, makeSink(f));
+        }) << "\n";
+
+        Capture tele = makeCapture<TelemetryProtocol>(20000, 1024, 6);
+        RuntimeProtocol teleRt{{0xEB, 0x90, 0x5A}, 2, Endian::BIG, 1024, ChecksumKind::CRC16_CCITT};
+        std::cout << "  telemetry ProtocolParser<Tele>    " << mbPerSec(tele.bytes, REPS, [&]{
+            ProtocolParser<TelemetryProtocol> p(50);
+            p.feed(tele.bytes.data(), tele.bytes.size(), 0, [&](const uint8_t*, size_t n){ sink = sink + n; });
+        }) << "\n";
+        std::cout << "  telemetry RuntimeParser           " << mbPerSec(tele.bytes, REPS, [&]{
+            RuntimeParser p(teleRt, 50);
+            p.feed(tele.bytes.data(), tele.bytes.size(), 0, [&](const uint8_t*, size_t n){ sink = sink + n; });
+        }) << "\n";
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
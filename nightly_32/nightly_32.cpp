@@ -0,0 +1,508 @@
+/*
+解码后帧的批量输出：不分配内存、不走 iostream
+
+问题：
+StreamProcessor::processStream 收到一帧就 std::cout << int(...) 逐字节打印再 std::endl
+night6 的每个字段也都是 iostream 格式化
+帧率一高，格式化 + 每帧刷新比解析本身还贵：locale、sentry、虚函数、每次 endl 一次 write 系统调用
+
+night32 的做法：
+1. 手写整数/定点数格式化：两位一查的数字表，从低位往高位写到栈上小缓冲再拷过去
+   温度 x100、偏航角 x10 这种定点数直接按整数拆成“整数部分.小数部分”，不经过 double
+2. FrameSink 三种格式：BINARY（定长 25 字节小端记录）、CSV、JSON Lines
+3. 缓冲区在构造时一次分配好：若干个固定大小的块，一条记录总是完整写进一个块
+   块写满换下一块，块都用完了才用一次 writev 把所有块一起交给内核
+   writev 写不完（管道满）就接着写剩下的部分，EINTR 重试，其它错误抛 std::system_error
+4. 热路径不分配：main 里用全局 operator new 计数验证
+5. main：
+   - CSV / JSON 输出和 snprintf 参考结果逐字节比对；BINARY 读回来和原记录比对
+   - 吞吐（帧/秒）：写文件、写管道，对比 iostream + endl、iostream + '\n'
+*/
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <system_error>
+#include <new>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+// ---------------- 分配计数（只用来验证热路径不分配） ----------------
+
+static std::atomic<uint64_t> g_allocs{0};
+
+void* operator new(size_t n){
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete(void* p, size_t) noexcept {std::free(p);}
+
+uint64_t nowNs(){
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------- 解码后的记录（night6 的传感器帧） ----------------
+
+struct Sample {
+    uint64_t ts_ns = 0;
+    uint8_t type = 0;
+    uint32_t seq = 0;
+    uint32_t pressure = 0;
+    int16_t temp_x100 = 0;
+    uint16_t voltage = 0;
+    int32_t yaw_x10 = 0;
+};
+
+// ---------------- 手写格式化 ----------------
+
+//"00".."99"，一次出两位
+static constexpr char kDigits2[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+//无符号整数写到 p，返回写完后的位置
+inline char* fmtU64(char* p, uint64_t v){
+    char tmp[20];
+    char* e = tmp + sizeof(tmp);
+    char* s = e;
+    while(v >= 100){
+        unsigned d = static_cast<unsigned>(v % 100);
+        v /= 100;
+        s -= 2;
+        std::memcpy(s, &kDigits2[d * 2], 2);
+    }
+    if(v >= 10){
+        s -= 2;
+        std::memcpy(s, &kDigits2[v * 2], 2);
+    }
+    else{
+        *--s = static_cast<char>('0' + v);
+    }
+    size_t n = static_cast<size_t>(e - s);
+    std::memcpy(p, s, n);
+    return p + n;
+}
+
+//定点数：value / 10^decimals，按 decimals 位小数输出（-5, 2 → "-0.05"）
+inline char* fmtFixed(char* p, int64_t value, unsigned decimals){
+    static constexpr uint64_t kPow10[] = {1, 10, 100, 1000, 10000, 100000};
+    uint64_t mag = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    if(value < 0) *p++ = '-';
+    p = fmtU64(p, mag / kPow10[decimals]);
+    if(decimals == 0) return p;
+    *p++ = '.';
+    uint64_t frac = mag % kPow10[decimals];
+    for(unsigned i = decimals; i-- > 0;){
+        p[i] = static_cast<char>('0' + frac % 10);
+        frac /= 10;
+    }
+    return p + decimals;
+}
+
+template <size_t N>
+inline char* put(char* p, const char (&s)[N]){
+    std::memcpy(p, s, N - 1);
+    return p + N - 1;
+}
+
+inline char* putLe(char* p, uint64_t v, size_t bytes){
+    for(size_t i = 0; i < bytes; i++) p[i] = static_cast<char>(v >> (8 * i));
+    return p + bytes;
+}
+
+// ---------------- FrameSink ----------------
+
+enum class OutputFormat : uint8_t {BINARY, CSV, JSONL};
+
+const char* formatName(OutputFormat f){
+    switch(f){
+        case OutputFormat::BINARY: return "binary";
+        case OutputFormat::CSV:    return "csv";
+        case OutputFormat::JSONL:  return "jsonl";
+    }
+    return "?";
+}
+
+struct SinkStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t writevCalls = 0;
+};
+
+/*
+记录格式化进预先分配好的块，块用完一次 writev 全部写出
+不拥有 fd；析构时把剩下的写出去（析构里出错只能吞掉，需要知道结果就先显式 flush()）
+*/
+class FrameSink {
+public:
+    static constexpr size_t BINARY_RECORD = 25;     // ts8 type1 seq4 pressure4 temp2 voltage2 yaw4
+    static constexpr size_t MAX_RECORD = 160;       // 最长的 JSON 行也放得下
+
+    FrameSink(int fd, OutputFormat format, size_t blockSize = 64 * 1024, size_t blockCount = 16)
+        : _fd(fd), _format(format), _blockSize(blockSize),
+          _blockCount(std::min<size_t>(blockCount, IOV_MAX)),
+          _storage(_blockSize * _blockCount), _iov(_blockCount) {
+        if(_blockSize < MAX_RECORD || _blockCount == 0)
+            throw std::invalid_argument("FrameSink: block must hold at least one record");
+        _cur = _storage.data();
+        _end = _cur + _blockSize;
+    }
+
+    FrameSink(const FrameSink&) = delete;
+    FrameSink& operator=(const FrameSink&) = delete;
+
+    ~FrameSink(){
+        try{
+            flush();
+        }
+        catch(...){
+        }
+    }
+
+    void write(const Sample& s){
+        if(static_cast<size_t>(_end - _cur) < MAX_RECORD) nextBlock();
+        char* p = _cur;
+        switch(_format){
+            case OutputFormat::BINARY:
+                p = putLe(p, s.ts_ns, 8);
+                p = putLe(p, s.type, 1);
+                p = putLe(p, s.seq, 4);
+                p = putLe(p, s.pressure, 4);
+                p = putLe(p, static_cast<uint16_t>(s.temp_x100), 2);
+                p = putLe(p, s.voltage, 2);
+                p = putLe(p, static_cast<uint32_t>(s.yaw_x10), 4);
+                break;
+            case OutputFormat::CSV:
+                p = fmtU64(p, s.ts_ns);         *p++ = ',';
+                p = fmtU64(p, s.type);          *p++ = ',';
+                p = fmtU64(p, s.seq);           *p++ = ',';
+                p = fmtU64(p, s.pressure);      *p++ = ',';
+                p = fmtFixed(p, s.temp_x100, 2); *p++ = ',';
+                p = fmtU64(p, s.voltage);       *p++ = ',';
+                p = fmtFixed(p, s.yaw_x10, 1);  *p++ = '\n';
+                break;
+            case OutputFormat::JSONL:
+                p = put(p, "{\"ts\":");         p = fmtU64(p, s.ts_ns);
+                p = put(p, ",\"type\":");       p = fmtU64(p, s.type);
+                p = put(p, ",\"seq\":");        p = fmtU64(p, s.seq);
+                p = put(p, ",\"pressure\":");   p = fmtU64(p, s.pressure);
+                p = put(p, ",\"temp\":");       p = fmtFixed(p, s.temp_x100, 2);
+                p = put(p, ",\"voltage\":");    p = fmtU64(p, s.voltage);
+                p = put(p, ",\"yaw\":");        p = fmtFixed(p, s.yaw_x10, 1);
+                p = put(p, "}\n");
+                break;
+        }
+        _cur = p;
+        _stats.frames++;
+    }
+
+    //CSV 表头（BINARY / JSONL 没有）
+    void writeHeader(){
+        if(_format != OutputFormat::CSV) return;
+        if(static_cast<size_t>(_end - _cur) < MAX_RECORD) nextBlock();
+        _cur = put(_cur, "ts_ns,type,seq,pressure,temp_c,voltage_mv,yaw_deg\n");
+    }
+
+    //把已经格式化的所有块一次写出
+    void flush(){
+        size_t n = _used;
+        char* blockStart = _storage.data() + _used * _blockSize;
+        if(_cur != blockStart){
+            _iov[n].iov_base = blockStart;
+            _iov[n].iov_len = static_cast<size_t>(_cur - blockStart);
+            n++;
+        }
+        if(n == 0) return;
+        writeAll(_iov.data(), static_cast<int>(n));
+        _used = 0;
+        _cur = _storage.data();
+        _end = _cur + _blockSize;
+    }
+
+    const SinkStats& stats() const {return _stats;}
+
+private:
+    void nextBlock(){
+        char* blockStart = _storage.data() + _used * _blockSize;
+        _iov[_used].iov_base = blockStart;
+        _iov[_used].iov_len = static_cast<size_t>(_cur - blockStart);
+        if(++_used == _blockCount){
+            writeAll(_iov.data(), static_cast<int>(_used));
+            _used = 0;
+        }
+        _cur = _storage.data() + _used * _blockSize;
+        _end = _cur + _blockSize;
+    }
+
+    //writev 可能只写一部分（管道、信号），跳过已写的再写
+    void writeAll(iovec* iov, int cnt){
+        for(int i = 0; i < cnt; i++) _stats.bytes += iov[i].iov_len;
+        while(cnt > 0){
+            ssize_t w = ::writev(_fd, iov, cnt);
+            _stats.writevCalls++;
+            if(w < 0){
+                if(errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "writev");
+            }
+            size_t left = static_cast<size_t>(w);
+            while(cnt > 0 && left >= iov->iov_len){
+                left -= iov->iov_len;
+                iov++;
+                cnt--;
+            }
+            if(cnt > 0){
+                iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+    }
+
+    int _fd;
+    OutputFormat _format;
+    size_t _blockSize;
+    size_t _blockCount;
+    std::vector<char> _storage;
+    std::vector<iovec> _iov;
+    size_t _used = 0;                               // 已经写满、等着 writev 的块数
+    char* _cur = nullptr;
+    char* _end = nullptr;
+    SinkStats _stats;
+};
+
+// ---------------- 测试数据和对照 ----------------
+
+std::vector<Sample> makeSamples(size_t n, uint32_t seed){
+    std::mt19937 rng(seed);
+    std::vector<Sample> out(n);
+    uint64_t ts = 1'700'000'000'000'000'000ULL;
+    for(size_t i = 0; i < n; i++){
+        Sample& s = out[i];
+        ts += 1000 + rng() % 100000;
+        s.ts_ns = ts;
+        s.type = static_cast<uint8_t>(0x10 | (rng() & 0x03));
+        s.seq = static_cast<uint32_t>(i);
+        s.pressure = 95000 + rng() % 10000;
+        s.temp_x100 = static_cast<int16_t>(static_cast<int>(rng() % 10000) - 4000);
+        s.voltage = static_cast<uint16_t>(11000 + rng() % 2000);
+        s.yaw_x10 = static_cast<int32_t>(rng() % 3601) - 1800;
+    }
+    //边界值
+    out[0].temp_x100 = -5;  out[0].yaw_x10 = -1;
+    out[1].temp_x100 = 0;   out[1].yaw_x10 = 0;
+    out[2].temp_x100 = INT16_MIN; out[2].yaw_x10 = INT32_MIN;
+    out[3].temp_x100 = INT16_MAX; out[3].yaw_x10 = INT32_MAX;
+    out[4].seq = UINT32_MAX; out[4].pressure = UINT32_MAX;
+    return out;
+}
+
+//snprintf 参考实现：定点数用整数拆，不用 %f（避免二进制浮点的舍入差异）
+std::string referenceLine(const Sample& s, OutputFormat f){
+    auto fixed = [](int64_t v, int64_t scale, int width){
+        char b[32];
+        uint64_t m = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+        std::snprintf(b, sizeof(b), "%s%llu.%0*llu", v < 0 ? "-" : "", (unsigned long long)(m / scale), width,
+                      (unsigned long long)(m % scale));
+        return std::string(b);
+    };
+    char b[256];
+    if(f == OutputFormat::CSV)
+        std::snprintf(b, sizeof(b), "%llu,%u,%u,%u,%s,%u,%s\n", (unsigned long long)s.ts_ns, s.type, s.seq, s.pressure,
+                      fixed(s.temp_x100, 100, 2).c_str(), s.voltage, fixed(s.yaw_x10, 10, 1).c_str());
+    else
+        std::snprintf(b, sizeof(b), "{\"ts\":%llu,\"type\":%u,\"seq\":%u,\"pressure\":%u,\"temp\":%s,\"voltage\":%u,\"yaw\":%s}\n",
+                      (unsigned long long)s.ts_ns, s.type, s.seq, s.pressure,
+                      fixed(s.temp_x100, 100, 2).c_str(), s.voltage, fixed(s.yaw_x10, 10, 1).c_str());
+    return b;
+}
+
+std::string readFile(const std::string& path){
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+int openOut(const std::string& path){
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+    return fd;
+}
+
+//管道另一头：一直读，丢掉
+class PipeDrain {
+public:
+    PipeDrain(){
+        if(::pipe(_fds) != 0) throw std::system_error(errno, std::generic_category(), "pipe");
+        _reader = std::thread([this]{
+            static char buf[1 << 16];
+            while(true){
+                ssize_t r = ::read(_fds[0], buf, sizeof(buf));
+                if(r > 0) _bytes += static_cast<uint64_t>(r);
+                else if(r == 0 || errno != EINTR) break;
+            }
+        });
+    }
+    ~PipeDrain(){
+        closeWrite();
+        _reader.join();
+        ::close(_fds[0]);
+    }
+    int fd() const {return _fds[1];}
+    void closeWrite(){
+        if(_fds[1] >= 0){
+            ::close(_fds[1]);
+            _fds[1] = -1;
+        }
+    }
+    uint64_t bytes() const {return _bytes;}
+
+private:
+    int _fds[2];
+    std::thread _reader;
+    std::atomic<uint64_t> _bytes{0};
+};
+
+//原来的写法：每个字段 operator<<，定点数转 double，每帧 endl
+void iostreamWrite(std::ostream& os, const Sample& s, bool endlEachFrame){
+    os << s.ts_ns << "," << int(s.type) << "," << s.seq << "," << s.pressure << ","
+       << std::fixed << std::setprecision(2) << s.temp_x100 / 100.0 << ","
+       << s.voltage << "," << std::setprecision(1) << s.yaw_x10 / 10.0;
+    if(endlEachFrame) os << std::endl;
+    else os << '\n';
+}
+
+struct BenchResult {
+    double framesPerSec;
+    double mbPerSec;
+    uint64_t writevCalls;
+    uint64_t allocs;
+};
+
+BenchResult benchSink(int fd, OutputFormat f, const std::vector<Sample>& samples){
+    FrameSink sink(fd, f);
+    uint64_t a0 = g_allocs.load();
+    uint64_t t0 = nowNs();
+    for(const Sample& s : samples) sink.write(s);
+    sink.flush();
+    double sec = (nowNs() - t0) / 1e9;
+    uint64_t allocs = g_allocs.load() - a0;
+    return {samples.size() / sec, sink.stats().bytes / sec / 1e6, sink.stats().writevCalls, allocs};
+}
+
+void printRow(const std::string& name, const BenchResult& r){
+    std::cout << "  " << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setw(7) << std::setprecision(2) << r.framesPerSec / 1e6 << " M frames/s"
+              << std::setw(8) << std::setprecision(0) << r.mbPerSec << " MB/s";
+    if(r.writevCalls) std::cout << "  writev=" << std::setw(5) << r.writevCalls << "  allocs=" << r.allocs;
+    std::cout << "\n";
+}
+
+int main(){
+    try{
+        const std::string path = "/tmp/nightly_32.out";
+
+        // ---------- 1) 正确性：和 snprintf 参考逐字节比对，二进制读回比对 ----------
+        std::vector<Sample> check = makeSamples(200000, 1);
+        for(OutputFormat f : {OutputFormat::CSV, OutputFormat::JSONL}){
+            int fd = openOut(path);
+            {
+                FrameSink sink(fd, f, 4096, 4);     // 小块：多次换块、多次 writev
+                for(const Sample& s : check) sink.write(s);
+                sink.flush();
+            }
+            ::close(fd);
+            std::string expect;
+            for(const Sample& s : check) expect += referenceLine(s, f);
+            std::string got = readFile(path);
+            std::cout << std::left << std::setw(7) << formatName(f) << std::right << " "
+                      << check.size() << " frames, " << got.size() << " bytes"
+                      << (got == expect ? "  [matches snprintf]" : "  [MISMATCH]") << "\n";
+            if(f == OutputFormat::CSV) std::cout << "  e.g. " << referenceLine(check[0], f);
+            else std::cout << "  e.g. " << referenceLine(check[2], f);
+        }
+        {
+            int fd = openOut(path);
+            {
+                FrameSink sink(fd, OutputFormat::BINARY, 4096, 4);
+                for(const Sample& s : check) sink.write(s);
+                sink.flush();
+            }
+            ::close(fd);
+            std::string got = readFile(path);
+            bool ok = got.size() == check.size() * FrameSink::BINARY_RECORD;
+            auto rd = [&](size_t off, size_t n){
+                uint64_t v = 0;
+                for(size_t i = 0; i < n; i++) v |= uint64_t(uint8_t(got[off + i])) << (8 * i);
+                return v;
+            };
+            for(size_t i = 0; ok && i < check.size(); i++){
+                size_t o = i * FrameSink::BINARY_RECORD;
+                const Sample& s = check[i];
+                ok = rd(o, 8) == s.ts_ns && rd(o + 8, 1) == s.type && rd(o + 9, 4) == s.seq
+                     && rd(o + 13, 4) == s.pressure && static_cast<int16_t>(rd(o + 17, 2)) == s.temp_x100
+                     && rd(o + 19, 2) == s.voltage && static_cast<int32_t>(rd(o + 21, 4)) == s.yaw_x10;
+            }
+            std::cout << "binary  " << check.size() << " frames, " << got.size() << " bytes"
+                      << (ok ? "  [round-trips]" : "  [MISMATCH]") << "\n";
+        }
+
+        // ---------- 2) 吞吐 ----------
+        std::vector<Sample> samples = makeSamples(2000000, 2);
+        std::cout << "\n" << samples.size() << " frames -> file\n";
+        {
+            std::ofstream os(path, std::ios::trunc);
+            uint64_t t0 = nowNs();
+            for(const Sample& s : samples) iostreamWrite(os, s, true);
+            double sec = (nowNs() - t0) / 1e9;
+            printRow("iostream + endl", {samples.size() / sec, double(os.tellp()) / sec / 1e6, 0, 0});
+        }
+        {
+            std::ofstream os(path, std::ios::trunc);
+            uint64_t t0 = nowNs();
+            for(const Sample& s : samples) iostreamWrite(os, s, false);
+            os.flush();
+            double sec = (nowNs() - t0) / 1e9;
+            printRow("iostream + '\\n'", {samples.size() / sec, double(os.tellp()) / sec / 1e6, 0, 0});
+        }
+        for(OutputFormat f : {OutputFormat::CSV, OutputFormat::JSONL, OutputFormat::BINARY}){
+            int fd = openOut(path);
+            BenchResult r = benchSink(fd, f, samples);
+            ::close(fd);
+            printRow(std::string("FrameSink ") + formatName(f), r);
+        }
+
+        std::cout << samples.size() << " frames -> pipe\n";
+        for(OutputFormat f : {OutputFormat::CSV, OutputFormat::JSONL, OutputFormat::BINARY}){
+            PipeDrain pipe;
+            BenchResult r = benchSink(pipe.fd(), f, samples);
+            printRow(std::string("FrameSink ") + formatName(f), r);
+        }
+        ::unlink(path.c_str());
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
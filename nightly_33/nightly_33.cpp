@@ -0,0 +1,586 @@
+/*
+可注入的时钟：超时测试加速、回放可重复
+
+问题：
+SimpleUartParser::feed 的超时、FSM::tick()/timeoutOf() 的状态超时、night3/4 轮询循环里的 sleep_for
+全都直接读 steady_clock 或者真睡
+超时相关的长稳测试要跑几个小时，回放也做不到每次结果一样
+
+night33 的做法：
+1. 时钟做成模板参数（和 night31 的协议特征一样是编译期注入），组件只持有 Clock&
+   Clock 只要提供 nowMs() / sleepUntil(ms) / sleepFor(ms)
+   - SteadyClock：生产用，nowMs() 就是 steady_clock，内联后和直接调用一模一样，没有虚函数
+   - SimClock：虚拟时间，手动 advance()；或者 autoAdvance 模式下 sleepUntil 直接把时间跳过去
+     多线程时 sleepUntil 阻塞在条件变量上，等别的线程 advance 到点再醒
+   - ScaledClock：N 倍速，虚拟时间 = 起点 + 真实流逝 × N，sleep 真睡 1/N
+2. SimpleUartParser<Clock>、FSM<Clock>、pollLoop<Clock>：原来读 steady_clock 的地方都换成 clock
+3. 24 小时场景：串口设备断续发帧（偶尔帧中途卡住超过解析器超时）、状态机事件间隔随机（有的会超时）、
+   100ms 一次的 tick 轮询；所有结果（收帧、丢帧、每次状态转移的时间点）算一个摘要
+   SimClock 跑两遍摘要必须一样，墙钟不到一秒
+4. 生产时钟零开销：同一个解析器用 SteadyClock 注入 vs 调用方每字节调 now_ms()，ns/字节对比
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+uint64_t nowNs(){
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------- 时钟 ----------------
+
+//生产用：就是 steady_clock，毫秒、uint32 回绕（和 now_ms() 一样，差值用无符号减法）
+struct SteadyClock {
+    uint32_t nowMs() const {return now_ms();}
+
+    void sleepUntil(uint32_t t) const {
+        uint32_t now = nowMs();
+        if(static_cast<int32_t>(t - now) > 0) sleepFor(t - now);
+    }
+
+    void sleepFor(uint32_t ms) const {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+};
+
+/*
+虚拟时钟
+autoAdvance=true：单线程驱动，sleepUntil 直接把时间跳到目标（离散事件仿真）
+autoAdvance=false：由测试线程 advance()，睡在 sleepUntil 里的线程到点被唤醒
+*/
+class SimClock {
+public:
+    explicit SimClock(uint32_t startMs = 0, bool autoAdvance = true)
+        : _now(startMs), _autoAdvance(autoAdvance) {}
+
+    uint32_t nowMs() const {return _now.load(std::memory_order_acquire);}
+
+    void advance(uint32_t ms){
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _now.fetch_add(ms, std::memory_order_acq_rel);
+        }
+        _cv.notify_all();
+    }
+
+    void sleepUntil(uint32_t t){
+        if(_autoAdvance){
+            uint32_t now = nowMs();
+            if(static_cast<int32_t>(t - now) > 0) advance(t - now);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(_mtx);
+        auto it = _sleepers.insert(t);
+        _cv.wait(lock, [&]{return static_cast<int32_t>(t - nowMs()) <= 0;});
+        _sleepers.erase(it);
+    }
+
+    void sleepFor(uint32_t ms){sleepUntil(nowMs() + ms);}
+
+    //手动模式下测试线程用：等到有 n 个线程睡在时钟上（目标时间还没到）再推进，避免推进早了
+    void waitForSleepers(size_t n){
+        while(true){
+            {
+                std::lock_guard<std::mutex> lock(_mtx);
+                size_t pending = 0;
+                for(uint32_t t : _sleepers)
+                    if(static_cast<int32_t>(t - nowMs()) > 0) pending++;
+                if(pending >= n) return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::atomic<uint32_t> _now;
+    bool _autoAdvance;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::multiset<uint32_t> _sleepers;              // 睡在 sleepUntil 里的目标时间
+};
+
+//N 倍速：真实时间的 N 倍流逝；真睡 1/N（结果受调度抖动影响，不保证可重复）
+class ScaledClock {
+public:
+    ScaledClock(uint32_t startMs, double speed)
+        : _startMs(startMs), _speed(speed), _realStart(std::chrono::steady_clock::now()) {}
+
+    uint32_t nowMs() const {
+        double real = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _realStart).count();
+        return _startMs + static_cast<uint32_t>(real * _speed);
+    }
+
+    void sleepUntil(uint32_t t) const {
+        uint32_t now = nowMs();
+        if(static_cast<int32_t>(t - now) > 0) sleepFor(t - now);
+    }
+
+    void sleepFor(uint32_t ms) const {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms / _speed));
+    }
+
+private:
+    uint32_t _startMs;
+    double _speed;
+    std::chrono::steady_clock::time_point _realStart;
+};
+
+// ---------------- 组件：解析器 ----------------
+
+//帧解析器（沿用 night20），时间从注入的时钟读；feed(byte, now) 保留给已经拿到时间戳的调用方
+template <typename Clock>
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(Clock& clock, uint32_t timeout_ms) : _clock(clock), timeout(timeout_ms){
+        reset();
+    }
+
+    bool feed(uint8_t byte){
+        return feed(byte, _clock.nowMs());
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+private:
+    Clock& _clock;
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+// ---------------- 组件：状态机 ----------------
+
+enum class State : uint8_t {GETUP = 0, GO_SCHOOL, EAT, DO_HOMEWORK, GO_SLEEP, TIMEOUT, ERROR, COUNT};
+enum class Events : uint8_t {EVENT1 = 0, EVENT2, EVENT3, EVENT_TIMEOUT, COUNT};
+
+constexpr size_t STATE_COUNT = static_cast<size_t>(State::COUNT);
+constexpr size_t EVENT_COUNT = static_cast<size_t>(Events::COUNT);
+constexpr uint8_t NO_TRANSITION = 0xFF;
+
+struct Transition {
+    State curState;
+    Events event;
+    State nextState;
+};
+
+constexpr Transition kStudentTable[] = {
+    {State::GETUP,       Events::EVENT1, State::GO_SCHOOL},
+    {State::GO_SCHOOL,   Events::EVENT2, State::EAT},
+    {State::EAT,         Events::EVENT3, State::DO_HOMEWORK},
+    {State::DO_HOMEWORK, Events::EVENT1, State::GO_SLEEP},
+    {State::GO_SLEEP,    Events::EVENT2, State::GETUP},
+    {State::GETUP,       Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SCHOOL,   Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::EAT,         Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::DO_HOMEWORK, Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::GO_SLEEP,    Events::EVENT_TIMEOUT, State::TIMEOUT},
+    {State::TIMEOUT, Events::EVENT1, State::GETUP},
+    {State::TIMEOUT, Events::EVENT3, State::ERROR},
+    {State::ERROR,   Events::EVENT1, State::GETUP},
+};
+
+template <size_t N>
+constexpr array<uint8_t, STATE_COUNT * EVENT_COUNT> buildJumpTable(const Transition (&t)[N]) {
+    array<uint8_t, STATE_COUNT * EVENT_COUNT> jump{};
+    for (size_t i = 0; i < jump.size(); i++)
+        jump[i] = NO_TRANSITION;
+    for (size_t i = 0; i < N; i++)
+        jump[static_cast<size_t>(t[i].curState) * EVENT_COUNT + static_cast<size_t>(t[i].event)] = static_cast<uint8_t>(i);
+    return jump;
+}
+
+constexpr auto kJump = buildJumpTable(kStudentTable);
+
+constexpr uint32_t timeoutOf(State s) {
+    switch (s) {
+    case State::GETUP:        return 1500;
+    case State::GO_SCHOOL:    return 1200;
+    case State::EAT:          return 1000;
+    case State::DO_HOMEWORK:  return 2000;
+    case State::GO_SLEEP:     return 1500;
+    default:                  return 0;
+    }
+}
+
+//FNV-1a：场景结果摘要
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+inline uint64_t fnv1a(uint64_t h, uint64_t v, size_t bytes){
+    for(size_t i = 0; i < bytes; i++) h = (h ^ ((v >> (8 * i)) & 0xFF)) * FNV_PRIME;
+    return h;
+}
+
+//night8 的状态机：进入时间从时钟读，tick() 按 timeoutOf 判超时；每次转移（时间、现态、次态）记进摘要
+template <typename Clock>
+class FSM {
+public:
+    explicit FSM(Clock& clock, State initial = State::GETUP)
+        : _clock(clock), _state(initial), _lastState(initial), _enterMs(clock.nowMs()) {}
+
+    void handleEvent(Events event){
+        uint32_t now = _clock.nowMs();
+        uint8_t k = kJump[static_cast<size_t>(_state) * EVENT_COUNT + static_cast<size_t>(event)];
+        State next = (k != NO_TRANSITION) ? kStudentTable[k].nextState : State::ERROR;
+        if(event == Events::EVENT_TIMEOUT) _timeouts++;
+        if(k == NO_TRANSITION) _errors++;
+        _digest = fnv1a(_digest, now, 4);
+        _digest = fnv1a(_digest, static_cast<uint8_t>(_state), 1);
+        _digest = fnv1a(_digest, static_cast<uint8_t>(next), 1);
+        _transitions++;
+        _lastState = _state;
+        _state = next;
+        _enterMs = now;
+    }
+
+    //超时检测：当前状态待够 timeoutOf 就投递 EVENT_TIMEOUT
+    void tick(){
+        uint32_t to = timeoutOf(_state);
+        if(to && _clock.nowMs() - _enterMs >= to)
+            handleEvent(Events::EVENT_TIMEOUT);
+    }
+
+    State state() const {return _state;}
+    uint64_t transitions() const {return _transitions;}
+    uint64_t timeouts() const {return _timeouts;}
+    uint64_t errors() const {return _errors;}
+    uint64_t digest() const {return _digest;}
+
+private:
+    Clock& _clock;
+    State _state;
+    State _lastState;
+    uint32_t _enterMs;
+    uint64_t _transitions = 0;
+    uint64_t _timeouts = 0;
+    uint64_t _errors = 0;
+    uint64_t _digest = FNV_OFFSET;
+};
+
+// ---------------- 组件：轮询循环（night3/4） ----------------
+
+/*
+night3/4 的主循环：每 periodMs 取一次标志位，直到处理够 expected 个或超过 limitMs
+sleep 和超时判断都走时钟
+*/
+template <typename Clock>
+uint64_t pollLoop(Clock& clock, std::atomic<uint32_t>& flag, uint64_t expected, uint32_t periodMs, uint32_t limitMs){
+    uint64_t handled = 0;
+    uint32_t start = clock.nowMs();
+    while(handled < expected){
+        handled += flag.exchange(0, std::memory_order_acq_rel);
+        if(handled >= expected) break;
+        clock.sleepFor(periodMs);
+        if(clock.nowMs() - start > limitMs) break;
+    }
+    return handled;
+}
+
+// ---------------- 24 小时场景 ----------------
+
+struct ScenarioConfig {
+    uint32_t durationMs;
+    bool uart;
+    uint32_t seed;
+    uint32_t parserTimeoutMs = 50;
+    uint32_t tickMs = 100;
+};
+
+struct ScenarioResult {
+    uint64_t framesSent = 0;            // 发完的帧（场景结束时没发完的不算）
+    uint64_t framesStalled = 0;         // 帧中途卡住超过解析器超时的
+    uint64_t framesReceived = 0;
+    uint64_t fsmEvents = 0;
+    uint64_t transitions = 0;
+    uint64_t timeouts = 0;
+    uint64_t ticks = 0;
+    uint64_t digest = 0;
+};
+
+/*
+离散事件驱动：下一个串口字节 / 下一个状态机事件 / 下一个 tick 谁先到就 sleepUntil 到谁
+所有随机数都来自 seed，时间都来自 clock
+*/
+template <typename Clock>
+ScenarioResult runScenario(Clock& clock, const ScenarioConfig& cfg){
+    std::mt19937 rng(cfg.seed);
+    SimpleUartParser<Clock> parser(clock, cfg.parserTimeoutMs);
+    FSM<Clock> fsm(clock);
+    ScenarioResult r;
+    uint64_t frameDigest = FNV_OFFSET;
+
+    const uint32_t start = clock.nowMs();
+    auto at = [&](uint32_t offset){return start + offset;};
+
+    //串口：当前正在发的帧
+    std::vector<uint8_t> frame;
+    size_t framePos = 0;
+    bool frameStalled = false;
+    uint32_t nextByte = 0;
+    auto newFrame = [&](){
+        frame.assign({0xAA, 0x55});
+        uint8_t len = static_cast<uint8_t>(1 + rng() % 32);
+        frame.push_back(len);
+        uint8_t sum = len;
+        for(uint8_t i = 0; i < len; i++){
+            uint8_t b = static_cast<uint8_t>(rng());
+            frame.push_back(b);
+            sum += b;
+        }
+        frame.push_back(sum);
+        framePos = 0;
+        frameStalled = false;
+    };
+    if(cfg.uart){
+        newFrame();
+        nextByte = 50 + rng() % 2000;
+    }
+
+    uint32_t nextEvent = 200 + rng() % 2300;
+    uint32_t nextTick = cfg.tickMs;
+
+    while(true){
+        uint32_t next = std::min(nextEvent, nextTick);
+        if(cfg.uart) next = std::min(next, nextByte);
+        if(next >= cfg.durationMs) break;
+        clock.sleepUntil(at(next));
+
+        if(cfg.uart && next == nextByte){
+            if(parser.feed(frame[framePos])){
+                r.framesReceived++;
+                for(uint8_t i = 0; i < parser.size(); i++) frameDigest = fnv1a(frameDigest, parser.data()[i], 1);
+                frameDigest = fnv1a(frameDigest, clock.nowMs() - start, 4);
+            }
+            if(++framePos == frame.size()){
+                r.framesSent++;
+                r.framesStalled += frameStalled;
+                newFrame();
+                nextByte += 50 + rng() % 2000;          // 帧间隔
+            }
+            else if(rng() % 2000 == 0){
+                nextByte += 100 + rng() % 900;          // 帧中途卡住，超过解析器超时
+                frameStalled = true;
+            }
+            else{
+                nextByte += 1;                          // 帧内字节间隔 1ms
+            }
+        }
+        if(next == nextEvent){
+            fsm.handleEvent(static_cast<Events>(rng() % 3));
+            r.fsmEvents++;
+            nextEvent += 200 + rng() % 2300;
+        }
+        if(next == nextTick){
+            fsm.tick();
+            r.ticks++;
+            nextTick += cfg.tickMs;
+        }
+    }
+
+    r.transitions = fsm.transitions();
+    r.timeouts = fsm.timeouts();
+    r.digest = fnv1a(fsm.digest(), frameDigest, 8);
+    return r;
+}
+
+void printScenario(const char* name, const ScenarioResult& r, double wallMs){
+    cout << "  " << left << setw(22) << name << right
+         << " frames sent=" << setw(6) << r.framesSent << " stalled=" << setw(3) << r.framesStalled
+         << " received=" << setw(6) << r.framesReceived
+         << " | fsm events=" << setw(6) << r.fsmEvents << " transitions=" << setw(6) << r.transitions
+         << " timeouts=" << setw(5) << r.timeouts << " ticks=" << setw(6) << r.ticks
+         << " | digest=" << hex << setw(16) << setfill('0') << r.digest << dec << setfill(' ')
+         << "  wall=" << fixed << setprecision(1) << wallMs << " ms\n";
+}
+
+int main(){
+    constexpr uint32_t DAY_MS = 24u * 3600u * 1000u;
+
+    // ---------- 1) 24 小时场景，虚拟时钟，跑两遍 ----------
+    cout << "24h scenario on SimClock:\n";
+    ScenarioConfig day{DAY_MS, true, 33};
+    ScenarioResult runs[2];
+    for(int i = 0; i < 2; i++){
+        SimClock clock(0xFFFF0000u);                    // 起点故意选在 uint32 回绕之前
+        uint64_t t0 = nowNs();
+        runs[i] = runScenario(clock, day);
+        printScenario(i == 0 ? "run 1" : "run 2", runs[i], (nowNs() - t0) / 1e6);
+    }
+    bool same = runs[0].digest == runs[1].digest && runs[0].framesReceived == runs[1].framesReceived
+                && runs[0].transitions == runs[1].transitions;
+    cout << "  deterministic: " << (same ? "yes" : "NO") << "  (every stalled frame lost: "
+         << (runs[0].framesReceived + runs[0].framesStalled == runs[0].framesSent ? "yes" : "NO") << ")\n";
+
+    // ---------- 2) 倍速时钟：10 分钟状态机场景按 600 倍跑 ----------
+    cout << "\n10 min fsm-only scenario:\n";
+    ScenarioConfig tenMin{10 * 60 * 1000, false, 7};
+    {
+        SimClock clock;
+        uint64_t t0 = nowNs();
+        ScenarioResult r = runScenario(clock, tenMin);
+        printScenario("SimClock", r, (nowNs() - t0) / 1e6);
+    }
+    {
+        ScaledClock clock(0, 600.0);
+        uint64_t t0 = nowNs();
+        ScenarioResult r = runScenario(clock, tenMin);
+        printScenario("ScaledClock x600", r, (nowNs() - t0) / 1e6);
+        cout << "  (ScaledClock really sleeps, so transition timestamps jitter and the digest varies run to run)\n";
+    }
+
+    // ---------- 3) 多线程：轮询循环睡在虚拟时钟上，测试线程推进时间 ----------
+    {
+        SimClock clock(0, false);
+        std::atomic<uint32_t> flag{0};
+        uint64_t handled = 0;
+        uint32_t returnedAt = 0;
+        std::thread loop([&]{
+            handled = pollLoop(clock, flag, 1000, 1, 5000);  // night3：1ms 一轮，最多 5s
+            returnedAt = clock.nowMs();
+        });
+        //每推进 1ms 来 3 个事件，只来 600 个：轮询循环应该在 5s 的限时处退出
+        uint32_t injected = 0;
+        uint64_t t0 = nowNs();
+        while(true){
+            clock.waitForSleepers(1);
+            if(injected < 600){
+                flag.fetch_add(3, std::memory_order_acq_rel);
+                injected += 3;
+            }
+            clock.advance(1);
+            if(clock.nowMs() > 5000) break;
+        }
+        loop.join();
+        cout << "\npollLoop on manual SimClock: handled=" << handled << "/600, returned at t=" << returnedAt
+             << " ms (limit 5000), wall=" << fixed << setprecision(1) << (nowNs() - t0) / 1e6 << " ms\n";
+    }
+
+    // ---------- 4) 生产时钟开销 ----------
+    {
+        std::vector<uint8_t> capture;
+        std::mt19937 rng(4);
+        while(capture.size() < 8u << 20){
+            uint8_t len = static_cast<uint8_t>(1 + rng() % 32);
+            uint8_t sum = len;
+            capture.insert(capture.end(), {0xAA, 0x55, len});
+            for(uint8_t i = 0; i < len; i++){
+                uint8_t b = static_cast<uint8_t>(rng());
+                capture.push_back(b);
+                sum += b;
+            }
+            capture.push_back(sum);
+        }
+        auto bench = [&](const char* name, auto&& feedAll){
+            uint64_t t0 = nowNs();
+            uint64_t frames = feedAll();
+            double ns = double(nowNs() - t0) / capture.size();
+            cout << "  " << left << setw(34) << name << right << fixed << setprecision(2) << setw(6) << ns
+                 << " ns/byte  frames=" << frames << "\n";
+        };
+        cout << "\nper-byte clock cost (" << (capture.size() >> 20) << " MB):\n";
+        SteadyClock steady;
+        SimClock sim;
+        bench("caller calls now_ms() per byte", [&]{
+            SimpleUartParser<SteadyClock> p(steady, 50);
+            uint64_t n = 0;
+            for(uint8_t b : capture) n += p.feed(b, now_ms());
+            return n;
+        });
+        bench("SimpleUartParser<SteadyClock>", [&]{
+            SimpleUartParser<SteadyClock> p(steady, 50);
+            uint64_t n = 0;
+            for(uint8_t b : capture) n += p.feed(b);
+            return n;
+        });
+        bench("SimpleUartParser<SimClock>", [&]{
+            SimpleUartParser<SimClock> p(sim, 50);
+            uint64_t n = 0;
+            for(uint8_t b : capture) n += p.feed(b);
+            return n;
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,446 @@
+/*
+实时运行配置：绑核、SCHED_FIFO、mlockall、预缺页 + 调度抖动直方图
+
+问题：
+延迟敏感的部署里，读线程、解析线程（StreamProcessor 线程、环形缓冲的生产者/消费者）要放在隔离的核上跑
+代码里没有任何地方能配置这些：线程开在哪个核、什么调度策略、内存会不会被换出、第一次碰到的页会不会缺页
+调了以后也没法证明有没有用
+
+night34 的做法：
+1. RtConfig：一行配置串描述整个进程和每个线程
+   "process:mlock=1,heap=64;reader:cpu=0,fifo=80,stack=256,heap=32;parser:cpu=0,fifo=70,stack=256,heap=32"
+   - process：mlock=1 → mlockall(MCL_CURRENT|MCL_FUTURE)；heap=MB → 只用主 arena、关掉 malloc 的 trim/mmap，预先碰一遍这么多堆内存
+   - 线程：cpu=N → pthread_setaffinity_np；fifo=P → SCHED_FIFO 优先级 P（0 表示保持 SCHED_OTHER）
+     stack=KB → 预先碰一遍栈（超过线程栈剩余空间时截断并记为降级）；heap=MB → 在本线程的 arena 里预缺页
+     （M_ARENA_MAX 管不到配置之前就已经有 arena 的线程，线程退出后它的 arena 还会被新线程复用）
+   配置写错直接抛 std::invalid_argument（启动时就发现）
+2. 应用配置不抛异常：每一项成功/失败（带 errno 原因）都记进 ProfileReport
+   没有权限（没有 CAP_SYS_NICE/CAP_IPC_LOCK、RLIMIT_RTPRIO=0）时照样跑，只是降级成普通线程，启动日志里看得到
+3. 抖动测量：线程按固定周期 clock_nanosleep(TIMER_ABSTIME) 醒来，记录“实际醒来 - 预定时间”
+   每次醒来还要碰一页工作缓冲（模拟处理数据），统计缺页和被动切换次数
+   输出 2 的幂桶直方图和 p50/p99/p99.9/max
+4. main：同样两条线程（reader/parser）+ 一条抢 CPU 的负载线程，先按默认配置测一遍，再按实时配置测一遍
+   最后 fork 一个子进程降成 nobody 用户，演示没有权限时的降级
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+uint64_t nowNs(){
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+// ---------------- 配置 ----------------
+
+struct ThreadProfile {
+    std::string name;
+    int cpu = -1;                       // -1：不绑核
+    int fifoPriority = 0;               // 0：保持 SCHED_OTHER
+    size_t prefaultStackBytes = 0;
+    size_t prefaultHeapBytes = 0;
+};
+
+struct ProcessProfile {
+    bool lockMemory = false;
+    size_t prefaultHeapBytes = 0;
+};
+
+struct RtConfig {
+    ProcessProfile process;
+    std::vector<ThreadProfile> threads;
+
+    //"process:mlock=1,heap=64;reader:cpu=0,fifo=80,stack=256"
+    static RtConfig parse(const std::string& spec){
+        RtConfig cfg;
+        for(const std::string& entry : split(spec, ';')){
+            if(entry.empty()) continue;
+            size_t colon = entry.find(':');
+            std::string name = entry.substr(0, colon);
+            if(name.empty()) throw std::invalid_argument("rt config: entry without a name: '" + entry + "'");
+            std::vector<std::string> kvs = colon == std::string::npos ? std::vector<std::string>{} : split(entry.substr(colon + 1), ',');
+            ThreadProfile t;
+            t.name = name;
+            for(const std::string& kv : kvs){
+                size_t eq = kv.find('=');
+                if(eq == std::string::npos) throw std::invalid_argument("rt config: expected key=value in '" + kv + "'");
+                std::string key = kv.substr(0, eq);
+                long v = number(kv.substr(eq + 1), kv);
+                if(name == "process"){
+                    if(key == "mlock") cfg.process.lockMemory = v != 0;
+                    else if(key == "heap") cfg.process.prefaultHeapBytes = size_t(v) << 20;
+                    else throw std::invalid_argument("rt config: unknown process key '" + key + "'");
+                }
+                else{
+                    if(key == "cpu") t.cpu = static_cast<int>(v);
+                    else if(key == "fifo"){
+                        if(v < 0 || v > 99) throw std::invalid_argument("rt config: fifo priority must be 0..99 in '" + kv + "'");
+                        t.fifoPriority = static_cast<int>(v);
+                    }
+                    else if(key == "stack") t.prefaultStackBytes = size_t(v) << 10;
+                    else if(key == "heap") t.prefaultHeapBytes = size_t(v) << 20;
+                    else throw std::invalid_argument("rt config: unknown thread key '" + key + "'");
+                }
+            }
+            if(name != "process") cfg.threads.push_back(t);
+        }
+        return cfg;
+    }
+
+    //没配置的线程按默认（不绑核、SCHED_OTHER）
+    ThreadProfile thread(const std::string& name) const {
+        for(const ThreadProfile& t : threads)
+            if(t.name == name) return t;
+        ThreadProfile t;
+        t.name = name;
+        return t;
+    }
+
+private:
+    static std::vector<std::string> split(const std::string& s, char sep){
+        std::vector<std::string> out;
+        size_t start = 0;
+        while(true){
+            size_t pos = s.find(sep, start);
+            out.push_back(s.substr(start, pos - start));
+            if(pos == std::string::npos) break;
+            start = pos + 1;
+        }
+        return out;
+    }
+
+    static long number(const std::string& s, const std::string& kv){
+        char* end = nullptr;
+        errno = 0;
+        long v = std::strtol(s.c_str(), &end, 10);
+        if(s.empty() || *end != '\0' || errno != 0 || v < 0)
+            throw std::invalid_argument("rt config: bad number in '" + kv + "'");
+        return v;
+    }
+};
+
+// ---------------- 应用配置（失败降级，不抛） ----------------
+
+struct ProfileReport {
+    std::vector<std::string> applied;
+    std::vector<std::string> degraded;
+
+    void ok(const std::string& what){applied.push_back(what);}
+    void fail(const std::string& what, int err){degraded.push_back(what + ": " + std::strerror(err));}
+
+    void print(const std::string& label) const {
+        std::cout << "  [" << label << "]";
+        for(const auto& a : applied) std::cout << " +" << a;
+        for(const auto& d : degraded) std::cout << " -(" << d << ")";
+        if(applied.empty() && degraded.empty()) std::cout << " defaults";
+        std::cout << "\n";
+    }
+};
+
+//栈底 guard 之上留给预缺页之后的调用链
+constexpr size_t STACK_MARGIN = 64u << 10;
+
+//当前线程栈从当前位置往下还能安全用掉多少字节
+size_t usableStackBytes(){
+    pthread_attr_t attr;
+    if(::pthread_getattr_np(pthread_self(), &attr) != 0) return 0;
+    void* low = nullptr;
+    size_t size = 0;
+    int err = ::pthread_attr_getstack(&attr, &low, &size);
+    ::pthread_attr_destroy(&attr);
+    if(err != 0) return 0;
+    uintptr_t here = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    uintptr_t bottom = reinterpret_cast<uintptr_t>(low) + STACK_MARGIN;
+    return here > bottom ? here - bottom : 0;
+}
+
+//碰一遍当前线程栈的 bytes 字节，之后函数调用不会再因为栈缺页；调用方保证 bytes 不超过 usableStackBytes()
+__attribute__((noinline)) void prefaultStack(size_t bytes){
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    char* buf = static_cast<char*>(alloca(bytes));
+    for(size_t i = 0; i < bytes; i += page)
+        static_cast<volatile char*>(buf)[i] = 0;
+    asm volatile("" : : "r"(buf) : "memory");
+}
+
+//在调用线程所用的 arena 里申请并碰一遍 bytes 字节再释放
+//释放的内存留在堆里，不还给内核（trim），大块也不走 mmap：这个 arena 后面 malloc 拿到的都是已经缺过页的内存
+//之后新建、还没有 arena 的线程都落到主 arena 上（M_ARENA_MAX=1）
+void prefaultHeap(size_t bytes, ProfileReport& r){
+    if(::mallopt(M_ARENA_MAX, 1) != 1 || ::mallopt(M_TRIM_THRESHOLD, -1) != 1 || ::mallopt(M_MMAP_MAX, 0) != 1){
+        r.fail("mallopt", EINVAL);
+        return;
+    }
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    char* heap = static_cast<char*>(std::malloc(bytes));
+    if(!heap){
+        r.fail("heap prefault", ENOMEM);
+        return;
+    }
+    for(size_t i = 0; i < bytes; i += page)
+        static_cast<volatile char*>(heap)[i] = 0;
+    std::free(heap);
+    r.ok("heap " + std::to_string(bytes >> 20) + "MB");
+}
+
+ProfileReport applyProcessProfile(const ProcessProfile& p){
+    ProfileReport r;
+    if(p.prefaultHeapBytes) prefaultHeap(p.prefaultHeapBytes, r);
+    if(p.lockMemory){
+        if(::mlockall(MCL_CURRENT | MCL_FUTURE) == 0) r.ok("mlockall");
+        else r.fail("mlockall", errno);
+    }
+    return r;
+}
+
+//作用于调用线程
+ProfileReport applyThreadProfile(const ThreadProfile& t){
+    ProfileReport r;
+    ::pthread_setname_np(pthread_self(), t.name.substr(0, 15).c_str());
+    if(t.cpu >= 0){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(t.cpu < CPU_SETSIZE) CPU_SET(t.cpu, &set);
+        int err = ::pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(err == 0) r.ok("cpu" + std::to_string(t.cpu));
+        else r.fail("cpu" + std::to_string(t.cpu), err);
+    }
+    if(t.fifoPriority > 0){
+        sched_param sp{};
+        sp.sched_priority = t.fifoPriority;
+        int err = ::pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if(err == 0) r.ok("fifo" + std::to_string(t.fifoPriority));
+        else r.fail("fifo" + std::to_string(t.fifoPriority), err);
+    }
+    if(t.prefaultStackBytes){
+        size_t bytes = std::min(t.prefaultStackBytes, usableStackBytes());
+        if(bytes) prefaultStack(bytes);
+        if(bytes == t.prefaultStackBytes)
+            r.ok("stack " + std::to_string(bytes >> 10) + "KB");
+        else
+            r.degraded.push_back("stack " + std::to_string(t.prefaultStackBytes >> 10) + "KB: clamped to "
+                                 + std::to_string(bytes >> 10) + "KB usable");
+    }
+    if(t.prefaultHeapBytes) prefaultHeap(t.prefaultHeapBytes, r);
+    return r;
+}
+
+// ---------------- 抖动测量 ----------------
+
+struct JitterResult {
+    std::string name;
+    ProfileReport profile;
+    std::vector<uint32_t> latencyNs;    // 每次醒来比预定时间晚多少
+    long minorFaults = 0;
+    long involuntarySwitches = 0;
+
+    //2 的幂桶：[0,1us) [1,2us) [2,4us) ... 最后一桶 >= 2^(BUCKETS-2) us
+    static constexpr int BUCKETS = 16;
+    std::array<uint64_t, BUCKETS> histogram() const {
+        std::array<uint64_t, BUCKETS> h{};
+        for(uint32_t ns : latencyNs){
+            uint32_t us = ns / 1000;
+            int b = us == 0 ? 0 : 1 + (31 - __builtin_clz(us));
+            h[std::min(b, BUCKETS - 1)]++;
+        }
+        return h;
+    }
+
+    uint32_t percentile(double p) const {
+        if(latencyNs.empty()) return 0;
+        std::vector<uint32_t> v = latencyNs;
+        size_t k = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+};
+
+/*
+周期性醒来：预定时间 = 起点 + k * period（绝对时间，误差不累积）
+每次醒来碰工作缓冲的下一页：没有预缺页/锁内存时这里会缺页
+*/
+void measureJitter(JitterResult& r, uint32_t periodUs, uint32_t iterations, char* work, size_t workBytes){
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    r.latencyNs.reserve(iterations);
+    rusage before, after;
+    ::getrusage(RUSAGE_THREAD, &before);
+
+    timespec next;
+    ::clock_gettime(CLOCK_MONOTONIC, &next);
+    size_t off = 0;
+    for(uint32_t i = 0; i < iterations; i++){
+        next.tv_nsec += long(periodUs) * 1000;
+        while(next.tv_nsec >= 1000000000L){
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        while(::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR){}
+        uint64_t woke = nowNs();
+        uint64_t due = uint64_t(next.tv_sec) * 1000000000ull + uint64_t(next.tv_nsec);
+        r.latencyNs.push_back(static_cast<uint32_t>(std::min<uint64_t>(woke > due ? woke - due : 0, UINT32_MAX)));
+
+        static_cast<volatile char*>(work)[off] = static_cast<char>(i);
+        off += page;
+        if(off >= workBytes) off = 0;
+    }
+
+    ::getrusage(RUSAGE_THREAD, &after);
+    r.minorFaults = after.ru_minflt - before.ru_minflt;
+    r.involuntarySwitches = after.ru_nivcsw - before.ru_nivcsw;
+}
+
+/*
+跑一轮：配置里的每条线程各测一次抖动，同时一条负载线程一直占着 CPU、不停申请/释放内存
+工作缓冲在应用配置之后分配（mlockall 的 MCL_FUTURE / 堆预缺页才能覆盖到它）
+*/
+std::vector<JitterResult> runRound(const RtConfig& cfg, const std::vector<std::string>& names,
+                                   uint32_t periodUs, uint32_t iterations, size_t workBytes){
+    std::atomic<bool> stop{false};
+    std::thread load([&]{
+        ::pthread_setname_np(pthread_self(), "load");
+        uint64_t x = 0;
+        while(!stop.load(std::memory_order_relaxed)){
+            std::vector<char> churn(1 << 20);
+            for(size_t i = 0; i < churn.size(); i += 4096) churn[i] = static_cast<char>(x++);
+        }
+    });
+
+    std::vector<JitterResult> results(names.size());
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < names.size(); i++){
+        threads.emplace_back([&, i]{
+            JitterResult& r = results[i];
+            r.name = names[i];
+            r.profile = applyThreadProfile(cfg.thread(names[i]));
+            char* buf = static_cast<char*>(std::malloc(workBytes));
+            measureJitter(r, periodUs, iterations, buf, workBytes);
+            std::free(buf);
+        });
+    }
+    for(auto& t : threads) t.join();
+    stop = true;
+    load.join();
+    return results;
+}
+
+void printResults(const char* title, const std::vector<JitterResult>& rs){
+    std::cout << title << "\n";
+    for(const auto& r : rs){
+        r.profile.print(r.name);
+        std::cout << "    wake-up latency p50=" << std::setw(6) << r.percentile(0.50) / 1000.0
+                  << "us p99=" << std::setw(8) << r.percentile(0.99) / 1000.0
+                  << "us p99.9=" << std::setw(8) << r.percentile(0.999) / 1000.0
+                  << "us max=" << std::setw(8) << r.percentile(1.0) / 1000.0
+                  << "us  minor faults=" << r.minorFaults
+                  << " involuntary switches=" << r.involuntarySwitches << "\n";
+    }
+}
+
+void printHistograms(const std::vector<JitterResult>& base, const std::vector<JitterResult>& tuned){
+    std::cout << "\nwake-up latency histogram (samples per bucket)\n";
+    std::cout << "  " << std::setw(16) << "bucket";
+    for(const auto& r : base) std::cout << std::setw(16) << (r.name + " default");
+    for(const auto& r : tuned) std::cout << std::setw(16) << (r.name + " rt");
+    std::cout << "\n";
+    std::vector<std::array<uint64_t, JitterResult::BUCKETS>> hs;
+    for(const auto& r : base) hs.push_back(r.histogram());
+    for(const auto& r : tuned) hs.push_back(r.histogram());
+    for(int b = 0; b < JitterResult::BUCKETS; b++){
+        bool any = false;
+        for(const auto& h : hs) any = any || h[b];
+        if(!any) continue;
+        std::string label = b == 0 ? "< 1us"
+                          : b == JitterResult::BUCKETS - 1 ? ">= " + std::to_string(1u << (b - 1)) + "us"
+                          : std::to_string(1u << (b - 1)) + "-" + std::to_string(1u << b) + "us";
+        std::cout << "  " << std::setw(16) << label;
+        for(const auto& h : hs) std::cout << std::setw(16) << h[b];
+        std::cout << "\n";
+    }
+}
+
+int main(int argc, char** argv){
+    try{
+        const std::string spec = argc >= 2 ? argv[1]
+            : "process:mlock=1,heap=64;reader:cpu=0,fifo=80,stack=256,heap=32;parser:cpu=0,fifo=70,stack=256,heap=32";
+        RtConfig rt = RtConfig::parse(spec);
+        const std::vector<std::string> names = {"reader", "parser"};
+        const uint32_t PERIOD_US = 1000;
+        const uint32_t ITERATIONS = 2000;
+        const size_t WORK_BYTES = 16u << 20;
+
+        std::cout << "rt config: " << spec << "\n";
+        try{
+            RtConfig::parse("reader:cpu=zero");
+        }
+        catch(const std::invalid_argument& e){
+            std::cout << "bad config is rejected at startup: " << e.what() << "\n";
+        }
+        std::cout << "cpus online: " << std::thread::hardware_concurrency()
+                  << ", period " << PERIOD_US << "us x " << ITERATIONS << " wake-ups per thread, with a CPU/memory load thread\n\n";
+
+        // ---------- 1) 默认：不绑核、SCHED_OTHER、不锁内存 ----------
+        std::vector<JitterResult> base = runRound(RtConfig{}, names, PERIOD_US, ITERATIONS, WORK_BYTES);
+        printResults("default profile:", base);
+
+        // ---------- 2) 实时配置 ----------
+        std::cout << "\n";
+        ProfileReport proc = applyProcessProfile(rt.process);
+        proc.print("process");
+        std::vector<JitterResult> tuned = runRound(rt, names, PERIOD_US, ITERATIONS, WORK_BYTES);
+        printResults("rt profile:", tuned);
+        printHistograms(base, tuned);
+
+        // ---------- 3) 没有权限时：子进程降成 nobody 再应用同一份配置 ----------
+        std::cout << "\nwithout privileges (child process as uid 65534):\n" << std::flush;
+        pid_t pid = ::fork();
+        if(pid < 0) throw std::system_error(errno, std::generic_category(), "fork");
+        if(pid == 0){
+            ::munlockall();
+            if(::setgid(65534) != 0 || ::setuid(65534) != 0){
+                std::cout << "  (cannot drop privileges here: " << std::strerror(errno) << ")\n" << std::flush;
+                ::_exit(0);
+            }
+            applyProcessProfile(rt.process).print("process");
+            JitterResult r;
+            r.name = "reader";
+            std::thread t([&]{
+                r.profile = applyThreadProfile(rt.thread("reader"));
+                char* buf = static_cast<char*>(std::malloc(1 << 20));
+                measureJitter(r, PERIOD_US, 200, buf, 1 << 20);
+                std::free(buf);
+            });
+            t.join();
+            printResults("  still runs, degraded:", {r});
+            std::cout << std::flush;
+            ::_exit(0);
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,980 @@
+/*
+大页 + NUMA 感知的内存：给环形缓冲和缓冲池用
+
+问题：
+双路服务器上，环形缓冲和缓冲池的内存落在哪个 NUMA 节点，全看谁第一次碰它（first-touch）
+构造它的往往是主线程，真正用它的读线程/解析线程却在另一个节点上，每次访问都跨节点
+环一大（几十上百 MB），4KB 页的 TLB 根本装不下，随机访问几乎每次都 TLB miss
+
+night35 的做法：
+1. MemoryPlacement：node（-1 不指定）、hugePages、prefault
+2. PlacedRegion：按 MemoryPlacement 申请一段 mmap 内存，每一步失败都往下退一级，不失败：
+   - 大页：先试 MAP_HUGETLB|MAP_HUGE_2MB（要预留大页池；指定了节点时 mbind 之后马上把页分配出来，节点上不够就不用它）
+     → 不行就按 2MB 对齐 mmap 普通页再 madvise(MADV_HUGEPAGE)（透明大页）
+     → 再不行就是 4KB 页
+   - 节点：mbind(MPOL_BIND) 走 syscall，不依赖 libnuma；失败（单节点机器、节点号不存在）就退回 first-touch
+   - prefault：构造时由当前线程碰一遍所有页；prefault=false 时由所属线程之后自己调 touch()（first-touch 放置）
+   实际拿到的结果（哪种页、大页字节数、页在哪个节点、每一步为什么退了）都能查，main 里打印出来
+3. SpscRing<T>：night9 的 SPSC 环，容量改成 2 的幂，存储放在 PlacedRegion 里；
+   head/tail 各占一条缓存行，并各自缓存对方的位置，减少跨核读
+4. BufferPool：night24 的缓冲池原样搬过来（含按池大小限制的线程缓存、从别的线程缓存拿回编号），底层内存从 aligned_alloc 换成 PlacedRegion
+5. main：
+   - 各种放置方式实际拿到了什么
+   - 不同大小的环：SPSC 吞吐 + 随机访问延迟（看 TLB），本节点 vs 跨节点（机器只有一个节点时跳过跨节点）、4KB vs 大页
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <system_error>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mman.h>
+#include <linux/mempolicy.h>
+
+uint64_t nowNs(){
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------- NUMA 拓扑（读 sysfs） ----------------
+
+//"0-3,8,10-11" → {0,1,2,3,8,10,11}
+std::vector<int> parseCpuList(const std::string& s){
+    std::vector<int> out;
+    std::stringstream ss(s);
+    std::string part;
+    while(std::getline(ss, part, ',')){
+        if(part.empty() || part == "\n") continue;
+        size_t dash = part.find('-');
+        int a = std::stoi(part.substr(0, dash));
+        int b = dash == std::string::npos ? a : std::stoi(part.substr(dash + 1));
+        for(int i = a; i <= b; i++) out.push_back(i);
+    }
+    return out;
+}
+
+std::string readFirstLine(const std::string& path){
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+std::vector<int> numaNodes(){
+    std::vector<int> nodes = parseCpuList(readFirstLine("/sys/devices/system/node/online"));
+    if(nodes.empty()) nodes.push_back(0);               // 没有 sysfs 信息就当单节点
+    return nodes;
+}
+
+std::vector<int> cpusOfNode(int node){
+    std::vector<int> cpus = parseCpuList(readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+    if(cpus.empty()){
+        for(unsigned c = 0; c < std::thread::hardware_concurrency(); c++) cpus.push_back(static_cast<int>(c));
+    }
+    return cpus;
+}
+
+bool pinToCpu(int cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+//libnuma 的 mbind/get_mempolicy 只是这两个系统调用的包装
+long sysMbind(void* addr, unsigned long len, int mode, const unsigned long* nodemask, unsigned long maxnode, unsigned flags){
+    return ::syscall(SYS_mbind, addr, len, mode, nodemask, maxnode, flags);
+}
+
+//节点上空闲的 2MB 大页数（读不到算 0）
+size_t freeHugePagesOnNode(int node){
+    std::string s = readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/hugepages/hugepages-2048kB/free_hugepages");
+    return s.empty() ? 0 : std::strtoul(s.c_str(), nullptr, 10);
+}
+
+//addr 所在页实际在哪个节点（页还没分配时返回 -1）
+int nodeOfAddress(const void* addr){
+    int node = -1;
+    if(::syscall(SYS_get_mempolicy, &node, nullptr, 0, const_cast<void*>(addr), MPOL_F_NODE | MPOL_F_ADDR) != 0)
+        return -1;
+    return node;
+}
+
+// ---------------- PlacedRegion ----------------
+
+constexpr size_t SMALL_PAGE = 4096;
+constexpr size_t HUGE_PAGE = 2u << 20;
+
+struct MemoryPlacement {
+    int node = -1;                      // -1：不指定，按 first-touch
+    bool hugePages = false;
+    bool prefault = true;               // false：由所属线程之后调 touch()
+};
+
+enum class Backing : uint8_t {SMALL_4K, THP_2M, HUGETLB_2M};
+
+const char* backingName(Backing b){
+    switch(b){
+        case Backing::SMALL_4K:   return "4K pages";
+        case Backing::THP_2M:     return "THP 2M (madvise)";
+        case Backing::HUGETLB_2M: return "hugetlb 2M";
+    }
+    return "?";
+}
+
+/*
+按放置要求申请的一段匿名内存（只能移动）
+只有最后一级（普通 mmap）也失败才抛 std::system_error，其余失败都记进 notes() 然后降级
+*/
+class PlacedRegion {
+public:
+    PlacedRegion() = default;
+
+    PlacedRegion(size_t bytes, const MemoryPlacement& placement) : _placement(placement) {
+        if(bytes == 0) throw std::invalid_argument("PlacedRegion: empty region");
+        if(placement.hugePages){
+            _size = roundUp(bytes, HUGE_PAGE);
+            if(!mapHugetlb()){
+                mapAligned(HUGE_PAGE);
+                if(::madvise(_base, _size, MADV_HUGEPAGE) == 0) _backing = Backing::THP_2M;
+                else note("madvise(MADV_HUGEPAGE)", errno);
+            }
+        }
+        else{
+            _size = roundUp(bytes, SMALL_PAGE);
+            mapAligned(SMALL_PAGE);
+        }
+
+        if(placement.node >= 0 && _backing != Backing::HUGETLB_2M) bind();    // hugetlb 在 mapHugetlb() 里已经绑过
+        if(placement.prefault) touch();
+    }
+
+    ~PlacedRegion(){
+        if(_mapBase) ::munmap(_mapBase, _mapSize);
+    }
+
+    PlacedRegion(PlacedRegion&& o) noexcept {swap(o);}
+    PlacedRegion& operator = (PlacedRegion&& o) noexcept {
+        if(this != &o){
+            PlacedRegion tmp(std::move(o));
+            swap(tmp);
+        }
+        return *this;
+    }
+    PlacedRegion(const PlacedRegion&) = delete;
+    PlacedRegion& operator = (const PlacedRegion&) = delete;
+
+    //每页写一次：没 mbind 时，页就落在调用线程所在的节点（first-touch）
+    void touch(){
+        const size_t step = _backing == Backing::HUGETLB_2M ? HUGE_PAGE : SMALL_PAGE;
+        for(size_t off = 0; off < _size; off += step)
+            static_cast<volatile uint8_t*>(_base)[off] = 0;
+    }
+
+    uint8_t* data() const {return _base;}
+    size_t size() const {return _size;}
+    Backing backing() const {return _backing;}
+    bool nodeBound() const {return _bound;}
+    const MemoryPlacement& placement() const {return _placement;}
+    const std::vector<std::string>& notes() const {return _notes;}
+
+    //首页、中间页、末页实际所在的节点（不一致时返回 -2）
+    int residentNode() const {
+        int a = nodeOfAddress(_base), b = nodeOfAddress(_base + _size / 2), c = nodeOfAddress(_base + _size - 1);
+        return (a == b && b == c) ? a : -2;
+    }
+
+    //这段内存里实际由大页支撑的字节数：hugetlb 全部都是；THP 看 /proc/self/smaps 的 AnonHugePages
+    size_t hugeBytes() const {
+        if(_backing == Backing::HUGETLB_2M) return _size;
+        if(_backing != Backing::THP_2M) return 0;
+        std::ifstream in("/proc/self/smaps");
+        std::string line;
+        uintptr_t lo = reinterpret_cast<uintptr_t>(_base), hi = lo + _size;
+        bool inside = false;
+        size_t total = 0;
+        while(std::getline(in, line)){
+            unsigned long a, b;
+            if(std::sscanf(line.c_str(), "%lx-%lx ", &a, &b) == 2 && line.find(':') > line.find(' ')){
+                inside = a < hi && b > lo;
+                continue;
+            }
+            unsigned long kb;
+            if(inside && std::sscanf(line.c_str(), "AnonHugePages: %lu kB", &kb) == 1) total += kb * 1024;
+        }
+        return total;
+    }
+
+private:
+    static size_t roundUp(size_t v, size_t a){return (v + a - 1) / a * a;}
+
+    //多映射一段再裁掉头尾，得到 align 对齐的起点（THP 要 2MB 对齐才能整页替换）
+    void mapAligned(size_t align){
+        size_t len = _size + (align > SMALL_PAGE ? align : 0);
+        void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED) throw std::system_error(errno, std::generic_category(), "mmap");
+        uintptr_t start = reinterpret_cast<uintptr_t>(p);
+        uintptr_t aligned = (start + align - 1) / align * align;
+        if(align > SMALL_PAGE){
+            if(aligned > start) ::munmap(p, aligned - start);
+            uintptr_t end = start + len, used = aligned + _size;
+            if(end > used) ::munmap(reinterpret_cast<void*>(used), end - used);
+        }
+        _base = reinterpret_cast<uint8_t*>(aligned);
+        _mapBase = _base;
+        _mapSize = _size;
+        _backing = Backing::SMALL_4K;
+    }
+
+    /*
+    MAP_HUGETLB 在 mmap 时只从全局大页池里预留，后面的 mbind 不管绑定的节点还有没有空闲大页；
+    节点的 free_hugepages 里也没扣掉别的映射预留了、还没碰过的页。节点上不够时，碰到页面直接 SIGBUS，没法降级
+    所以指定了节点就在 mbind 之后马上 MADV_POPULATE_WRITE 把页分配出来（不够时它返回错误而不是 SIGBUS），
+    失败就拆掉映射退回透明大页；第一次碰页不会留给之后的线程。free_hugepages 只用来提前排除明显不够的情况
+    */
+    bool mapHugetlb(){
+        const size_t needPages = _size / HUGE_PAGE;
+        if(_placement.node >= 0){
+            const size_t nodeFree = freeHugePagesOnNode(_placement.node);
+            if(nodeFree < needPages){
+                _notes.push_back("hugetlb: node" + std::to_string(_placement.node) + " has " + std::to_string(nodeFree)
+                                 + " free 2M pages, need " + std::to_string(needPages));
+                return false;
+            }
+        }
+        void* p = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+        if(p == MAP_FAILED){
+            note("hugetlb", errno);
+            return false;
+        }
+        _base = static_cast<uint8_t*>(p);
+        _mapBase = p;
+        _mapSize = _size;
+        _backing = Backing::HUGETLB_2M;
+        //没绑节点（不指定或 mbind 失败）时全局预留就够了，不会 SIGBUS
+        if(_placement.node < 0 || !bind()) return true;
+        if(::madvise(_base, _size, MADV_POPULATE_WRITE) == 0) return true;
+
+        note("hugetlb populate on node" + std::to_string(_placement.node), errno);
+        ::munmap(p, _size);
+        _base = nullptr;
+        _mapBase = nullptr;
+        _mapSize = 0;
+        _backing = Backing::SMALL_4K;
+        _bound = false;
+        return false;
+    }
+
+    bool bind(){
+        unsigned long mask[16] = {};
+        const unsigned long bits = sizeof(mask) * 8;
+        if(static_cast<unsigned long>(_placement.node) >= bits){
+            note("mbind node" + std::to_string(_placement.node), EINVAL);
+            return false;
+        }
+        mask[_placement.node / (8 * sizeof(unsigned long))] |= 1ul << (_placement.node % (8 * sizeof(unsigned long)));
+        if(sysMbind(_base, _size, MPOL_BIND, mask, bits + 1, MPOL_MF_STRICT | MPOL_MF_MOVE) != 0){
+            note("mbind node" + std::to_string(_placement.node), errno);
+            return false;
+        }
+        _bound = true;
+        return true;
+    }
+
+    void note(const std::string& what, int err){_notes.push_back(what + ": " + std::strerror(err));}
+
+    void swap(PlacedRegion& o) noexcept {
+        std::swap(_placement, o._placement);
+        std::swap(_base, o._base);
+        std::swap(_size, o._size);
+        std::swap(_mapBase, o._mapBase);
+        std::swap(_mapSize, o._mapSize);
+        std::swap(_backing, o._backing);
+        std::swap(_bound, o._bound);
+        std::swap(_notes, o._notes);
+    }
+
+    MemoryPlacement _placement;
+    uint8_t* _base = nullptr;
+    size_t _size = 0;
+    void* _mapBase = nullptr;
+    size_t _mapSize = 0;
+    Backing _backing = Backing::SMALL_4K;
+    bool _bound = false;
+    std::vector<std::string> _notes;                // 每一步降级的原因
+};
+
+std::string describe(const PlacedRegion& r){
+    std::ostringstream os;
+    os << (r.size() >> 10) << " KB, " << backingName(r.backing())
+       << ", huge " << (r.hugeBytes() >> 20) << " MB";
+    int node = r.residentNode();
+    os << ", node " << (node == -2 ? std::string("mixed") : node < 0 ? std::string("?") : std::to_string(node))
+       << (r.nodeBound() ? " (mbind)" : " (first-touch)");
+    for(const auto& n : r.notes()) os << "\n      fallback: " << n;
+    return os.str();
+}
+
+// ---------------- SPSC 环（night9） ----------------
+
+/*
+单生产者单消费者环
+容量向上取 2 的幂，下标用自由增长的计数器 & mask；head/tail 各占一条缓存行
+每一侧缓存对方的位置，只有看起来满/空时才去读对方的原子变量
+*/
+template <typename T>
+class SpscRing {
+public:
+    SpscRing(size_t capacity, const MemoryPlacement& placement)
+        : _capacity(roundUpPow2(capacity)), _mask(_capacity - 1),
+          _region(_capacity * sizeof(T), placement),
+          _slots(reinterpret_cast<T*>(_region.data())) {
+        static_assert(std::is_trivially_copyable<T>::value, "SpscRing stores raw T in mapped memory");
+    }
+
+    bool push(const T& v){
+        size_t h = _head.load(std::memory_order_relaxed);
+        if(h - _tailCache == _capacity){
+            _tailCache = _tail.load(std::memory_order_acquire);
+            if(h - _tailCache == _capacity) return false;
+        }
+        _slots[h & _mask] = v;
+        _head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& v){
+        size_t t = _tail.load(std::memory_order_relaxed);
+        if(t == _headCache){
+            _headCache = _head.load(std::memory_order_acquire);
+            if(t == _headCache) return false;
+        }
+        v = _slots[t & _mask];
+        _tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const {return _capacity;}
+    PlacedRegion& region() {return _region;}
+
+private:
+    static size_t roundUpPow2(size_t v){
+        size_t p = 1;
+        while(p < v) p <<= 1;
+        return p;
+    }
+
+    const size_t _capacity;
+    const size_t _mask;
+    PlacedRegion _region;
+    T* _slots;
+    alignas(64) std::atomic<size_t> _head{0};       // 只有生产者写
+    size_t _tailCache = 0;                          // 生产者看到的 tail
+    alignas(64) std::atomic<size_t> _tail{0};       // 只有消费者写
+    size_t _headCache = 0;                          // 消费者看到的 head
+};
+
+// ---------------- 缓冲池（night24） ----------------
+
+//单写者计数：只有所属线程写，其他线程只读（night21）
+static void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*
+定长缓冲池（night24），底层内存换成 PlacedRegion：可以指定节点、用大页
+- 所有句柄必须在池析构之前释放
+- acquire() 池空时返回空句柄（operator bool 为 false），不抛异常也不阻塞，由调用方决定重试还是丢弃
+- 线程本地缓存按池的槽位号索引；最多同时有 MAX_POOLS 个池用缓存，超出的池每次都走全局栈
+*/
+class BufferPool {
+public:
+    static constexpr size_t MAX_POOLS = 32;
+    static constexpr uint32_t CACHE_MAX = 64;       // 每线程最多缓存的编号数（小池按 capacity / EXPECTED_THREADS 再缩小）
+    static constexpr size_t EXPECTED_THREADS = 4;   // 缓存上限按几个线程同时用池来分
+
+    struct Stats {
+        size_t capacity;
+        size_t bufferSize;
+        size_t globalFree;      // 全局空闲栈里的缓冲
+        size_t outstanding;     // 不在全局栈里的缓冲（在用 + 在线程缓存里）
+        size_t highWater;       // outstanding 的最大值
+        uint64_t acquires;
+        uint64_t exhausted;     // acquire 失败次数
+        uint64_t refills;       // 线程缓存从全局栈批量取
+        uint64_t flushes;       // 线程缓存向全局栈批量还
+        uint64_t steals;        // 全局栈空时从别的线程缓存拿回编号
+    };
+
+    class Shared;
+
+    //独占句柄
+    class Unique {
+    public:
+        Unique() = default;
+        ~Unique() {reset();}
+
+        Unique(const Unique&) = delete;
+        Unique& operator = (const Unique&) = delete;
+
+        Unique(Unique&& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            other._pool = nullptr;
+        }
+        Unique& operator = (Unique&& other) noexcept {
+            if(this != &other){
+                reset();
+                _pool = other._pool;
+                _index = other._index;
+                _size = other._size;
+                other._pool = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {return _pool != nullptr;}
+        uint8_t* data() const {return _pool->bufferAt(_index);}
+        size_t capacity() const {return _pool->bufferSize();}
+        size_t size() const {return _size;}
+        void setSize(size_t n) {_size = static_cast<uint32_t>(std::min(n, capacity()));}
+
+        void reset(){
+            if(_pool){
+                _pool->release(_index);
+                _pool = nullptr;
+            }
+        }
+
+        //转成共享句柄，本句柄失效
+        Shared share() &&;
+
+    private:
+        friend class BufferPool;
+        Unique(BufferPool* pool, uint32_t index) : _pool(pool), _index(index) {}
+
+        BufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+        uint32_t _size = 0;
+    };
+
+    //共享句柄：拷贝加引用，析构减引用，减到 0 还给池
+    class Shared {
+    public:
+        Shared() = default;
+        ~Shared() {reset();}
+
+        Shared(const Shared& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            if(_pool) _pool->_refs[_index].fetch_add(1, std::memory_order_relaxed);
+        }
+        Shared& operator = (const Shared& other) noexcept {
+            if(this != &other){
+                Shared tmp(other);
+                swap(tmp);
+            }
+            return *this;
+        }
+        Shared(Shared&& other) noexcept : _pool(other._pool), _index(other._index), _size(other._size) {
+            other._pool = nullptr;
+        }
+        Shared& operator = (Shared&& other) noexcept {
+            if(this != &other){
+                reset();
+                swap(other);
+            }
+            return *this;
+        }
+
+        explicit operator bool() const {return _pool != nullptr;}
+        const uint8_t* data() const {return _pool->bufferAt(_index);}
+        size_t size() const {return _size;}
+        uint32_t useCount() const {return _pool ? _pool->_refs[_index].load(std::memory_order_relaxed) : 0;}
+
+        void reset(){
+            if(_pool){
+                //acq_rel：最后一个释放者要看到其他线程对缓冲的全部写入之后才能还回去
+                if(_pool->_refs[_index].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    _pool->release(_index);
+                _pool = nullptr;
+            }
+        }
+
+        void swap(Shared& other) noexcept {
+            std::swap(_pool, other._pool);
+            std::swap(_index, other._index);
+            std::swap(_size, other._size);
+        }
+
+    private:
+        friend class Unique;
+        Shared(BufferPool* pool, uint32_t index, uint32_t size) : _pool(pool), _index(index), _size(size) {}
+
+        BufferPool* _pool = nullptr;
+        uint32_t _index = 0;
+        uint32_t _size = 0;
+    };
+
+    BufferPool(size_t bufferSize, size_t count, size_t alignment = 64, const MemoryPlacement& placement = {})
+        : _bufferSize(bufferSize),
+          _stride(checkedStride(bufferSize, count, alignment)),
+          _count(count),
+          _cacheMax(static_cast<uint32_t>(std::clamp<size_t>(count / EXPECTED_THREADS, 1, CACHE_MAX))),
+          _batch(std::max<uint32_t>(_cacheMax / 2, 1)),
+          _memory(_stride * count, placement),
+          _refs(new std::atomic<uint32_t>[count]) {
+        _free.reserve(count);
+        for(size_t i = count; i > 0; i--)           // 倒序压栈，先发出低地址的缓冲
+            _free.push_back(static_cast<uint32_t>(i - 1));
+        for(size_t i = 0; i < count; i++)
+            _refs[i].store(0, std::memory_order_relaxed);
+        registerPool();
+    }
+
+    ~BufferPool(){
+        unregisterPool();
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator = (const BufferPool&) = delete;
+
+    size_t bufferSize() const {return _bufferSize;}
+    size_t capacity() const {return _count;}
+    const PlacedRegion& memory() const {return _memory;}
+
+    Unique acquire(){
+        ThreadCache* c = localCache();
+        if(!c){
+            uint32_t index;
+            if(!popGlobal(index)) return Unique();
+            return Unique(this, index);
+        }
+        c->lock();
+        if(c->count == 0 && !refill(*c)){
+            c->unlock();
+            bump(c->exhausted);
+            return Unique();
+        }
+        uint32_t index = c->items[--c->count];
+        c->unlock();
+        bump(c->acquires);
+        return Unique(this, index);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Stats s{_count, _bufferSize, _free.size(), _count - _free.size(), _highWater,
+                _globalAcquires.load(std::memory_order_relaxed),
+                _globalExhausted.load(std::memory_order_relaxed), _refills, _flushes, _steals};
+        for(auto& c : _caches){
+            s.acquires += c->acquires.load(std::memory_order_relaxed);
+            s.exhausted += c->exhausted.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    //count/items 由 busy 保护（night24）：所属线程取/还时拿，别的线程拿回编号时只 tryLock
+    struct ThreadCache {
+        std::atomic<bool> busy{false};
+        uint32_t count = 0;
+        uint32_t items[CACHE_MAX];
+        std::atomic<uint64_t> acquires{0};
+        std::atomic<uint64_t> exhausted{0};
+
+        void lock(){
+            while(busy.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+        }
+        bool tryLock(){
+            return !busy.load(std::memory_order_relaxed) && !busy.exchange(true, std::memory_order_acquire);
+        }
+        void unlock(){busy.store(false, std::memory_order_release);}
+    };
+
+    //每个线程一份：按池槽位号记录本线程的缓存，线程退出时把编号还回仍然存活的池
+    struct TlsCaches {
+        struct Slot {
+            uint64_t serial = 0;
+            ThreadCache* cache = nullptr;
+        };
+        Slot slots[MAX_POOLS];
+
+        ~TlsCaches(){
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            for(size_t i = 0; i < MAX_POOLS; i++){
+                if(slots[i].cache && registry().serials[i] == slots[i].serial)
+                    registry().pools[i]->retireCache(slots[i].cache);
+            }
+        }
+    };
+
+    //存活池的登记表：线程退出时靠它判断池还在不在
+    struct Registry {
+        std::mutex mutex;
+        BufferPool* pools[MAX_POOLS] = {};
+        uint64_t serials[MAX_POOLS] = {};
+        uint64_t nextSerial = 1;
+    };
+
+    static Registry& registry(){
+        static Registry r;
+        return r;
+    }
+
+    static TlsCaches& tlsCaches(){
+        thread_local TlsCaches t;
+        return t;
+    }
+
+    void registerPool(){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        _serial = r.nextSerial++;
+        for(size_t i = 0; i < MAX_POOLS; i++){
+            if(r.pools[i] == nullptr){
+                r.pools[i] = this;
+                r.serials[i] = _serial;
+                _slot = static_cast<int>(i);
+                return;
+            }
+        }
+        _slot = -1;                                 // 槽位用完，这个池不用线程缓存
+    }
+
+    void unregisterPool(){
+        if(_slot < 0) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.pools[_slot] = nullptr;
+        r.serials[_slot] = 0;
+    }
+
+    ThreadCache* localCache(){
+        if(_slot < 0) return nullptr;
+        TlsCaches::Slot& s = tlsCaches().slots[_slot];
+        if(s.serial == _serial) return s.cache;
+
+        //本线程第一次用这个池：优先复用已退出线程留下的缓存
+        std::lock_guard<std::mutex> lock(_mutex);
+        ThreadCache* c;
+        if(!_idleCaches.empty()){
+            c = _idleCaches.back();
+            _idleCaches.pop_back();
+        }
+        else{
+            _caches.push_back(std::make_unique<ThreadCache>());
+            c = _caches.back().get();
+        }
+        s.serial = _serial;
+        s.cache = c;
+        return c;
+    }
+
+    //线程退出：缓存里的编号还回全局栈，缓存对象留给下一个线程
+    void retireCache(ThreadCache* c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(uint32_t i = 0; i < c->count; i++)
+            _free.push_back(c->items[i]);
+        c->count = 0;
+        _idleCaches.push_back(c);
+    }
+
+    //调用方持有 c 的锁；慢路径，不内联进 acquire()
+    __attribute__((noinline)) bool refill(ThreadCache& c){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()) stealLocked(c);
+        if(_free.empty()) return false;
+        uint32_t n = static_cast<uint32_t>(std::min<size_t>(_batch, _free.size()));
+        for(uint32_t i = 0; i < n; i++){
+            c.items[c.count++] = _free.back();
+            _free.pop_back();
+        }
+        _refills++;
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    //全局栈空了：把别的线程缓存里的编号拿回一半（至少一个），凑够一批就停
+    void stealLocked(ThreadCache& self){
+        for(auto& other : _caches){
+            if(_free.size() >= _batch) break;
+            ThreadCache* v = other.get();
+            if(v == &self || !v->tryLock()) continue;
+            uint32_t n = (v->count + 1) / 2;
+            for(uint32_t i = 0; i < n; i++)
+                _free.push_back(v->items[--v->count]);
+            v->unlock();
+            if(n) _steals++;
+        }
+    }
+
+    bool popGlobal(uint32_t& index){
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty()){
+            bump(_globalExhausted);
+            return false;
+        }
+        index = _free.back();
+        _free.pop_back();
+        bump(_globalAcquires);
+        _highWater = std::max(_highWater, _count - _free.size());
+        return true;
+    }
+
+    void release(uint32_t index){
+        ThreadCache* c = localCache();
+        if(!c){
+            std::lock_guard<std::mutex> lock(_mutex);
+            _free.push_back(index);
+            return;
+        }
+        c->lock();
+        if(c->count == _cacheMax){
+            std::lock_guard<std::mutex> lock(_mutex);
+            for(uint32_t i = 0; i < _batch; i++)
+                _free.push_back(c->items[--c->count]);
+            _flushes++;
+        }
+        c->items[c->count++] = index;
+        c->unlock();
+    }
+
+    //映射区按页对齐，所以对齐要求不能超过一页；算步长和总大小都不会回绕
+    static size_t checkedStride(size_t bufferSize, size_t count, size_t alignment){
+        if(bufferSize == 0 || count == 0 || count > UINT32_MAX ||
+           alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > SMALL_PAGE ||
+           bufferSize > SIZE_MAX - (alignment - 1))
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        size_t stride = (bufferSize + alignment - 1) / alignment * alignment;
+        if(stride > SIZE_MAX / count)
+            throw std::invalid_argument("BufferPool: bad size/count/alignment");
+        return stride;
+    }
+
+    uint8_t* bufferAt(uint32_t index) const {return _memory.data() + static_cast<size_t>(index) * _stride;}
+
+    const size_t _bufferSize;
+    const size_t _stride;
+    const size_t _count;
+    const uint32_t _cacheMax;                       // 本池每线程缓存上限
+    const uint32_t _batch;                          // 和全局栈一次交换的数量
+    PlacedRegion _memory;
+    std::unique_ptr<std::atomic<uint32_t>[]> _refs;
+
+    int _slot = -1;
+    uint64_t _serial = 0;
+
+    mutable std::mutex _mutex;                      // 保护下面的全局状态
+    std::vector<uint32_t> _free;
+    std::vector<std::unique_ptr<ThreadCache>> _caches;
+    std::vector<ThreadCache*> _idleCaches;
+    size_t _highWater = 0;
+    uint64_t _refills = 0;
+    uint64_t _flushes = 0;
+    uint64_t _steals = 0;
+    std::atomic<uint64_t> _globalAcquires{0};
+    std::atomic<uint64_t> _globalExhausted{0};
+};
+
+inline BufferPool::Shared BufferPool::Unique::share() && {
+    if(!_pool) return Shared();
+    BufferPool* pool = _pool;
+    _pool = nullptr;
+    pool->_refs[_index].store(1, std::memory_order_relaxed);
+    return Shared(pool, _index, _size);
+}
+
+
+// ---------------- 测量 ----------------
+
+//生产者、消费者分别绑到 cpuProd / cpuCons，推 items 个递增整数，返回 M items/s；顺序不对抛异常
+double ringThroughput(SpscRing<uint64_t>& ring, uint64_t items, int cpuProd, int cpuCons){
+    std::atomic<bool> go{false};
+    uint64_t t0 = 0, t1 = 0;
+    bool inOrder = true;
+    std::thread consumer([&]{
+        pinToCpu(cpuCons);
+        while(!go.load(std::memory_order_acquire)) std::this_thread::yield();
+        uint64_t expect = 0, v;
+        while(expect < items){
+            if(ring.pop(v)){
+                inOrder = inOrder && v == expect;
+                expect++;
+            }
+            else{
+                std::this_thread::yield();
+            }
+        }
+        t1 = nowNs();
+    });
+    std::thread producer([&]{
+        pinToCpu(cpuProd);
+        t0 = nowNs();
+        go.store(true, std::memory_order_release);
+        for(uint64_t i = 0; i < items;){
+            if(ring.push(i)) i++;
+            else std::this_thread::yield();
+        }
+    });
+    producer.join();
+    consumer.join();
+    if(!inOrder) throw std::runtime_error("SpscRing delivered items out of order");
+    return items / ((t1 - t0) / 1e3);
+}
+
+/*
+随机访问延迟：在整段内存里随机挑 slots 条缓存行串成一个环，顺着指针走 hops 步
+每一步都依赖上一步的结果，CPU 没法并行，测的就是“TLB + 缓存 + 内存”的真实延迟
+*/
+double chaseNs(PlacedRegion& r, size_t hops, int cpu){
+    pinToCpu(cpu);
+    const size_t lines = r.size() / 64;
+    const size_t slots = std::min<size_t>(lines, 1u << 20);
+    std::mt19937_64 rng(35);
+    std::vector<uint64_t> order(slots);
+    for(size_t i = 0; i < slots; i++) order[i] = (lines / slots) * i + rng() % (lines / slots);
+    std::shuffle(order.begin(), order.end(), rng);
+    uint64_t* mem = reinterpret_cast<uint64_t*>(r.data());
+    for(size_t i = 0; i < slots; i++)
+        mem[order[i] * 8] = order[(i + 1) % slots] * 8;
+
+    uint64_t pos = order[0] * 8;
+    uint64_t t0 = nowNs();
+    for(size_t i = 0; i < hops; i++) pos = mem[pos];
+    double ns = double(nowNs() - t0) / hops;
+    asm volatile("" : : "r"(pos));                      // 让 pos 保持有用，不被优化掉
+    return ns;
+}
+
+int main(){
+    try{
+        const std::vector<int> nodes = numaNodes();
+        const int local = nodes.front();
+        const std::vector<int> localCpus = cpusOfNode(local);
+        const int cpuA = localCpus.front();
+        const int cpuB = localCpus.size() > 1 ? localCpus[1] : localCpus.front();
+
+        std::cout << "numa nodes:";
+        for(int n : nodes){
+            std::cout << " node" << n << "(cpus";
+            for(int c : cpusOfNode(n)) std::cout << " " << c;
+            std::cout << ")";
+        }
+        std::cout << "\n\n";
+
+        // ---------- 1) 各种放置方式实际拿到了什么 ----------
+        const size_t REGION = 64u << 20;
+        std::cout << "placements (" << (REGION >> 20) << " MB each):\n";
+        auto row = [](const std::string& label, const PlacedRegion& r){
+            std::cout << "  " << std::left << std::setw(30) << label << std::right << ": " << describe(r) << "\n";
+        };
+        {
+            PlacedRegion r(REGION, MemoryPlacement{});
+            row("4K, first-touch by main", r);
+        }
+        {
+            PlacedRegion r(REGION, MemoryPlacement{local, false, true});
+            row("4K, mbind node" + std::to_string(local), r);
+        }
+        {
+            PlacedRegion r(REGION, MemoryPlacement{local, true, true});
+            row("huge, mbind node" + std::to_string(local), r);
+        }
+        {
+            int absent = nodes.back() + 1;
+            PlacedRegion r(REGION, MemoryPlacement{absent, true, true});
+            row("huge, mbind node" + std::to_string(absent) + " (absent)", r);
+        }
+        {
+            //不预缺页：由所属线程（绑在本节点 CPU 上）第一次碰，页就落在它的节点
+            PlacedRegion r(REGION, MemoryPlacement{-1, true, false});
+            std::thread owner([&]{
+                pinToCpu(cpuB);
+                r.touch();
+            });
+            owner.join();
+            row("huge, first-touch by owner", r);
+        }
+        {
+            BufferPool pool(2048, 8192, 64, MemoryPlacement{local, true, true});
+            BufferPool::Unique a = pool.acquire(), b = pool.acquire();
+            std::memset(a.data(), 0x5A, a.capacity());
+            row("BufferPool 8192 x 2KB, huge", pool.memory());
+            std::cout << "      acquire/release ok: " << (a && b && a.data() != b.data() ? "yes" : "NO") << "\n";
+        }
+        {
+            //小池跨线程：主线程取光，另一个线程全部还掉后不退出（编号留在它的缓存里），主线程必须能再取光
+            BufferPool pool(2048, 32, 64, MemoryPlacement{local, false, true});
+            std::vector<BufferPool::Unique> held;
+            for(BufferPool::Unique u = pool.acquire(); u; u = pool.acquire()) held.push_back(std::move(u));
+            std::atomic<int> phase{0};
+            std::thread releaser([&]{
+                held.clear();
+                phase.store(1, std::memory_order_release);
+                while(phase.load(std::memory_order_acquire) != 2) std::this_thread::yield();
+            });
+            while(phase.load(std::memory_order_acquire) != 1) std::this_thread::yield();
+            std::vector<BufferPool::Unique> again;
+            for(BufferPool::Unique u = pool.acquire(); u; u = pool.acquire()) again.push_back(std::move(u));
+            phase.store(2, std::memory_order_release);
+            releaser.join();
+            std::cout << "  BufferPool 32, cross-thread   : released on another thread, reacquired " << again.size() << "/32"
+                      << " (steals=" << pool.stats().steals << ")\n";
+            if(again.size() != 32) throw std::runtime_error("BufferPool: buffers released on another thread were not reusable");
+        }
+
+        // ---------- 2) SPSC 环：本节点 vs 跨节点，4K vs 大页 ----------
+        struct Variant {
+            const char* name;
+            int memNode;
+            bool huge;
+        };
+        std::vector<Variant> variants = {{"local, 4K", local, false}, {"local, huge", local, true}};
+        if(nodes.size() > 1){
+            variants.push_back({"remote, 4K", nodes.back(), false});
+            variants.push_back({"remote, huge", nodes.back(), true});
+        }
+
+        std::cout << "\nSPSC ring, producer on cpu" << cpuA << ", consumer on cpu" << cpuB << " (node" << local << ")";
+        if(nodes.size() == 1) std::cout << "\n  only one NUMA node on this host: cross-node rows skipped";
+        std::cout << "\n  " << std::left << std::setw(10) << "ring" << std::setw(14) << "placement" << std::right
+                  << std::setw(16) << "M items/s" << std::setw(18) << "random read ns" << "   backing\n";
+
+        const uint64_t ITEMS = 16u << 20;
+        const size_t HOPS = 4u << 20;
+        for(size_t bytes : {size_t(1) << 20, size_t(16) << 20, size_t(256) << 20}){
+            for(const Variant& v : variants){
+                SpscRing<uint64_t> ring(bytes / sizeof(uint64_t), MemoryPlacement{v.memNode, v.huge, true});
+                double mips = ringThroughput(ring, ITEMS, cpuA, cpuB);
+                double ns = chaseNs(ring.region(), HOPS, cpuB);
+                std::cout << "  " << std::left << std::setw(10) << (std::to_string(bytes >> 20) + " MB")
+                          << std::setw(14) << v.name << std::right << std::fixed
+                          << std::setw(16) << std::setprecision(1) << mips
+                          << std::setw(18) << std::setprecision(1) << ns
+                          << "   " << backingName(ring.region().backing())
+                          << " (" << (ring.region().hugeBytes() >> 20) << " MB huge)\n";
+            }
+        }
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,606 @@
+/*
+按帧类型路由：O(1) 类型表 + 重类型独占消费线程
+
+问题：
+night6 格式的每一帧都带一个 type 字节，但是没有任何地方按它分发
+气压、姿态、电源帧全走同一条路径：气压滤波慢一点，后面排着的电源帧就跟着一起等
+
+night36 的做法：
+1. FrameRouter：256 项的 type → Route 表，按 type 字节直接下标，O(1)，没有 map/switch
+   Route 里是处理函数（函数指针 + 上下文，和 night31 的 Sink 一样）和它所在的 lane
+2. lane：
+   - INLINE：在路由线程上直接调用（轻量类型）
+   - addLane() 开的独占 lane：一个有界队列（night24）+ 一条消费线程，重类型自己排队，不挡别人
+   一个类型只属于一个 lane，lane 是单消费者 FIFO，所以同一类型内部保持顺序（不同类型之间不保证）
+   队列满时路由线程等待（不丢帧，按 night27 的 Backoff 退让），记一次 queueFull
+3. 计数：每个类型 dispatched（路由线程写）/ handled（处理它的线程写），分开放在不同缓存行；没注册的类型记 unrouted
+   处理函数不应该抛异常；万一抛了，lane 记下第一个异常继续消费，stop() 时再抛出来
+4. main：按固定节奏喂串口数据（每 1ms 一块），同一份数据跑两种配置
+   - single path：全部 INLINE（原来的做法）
+   - routed：气压、姿态各自一条 lane，电源、温度 INLINE
+   每个类型：帧数、吞吐、从读到数据到处理完的延迟 p50/p99、类型内乱序次数
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <iterator>
+#include <exception>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// ---------------- 有界队列（night24，移动语义版）和工具 ----------------
+
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _mask(roundUp(capacity) - 1), _cells(new Cell[_mask + 1]) {
+        for (size_t i = 0; i <= _mask; i++)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        _enqueuePos.store(0, std::memory_order_relaxed);
+        _dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    bool push(T&& data) {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 满（data 没有被移走）
+            } else {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(data);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& data) {
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;                           // 空
+            } else {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        data = std::move(cell->data);
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const {return _mask + 1;}
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t v = 2;
+        while (v < n) v <<= 1;
+        return v;
+    }
+
+    const size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    alignas(64) std::atomic<size_t> _enqueuePos;    // 生产者和消费者的位置分开放，避免伪共享
+    alignas(64) std::atomic<size_t> _dequeuePos;
+};
+
+//单写者计数：只有所属线程写，其他线程只读（night21）
+static void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static uint64_t nowNs(){
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t now_ms(){
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(
+        steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//等待策略：先空转，再让出 CPU，最后睡眠（单核机器上空转没有意义，很快就退到 yield）
+struct Backoff {
+    uint32_t n = 0;
+    void wait(){
+        if(n < 32){
+            n++;
+        }
+        else if(n < 32 + 256){
+            n++;
+            std::this_thread::yield();
+        }
+        else{
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+};
+//帧解析器（沿用 night20）
+class SimpleUartParser{
+public:
+    static const uint8_t HEAD1 = 0XAA;
+    static const uint8_t HEAD2 = 0X55;
+    static const uint8_t MAX_LENGTH = 32;
+
+    SimpleUartParser(uint32_t timeout_us) : timeout(timeout_us){
+        reset();
+    }
+
+    bool feed(uint8_t byte,uint32_t now_ms){
+        if(now_ms - last_time > timeout){
+            reset();
+        }
+        last_time = now_ms;
+
+        switch(state){
+            case 0:
+                if(byte == HEAD1)
+                    state = 1;
+                break;
+            case 1:
+                if(byte == HEAD2)
+                    state = 2;
+                else
+                    state = 0;
+                break;
+            case 2:
+                length = byte;
+                if(length > MAX_LENGTH){
+                    reset();
+                }
+                else{
+                    index = 0;
+                    checksum = length;
+                    state = 3;
+                }
+                break;
+            case 3:
+                buffer[index++] = byte;
+                checksum += byte;
+                if(index >= length)
+                    state = 4;
+                break;
+            case 4:
+                if((checksum & 0xFF) == byte){
+                    state = 0;
+                    return true;
+                }
+                else{
+                    reset();
+                }
+                break;
+        }
+
+        return false;
+    }
+
+    //一次喂一段连续数据，每收到一帧回调 onFrame(data, size)
+    template <typename F>
+    void feed(const uint8_t* p, size_t n, uint32_t now_ms, F&& onFrame){
+        for(size_t i = 0; i < n; i++){
+            if(feed(p[i], now_ms))
+                onFrame(data(), size());
+        }
+    }
+
+    uint8_t* data() {return buffer;}
+    uint8_t size() {return length;}
+
+private:
+    void reset(){
+        state = 0;
+        length = 0;
+        index = 0;
+        checksum = 0;
+    }
+
+    uint8_t state;
+    uint8_t length;
+    uint8_t index;
+    uint8_t checksum;
+    uint8_t buffer[MAX_LENGTH];
+    uint32_t timeout;
+    uint32_t last_time = 0;
+};
+
+
+// ---------------- 解码（night6 的 22 字节传感器帧） ----------------
+
+//le:小端序  be：大端序（night6）
+static uint16_t le16(const uint8_t* p){
+    return uint16_t(p[0]) | (uint16_t(p[1]) << 8);
+}
+
+static uint32_t le32(const uint8_t* p){
+    return uint32_t(p[0]) |
+    (uint32_t(p[1]) << 8) |
+    (uint32_t(p[2]) << 16) |
+    (uint32_t(p[3]) << 24);
+}
+
+static uint16_t be16(const uint8_t* p){
+    return uint16_t(p[0] << 8) | (uint16_t(p[1]));
+}
+
+static uint32_t be32(const uint8_t* p){
+    return (uint32_t(p[0]) << 24) |
+    (uint32_t(p[1]) << 16) |
+    (uint32_t(p[2]) << 8) |
+    (uint32_t(p[3]));
+}
+
+constexpr size_t SENSOR_FRAME_LEN = 22;
+
+struct Sample {
+    uint64_t ts_ns = 0;                 // 这块数据从串口读到的时间，算端到端延迟用
+    uint8_t type = 0;
+    uint16_t len = 0;
+    uint32_t seq = 0;
+    uint32_t pressure = 0;
+    int16_t temp_x100 = 0;
+    uint16_t voltage = 0;
+    int32_t yaw_x10 = 0;
+};
+
+//magic/tail/长度不对返回 false
+bool decodeSample(const uint8_t* p, size_t n, Sample& s){
+    if(n != SENSOR_FRAME_LEN || p[0] != 0xAA || p[1] != 0x55 || p[21] != 0x0D) return false;
+    s.type = p[2];
+    s.len = le16(&p[3]);
+    s.seq = le32(&p[5]);
+    s.pressure = be32(&p[9]);
+    s.temp_x100 = static_cast<int16_t>(be16(&p[13]));
+    s.voltage = le16(&p[15]);
+    s.yaw_x10 = static_cast<int32_t>(be32(&p[17]));
+    return true;
+}
+
+// ---------------- FrameRouter ----------------
+
+/*
+type 字节 → 处理函数
+用法：addLane()/route() 配好 → start() → 路由线程 dispatch() → stop()（等所有 lane 排空再退出）
+route() 只能在 start() 之前调用；dispatch() 只能由一个线程调用（inline 处理函数就跑在这个线程上）
+*/
+class FrameRouter {
+public:
+    using Handler = void (*)(void* ctx, const Sample& s);
+    static constexpr int INLINE = -1;
+
+    struct TypeStats {
+        uint8_t type;
+        std::string name;
+        std::string lane;
+        uint64_t dispatched;
+        uint64_t handled;
+        uint64_t queueFull;             // 路由线程因为这个类型的队列满而等待的次数
+    };
+
+    FrameRouter() = default;
+    ~FrameRouter(){
+        try{
+            stop();
+        }
+        catch(...){
+        }
+    }
+
+    FrameRouter(const FrameRouter&) = delete;
+    FrameRouter& operator = (const FrameRouter&) = delete;
+
+    //开一条独占 lane（队列 + 消费线程），返回 lane 编号
+    int addLane(const std::string& name, size_t capacity){
+        if(_started) throw std::logic_error("FrameRouter: addLane after start");
+        _lanes.push_back(std::make_unique<Lane>(name, capacity));
+        return static_cast<int>(_lanes.size() - 1);
+    }
+
+    void route(uint8_t type, const std::string& name, Handler fn, void* ctx, int lane = INLINE){
+        if(_started) throw std::logic_error("FrameRouter: route after start");
+        if(!fn) throw std::invalid_argument("FrameRouter: null handler for " + name);
+        if(lane != INLINE && (lane < 0 || lane >= static_cast<int>(_lanes.size())))
+            throw std::invalid_argument("FrameRouter: no lane " + std::to_string(lane) + " for " + name);
+        Route& r = _routes[type];
+        if(r.fn) throw std::invalid_argument("FrameRouter: type " + std::to_string(type) + " already routed to " + r.name);
+        r.fn = fn;
+        r.ctx = ctx;
+        r.lane = lane == INLINE ? nullptr : _lanes[lane].get();
+        r.name = name;
+    }
+
+    void start(){
+        if(_started) return;
+        _started = true;
+        for(auto& l : _lanes){
+            Lane* lane = l.get();
+            lane->thread = std::thread([this, lane]{ runLane(*lane); });
+        }
+    }
+
+    //O(1)：按 type 下标取路由，inline 直接调用，否则进这个类型的 lane 队列
+    void dispatch(const Sample& s){
+        Route& r = _routes[s.type];
+        if(!r.fn){
+            bump(_unrouted);
+            return;
+        }
+        bump(r.dispatched);
+        if(!r.lane){
+            call(r, s, _inlineError);
+            return;
+        }
+        Sample copy = s;
+        if(r.lane->queue.push(std::move(copy))) return;
+        bump(r.queueFull);
+        Backoff backoff;
+        do{
+            backoff.wait();
+            copy = s;
+        }while(!r.lane->queue.push(std::move(copy)));
+    }
+
+    //等所有 lane 把队列里的帧处理完，再收线程；处理函数抛过异常就在这里抛出第一个
+    void stop(){
+        if(!_started || _stopped) return;
+        _stopped = true;
+        _stopping.store(true, std::memory_order_release);
+        for(auto& l : _lanes)
+            if(l->thread.joinable()) l->thread.join();
+        if(_inlineError) std::rethrow_exception(_inlineError);
+        for(auto& l : _lanes)
+            if(l->error) std::rethrow_exception(l->error);
+    }
+
+    std::vector<TypeStats> stats() const {
+        std::vector<TypeStats> out;
+        for(size_t t = 0; t < _routes.size(); t++){
+            const Route& r = _routes[t];
+            if(!r.fn) continue;
+            out.push_back({static_cast<uint8_t>(t), r.name, r.lane ? r.lane->name : std::string("inline"),
+                           r.dispatched.load(std::memory_order_relaxed), r.handled.load(std::memory_order_relaxed),
+                           r.queueFull.load(std::memory_order_relaxed)});
+        }
+        return out;
+    }
+
+    uint64_t unrouted() const {return _unrouted.load(std::memory_order_relaxed);}
+
+private:
+    struct Lane {
+        Lane(const std::string& n, size_t capacity) : name(n), queue(capacity) {}
+        std::string name;
+        BoundedQueue<Sample> queue;
+        std::thread thread;
+        std::exception_ptr error;
+    };
+
+    struct Route {
+        Handler fn = nullptr;
+        void* ctx = nullptr;
+        Lane* lane = nullptr;           // nullptr：inline
+        std::string name;
+        std::atomic<uint64_t> dispatched{0};            // 路由线程写
+        std::atomic<uint64_t> queueFull{0};             // 路由线程写
+        alignas(64) std::atomic<uint64_t> handled{0};   // 处理它的线程写，和上面分开缓存行
+    };
+
+    void call(Route& r, const Sample& s, std::exception_ptr& error){
+        try{
+            r.fn(r.ctx, s);
+        }
+        catch(...){
+            if(!error) error = std::current_exception();
+        }
+        bump(r.handled);
+    }
+
+    void runLane(Lane& lane){
+        Sample s;
+        Backoff backoff;
+        while(true){
+            if(lane.queue.pop(s)){
+                call(_routes[s.type], s, lane.error);
+                backoff = Backoff{};
+                continue;
+            }
+            if(_stopping.load(std::memory_order_acquire)){
+                //看到 stopping 之后再确认一次队列是空的：stop() 之前 dispatch 进来的帧一定会被处理
+                if(!lane.queue.pop(s)) break;
+                call(_routes[s.type], s, lane.error);
+                continue;
+            }
+            backoff.wait();
+        }
+    }
+
+    std::array<Route, 256> _routes;
+    std::vector<std::unique_ptr<Lane>> _lanes;
+    std::atomic<uint64_t> _unrouted{0};
+    std::exception_ptr _inlineError;
+    std::atomic<bool> _stopping{false};
+    bool _started = false;
+    bool _stopped = false;
+};
+
+// ---------------- 测试数据和处理函数 ----------------
+
+enum : uint8_t {TYPE_PRESSURE = 0x10, TYPE_ATTITUDE = 0x11, TYPE_POWER = 0x12, TYPE_TEMPERATURE = 0x13};
+
+//生成一段抓包：AA 55 len [night6 传感器帧] crc；类型按 4:3:2:1 混合，偶尔一个没注册的类型 0x7F
+std::vector<uint8_t> makeCapture(size_t frames, uint32_t seed){
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> out;
+    out.reserve(frames * (SENSOR_FRAME_LEN + 4));
+    for(uint32_t seq = 0; seq < frames; seq++){
+        uint32_t r = rng() % 1000;
+        uint8_t type = r < 400 ? TYPE_PRESSURE : r < 700 ? TYPE_ATTITUDE : r < 900 ? TYPE_POWER : r < 999 ? TYPE_TEMPERATURE : 0x7F;
+        uint8_t p[SENSOR_FRAME_LEN] = {
+            0xAA, 0x55, type, 0x07, 0x00,
+            uint8_t(seq), uint8_t(seq >> 8), uint8_t(seq >> 16), uint8_t(seq >> 24),
+            0x00, 0x01, 0x8B, 0xCD, 0x09, 0xE6, 0x82, 0x2D, 0xFF, 0xFF, 0xFF, 0x85, 0x0D};
+        out.push_back(0xAA);
+        out.push_back(0x55);
+        out.push_back(static_cast<uint8_t>(SENSOR_FRAME_LEN));
+        uint8_t crc = static_cast<uint8_t>(SENSOR_FRAME_LEN);
+        for(uint8_t b : p){
+            out.push_back(b);
+            crc += b;
+        }
+        out.push_back(crc);
+    }
+    return out;
+}
+
+//每个类型一份：检查类型内顺序（seq 严格递增）、记录端到端延迟；workNs 模拟处理耗时
+struct TypeSink {
+    uint64_t workNs = 0;
+    uint32_t lastSeq = 0;
+    bool first = true;
+    uint64_t orderErrors = 0;
+    uint64_t frames = 0;
+    uint64_t firstNs = 0;
+    uint64_t lastNs = 0;
+    std::vector<uint32_t> latencyNs;
+
+    static void handle(void* ctx, const Sample& s){
+        TypeSink& t = *static_cast<TypeSink*>(ctx);
+        if(t.workNs){
+            uint64_t until = nowNs() + t.workNs;
+            while(nowNs() < until){}
+        }
+        if(!t.first && s.seq <= t.lastSeq) t.orderErrors++;
+        t.first = false;
+        t.lastSeq = s.seq;
+        uint64_t now = nowNs();
+        if(t.frames++ == 0) t.firstNs = now;
+        t.lastNs = now;
+        t.latencyNs.push_back(static_cast<uint32_t>(std::min<uint64_t>(now - s.ts_ns, UINT32_MAX)));
+    }
+
+    uint32_t percentile(double p) const {
+        if(latencyNs.empty()) return 0;
+        std::vector<uint32_t> v = latencyNs;
+        size_t k = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+};
+
+struct TypeSpec {
+    uint8_t type;
+    const char* name;
+    uint64_t workNs;
+    bool heavy;                         // routed 配置里给它开独占 lane
+};
+
+const TypeSpec kTypes[] = {
+    {TYPE_PRESSURE,    "pressure",    4000, true},
+    {TYPE_ATTITUDE,    "attitude",    2000, true},
+    {TYPE_POWER,       "power",          0, false},
+    {TYPE_TEMPERATURE, "temperature",    0, false},
+};
+
+/*
+按固定节奏喂数据：每 periodUs 解析一块 chunkBytes（模拟串口每次 read 到的量），解出的帧交给路由器
+*/
+void runConfig(const char* title, bool routed, const std::vector<uint8_t>& capture, size_t chunkBytes, uint32_t periodUs){
+    std::vector<TypeSink> sinks(std::size(kTypes));
+    FrameRouter router;
+    for(size_t i = 0; i < std::size(kTypes); i++){
+        sinks[i].workNs = kTypes[i].workNs;
+        sinks[i].latencyNs.reserve(capture.size() / SENSOR_FRAME_LEN);
+        int lane = FrameRouter::INLINE;
+        if(routed && kTypes[i].heavy) lane = router.addLane(kTypes[i].name, 1u << 16);
+        router.route(kTypes[i].type, kTypes[i].name, &TypeSink::handle, &sinks[i], lane);
+    }
+    router.start();
+
+    SimpleUartParser parser(50);
+    uint64_t t0 = nowNs();
+    uint64_t next = t0;
+    for(size_t off = 0; off < capture.size(); off += chunkBytes){
+        next += uint64_t(periodUs) * 1000;
+        while(nowNs() < next) std::this_thread::sleep_for(std::chrono::microseconds(50));
+        size_t n = std::min(chunkBytes, capture.size() - off);
+        uint64_t arrived = nowNs();
+        parser.feed(capture.data() + off, n, now_ms(), [&](const uint8_t* d, uint8_t len){
+            Sample s;
+            if(!decodeSample(d, len, s)) return;
+            s.ts_ns = arrived;
+            router.dispatch(s);
+        });
+    }
+    router.stop();
+    double sec = (nowNs() - t0) / 1e9;
+
+    std::cout << title << " (" << std::fixed << std::setprecision(2) << sec << " s, unrouted=" << router.unrouted() << ")\n";
+    std::vector<FrameRouter::TypeStats> stats = router.stats();
+    for(size_t i = 0; i < stats.size(); i++){
+        const FrameRouter::TypeStats& st = stats[i];
+        const TypeSink& t = sinks[i];
+        std::cout << "  0x" << std::hex << int(st.type) << std::dec << " " << std::left << std::setw(12) << st.name
+                  << std::setw(10) << st.lane << std::right
+                  << " frames=" << std::setw(6) << st.handled << "/" << std::setw(6) << st.dispatched
+                  << std::setprecision(0) << std::setw(8) << st.handled / sec << " frames/s"
+                  << std::setprecision(1) << "  latency p50=" << std::setw(7) << t.percentile(0.5) / 1000.0
+                  << "us p99=" << std::setw(7) << t.percentile(0.99) / 1000.0 << "us"
+                  << "  out-of-order=" << t.orderErrors << "  queue-full=" << st.queueFull << "\n";
+    }
+}
+
+int main(){
+    try{
+        //每 1ms 一块 4KB（约 150 帧），跑 2 秒
+        const size_t CHUNK = 4096;
+        const uint32_t PERIOD_US = 1000;
+        std::vector<uint8_t> capture = makeCapture(2000 * CHUNK / (SENSOR_FRAME_LEN + 4), 36);
+
+        //配置错误在 start() 之前就报出来
+        try{
+            FrameRouter r;
+            r.route(TYPE_POWER, "power", &TypeSink::handle, nullptr);
+            r.route(TYPE_POWER, "power-again", &TypeSink::handle, nullptr);
+        }
+        catch(const std::invalid_argument& e){
+            std::cout << "rejected: " << e.what() << "\n\n";
+        }
+
+        runConfig("single path (all inline)", false, capture, CHUNK, PERIOD_US);
+        std::cout << "\n";
+        runConfig("routed (pressure/attitude on own lanes)", true, capture, CHUNK, PERIOD_US);
+    }
+    catch(const std::exception& e){
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}